@@ -51,7 +51,7 @@ static const ble_gap_adv_params_t   m_adv_params_nonconnectable = {
 /*---------------------------------------------------------------------------*/
 void advertising_start_connectable(void)
 {
-    PUTS(__func__);
+    LOG_DEBUG("%s\n", __func__);
 
     APP_ERROR_CHECK( sd_ble_gap_adv_start(&m_adv_params_connectable) );
 
@@ -63,7 +63,7 @@ void advertising_start_connectable(void)
 /*---------------------------------------------------------------------------*/
 void advertising_start_nonconnectable(void)
 {
-    PUTS(__func__);
+    LOG_DEBUG("%s\n", __func__);
 
     APP_ERROR_CHECK( sd_ble_gap_adv_start(&m_adv_params_nonconnectable) );
 }
@@ -73,7 +73,7 @@ void advertising_start_nonconnectable(void)
 /*---------------------------------------------------------------------------*/
 void advertising_init(void)
 {
-    PUTS(__func__);
+    LOG_DEBUG("%s\n", __func__);
 
     /* Build (refresh) all Eddystone frames. */
     eddystone_init();
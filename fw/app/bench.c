@@ -0,0 +1,37 @@
+/*---------------------------------------------------------------------------*/
+/*  bench.c  -- timing of code on the target, see bench.h                    */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdint.h>
+
+#include "nrf51.h"
+#include "nrf51_bitfields.h"
+
+#include "bench.h"
+
+/*---------------------------------------------------------------------------*/
+/*  Interrupts, the SoftDevice's included, are timed with the calls: run it  */
+/*  before advertising starts.                                               */
+/*---------------------------------------------------------------------------*/
+uint32_t bench_run(bench_func_t p_func, uint32_t count)
+{
+    uint32_t i;
+    uint32_t ticks;
+
+    NRF_TIMER2->MODE      = TIMER_MODE_MODE_Timer;
+    NRF_TIMER2->BITMODE   = TIMER_BITMODE_BITMODE_32Bit << TIMER_BITMODE_BITMODE_Pos;
+    NRF_TIMER2->PRESCALER = 0;
+
+    NRF_TIMER2->TASKS_CLEAR = 1;
+    NRF_TIMER2->TASKS_START = 1;
+
+    for (i = 0; i < count; i++)
+        p_func();
+
+    NRF_TIMER2->TASKS_CAPTURE[0] = 1;
+    ticks = NRF_TIMER2->CC[0];
+
+    NRF_TIMER2->TASKS_SHUTDOWN = 1;
+
+    return ticks / count;
+}
@@ -0,0 +1,23 @@
+/*---------------------------------------------------------------------------*/
+/*  bench.h                                                                  */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <stdint.h>
+
+/*
+ *  Timing of code on the target, for comparing build profiles; built with
+ *  BENCHMARK, see the makefile.  TIMER2, unused otherwise, counts at 16 MHz.
+ */
+#define BENCH_TICKS_PER_US  16
+
+typedef void (*bench_func_t)(void);
+
+/*
+ *  Call p_func count times, and return the mean time of a call in ticks.
+ */
+uint32_t bench_run(bench_func_t p_func, uint32_t count);
+
+#endif  /* _BENCH_H_ */
@@ -93,6 +93,13 @@
 #define EDDYSTONE_URL                   1
 #define EDDYSTONE_TLM                   2
 
+/*
+ *  Send the reset count, see reset_stats.h, in the last two bytes of the
+ *  TLM frame, big endian and saturating; 0 leaves them 0x00, the RFU
+ *  value of the Eddystone TLM format.
+ */
+#define TLM_RESET_COUNT                 0
+
 /* 
  *  Handle of first application specific service when when 
  *  service changed characteristic is present.
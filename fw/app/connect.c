@@ -22,9 +22,14 @@
 #include "advert.h"
 #include "connect.h"
 #include "dbglog.h"
+#include "flash_sched.h"
+#include "diag_service.h"
 #include "pstorage_platform.h"
 #include "ble_dfu.h"
 #include "dfu_app_handler.h"
+#if defined(DFU_DUAL_BANK_SUPPORT)
+#include "dfu_bank.h"
+#endif
 
 /*---------------------------------------------------------------------------*/
 /*                                                                           */
@@ -178,7 +183,7 @@ uint32_t service_changed_indicate(void)
         case BLE_ERROR_NO_TX_BUFFERS:
         case NRF_ERROR_BUSY:
         case BLE_ERROR_GATTS_SYS_ATTR_MISSING:
-            PRINTF("service_changed minor error: %u\n", (unsigned)err_code); 
+            LOG_WARN("service_changed minor error: %u\n", (unsigned)err_code); 
             break;
 
         case NRF_ERROR_NOT_SUPPORTED:
@@ -285,6 +290,21 @@ static void reset_prepare(void)
     }
 }
 
+/*---------------------------------------------------------------------------*/
+/*  DFU Service events: application updates are received into bank 1, all   */
+/*  others reset into the bootloader.                                        */
+/*---------------------------------------------------------------------------*/
+#if defined(DFU_DUAL_BANK_SUPPORT)
+static void dfu_evt_handler(ble_dfu_t * p_dfu, ble_dfu_evt_t * p_evt)
+{
+    if (!dfu_bank_on_dfu_evt(p_dfu, p_evt)) {
+        dfu_app_on_dfu_evt(p_dfu, p_evt);
+    }
+}
+#else
+#define dfu_evt_handler  dfu_app_on_dfu_evt
+#endif
+
 /*---------------------------------------------------------------------------*/
 /*  Initializing the DFU Service.                                            */
 /*---------------------------------------------------------------------------*/
@@ -294,7 +314,7 @@ static void dfu_init(void)
 
     /* Initialize the Device Firmware Update Service. */
     memset(&dfus_init, 0, sizeof(dfus_init));
-    dfus_init.evt_handler   = dfu_app_on_dfu_evt;
+    dfus_init.evt_handler   = dfu_evt_handler;
     dfus_init.error_handler = NULL;
 
     APP_ERROR_CHECK( ble_dfu_init(&m_dfus, &dfus_init) );
@@ -308,6 +328,7 @@ static void dfu_init(void)
 void services_init(void)
 {    
     dfu_init();
+    diag_service_init();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -316,6 +337,8 @@ void services_init(void)
 void storage_init(void)
 {   
     APP_ERROR_CHECK( pstorage_init() );
+
+    flash_sched_init();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -427,6 +450,12 @@ void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 
     ble_dfu_on_ble_evt(&m_dfus, p_ble_evt);
 
+#if defined(DFU_DUAL_BANK_SUPPORT)
+    dfu_bank_on_ble_evt(p_ble_evt);
+#endif
+
+    diag_service_on_ble_evt(p_ble_evt);
+
     on_ble_evt(p_ble_evt);
 }
 
@@ -457,6 +486,7 @@ static void on_sys_evt(uint32_t sys_evt)
 void sys_evt_dispatch(uint32_t sys_evt)
 {
     pstorage_sys_event_handler(sys_evt);
+    flash_sched_on_sys_evt(sys_evt);
 
     on_sys_evt(sys_evt);
 }
@@ -0,0 +1,221 @@
+/*---------------------------------------------------------------------------*/
+/*  crash.c  -- crash records kept over a reset, see crash.h                 */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "nrf51.h"
+#include "app_error.h"
+#include "pstorage.h"
+
+#include "crash.h"
+#include "flash_sched.h"
+#include "reset_stats.h"
+#include "uptime.h"
+#include "dbglog.h"
+
+#define CRASH_MAGIC  0x48535243   /* "CRSH" */
+
+#define CHECKSUM_WORDS  (offsetof(crash_record_t, checksum) / sizeof(uint32_t))
+
+/* Not cleared at startup, see the .noinit section of the linker script. */
+static crash_record_t      m_saved __attribute__((section(".noinit")));
+
+/* The latest record, as written to flash; kept until the store is done. */
+static crash_record_t      m_record;
+
+static pstorage_handle_t   m_handle;
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static uint32_t record_checksum(const crash_record_t * p_record)
+{
+    const uint32_t * p_words = (const uint32_t *) p_record;
+    uint32_t         sum     = 0;
+    uint32_t         i;
+
+    for (i = 0; i < CHECKSUM_WORDS; i++)
+        sum = ((sum << 1) | (sum >> 31)) + p_words[i];
+
+    return ~sum;
+}
+
+static bool record_valid(const crash_record_t * p_record)
+{
+    return (p_record->magic    == CRASH_MAGIC) &&
+           (p_record->checksum == record_checksum(p_record));
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Start a record: what is known in either handler.                         */
+/*---------------------------------------------------------------------------*/
+static void record_start(uint16_t type)
+{
+    memset(&m_saved, 0, sizeof(m_saved));
+
+    m_saved.magic  = CRASH_MAGIC;
+    m_saved.type   = type;
+    m_saved.icsr   = SCB->ICSR;
+    m_saved.uptime = uptime_get();
+
+    /* Counted by reset_stats_init(), which may not have run yet. */
+    if (reset_stats_ready())
+        m_saved.resets = reset_stats_get()->resets;
+}
+
+static void record_frame(const uint32_t * p_frame)
+{
+    m_saved.lr  = p_frame[5];
+    m_saved.pc  = p_frame[6];
+    m_saved.psr = p_frame[7];
+    m_saved.sp  = (uint32_t) p_frame;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void crash_fault_save(const uint32_t * p_frame)
+{
+    record_start(CRASH_TYPE_HARD_FAULT);
+    record_frame(p_frame);
+
+    m_saved.checksum = record_checksum(&m_saved);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The frame is that of the code the timeout interrupted: where it hung.    */
+/*---------------------------------------------------------------------------*/
+void crash_watchdog_save(const uint32_t * p_frame, uint32_t missing)
+{
+    record_start(CRASH_TYPE_WATCHDOG);
+    record_frame(p_frame);
+
+    m_saved.error_code = missing;
+
+    m_saved.checksum = record_checksum(&m_saved);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void crash_error_save(uint32_t        error_code,
+                      uint32_t        line,
+                      const uint8_t * p_file_name,
+                      uint32_t        caller)
+{
+    size_t length;
+
+    record_start(CRASH_TYPE_APP_ERROR);
+
+    m_saved.error_code = error_code;
+    m_saved.line       = line;
+    m_saved.lr         = caller;
+    m_saved.sp         = __get_MSP();
+
+    /* The end of the name tells the file apart; keep the terminator. */
+    if (p_file_name != NULL) {
+        length = strlen((const char *) p_file_name);
+        if (length > CRASH_FILE_LENGTH - 1)
+            p_file_name += length - (CRASH_FILE_LENGTH - 1);
+        strncpy(m_saved.file, (const char *) p_file_name, CRASH_FILE_LENGTH - 1);
+    }
+
+    m_saved.checksum = record_checksum(&m_saved);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+const crash_record_t * crash_record_get(void)
+{
+    return &m_record;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The page is only registered with pstorage: the record is written through */
+/*  the flash scheduler, so pstorage has nothing to call back about.          */
+/*---------------------------------------------------------------------------*/
+static void pstorage_callback_handler(pstorage_handle_t * p_handle,
+                                      uint8_t             op_code,
+                                      uint32_t            result,
+                                      uint8_t           * p_data,
+                                      uint32_t            data_len)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/*  A record which cannot be written is only logged: it is not worth an      */
+/*  app error, and another crash, of its own.                                */
+/*---------------------------------------------------------------------------*/
+static void flash_callback_handler(uint8_t  op_code,
+                                   uint32_t result,
+                                   uint32_t size,
+                                   uint32_t count)
+{
+    if (result != NRF_SUCCESS)
+        LOG_WARN("crash: record not written (%u)\n", (unsigned) result);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The record has its page to itself, so erasing it and storing the record  */
+/*  is the update pstorage would do, only in the radio idle windows.         */
+/*---------------------------------------------------------------------------*/
+static void record_write(void)
+{
+    pstorage_handle_t block;
+    uint32_t          err_code;
+
+    APP_ERROR_CHECK( pstorage_block_identifier_get(&m_handle, 0, &block) );
+
+    err_code = flash_sched_clear(block.block_id, PSTORAGE_FLASH_PAGE_SIZE,
+                                 flash_callback_handler);
+    if (err_code == NRF_SUCCESS)
+        err_code = flash_sched_store(block.block_id, (const uint32_t *) &m_record,
+                                     sizeof(m_record), flash_callback_handler);
+
+    if (err_code != NRF_SUCCESS)
+        LOG_WARN("crash: record not queued (%u)\n", (unsigned) err_code);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void crash_init(void)
+{
+    pstorage_module_param_t param;
+    uint16_t                count;
+
+    param.block_size  = sizeof(crash_record_t);
+    param.block_count = 1;
+    param.cb          = pstorage_callback_handler;
+
+    APP_ERROR_CHECK( pstorage_register(&param, &m_handle) );
+
+    APP_ERROR_CHECK( pstorage_load((uint8_t *) &m_record, &m_handle, sizeof(m_record), 0) );
+
+    if (!record_valid(&m_record))
+        memset(&m_record, 0, sizeof(m_record));
+
+    if (!record_valid(&m_saved))
+        return;
+
+    count = m_record.count + 1;
+
+    m_record          = m_saved;
+    m_record.count    = count;
+    m_record.checksum = record_checksum(&m_record);
+
+    memset(&m_saved, 0, sizeof(m_saved));
+
+    LOG_ERROR("crash: type %u, pc 0x%x, lr 0x%x, error 0x%x line %u, uptime %u, resets %u\n",
+              (unsigned) m_record.type, (unsigned) m_record.pc,
+              (unsigned) m_record.lr, (unsigned) m_record.error_code,
+              (unsigned) m_record.line, (unsigned) m_record.uptime,
+              (unsigned) m_record.resets);
+
+    record_write();
+}
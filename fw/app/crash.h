@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------------------*/
+/*  crash.h                                                                  */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _CRASH_H_
+#define _CRASH_H_
+
+#include <stdint.h>
+
+/*
+ *  Crash records: the hard fault and app error handlers save what they know
+ *  to no-init RAM before the reset.  On the next boot the record is written
+ *  to the module's pstorage page, where the latest one is kept, and can be
+ *  read through the diagnostics service.  A watchdog timeout is recorded
+ *  likewise, with the check-ins which were missing, see watchdog.h.
+ */
+
+#define CRASH_TYPE_NONE         0
+#define CRASH_TYPE_HARD_FAULT   1
+#define CRASH_TYPE_APP_ERROR    2
+#define CRASH_TYPE_WATCHDOG     3
+
+#define CRASH_FILE_LENGTH       16
+
+typedef struct {
+    uint32_t magic;                     /* CRASH_MAGIC                        */
+    uint16_t type;                      /* CRASH_TYPE_xxx                     */
+    uint16_t count;                     /* crashes recorded so far            */
+    uint32_t error_code;                /* app error; missing watchdog check-ins */
+    uint32_t line;                      /* app error                          */
+    uint32_t pc;                        /* stacked; 0 for an app error        */
+    uint32_t lr;                        /* stacked; caller for an app error   */
+    uint32_t psr;                       /* stacked                            */
+    uint32_t sp;                        /* exception frame                    */
+    uint32_t icsr;                      /* SCB->ICSR: the active exception    */
+    uint32_t uptime;                    /* seconds since boot                 */
+    uint32_t resets;                    /* resets before the crash, all boots */
+    char     file[CRASH_FILE_LENGTH];   /* app error, end of the file name    */
+    uint32_t checksum;
+} crash_record_t;
+
+/*
+ *  Called by the fault handlers, with interrupts of their priority and
+ *  below blocked.  p_frame is the exception frame: r0-r3, r12, lr, pc, psr.
+ *  caller is the return address of app_error_handler().
+ */
+void crash_fault_save(const uint32_t * p_frame);
+void crash_watchdog_save(const uint32_t * p_frame, uint32_t missing);
+void crash_error_save(uint32_t        error_code,
+                      uint32_t        line,
+                      const uint8_t * p_file_name,
+                      uint32_t        caller);
+
+/*
+ *  Register the crash page with pstorage, and write a record saved before
+ *  the reset to it.  Call after device_manager_init(), so as not to move
+ *  the device manager's pstorage page.
+ */
+void crash_init(void);
+
+/*
+ *  The latest crash recorded; type is CRASH_TYPE_NONE if there is none.
+ */
+const crash_record_t * crash_record_get(void);
+
+#endif  /* _CRASH_H_ */
@@ -0,0 +1,77 @@
+/*---------------------------------------------------------------------------*/
+/*  dbglog.c  -- binary log records, see dbglog.h                            */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "uart.h"
+#include "dbglog.h"
+
+#define RECORD_HEADER_SIZE  4
+#define RECORD_MAX_SIZE     (RECORD_HEADER_SIZE + DBGLOG_ARGS_MAX * sizeof(uint32_t))
+
+/* Records dropped since the last DBGLOG_LOST_ID record. */
+static uint32_t  m_lost;
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static uint8_t * put_u32(uint8_t * p, uint32_t value)
+{
+    *p++ = (uint8_t) (value);
+    *p++ = (uint8_t) (value >> 8);
+    *p++ = (uint8_t) (value >> 16);
+    *p++ = (uint8_t) (value >> 24);
+    return p;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The record is queued whole or dropped, so the decoder stays in step.     */
+/*---------------------------------------------------------------------------*/
+static bool record_send(uint16_t fmt_id, uint8_t nargs, const uint32_t * p_args)
+{
+    uint8_t   record[RECORD_MAX_SIZE];
+    uint8_t * p = record;
+    uint8_t   i;
+
+    *p++ = DBGLOG_SYNC;
+    *p++ = nargs;
+    *p++ = (uint8_t) (fmt_id);
+    *p++ = (uint8_t) (fmt_id >> 8);
+
+    for (i = 0; i < nargs; i++)
+        p = put_u32(p, p_args[i]);
+
+    return uart_write(record, p - record);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void dbglog_record(uint16_t fmt_id, uint32_t nargs, ...)
+{
+    uint32_t args[DBGLOG_ARGS_MAX];
+    va_list  ap;
+    uint8_t  i;
+
+    if (nargs > DBGLOG_ARGS_MAX)
+        nargs = DBGLOG_ARGS_MAX;
+
+    va_start(ap, nargs);
+    for (i = 0; i < nargs; i++)
+        args[i] = va_arg(ap, uint32_t);
+    va_end(ap);
+
+    if (m_lost != 0) {
+        if (!record_send(DBGLOG_LOST_ID, 1, &m_lost)) {
+            m_lost++;
+            return;
+        }
+        m_lost = 0;
+    }
+
+    if (!record_send(fmt_id, nargs, args))
+        m_lost++;
+}
@@ -5,20 +5,114 @@
 #ifndef DBGLOG_H
 #define DBGLOG_H
 
-#if defined(PROVISION_DBGLOG)
+/*
+ *  Log levels.  DBGLOG_LEVEL is set for the build by the makefile, and a
+ *  module may log less by defining DBGLOG_MODULE_LEVEL before including
+ *  this header.  Calls above the level compile to nothing, their strings
+ *  included.  PRINTF and PUTS log at DBGLOG_LEVEL_INFO.
+ */
+#define DBGLOG_LEVEL_NONE   0
+#define DBGLOG_LEVEL_ERROR  1
+#define DBGLOG_LEVEL_WARN   2
+#define DBGLOG_LEVEL_INFO   3
+#define DBGLOG_LEVEL_DEBUG  4
+#define DBGLOG_LEVEL_TRACE  5
 
-#include <stdio.h>
+#if !defined(PROVISION_DBGLOG)
+  #define DBGLOG_THRESHOLD  DBGLOG_LEVEL_NONE
+#else
+  #if !defined(DBGLOG_LEVEL)
+    #define DBGLOG_LEVEL    DBGLOG_LEVEL_INFO
+  #endif
+  #if defined(DBGLOG_MODULE_LEVEL) && (DBGLOG_MODULE_LEVEL < DBGLOG_LEVEL)
+    #define DBGLOG_THRESHOLD  DBGLOG_MODULE_LEVEL
+  #else
+    #define DBGLOG_THRESHOLD  DBGLOG_LEVEL
+  #endif
+#endif
+
+/* For #if around code only needed by log calls of a level. */
+#define DBGLOG_ENABLED(level)  ((level) <= DBGLOG_THRESHOLD)
+
+#if defined(PROVISION_DBGLOG) && defined(DBGLOG_BINARY)
+
+#include <stdint.h>
 
-#define PRINTF   printf
-#define PUTS     puts
+/*
+ *  Binary logging: a log site sends a record holding the offset of its
+ *  format string in the .dbglog_fmt section, and its arguments, unformatted.
+ *  The section is not loaded, so the strings take no flash on the device;
+ *  gcc/dbglog_decode.py formats the records using the strings in the .elf.
+ *
+ *  Arguments are passed as 32 bit words, up to DBGLOG_ARGS_MAX.  A %s
+ *  argument is sent as a pointer and read from the .elf by the decoder, so
+ *  it must point to a string in flash.
+ *
+ *  Record: DBGLOG_SYNC, argument count, 16 bit format offset, arguments,
+ *  all little endian.
+ */
+#define DBGLOG_SYNC        0xA5
+#define DBGLOG_ARGS_MAX    8
+#define DBGLOG_LOST_ID     0xFFFF   /* one argument: records dropped */
 
-#else /* PROVISION_DBGLOG */
+void dbglog_record(uint16_t fmt_id, uint32_t nargs, ...);
 
-#define PRINTF(...)
-#define PUTS(s)
+#define DBGLOG_NARGS(...)  DBGLOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define DBGLOG_NARGS_(_, a1, a2, a3, a4, a5, a6, a7, a8, n, ...)  n
+
+#define DBGLOG_RECORD(fmt, ...)                                                \
+    do {                                                                       \
+        static const char _fmt[] __attribute__((section(".dbglog_fmt"))) = fmt; \
+        dbglog_record((uint16_t)(uint32_t) _fmt,                               \
+                      DBGLOG_NARGS(__VA_ARGS__), ##__VA_ARGS__);               \
+    } while (0)
+
+#define DBGLOG_PRINTF(fmt, ...)  DBGLOG_RECORD(fmt, ##__VA_ARGS__)
+#define DBGLOG_PUTS(s)           DBGLOG_RECORD("%s\n", s)
+
+#elif defined(PROVISION_DBGLOG)
+
+#include <stdio.h>
+
+#define DBGLOG_PRINTF  printf
+#define DBGLOG_PUTS    puts
 
 #endif /* PROVISION_DBGLOG */
 
-#define TRACE PRINTF("at: %s(%d)\n", __FUNCTION__, __LINE__)
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_ERROR)
+  #define LOG_ERROR(...)  DBGLOG_PRINTF(__VA_ARGS__)
+#else
+  #define LOG_ERROR(...)
+#endif
+
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_WARN)
+  #define LOG_WARN(...)   DBGLOG_PRINTF(__VA_ARGS__)
+#else
+  #define LOG_WARN(...)
+#endif
+
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_INFO)
+  #define LOG_INFO(...)   DBGLOG_PRINTF(__VA_ARGS__)
+  #define PRINTF(...)     DBGLOG_PRINTF(__VA_ARGS__)
+  #define PUTS(s)         DBGLOG_PUTS(s)
+#else
+  #define LOG_INFO(...)
+  #define PRINTF(...)
+  #define PUTS(s)
+#endif
+
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_DEBUG)
+  #define LOG_DEBUG(...)  DBGLOG_PRINTF(__VA_ARGS__)
+#else
+  #define LOG_DEBUG(...)
+#endif
+
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_TRACE)
+  #define LOG_TRACE(...)  DBGLOG_PRINTF(__VA_ARGS__)
+#else
+  #define LOG_TRACE(...)
+#endif
+
+#define TRACE LOG_TRACE("at: %s(%d)\n", __FUNCTION__, __LINE__)
 
 #endif  /* DBGLOG_H */
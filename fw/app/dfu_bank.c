@@ -0,0 +1,474 @@
+/*---------------------------------------------------------------------------*/
+/*  dfu_bank.c  -- receive an application update into bank 1                 */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "nrf51.h"
+#include "nrf_soc.h"
+#include "ble.h"
+#include "ble_dfu.h"
+#include "app_error.h"
+#include "app_util.h"
+#include "pstorage.h"
+
+#include "flash_sched.h"
+#include "dfu_bank.h"
+#include "dfu_types.h"
+#include "bootloader_types.h"
+#include "bootloader_settings.h"
+#include "crc16.h"
+#include "dbglog.h"
+
+/*
+ *  The transfer follows the bootloader's DFU protocol, so the same DFU
+ *  controller can be used: start packet (image sizes), init packet,
+ *  data packets, validate, activate.
+ */
+typedef enum {
+    DFU_BANK_IDLE,          /* no transfer: events go to dfu_app_handler   */
+    DFU_BANK_START,         /* waiting for the image sizes                 */
+    DFU_BANK_ERASING,       /* bank 1 being erased                         */
+    DFU_BANK_READY,         /* waiting for the init packet                 */
+    DFU_BANK_RX_INIT,       /* receiving the init packet                   */
+    DFU_BANK_INIT_DONE,     /* waiting for the image                       */
+    DFU_BANK_RX_DATA,       /* receiving the image                         */
+    DFU_BANK_RX_DONE,       /* image received, waiting for validate        */
+    DFU_BANK_VALIDATED,     /* waiting for activate                        */
+    DFU_BANK_ACTIVATING,    /* bank 1 descriptor being written             */
+} dfu_bank_state_t;
+
+#define START_PACKET_LENGTH         12      /* SoftDevice, bootloader and app sizes */
+#define INIT_PACKET_VERSION_OFFSET  4       /* see dfu_init_packet_t                */
+#define INIT_PACKET_SD_LEN_OFFSET   8
+#define DATA_PACKET_WORDS           5       /* 20 byte BLE write                    */
+
+/*
+ *  Data packets are copied here until the flash scheduler has written them.  The DFU
+ *  controller's packet receipt notification interval must be below this.
+ */
+#define DATA_BUFFER_COUNT           16
+
+static ble_dfu_t *               mp_dfu;
+static dfu_bank_state_t          m_state = DFU_BANK_IDLE;
+
+static dfu_bank_1_descriptor_t   m_descriptor;
+static const uint32_t            m_magic = DFU_BANK_1_DESCRIPTOR_MAGIC;
+
+static uint32_t                  m_image_size;
+static uint32_t                  m_received;
+static uint32_t                  m_written;
+static uint16_t                  m_written_crc;     /* CRC16 of bank 1 up to m_written */
+static uint8_t                   m_pending;
+
+static uint16_t                  m_pkt_notif_target;
+static uint16_t                  m_pkt_notif_count;
+
+static uint32_t                  m_buffers[DATA_BUFFER_COUNT][DATA_PACKET_WORDS];
+static uint8_t                   m_buffer_index;
+
+static void flash_callback_handler(uint8_t  op_code,
+                                   uint32_t result,
+                                   uint32_t size,
+                                   uint32_t count);
+
+/*---------------------------------------------------------------------------*/
+/*  Abandon the transfer.  Whatever was written to bank 1 is ignored, as     */
+/*  there is no descriptor for it.                                           */
+/*---------------------------------------------------------------------------*/
+static void transfer_abort(ble_dfu_procedure_t procedure, ble_dfu_resp_val_t resp_val)
+{
+    LOG_WARN("dfu_bank: abort (%u)\n", (unsigned) resp_val);
+
+    m_state = DFU_BANK_IDLE;
+
+    (void) ble_dfu_response_send(mp_dfu, procedure, resp_val);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Image CRC from the extended part of the init packet.                     */
+/*---------------------------------------------------------------------------*/
+static bool init_packet_crc_get(uint16_t * p_crc)
+{
+    uint32_t offset;
+
+    if (m_descriptor.init_packet_length < INIT_PACKET_SD_LEN_OFFSET + sizeof(uint16_t))
+        return false;
+
+    offset = INIT_PACKET_SD_LEN_OFFSET + sizeof(uint16_t) +
+             sizeof(uint16_t) * uint16_decode(&m_descriptor.init_packet[INIT_PACKET_SD_LEN_OFFSET]);
+
+    if (offset + sizeof(uint16_t) > m_descriptor.init_packet_length)
+        return false;
+
+    *p_crc = uint16_decode(&m_descriptor.init_packet[offset]);
+    return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The bootloader refuses an application older than the one installed, so  */
+/*  the image is refused here too, before it is transferred.  Images        */
+/*  without a version are not checked.                                       */
+/*---------------------------------------------------------------------------*/
+static bool init_packet_version_ok(void)
+{
+    const bootloader_settings_t * p_settings;
+    uint32_t version;
+
+    if (m_descriptor.init_packet_length < INIT_PACKET_SD_LEN_OFFSET)
+        return false;
+
+    version = uint32_decode(&m_descriptor.init_packet[INIT_PACKET_VERSION_OFFSET]);
+
+    bootloader_util_settings_get(&p_settings);
+
+    if (version == BOOTLOADER_APP_VERSION_NONE ||
+        p_settings->app_version == BOOTLOADER_APP_VERSION_NONE)
+        return true;
+
+    if (version < p_settings->app_version) {
+        LOG_WARN("dfu_bank: version 0x%x older than 0x%x\n",
+                 (unsigned) version, (unsigned) p_settings->app_version);
+        return false;
+    }
+    return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Bank 1 must not overlap the running application.                         */
+/*---------------------------------------------------------------------------*/
+static bool bank_1_free(void)
+{
+    const bootloader_settings_t * p_settings;
+
+    bootloader_util_settings_get(&p_settings);
+
+    return (DFU_BANK_0_REGION_START + p_settings->bank_0_size) <= DFU_BANK_1_REGION_START;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Start packet: image sizes.  Only an application image is received here.  */
+/*---------------------------------------------------------------------------*/
+static void start_packet_handle(ble_dfu_pkt_write_t * p_write)
+{
+    uint32_t sd_size;
+    uint32_t bl_size;
+
+    if (p_write->len != START_PACKET_LENGTH) {
+        transfer_abort(BLE_DFU_START_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+        return;
+    }
+
+    sd_size      = uint32_decode(&p_write->p_data[0]);
+    bl_size      = uint32_decode(&p_write->p_data[4]);
+    m_image_size = uint32_decode(&p_write->p_data[8]);
+
+    if ((sd_size != 0) || (bl_size != 0)) {
+        transfer_abort(BLE_DFU_START_PROCEDURE, BLE_DFU_RESP_VAL_NOT_SUPPORTED);
+        return;
+    }
+
+    if ((m_image_size == 0) ||
+        (m_image_size > DFU_BANK_1_IMAGE_MAX_SIZE) ||
+        ((m_image_size & (sizeof(uint32_t) - 1)) != 0)) {
+        transfer_abort(BLE_DFU_START_PROCEDURE, BLE_DFU_RESP_VAL_DATA_SIZE);
+        return;
+    }
+
+    m_received = 0;
+    m_written  = 0;
+    m_written_crc = 0xFFFF;
+    m_descriptor.init_packet_length = 0;
+
+    /* Erase all of bank 1, including any old descriptor. */
+    m_state = DFU_BANK_ERASING;
+
+    if (flash_sched_clear(DFU_BANK_1_REGION_START,
+                          DFU_IMAGE_MAX_SIZE_BANKED,
+                          flash_callback_handler) != NRF_SUCCESS) {
+        transfer_abort(BLE_DFU_START_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static void init_packet_handle(ble_dfu_pkt_write_t * p_write)
+{
+    if (m_descriptor.init_packet_length + p_write->len > sizeof(m_descriptor.init_packet)) {
+        transfer_abort(BLE_DFU_INIT_PROCEDURE, BLE_DFU_RESP_VAL_DATA_SIZE);
+        return;
+    }
+
+    memcpy(&m_descriptor.init_packet[m_descriptor.init_packet_length],
+           p_write->p_data,
+           p_write->len);
+    m_descriptor.init_packet_length += p_write->len;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Data packet: queue the write to bank 1.                                  */
+/*---------------------------------------------------------------------------*/
+static void data_packet_handle(ble_dfu_pkt_write_t * p_write)
+{
+    uint32_t * p_buffer;
+
+    if ((p_write->len > sizeof(m_buffers[0]))                ||
+        ((p_write->len & (sizeof(uint32_t) - 1)) != 0)       ||
+        (m_received + p_write->len > m_image_size)) {
+        transfer_abort(BLE_DFU_RECEIVE_APP_PROCEDURE, BLE_DFU_RESP_VAL_DATA_SIZE);
+        return;
+    }
+
+    /* Flash is not keeping up with the DFU controller. */
+    if (m_pending == DATA_BUFFER_COUNT) {
+        transfer_abort(BLE_DFU_RECEIVE_APP_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+        return;
+    }
+
+    p_buffer = m_buffers[m_buffer_index];
+    m_buffer_index = (m_buffer_index + 1) % DATA_BUFFER_COUNT;
+
+    memcpy(p_buffer, p_write->p_data, p_write->len);
+
+    if (flash_sched_store(DFU_BANK_1_REGION_START + m_received,
+                          p_buffer,
+                          p_write->len,
+                          flash_callback_handler) != NRF_SUCCESS) {
+        transfer_abort(BLE_DFU_RECEIVE_APP_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+        return;
+    }
+
+    m_pending++;
+    m_received += p_write->len;
+
+    if (m_pkt_notif_target != 0 && ++m_pkt_notif_count >= m_pkt_notif_target) {
+        m_pkt_notif_count = 0;
+        (void) ble_dfu_pkts_rcpt_notify(mp_dfu, m_received);
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Validate the image as written to flash against the init packet CRC.      */
+/*  The CRC is taken as each write completes, so only the compare is left.   */
+/*---------------------------------------------------------------------------*/
+static void image_validate(void)
+{
+    uint16_t expected_crc;
+
+    if (!init_packet_crc_get(&expected_crc)) {
+        transfer_abort(BLE_DFU_VALIDATE_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+        return;
+    }
+
+    if (m_written_crc != expected_crc) {
+        transfer_abort(BLE_DFU_VALIDATE_PROCEDURE, BLE_DFU_RESP_VAL_CRC_ERROR);
+        return;
+    }
+
+    m_state = DFU_BANK_VALIDATED;
+
+    (void) ble_dfu_response_send(mp_dfu, BLE_DFU_VALIDATE_PROCEDURE, BLE_DFU_RESP_VAL_SUCCESS);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Write the bank 1 descriptor, the magic number last, then reset.          */
+/*---------------------------------------------------------------------------*/
+static void image_activate(void)
+{
+    m_descriptor.image_size = m_image_size;
+
+    if ((flash_sched_store(DFU_BANK_1_DESCRIPTOR_ADDRESS,
+                           (uint32_t *) &m_descriptor,
+                           offsetof(dfu_bank_1_descriptor_t, magic),
+                           flash_callback_handler) != NRF_SUCCESS) ||
+        (flash_sched_store(DFU_BANK_1_DESCRIPTOR_ADDRESS + offsetof(dfu_bank_1_descriptor_t, magic),
+                           &m_magic,
+                           sizeof(m_magic),
+                           flash_callback_handler) != NRF_SUCCESS)) {
+        transfer_abort(BLE_DFU_VALIDATE_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+        return;
+    }
+
+    m_pending = 2;
+    m_state   = DFU_BANK_ACTIVATING;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static void flash_callback_handler(uint8_t  op_code,
+                                   uint32_t result,
+                                   uint32_t size,
+                                   uint32_t count)
+{
+    if (m_state == DFU_BANK_IDLE)
+        return;
+
+    if (result != NRF_SUCCESS) {
+        transfer_abort(BLE_DFU_RECEIVE_APP_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+        return;
+    }
+
+    switch (op_code) {
+
+        case PSTORAGE_CLEAR_OP_CODE:
+            if (m_state == DFU_BANK_ERASING) {
+                /* Writes of an abandoned transfer were queued before the erase. */
+                m_pending = 0;
+                m_state   = DFU_BANK_READY;
+                (void) ble_dfu_response_send(mp_dfu,
+                                             BLE_DFU_START_PROCEDURE,
+                                             BLE_DFU_RESP_VAL_SUCCESS);
+            }
+            break;
+
+        case PSTORAGE_STORE_OP_CODE:
+            /* Adjacent data packets may be written as one. */
+            m_pending -= count;
+
+            if (m_state == DFU_BANK_RX_DATA) {
+                /* Read back what was written; writes complete in order. */
+                m_written_crc = crc16_compute((uint8_t *) DFU_BANK_1_REGION_START + m_written,
+                                              size,
+                                              &m_written_crc);
+                m_written += size;
+
+                if (m_written == m_image_size) {
+                    m_state = DFU_BANK_RX_DONE;
+                    (void) ble_dfu_response_send(mp_dfu,
+                                                 BLE_DFU_RECEIVE_APP_PROCEDURE,
+                                                 BLE_DFU_RESP_VAL_SUCCESS);
+                }
+            }
+            else if (m_state == DFU_BANK_ACTIVATING && m_pending == 0) {
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_DEBUG)
+                flash_sched_stats_t stats;
+
+                flash_sched_stats_get(&stats);
+                LOG_DEBUG("flash_sched: %u requests, %u merged, %u retries, depth %u, latency max %u\n",
+                          (unsigned) stats.requests, (unsigned) stats.merged,
+                          (unsigned) stats.retries, (unsigned) stats.depth_max,
+                          (unsigned) stats.latency_max);
+#endif
+                PUTS("dfu_bank: activate, reset");
+                (void) sd_nvic_SystemReset();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+bool dfu_bank_on_dfu_evt(ble_dfu_t * p_dfu, ble_dfu_evt_t * p_evt)
+{
+    if (p_evt->ble_dfu_evt_type == BLE_DFU_START) {
+        uint8_t mode = p_evt->evt.ble_dfu_pkt_write.p_data[0] & ~DFU_UPDATE_RESUME;
+
+        /* Other updates, or an application too large for dual bank, reset into the bootloader. */
+        if (mode != DFU_UPDATE_APP || !bank_1_free() || m_state == DFU_BANK_ACTIVATING)
+            return false;
+
+        PUTS("dfu_bank: start");
+
+        mp_dfu  = p_dfu;
+        m_state = DFU_BANK_START;
+        return true;
+    }
+
+    if (m_state == DFU_BANK_IDLE)
+        return false;
+
+    switch (p_evt->ble_dfu_evt_type) {
+
+        case BLE_DFU_PACKET_WRITE:
+            if (m_state == DFU_BANK_START)
+                start_packet_handle(&p_evt->evt.ble_dfu_pkt_write);
+            else if (m_state == DFU_BANK_RX_INIT)
+                init_packet_handle(&p_evt->evt.ble_dfu_pkt_write);
+            else if (m_state == DFU_BANK_RX_DATA)
+                data_packet_handle(&p_evt->evt.ble_dfu_pkt_write);
+            break;
+
+        case BLE_DFU_RECEIVE_INIT_DATA:
+            if (p_evt->evt.ble_dfu_pkt_write.p_data[0] == DFU_INIT_RX && m_state == DFU_BANK_READY) {
+                m_state = DFU_BANK_RX_INIT;
+            }
+            else if (p_evt->evt.ble_dfu_pkt_write.p_data[0] == DFU_INIT_COMPLETE &&
+                     m_state == DFU_BANK_RX_INIT) {
+                if (!init_packet_version_ok()) {
+                    transfer_abort(BLE_DFU_INIT_PROCEDURE, BLE_DFU_RESP_VAL_OPER_FAILED);
+                    break;
+                }
+                m_state = DFU_BANK_INIT_DONE;
+                (void) ble_dfu_response_send(p_dfu, BLE_DFU_INIT_PROCEDURE, BLE_DFU_RESP_VAL_SUCCESS);
+            }
+            else {
+                transfer_abort(BLE_DFU_INIT_PROCEDURE, BLE_DFU_RESP_VAL_INVALID_STATE);
+            }
+            break;
+
+        case BLE_DFU_RECEIVE_APP_DATA:
+            if (m_state == DFU_BANK_INIT_DONE) {
+                m_state = DFU_BANK_RX_DATA;
+                m_pkt_notif_count = 0;
+            }
+            else {
+                transfer_abort(BLE_DFU_RECEIVE_APP_PROCEDURE, BLE_DFU_RESP_VAL_INVALID_STATE);
+            }
+            break;
+
+        case BLE_DFU_VALIDATE:
+            if (m_state == DFU_BANK_RX_DONE)
+                image_validate();
+            else
+                transfer_abort(BLE_DFU_VALIDATE_PROCEDURE, BLE_DFU_RESP_VAL_INVALID_STATE);
+            break;
+
+        case BLE_DFU_ACTIVATE_N_RESET:
+            if (m_state == DFU_BANK_VALIDATED)
+                image_activate();
+            break;
+
+        case BLE_DFU_SYS_RESET:
+            if (m_state != DFU_BANK_ACTIVATING)
+                (void) sd_nvic_SystemReset();
+            break;
+
+        case BLE_DFU_PKT_RCPT_NOTIF_ENABLED:
+            m_pkt_notif_target = p_evt->evt.pkt_rcpt_notif_req.num_of_pkts;
+            m_pkt_notif_count  = 0;
+            break;
+
+        case BLE_DFU_PKT_RCPT_NOTIF_DISABLED:
+            m_pkt_notif_target = 0;
+            break;
+
+        case BLE_DFU_BYTES_RECEIVED_SEND:
+            (void) ble_dfu_bytes_rcvd_report(p_dfu, m_received);
+            break;
+
+        default:
+            break;
+    }
+
+    return true;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  A transfer does not survive the connection; the controller starts over.  */
+/*---------------------------------------------------------------------------*/
+void dfu_bank_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED &&
+        m_state != DFU_BANK_ACTIVATING) {
+        m_state = DFU_BANK_IDLE;
+    }
+}
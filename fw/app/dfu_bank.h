@@ -0,0 +1,32 @@
+/*---------------------------------------------------------------------------*/
+/*  dfu_bank.h                                                               */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _DFU_BANK_H_
+#define _DFU_BANK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble.h"
+#include "ble_dfu.h"
+
+/*
+ *  Dual bank DFU: an application update is received into bank 1 over the
+ *  existing connection while the beacon keeps advertising.  On "activate"
+ *  the bank 1 descriptor is written and the device resets; the bootloader
+ *  validates bank 1 again and copies it to bank 0.
+ *
+ *  SoftDevice and bootloader updates still reset into the bootloader.
+ *  Bank 1 is written through the flash scheduler, see flash_sched.h.
+ */
+
+/*
+ *  Handle a DFU Service event.  Returns false if the event is not part of
+ *  a bank 1 transfer, and should be handled by dfu_app_on_dfu_evt().
+ */
+bool dfu_bank_on_dfu_evt(ble_dfu_t * p_dfu, ble_dfu_evt_t * p_evt);
+
+void dfu_bank_on_ble_evt(ble_evt_t * p_ble_evt);
+
+#endif  /* _DFU_BANK_H_ */
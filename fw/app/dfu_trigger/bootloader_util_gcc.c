@@ -13,14 +13,8 @@
 
 #if __GNUC__ && __ARM_EABI__
 
-__attribute__ ((section(".bootloaderSettings"))) uint8_t m_boot_settings[1024] ;
 __attribute__ ((section(".uicrBootStartAddress"))) uint32_t m_uicr_bootloader_start_address = BOOTLOADER_REGION_START;
 
-/* 
- *  Read only pointer to bootloader settings in flash. 
- */
-const bootloader_settings_t const * const mp_bootloader_settings = (bootloader_settings_t *) &m_boot_settings[0];
-
 typedef void (*reset_handler_t)(void);
 
 
@@ -67,9 +61,3 @@ void bootloader_util_app_start(uint32_t start_addr)
     PRINTF("bootloader_util_app_start: 0x%x\n", (unsigned) start_addr);
     StartApplication(start_addr);
 }
-
-
-void bootloader_util_settings_get(const bootloader_settings_t ** pp_bootloader_settings)
-{
-    *pp_bootloader_settings = mp_bootloader_settings;
-}
@@ -0,0 +1,137 @@
+/*---------------------------------------------------------------------------*/
+/*  diag_service.c                                                           */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ble.h"
+#include "ble_gatts.h"
+#include "ble_srv_common.h"
+#include "app_error.h"
+
+#include "diag_service.h"
+#include "crash.h"
+#include "reset_stats.h"
+#include "ram_usage.h"
+
+/* 0000xxxx-8d5e-4a5b-9e42-5eb1ec0ed1a6, little endian. */
+static const ble_uuid128_t m_base_uuid = {
+    {
+        0xA6, 0xD1, 0x0E, 0xEC, 0xB1, 0x5E, 0x42, 0x9E,
+        0x5B, 0x4A, 0x5E, 0x8D, 0x00, 0x00, 0x00, 0x00
+    }
+};
+
+static uint16_t                  m_service_handle;
+static uint8_t                   m_uuid_type;
+static ble_gatts_char_handles_t  m_crash_handles;
+static ble_gatts_char_handles_t  m_reset_handles;
+static ble_gatts_char_handles_t  m_ram_handles;
+
+/*---------------------------------------------------------------------------*/
+/*  A read-only characteristic, read from p_value in place.  With rd_auth,   */
+/*  each read is authorized in diag_service_on_ble_evt(), which first       */
+/*  updates the value.                                                       */
+/*---------------------------------------------------------------------------*/
+static void char_add(uint16_t                   uuid,
+                     const void               * p_value,
+                     uint16_t                   length,
+                     bool                       rd_auth,
+                     ble_gatts_char_handles_t * p_handles)
+{
+    ble_gatts_char_md_t char_md;
+    ble_gatts_attr_md_t attr_md;
+    ble_gatts_attr_t    attr_char_value;
+    ble_uuid_t          char_uuid;
+
+    memset(&char_md, 0, sizeof(char_md));
+    char_md.char_props.read = 1;
+
+    char_uuid.type = m_uuid_type;
+    char_uuid.uuid = uuid;
+
+    memset(&attr_md, 0, sizeof(attr_md));
+
+    BLE_GAP_CONN_SEC_MODE_SET_OPEN(&attr_md.read_perm);
+    BLE_GAP_CONN_SEC_MODE_SET_NO_ACCESS(&attr_md.write_perm);
+
+    attr_md.vloc    = BLE_GATTS_VLOC_USER;
+    attr_md.rd_auth = rd_auth ? 1 : 0;
+
+    memset(&attr_char_value, 0, sizeof(attr_char_value));
+
+    attr_char_value.p_uuid    = &char_uuid;
+    attr_char_value.p_attr_md = &attr_md;
+    attr_char_value.init_len  = length;
+    attr_char_value.max_len   = length;
+    attr_char_value.p_value   = (uint8_t *) p_value;
+
+    APP_ERROR_CHECK( sd_ble_gatts_characteristic_add(m_service_handle,
+                                                     &char_md,
+                                                     &attr_char_value,
+                                                     p_handles) );
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void diag_service_init(void)
+{
+    ble_uuid_t service_uuid;
+
+    APP_ERROR_CHECK( sd_ble_uuid_vs_add(&m_base_uuid, &m_uuid_type) );
+
+    service_uuid.type = m_uuid_type;
+    service_uuid.uuid = DIAG_SERVICE_UUID;
+
+    APP_ERROR_CHECK( sd_ble_gatts_service_add(BLE_GATTS_SRVC_TYPE_PRIMARY,
+                                              &service_uuid,
+                                              &m_service_handle) );
+
+    char_add(DIAG_CRASH_CHAR_UUID,
+             crash_record_get(),
+             sizeof(crash_record_t),
+             false,
+             &m_crash_handles);
+
+    char_add(DIAG_RESET_CHAR_UUID,
+             reset_stats_get(),
+             sizeof(reset_stats_t),
+             false,
+             &m_reset_handles);
+
+    char_add(DIAG_RAM_CHAR_UUID,
+             ram_usage_update(),
+             sizeof(ram_usage_t),
+             true,
+             &m_ram_handles);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The high-water marks are scanned for when read, not kept up to date.     */
+/*---------------------------------------------------------------------------*/
+void diag_service_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    ble_gatts_evt_rw_authorize_request_t * p_request;
+    ble_gatts_rw_authorize_reply_params_t  reply;
+
+    if (p_ble_evt->header.evt_id != BLE_GATTS_EVT_RW_AUTHORIZE_REQUEST)
+        return;
+
+    p_request = &p_ble_evt->evt.gatts_evt.params.authorize_request;
+
+    if (p_request->type != BLE_GATTS_AUTHORIZE_TYPE_READ ||
+        p_request->request.read.handle != m_ram_handles.value_handle)
+        return;
+
+    (void) ram_usage_update();
+
+    memset(&reply, 0, sizeof(reply));
+    reply.type = BLE_GATTS_AUTHORIZE_TYPE_READ;
+    reply.params.read.gatt_status = BLE_GATT_STATUS_SUCCESS;
+
+    APP_ERROR_CHECK( sd_ble_gatts_rw_authorize_reply(p_ble_evt->evt.gatts_evt.conn_handle,
+                                                     &reply) );
+}
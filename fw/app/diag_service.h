@@ -0,0 +1,27 @@
+/*---------------------------------------------------------------------------*/
+/*  diag_service.h                                                           */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _DIAG_SERVICE_H_
+#define _DIAG_SERVICE_H_
+
+#include "ble.h"
+
+/*
+ *  Diagnostics Service: read-only characteristics for field units.
+ *
+ *    Crash record   DIAG_CRASH_CHAR_UUID   crash_record_t, see crash.h
+ *    Reset stats    DIAG_RESET_CHAR_UUID   reset_stats_t, see reset_stats.h
+ *    RAM usage      DIAG_RAM_CHAR_UUID     ram_usage_t, see ram_usage.h
+ *
+ *  The UUIDs are on the base 0000xxxx-8d5e-4a5b-9e42-5eb1ec0ed1a6.
+ */
+#define DIAG_SERVICE_UUID      0x0D10
+#define DIAG_CRASH_CHAR_UUID   0x0D11
+#define DIAG_RESET_CHAR_UUID   0x0D12
+#define DIAG_RAM_CHAR_UUID     0x0D13
+
+void diag_service_init(void);
+void diag_service_on_ble_evt(ble_evt_t * p_ble_evt);
+
+#endif  /* _DIAG_SERVICE_H_ */
@@ -13,6 +13,10 @@
 #include "eddystone.h"
 #include "battery.h"
 #include "temperature.h"
+#include "reset_stats.h"
+#if defined(BENCHMARK)
+  #include "bench.h"
+#endif
 #include "dbglog.h"
 
 /*---------------------------------------------------------------------------*/
@@ -151,6 +155,9 @@ static void build_tlm_frame_buffer(void)
 {
     uint8_t * encoded_advdata =  eddystone_frames[EDDYSTONE_TLM].adv_frame;
     uint8_t * len_advdata     = &eddystone_frames[EDDYSTONE_TLM].adv_len;
+#if TLM_RESET_COUNT
+    uint32_t  resets;
+#endif
 
     *len_advdata = 0;
 
@@ -170,9 +177,16 @@ static void build_tlm_frame_buffer(void)
     /* Time since power-on or reboot */
     eddystone_uint32(encoded_advdata, len_advdata, sec_cnt);
 
+#if TLM_RESET_COUNT
+    /* Resets over all boots, for spotting unstable units; 0 until counted */
+    resets = reset_stats_ready() ? reset_stats_get()->resets : 0;
+    eddystone_uint16(encoded_advdata, len_advdata,
+                     (resets < UINT16_MAX) ? resets : UINT16_MAX);
+#else
     /* RFU field must be 0x00 */
     encoded_advdata[(*len_advdata)++] = 0x00;
     encoded_advdata[(*len_advdata)++] = 0x00;
+#endif
 
     /* Update Service Data Length. */
     encoded_advdata[SERVICE_DATA_OFFSET] = (*len_advdata) - SVC_DATA_LEN_OFFSET;
@@ -250,6 +264,27 @@ void eddystone_init(void)
     eddystone_set_adv_data(EDDYSTONE_UID);
 }
 
+#if defined(BENCHMARK)
+
+#define BENCH_COUNT  100
+
+/*---------------------------------------------------------------------------*/
+/*  Time each frame encoder.  The TLM one includes the battery and           */
+/*  temperature readings.  Logged whatever DBGLOG_LEVEL is.                  */
+/*---------------------------------------------------------------------------*/
+void eddystone_benchmark(void)
+{
+    uint32_t uid = bench_run(build_uid_frame_buffer, BENCH_COUNT);
+    uint32_t url = bench_run(build_url_frame_buffer, BENCH_COUNT);
+    uint32_t tlm = bench_run(build_tlm_frame_buffer, BENCH_COUNT);
+
+    DBGLOG_PRINTF("benchmark %s: uid %u, url %u, tlm %u (1/%u us)\n",
+                  BUILD_PROFILE_NAME, (unsigned) uid, (unsigned) url,
+                  (unsigned) tlm, (unsigned) BENCH_TICKS_PER_US);
+}
+
+#endif /* BENCHMARK */
+
 /*---------------------------------------------------------------------------*/
 /*  Crappy scheduler -- will re-implement later (sigh)                       */
 /*---------------------------------------------------------------------------*/
@@ -8,4 +8,8 @@
 void eddystone_init(void);
 void eddystone_scheduler(bool radio_is_active);
 
+#if defined(BENCHMARK)
+void eddystone_benchmark(void);
+#endif
+
 #endif /* EDDYSTONE_H */
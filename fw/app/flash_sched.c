@@ -0,0 +1,298 @@
+/*---------------------------------------------------------------------------*/
+/*  flash_sched.c  -- pstorage operations issued in radio idle windows       */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "nrf51.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "pstorage.h"
+
+#include "flash_sched.h"
+#include "watchdog.h"
+#include "dbglog.h"
+
+/*
+ *  Enough for the dual bank DFU data buffers and the bank 1 descriptor.
+ */
+#define FLASH_SCHED_QUEUE_SIZE   20
+
+/*
+ *  Largest store made by merging.  Each word takes about 46us to write, so
+ *  160 bytes fit easily between connection events.
+ */
+#define FLASH_SCHED_MERGE_MAX    160
+
+/*
+ *  Times an operation is issued again after pstorage reports it failed,
+ *  usually because the SoftDevice could not fit it around the radio.
+ */
+#define FLASH_SCHED_RETRIES      3
+
+#define FLASH_PAGE_SIZE          0x400
+
+typedef struct {
+    uint8_t                 op_code;     /* PSTORAGE_STORE/CLEAR_OP_CODE          */
+    uint8_t                 retries;
+    uint16_t                count;       /* requests merged into this one         */
+    uint32_t                address;     /* next page to erase, for a clear       */
+    const uint8_t         * p_src;
+    uint32_t                size;        /* bytes left to erase, for a clear      */
+    uint32_t                total;
+    uint32_t                ticks;       /* RTC1 count when the first was queued  */
+    flash_sched_handler_t   handler;
+} flash_op_t;
+
+static pstorage_handle_t    m_handle;
+static flash_op_t           m_queue[FLASH_SCHED_QUEUE_SIZE];
+static uint8_t              m_head;
+static uint8_t              m_count;
+static bool                 m_busy;          /* head passed to pstorage   */
+static bool                 m_radio_active;  /* no idle window            */
+static flash_sched_stats_t  m_stats;
+
+/*---------------------------------------------------------------------------*/
+/*  Pass the oldest operation to pstorage, if none is in progress and the    */
+/*  radio is idle.  A clear is issued one page at a time.                    */
+/*---------------------------------------------------------------------------*/
+static void op_issue(void)
+{
+    flash_op_t      * p_op;
+    pstorage_handle_t handle;
+    uint32_t          err_code;
+
+    if (m_busy || m_radio_active || m_count == 0)
+        return;
+
+    p_op = &m_queue[m_head];
+
+    handle          = m_handle;
+    handle.block_id = p_op->address;
+
+    if (p_op->op_code == PSTORAGE_CLEAR_OP_CODE)
+        err_code = pstorage_raw_clear(&handle, FLASH_PAGE_SIZE);
+    else
+        err_code = pstorage_raw_store(&handle, (uint8_t *) p_op->p_src, p_op->size, 0);
+
+    APP_ERROR_CHECK(err_code);
+
+    m_busy = true;
+    m_stats.operations++;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The head operation is done: account for it, and tell its requester.      */
+/*---------------------------------------------------------------------------*/
+static void op_complete(uint32_t result)
+{
+    flash_op_t op = m_queue[m_head];
+    uint32_t   now;
+    uint32_t   latency;
+
+    m_head = (m_head + 1) % FLASH_SCHED_QUEUE_SIZE;
+    m_count--;
+
+    APP_ERROR_CHECK( app_timer_cnt_get(&now) );
+    APP_ERROR_CHECK( app_timer_cnt_diff_compute(now, op.ticks, &latency) );
+
+    m_stats.depth         -= op.count;
+    m_stats.completed     += op.count;
+    m_stats.latency_total += latency * op.count;
+    if (latency > m_stats.latency_max)
+        m_stats.latency_max = latency;
+
+    if (result != NRF_SUCCESS) {
+        m_stats.failures += op.count;
+        LOG_ERROR("flash_sched: 0x%x failed (%u)\n", (unsigned) op.address, (unsigned) result);
+    }
+
+    op.handler(op.op_code, result, op.total, op.count);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static void pstorage_callback_handler(pstorage_handle_t * p_handle,
+                                      uint8_t             op_code,
+                                      uint32_t            result,
+                                      uint8_t           * p_data,
+                                      uint32_t            data_len)
+{
+    flash_op_t * p_op = &m_queue[m_head];
+
+    if (!m_busy)
+        return;
+
+    m_busy = false;
+
+    watchdog_checkin(WATCHDOG_CHECKIN_FLASH);
+
+    if (result != NRF_SUCCESS && p_op->retries < FLASH_SCHED_RETRIES) {
+        /* Issued again in the next idle window. */
+        p_op->retries++;
+        m_stats.retries++;
+    }
+    else if (result == NRF_SUCCESS && p_op->op_code == PSTORAGE_CLEAR_OP_CODE &&
+             p_op->size > FLASH_PAGE_SIZE) {
+        p_op->address += FLASH_PAGE_SIZE;
+        p_op->size    -= FLASH_PAGE_SIZE;
+        p_op->retries  = 0;
+    }
+    else {
+        op_complete(result);
+    }
+
+    op_issue();
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Queue an operation, or merge a store into the last one queued.           */
+/*---------------------------------------------------------------------------*/
+static uint32_t op_enqueue(uint8_t                 op_code,
+                           uint32_t                address,
+                           const uint8_t         * p_src,
+                           uint32_t                size,
+                           flash_sched_handler_t   handler)
+{
+    flash_op_t * p_op;
+
+    if (m_count > 0 && op_code == PSTORAGE_STORE_OP_CODE) {
+        p_op = &m_queue[(m_head + m_count - 1) % FLASH_SCHED_QUEUE_SIZE];
+
+        if ((p_op != &m_queue[m_head] || !m_busy)             &&
+            p_op->op_code == PSTORAGE_STORE_OP_CODE            &&
+            p_op->handler == handler                           &&
+            p_op->address + p_op->size == address              &&
+            p_op->p_src + p_op->size == p_src                  &&
+            p_op->size + size <= FLASH_SCHED_MERGE_MAX) {
+
+            p_op->size  += size;
+            p_op->total += size;
+            p_op->count++;
+
+            m_stats.requests++;
+            m_stats.merged++;
+            m_stats.depth++;
+            return NRF_SUCCESS;
+        }
+    }
+
+    if (m_count == FLASH_SCHED_QUEUE_SIZE)
+        return NRF_ERROR_NO_MEM;
+
+    p_op = &m_queue[(m_head + m_count) % FLASH_SCHED_QUEUE_SIZE];
+
+    p_op->op_code = op_code;
+    p_op->retries = 0;
+    p_op->count   = 1;
+    p_op->address = address;
+    p_op->p_src   = p_src;
+    p_op->size    = size;
+    p_op->total   = size;
+    p_op->handler = handler;
+    APP_ERROR_CHECK( app_timer_cnt_get(&p_op->ticks) );
+
+    m_count++;
+
+    m_stats.requests++;
+    m_stats.depth++;
+    if (m_stats.depth > m_stats.depth_max)
+        m_stats.depth_max = m_stats.depth;
+
+    op_issue();
+
+    return NRF_SUCCESS;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Callers in thread mode, as at startup, could otherwise be interrupted    */
+/*  by the radio notification or a completion while changing the queue.      */
+/*---------------------------------------------------------------------------*/
+static uint32_t op_queue(uint8_t                 op_code,
+                         uint32_t                address,
+                         const uint8_t         * p_src,
+                         uint32_t                size,
+                         flash_sched_handler_t   handler)
+{
+    uint32_t err_code;
+
+    CRITICAL_REGION_ENTER();
+    err_code = op_enqueue(op_code, address, p_src, size, handler);
+    CRITICAL_REGION_EXIT();
+
+    return err_code;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+uint32_t flash_sched_store(uint32_t                address,
+                           const uint32_t        * p_src,
+                           uint32_t                size,
+                           flash_sched_handler_t   handler)
+{
+    if (size == 0 || (size & (sizeof(uint32_t) - 1)) != 0)
+        return NRF_ERROR_INVALID_LENGTH;
+
+    return op_queue(PSTORAGE_STORE_OP_CODE, address, (const uint8_t *) p_src, size, handler);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+uint32_t flash_sched_clear(uint32_t address, uint32_t size, flash_sched_handler_t handler)
+{
+    if (size == 0 || (size & (FLASH_PAGE_SIZE - 1)) != 0 ||
+        (address & (FLASH_PAGE_SIZE - 1)) != 0)
+        return NRF_ERROR_INVALID_LENGTH;
+
+    return op_queue(PSTORAGE_CLEAR_OP_CODE, address, NULL, size, handler);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The notification comes ahead of each radio event, and again when it      */
+/*  ends: the window between is free of radio activity.                      */
+/*---------------------------------------------------------------------------*/
+void flash_sched_on_radio_evt(bool radio_active)
+{
+    m_radio_active = radio_active;
+
+    op_issue();
+
+    /* Not waiting on pstorage; while it is, completions check in. */
+    if (!m_busy)
+        watchdog_checkin(WATCHDOG_CHECKIN_FLASH);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void flash_sched_on_sys_evt(uint32_t sys_evt)
+{
+    if (sys_evt == NRF_EVT_FLASH_OPERATION_ERROR)
+        m_stats.flash_errors++;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void flash_sched_stats_get(flash_sched_stats_t * p_stats)
+{
+    CRITICAL_REGION_ENTER();
+    *p_stats = m_stats;
+    CRITICAL_REGION_EXIT();
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void flash_sched_init(void)
+{
+    pstorage_module_param_t param = {.cb = pstorage_callback_handler};
+
+    APP_ERROR_CHECK( pstorage_raw_register(&param, &m_handle) );
+}
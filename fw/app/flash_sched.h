@@ -0,0 +1,79 @@
+/*---------------------------------------------------------------------------*/
+/*  flash_sched.h                                                            */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _FLASH_SCHED_H_
+#define _FLASH_SCHED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Flash scheduler: raw flash stores and clears are queued here and passed
+ *  to pstorage one at a time, only while the radio is idle, as told by the
+ *  radio notification.  Adjacent stores are merged, and an operation the
+ *  SoftDevice could not fit in is tried again in the next idle window.
+ *
+ *  All application flash writes come through here.  Modules keeping
+ *  records still register them with pstorage, for a page of their own,
+ *  but erase and store that page with flash_sched_clear/store.
+ *
+ *  The radio notification and the SoftDevice events run at
+ *  NRF_APP_PRIORITY_LOW, so neither preempts the other.  Callers may also
+ *  be in thread mode, as the crash and reset records written at startup:
+ *  the queue is changed in a critical region.
+ */
+
+/*
+ *  Called when a store or clear is done.  size is the bytes written or
+ *  cleared, count the number of requests merged into the operation.
+ *  op_code is PSTORAGE_STORE_OP_CODE or PSTORAGE_CLEAR_OP_CODE.
+ */
+typedef void (*flash_sched_handler_t)(uint8_t  op_code,
+                                      uint32_t result,
+                                      uint32_t size,
+                                      uint32_t count);
+
+typedef struct {
+    uint32_t requests;       /* stores and clears requested                 */
+    uint32_t merged;         /* stores merged into the previous store       */
+    uint32_t operations;     /* pstorage operations issued, retries too     */
+    uint32_t retries;        /* operations issued again after failing       */
+    uint32_t failures;       /* requests failed after all retries           */
+    uint32_t completed;      /* requests done, failed or not                */
+    uint32_t flash_errors;   /* NRF_EVT_FLASH_OPERATION_ERROR events        */
+    uint16_t depth;          /* requests queued now                         */
+    uint16_t depth_max;      /* most requests queued at once                */
+    uint32_t latency_max;    /* longest request to completion, RTC1 ticks   */
+    uint32_t latency_total;  /* sum over the completed requests             */
+} flash_sched_stats_t;
+
+/*
+ *  Register with pstorage as its raw mode user.  Call after pstorage_init().
+ */
+void flash_sched_init(void);
+
+/*
+ *  Queue a store of size bytes, a multiple of 4, from p_src to address.
+ *  The data must be kept until the handler is called.
+ */
+uint32_t flash_sched_store(uint32_t                address,
+                           const uint32_t        * p_src,
+                           uint32_t                size,
+                           flash_sched_handler_t   handler);
+
+/*
+ *  Queue the erase of size bytes, whole pages, from address.  The pages
+ *  are erased one per operation.
+ */
+uint32_t flash_sched_clear(uint32_t address, uint32_t size, flash_sched_handler_t handler);
+
+/*
+ *  Radio notification and SoftDevice system event inputs.
+ */
+void flash_sched_on_radio_evt(bool radio_active);
+void flash_sched_on_sys_evt(uint32_t sys_evt);
+
+void flash_sched_stats_get(flash_sched_stats_t * p_stats);
+
+#endif  /* _FLASH_SCHED_H_ */
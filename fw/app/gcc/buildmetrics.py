@@ -4,9 +4,16 @@
 # Determines whether the code will fit in the allocated flash
 # Exits with '0' if it fits, '1' otherwise
 #
+# Given the linker map file, also breaks the flash and RAM used down by
+# module (object file or library) and by symbol.  Given a baseline saved
+# from an earlier build, shows each module's growth, and exits with '1' if
+# a module grew more than allowed.
+#
 
 import os
+import re
 import sys
+import json
 import subprocess
 import argparse
 
@@ -46,6 +53,35 @@ def colorize(s, color):
     else:
         return s
 
+def ld_length(line):
+    '''
+    This routine evaluates the LENGTH of a MEMORY line, which may be a sum
+    such as "8K - 128"
+
+    @param line - one line of the MEMORY block of the .ld file
+
+    @return Returns the length in bytes
+    '''
+
+    expr = line.split("LENGTH")[1].split("/*")[0]
+    size = 0
+    sign = 1
+    for term in re.findall(r"[-+]|0x[0-9a-fA-F]+|[0-9]+[KM]?", expr):
+        if term == "+" or term == "-":
+            sign = -1 if term == "-" else 1
+            continue
+        if term.startswith("0x"):
+            value = int(term, 16)
+        elif term[-1] == "K":
+            value = int(term[:-1]) * 1024
+        elif term[-1] == "M":
+            value = int(term[:-1]) * 1024 * 1024
+        else:
+            value = int(term)
+        size += sign * value
+
+    return size
+
 def read_in_ld_file(filename):
     '''
     This routine reads in the .ld file and parses the size of the various sections
@@ -64,35 +100,29 @@ def read_in_ld_file(filename):
 
     # Assumes a well formatted file for example:
     # FLASH  (rx)  : ORIGIN = 0x08030000, LENGTH = 192K
-    # RAM    (xrw) : ORIGIN = 0x20000000, LENGTH = 48K
+    # RAM    (xrw) : ORIGIN = 0x20000000, LENGTH = 48K - 128
 
     ldFile = open(filename, "r")
 
     for line in ldFile:
-        if "FLASH" in line:
+        if "FLASH" in line and "LENGTH" in line:
             for word in line.split():
                 if "0x" in word:
                     # Found the start address
                     tempStart = [int(word[2:-1], 16)]
                     flashStart = tempStart[0]
-                elif "K" in word:
-                    # Found the length
-                    tempSize = [int(word[:-1])]
-                    flashSize = tempSize[0] * 1024
+            flashSize = ld_length(line)
 
             #print "FLASH start: 0x{0:08x}".format(flashStart)  # robin
             #print "FLASH size:  {0}".format(flashSize)  # robin
 
-        elif "RAM" in line:
+        elif "RAM" in line and "LENGTH" in line:
             for word in line.split():
                 if "0x" in word:
                     #Found the start address
                     tempStart = [int(word[2:-1], 16)]
                     ramStart = tempStart[0]
-                elif "K" in word:
-                    #Found the length
-                    tempSize = [int(word[:-1])]
-                    ramSize = tempSize[0] * 1024
+            ramSize = ld_length(line)
 
             #print "RAM start: 0x{0:08x}".format(ramStart)  # robin
             #print "RAM size:  {0}".format(ramSize)  # robin
@@ -219,6 +249,9 @@ def get_code_size(filename):
         print "ERROR: Computed FLASH size is 0."
         return False
 
+    if profile:
+        print "Build profile: " + profile + "\n"
+
     print "Flash Metrics"
     print "    Flash: {0} bytes used of {1} bytes maximum".format(computedFlashSize, flashSize)
 
@@ -270,6 +303,191 @@ def get_code_size(filename):
 
     return noErrorFound
 
+# Input section in the map file, with its address, size and object on the
+# same line or, for a long name, the next:
+#  .text.main     0x00018abc       0x48 _build/main.o
+#  .text.ble_advdata_encode
+#                 0x0001a000      0x1a4 _build/ble_advdata.o
+mapSectionLine = re.compile(r'^ (\.\S+|COMMON|\*fill\*)(?:\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+(\S.*))?)?$')
+mapContinuedLine = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+
+def module_name(objectFile):
+
+    '''
+    This routine names the module an object file of the map file belongs to.
+
+    @param objectFile - Supplies the object, for example _build/main.o, or
+                        .../libc_nano.a(lib_a-memcpy.o) for a library member.
+
+    @return Returns the object's file name, or the library's.
+    '''
+
+    if objectFile.endswith(")") and "(" in objectFile:
+        objectFile = objectFile[:objectFile.index("(")]
+
+    return os.path.basename(objectFile)
+
+def read_in_map_file(filename):
+
+    '''
+    This routine reads in the linker map file and sums the flash and RAM
+    taken by each module, and by each input section, which is one symbol
+    when built with -ffunction-sections and -fdata-sections.
+
+    @param filename - filepath + filename for the .map file
+
+    @return Returns success if any input section was found, otherwise fails
+    '''
+
+    global moduleSizes
+    global symbolSizes
+
+    inMemoryMap = False
+    pending     = None
+
+    mapFile = open(filename, "r")
+
+    for line in mapFile:
+        line = line.rstrip()
+
+        # Input sections before the memory map were discarded.
+        if line.startswith("Linker script and memory map"):
+            inMemoryMap = True
+            continue
+        if not inMemoryMap:
+            continue
+        if line.startswith("OUTPUT(") or line.startswith("Cross Reference Table"):
+            break
+
+        fields = None
+
+        match = mapSectionLine.match(line)
+        if match:
+            if match.group(2) is None:
+                pending = match.group(1)
+                continue
+            fields = match.groups()
+        elif pending is not None:
+            match = mapContinuedLine.match(line)
+            if match:
+                fields = (pending,) + match.groups()
+
+        pending = None
+
+        if fields is None:
+            continue
+
+        section, address, size, objectFile = fields
+        address = int(address, 16)
+        size    = int(size, 16)
+
+        if size == 0:
+            continue
+
+        # .data takes flash for its initial values, and RAM.
+        flash = size if (flashStart <= address < flashEnd or section.startswith(".data")) else 0
+        ram   = size if (ramStart <= address < ramEnd) else 0
+
+        if flash == 0 and ram == 0:
+            continue
+
+        if section == "*fill*" or objectFile is None:
+            module = "(fill)"
+        else:
+            module = module_name(objectFile)
+
+        sizes = moduleSizes.setdefault(module, {"flash": 0, "ram": 0})
+        sizes["flash"] += flash
+        sizes["ram"]   += ram
+
+        symbolSizes.append((flash + ram, section, module))
+
+    mapFile.close()
+
+    if len(moduleSizes) == 0:
+        print "ERROR: " + filename + " has no memory map."
+        return False
+
+    # An LTO link gives all the code to temporary objects, named anew each
+    # build, so there are no modules to compare.
+    if any(".ltrans" in module for module in moduleSizes):
+        print "ERROR: " + filename + " is from an LTO link, no sizes by module."
+        return False
+
+    return True
+
+def format_growth(value):
+
+    '''
+    This routine formats a size change, with its sign.
+    '''
+
+    if value == 0:
+        return "0"
+
+    return "{0:+d}".format(value)
+
+def module_report(baseline, maxGrowth, limits, symbolCount):
+
+    '''
+    This routine prints the flash and RAM of each module, with the growth
+    since the baseline, and the largest symbols.
+
+    @param baseline - Supplies the module sizes of the baseline, or None.
+    @param maxGrowth - Supplies the growth allowed in flash or RAM for a
+                       module, or None for no limit.
+    @param limits - Supplies the growth allowed for named modules.
+    @param symbolCount - Supplies the number of symbols listed.
+
+    @return Returns success if no module grew more than allowed
+    '''
+
+    noErrorFound = True
+
+    modules = sorted(moduleSizes.keys(), key=lambda m: (-moduleSizes[m]["flash"], -moduleSizes[m]["ram"], m))
+
+    if baseline is not None:
+        for module in baseline:
+            if module not in moduleSizes:
+                modules.append(module)
+
+    print "\nModule Metrics"
+    if baseline is None:
+        print "    {0:<32} {1:>8} {2:>8}".format("Module", "Flash", "RAM")
+    else:
+        print "    {0:<32} {1:>8} {2:>8} {3:>8} {4:>8}".format("Module", "Flash", "RAM", "Flash+-", "RAM+-")
+
+    for module in modules:
+        sizes = moduleSizes.get(module, {"flash": 0, "ram": 0})
+
+        if baseline is None:
+            print "    {0:<32} {1:>8} {2:>8}".format(module, sizes["flash"], sizes["ram"])
+            continue
+
+        base = baseline.get(module, {"flash": 0, "ram": 0})
+
+        flashGrowth = sizes["flash"] - base.get("flash", 0)
+        ramGrowth   = sizes["ram"] - base.get("ram", 0)
+
+        limit = limits.get(module, maxGrowth)
+
+        growthStr = "{0:>8} {1:>8}".format(format_growth(flashGrowth), format_growth(ramGrowth))
+
+        if limit is not None and (flashGrowth > limit or ramGrowth > limit):
+            growthStr = colorize(growthStr, ansi_colors.RED) + "  exceeds {0}".format(limit)
+            noErrorFound = False
+        elif flashGrowth > 0 or ramGrowth > 0:
+            growthStr = colorize(growthStr, ansi_colors.YELLOW)
+
+        print "    {0:<32} {1:>8} {2:>8} {3}".format(module, sizes["flash"], sizes["ram"], growthStr)
+
+    if symbolCount > 0:
+        print "\nLargest Symbols"
+        for size, section, module in sorted(symbolSizes, reverse=True)[:symbolCount]:
+            print "    {0:>8}  {1:<40} {2}".format(size, section, module)
+
+    return noErrorFound
+
 #=============================================================================================
 #Main code path
 
@@ -283,18 +501,30 @@ ramEnd = 0
 heapSize = 0
 bssSize = 0
 dataSize = 0
+moduleSizes = {}
+symbolSizes = []
 
 useColor = True
+profile = None
 
 parser = argparse.ArgumentParser()
 
 parser.add_argument("ldfile", help="Path to linker script")
 parser.add_argument("imagefile", help="Path to elf image")
 parser.add_argument('-n', '--no-color', action = 'store_true', help = 'Suppress color output.')
+parser.add_argument('-m', '--map', help = 'Path to linker map file, for the sizes by module.')
+parser.add_argument('-b', '--baseline', help = 'Module sizes saved from an earlier build, to compare with.')
+parser.add_argument('-s', '--save-baseline', help = 'Save the module sizes of this build to the given file.')
+parser.add_argument('-g', '--max-growth', type = int, help = 'Bytes of flash or RAM a module may grow by.')
+parser.add_argument('-l', '--limit', action = 'append', default = [], metavar = 'MODULE=BYTES',
+                    help = 'Bytes a given module may grow by, instead of --max-growth.')
+parser.add_argument('-t', '--top', type = int, default = 10, help = 'Number of largest symbols listed.')
+parser.add_argument('-p', '--profile', help = 'Build profile, named in the report.')
 
 args = parser.parse_args()
 
 useColor = not args.no_color
+profile  = args.profile
 
 if args.ldfile:
     ldFile = args.ldfile
@@ -312,4 +542,27 @@ if(read_in_ld_file(ldFile) == False):
 if(get_code_size(elfFile) == False):
     sys.exit(1)
 
+if args.map:
+    if(read_in_map_file(args.map) == False):
+        sys.exit(1)
+
+    baseline = None
+    if args.baseline:
+        if os.path.exists(args.baseline):
+            baseline = json.load(open(args.baseline, "r"))["modules"]
+        else:
+            print "\nNo baseline " + args.baseline + " yet, growth not checked."
+
+    limits = {}
+    for limit in args.limit:
+        module, _, size = limit.partition("=")
+        limits[module] = int(size)
+
+    if args.save_baseline:
+        json.dump({"modules": moduleSizes}, open(args.save_baseline, "w"), indent=2, sort_keys=True)
+        print "\nBaseline saved to " + args.save_baseline
+
+    if(module_report(baseline, args.max_growth, limits, args.top) == False):
+        sys.exit(1)
+
 sys.exit(0)
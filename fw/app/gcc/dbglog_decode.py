@@ -0,0 +1,196 @@
+#!/usr/bin/env python
+#
+# Decodes the binary log records of a DBGLOG_BINARY build, see dbglog.h.
+# The format strings are read from the .dbglog_fmt section of the build's
+# .elf file, and %s arguments from its flash image.
+#
+#   dbglog_decode.py _build/application.elf capture.bin
+#   cat /dev/ttyACM0 | dbglog_decode.py _build/application.elf
+#
+
+from __future__ import print_function
+
+import re
+import struct
+import sys
+import argparse
+
+DBGLOG_SYNC     = 0xA5
+DBGLOG_ARGS_MAX = 8
+DBGLOG_LOST_ID  = 0xFFFF
+
+SHF_ALLOC       = 0x2
+SHT_PROGBITS    = 1
+
+class elf_image:
+
+    '''
+    The sections of a 32 bit little endian .elf file this decoder needs:
+    .dbglog_fmt, and the loaded sections for strings in flash.
+    '''
+
+    def __init__(self, filename):
+        data = open(filename, "rb").read()
+
+        if data[:4] != b"\x7fELF" or data[4:5] != b"\x01" or data[5:6] != b"\x01":
+            raise ValueError(filename + " is not a 32 bit little endian .elf file")
+
+        shoff, = struct.unpack_from("<I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x2E)
+
+        headers = [struct.unpack_from("<IIIIIIIIII", data, shoff + i * shentsize)
+                   for i in range(shnum)]
+
+        names = headers[shstrndx]
+        names = data[names[4]:names[4] + names[5]]
+
+        self.formats  = b""
+        self.sections = []
+
+        for name, type, flags, addr, offset, size, _, _, _, _ in headers:
+            name = names[name:names.index(b"\0", name)]
+            if name == b".dbglog_fmt":
+                self.formats = data[offset:offset + size]
+            elif type == SHT_PROGBITS and (flags & SHF_ALLOC) and size > 0:
+                self.sections.append((addr, data[offset:offset + size]))
+
+        if not self.formats:
+            raise ValueError(filename + " has no .dbglog_fmt section, not a DBGLOG_BINARY build")
+
+    def format_get(self, fmt_id):
+        '''The format string at fmt_id, or None if no string starts there.'''
+        if fmt_id >= len(self.formats):
+            return None
+        if fmt_id > 0 and self.formats[fmt_id - 1:fmt_id] != b"\0":
+            return None
+        return self.formats[fmt_id:self.formats.index(b"\0", fmt_id)].decode("latin-1")
+
+    def string_get(self, address):
+        '''The string at a flash address, as passed for %s.'''
+        for start, data in self.sections:
+            if start <= address < start + len(data):
+                offset = address - start
+                end = data.find(b"\0", offset)
+                if end < 0:
+                    end = len(data)
+                return data[offset:end].decode("latin-1")
+        return "<0x%08x>" % address
+
+# The conversions of printf.c: flags '-' and '0', a width, and s d x X u c.
+conversion = re.compile(r"%(-?)(0*)(\d*)([sdxXuc%])")
+
+def format_record(image, fmt, args):
+
+    '''
+    Formats args as printf.c would on the device.
+    '''
+
+    args = list(args)
+
+    def convert(match):
+        left, zero, width, kind = match.groups()
+
+        if kind == "%":
+            return "%"
+        if not args:
+            return "<missing>"
+
+        value = args.pop(0)
+
+        if kind == "s":
+            text = image.string_get(value)
+        elif kind == "c":
+            text = chr(value & 0xFF)
+        elif kind == "d":
+            text = str(value - (1 << 32) if value & 0x80000000 else value)
+        elif kind == "u":
+            text = str(value)
+        elif kind == "x":
+            text = "%x" % value
+        else:
+            text = "%X" % value
+
+        width = int(width or 0)
+        if left:
+            return text.ljust(width)
+        if zero and kind != "s":
+            if text.startswith("-"):
+                return "-" + text[1:].rjust(width - 1, "0")
+            return text.rjust(width, "0")
+        return text.rjust(width)
+
+    return conversion.sub(convert, fmt)
+
+def decode(image, stream, out):
+
+    '''
+    Reads records from stream, and writes their text to out.  Bytes which do
+    not start a record, such as the output before DBGLOG_BINARY logging was
+    started, are skipped and counted.
+    '''
+
+    buffer  = b""
+    skipped = 0
+
+    while True:
+        chunk = stream.read(1) if stream.isatty() else stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+
+        while len(buffer) >= 4:
+            sync, nargs, fmt_id = struct.unpack_from("<BBH", buffer, 0)
+
+            if fmt_id == DBGLOG_LOST_ID and nargs == 1:
+                fmt = "*** %u records lost ***\n"
+            else:
+                fmt = image.format_get(fmt_id)
+
+            if sync != DBGLOG_SYNC or nargs > DBGLOG_ARGS_MAX or fmt is None:
+                buffer   = buffer[1:]
+                skipped += 1
+                continue
+
+            length = 4 + 4 * nargs
+            if len(buffer) < length:
+                break
+
+            args   = struct.unpack_from("<%dI" % nargs, buffer, 4)
+            buffer = buffer[length:]
+
+            out.write(format_record(image, fmt, args))
+            out.flush()
+
+    return skipped + len(buffer)
+
+def main():
+
+    parser = argparse.ArgumentParser(description="Decode DBGLOG_BINARY log records.")
+    parser.add_argument("elf", help="the .elf file of the build on the device")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="captured UART output, default stdin")
+    args = parser.parse_args()
+
+    try:
+        image = elf_image(args.elf)
+    except (IOError, ValueError) as error:
+        print("ERROR: " + str(error), file=sys.stderr)
+        return 1
+
+    if args.input == "-":
+        stream = getattr(sys.stdin, "buffer", sys.stdin)
+    else:
+        stream = open(args.input, "rb")
+
+    try:
+        skipped = decode(image, stream, sys.stdout)
+    except KeyboardInterrupt:
+        return 0
+
+    if skipped:
+        print("%d bytes skipped" % skipped, file=sys.stderr)
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
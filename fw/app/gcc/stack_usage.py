@@ -0,0 +1,222 @@
+#!/usr/bin/env python
+#
+# Estimates the worst case stack depth of the application from the frame
+# sizes gcc writes with -fstack-usage (.su files next to the objects), and
+# the calls found by disassembling the .elf file.
+#
+#   stack_usage.py -s 2048 _build/application.elf _build
+#
+# Each root, main() and the exception handlers in the vector table, is
+# followed down its deepest call chain.  Calls through function pointers
+# cannot be followed, nor the SoftDevice's own use of the stack: both are
+# reported, and the SoftDevice's worst case is added from its specification.
+# Exits with '1' if the estimate exceeds the stack size, '0' otherwise.
+#
+
+from __future__ import print_function
+
+import os
+import re
+import sys
+import subprocess
+import argparse
+
+EXCEPTION_FRAME = 32      # r0-r3, r12, lr, pc, psr stacked on each entry
+SOFTDEVICE_STACK = 1536   # S110 worst case, see its specification
+
+# 00018abc <main>:
+symbol_line = re.compile(r"^[0-9a-f]+ <(?P<name>[^>]+)>:$")
+
+#    18ac2:	f7ff ffe1 	bl	18a88 <uptime_get>
+#    18ac6:	e7fd      	b.n	18ac4 <main+0x8>
+#    18ac8:	4798      	blx	r3
+call_line = re.compile(r"^\s*[0-9a-f]+:\s+(?:[0-9a-f]{4}\s?)+\s+"
+                       r"(?P<op>bl|blx|b|b\.n|b\.w)\s+\S+(?:\s+<(?P<name>[^>+]+)(?P<offset>\+0x[0-9a-f]+)?>)?")
+
+# main.c:190:5:main	24	static
+su_line = re.compile(r"^(?P<location>\S+?):(?P<name>[^:\s]+)\t(?P<size>\d+)\t(?P<kind>\S+)")
+
+def read_frames(directory):
+
+    '''
+    The frame size of each function, from the .su files in directory.  A
+    name defined static in several files keeps its largest frame.
+    '''
+
+    frames  = {}
+    dynamic = set()
+
+    for filename in sorted(os.listdir(directory)):
+        if not filename.endswith(".su"):
+            continue
+        for line in open(os.path.join(directory, filename)):
+            match = su_line.match(line)
+            if not match:
+                continue
+            name = match.group("name")
+            frames[name] = max(frames.get(name, 0), int(match.group("size")))
+            if "dynamic" in match.group("kind"):
+                dynamic.add(name)
+
+    return frames, dynamic
+
+def read_calls(objdump, elf):
+
+    '''
+    The functions each function calls, and those which call through a
+    pointer, from the disassembly of elf.  A branch to the start of another
+    function is a tail call, and is followed as a call.
+    '''
+
+    output = subprocess.Popen([objdump, "-d", elf], stdout=subprocess.PIPE,
+                              universal_newlines=True).stdout
+
+    calls    = {}
+    indirect = set()
+    current  = None
+
+    for line in output:
+        line = line.rstrip()
+
+        match = symbol_line.match(line)
+        if match:
+            current = match.group("name")
+            calls.setdefault(current, set())
+            continue
+
+        match = call_line.match(line)
+        if not match or current is None:
+            continue
+
+        op, name = match.group("op"), match.group("name")
+
+        # A branch to its own start is a loop; a call to itself, recursion.
+        if op == "blx" and name is None:
+            indirect.add(current)
+        elif name is not None and match.group("offset") is None and \
+             (name != current or op == "bl"):
+            calls[current].add(name)
+
+    return calls, indirect
+
+def vector_handlers(calls):
+
+    '''
+    The exception handlers: the names the vector table uses.
+    '''
+
+    return sorted(name for name in calls
+                  if name.endswith("_Handler") or name.endswith("_IRQHandler"))
+
+class analysis:
+
+    '''
+    Deepest call chain from a function, with recursion cut where found.
+    '''
+
+    def __init__(self, frames, calls, indirect, dynamic):
+        self.frames    = frames
+        self.calls     = calls
+        self.indirect  = indirect
+        self.dynamic   = dynamic
+        self.depths    = {}
+        self.unknown   = set()
+        self.recursive = set()
+
+    def depth(self, name, active=()):
+        '''(depth, chain) of the deepest call chain from name.'''
+        if name in self.depths:
+            return self.depths[name]
+        if name in active:
+            self.recursive.add(name)
+            return 0, []
+
+        if name not in self.frames:
+            self.unknown.add(name)
+
+        deepest, chain = 0, []
+        for callee in sorted(self.calls.get(name, ())):
+            d, c = self.depth(callee, active + (name,))
+            if d > deepest:
+                deepest, chain = d, c
+
+        result = (self.frames.get(name, 0) + deepest, [name] + chain)
+        self.depths[name] = result
+        return result
+
+def main():
+
+    parser = argparse.ArgumentParser(description="Estimate the worst case stack depth.")
+    parser.add_argument("elf", help="the linked .elf file")
+    parser.add_argument("objects", help="directory of the objects and their .su files")
+    parser.add_argument("-s", "--stack-size", type=int, default=0,
+                        help="stack reserved, STACK_SIZE in the makefile")
+    parser.add_argument("-o", "--objdump", default="arm-none-eabi-objdump",
+                        help="objdump of the toolchain")
+    parser.add_argument("-n", "--top", type=int, default=10,
+                        help="number of roots listed")
+    args = parser.parse_args()
+
+    frames, dynamic = read_frames(args.objects)
+    if not frames:
+        print("ERROR: no .su files in " + args.objects + ", build with -fstack-usage", file=sys.stderr)
+        return 1
+
+    try:
+        calls, indirect = read_calls(args.objdump, args.elf)
+    except OSError as error:
+        print("ERROR: " + args.objdump + ": " + str(error), file=sys.stderr)
+        return 1
+
+    graph = analysis(frames, calls, indirect, dynamic)
+
+    handlers = [(graph.depth(name), name) for name in vector_handlers(calls)]
+    handlers.sort(reverse=True)
+
+    main_depth, main_chain = graph.depth("main")
+
+    # Handlers nest by priority; as a bound, the two deepest are taken nested.
+    nested = sum(depth + EXCEPTION_FRAME for (depth, chain), name in handlers[:2])
+    total  = main_depth + nested + SOFTDEVICE_STACK
+
+    print("Stack Metrics")
+    print("    main:                   {0} bytes".format(main_depth))
+    print("        " + " > ".join(main_chain))
+    for (depth, chain), name in handlers[:args.top]:
+        print("    {0:<24}{1} bytes".format(name + ":", depth))
+        if len(chain) > 1:
+            print("        " + " > ".join(chain))
+
+    print("    SoftDevice:             {0} bytes".format(SOFTDEVICE_STACK))
+    print("    Worst case estimate:    {0} bytes".format(total), end="")
+    if args.stack_size:
+        print(" of {0} bytes reserved".format(args.stack_size))
+    else:
+        print()
+
+    reached = set()
+    for name in ["main"] + [name for _, name in handlers]:
+        pending = [name]
+        while pending:
+            n = pending.pop()
+            if n not in reached:
+                reached.add(n)
+                pending.extend(calls.get(n, ()))
+
+    notes = [
+        ("calls through pointers, not followed", graph.indirect & reached),
+        ("dynamic frames, size is a minimum",    graph.dynamic  & reached),
+        ("recursive, one level counted",         graph.recursive),
+        ("no stack usage data, counted as 0",    graph.unknown),
+    ]
+    for text, names in notes:
+        if names:
+            print("    {0} {1}: {2}".format(len(names), text, " ".join(sorted(names))))
+
+    if args.stack_size and total > args.stack_size:
+        return 1
+
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -3,8 +3,14 @@
 /*---------------------------------------------------------------------------*/
 #include <stdio.h>
 
+#include "nrf51.h"
+#include "crash.h"
 #include "dbglog.h"
 
+#if defined(PROVISION_DBGLOG)
+  #include "uart.h"
+#endif
+
 /**
 * HardFaultHandler_C:
 * This is called from the HardFault_HandlerAsm with a pointer the Fault stack
@@ -14,6 +20,7 @@
 * cause of the fault.
 * The function ends with a BKPT instruction to force control back into the debugger
 */
+__attribute__((used))
 void HardFault_HandlerC(unsigned long *hardfault_args)
 {
     volatile unsigned long stacked_r0 __attribute__((unused));
@@ -31,6 +38,8 @@ void HardFault_HandlerC(unsigned long *hardfault_args)
     volatile unsigned long _BFAR __attribute__((unused));
     volatile unsigned long _MMAR __attribute__((unused));
 
+    crash_fault_save((const uint32_t *) hardfault_args);
+
     stacked_r0  = ((unsigned long)hardfault_args[0]);
     stacked_r1  = ((unsigned long)hardfault_args[1]);
     stacked_r2  = ((unsigned long)hardfault_args[2]);
@@ -60,16 +69,24 @@ void HardFault_HandlerC(unsigned long *hardfault_args)
     // Bus Fault Address Register
     _BFAR = (*((volatile unsigned long *)(0xE000ED38)));
 
-    PUTS("\nHard Fault");
-    PRINTF(" R0  0x%08X\n", (unsigned) stacked_r0);
-    PRINTF(" R1  0x%08X\n", (unsigned) stacked_r1);
-    PRINTF(" R2  0x%08X\n", (unsigned) stacked_r2);
-    PRINTF(" R3  0x%08X\n", (unsigned) stacked_r3);
-    PRINTF(" R12 0x%08X\n", (unsigned) stacked_r12);
-    PRINTF(" LR  0x%08X\n", (unsigned) stacked_lr);
-    PRINTF(" PC  0x%08X\n", (unsigned) stacked_pc);
+#if defined(PROVISION_DBGLOG)
+    uart_flush();
+#endif
+
+    LOG_ERROR("\nHard Fault\n");
+    LOG_ERROR(" R0  0x%08X\n", (unsigned) stacked_r0);
+    LOG_ERROR(" R1  0x%08X\n", (unsigned) stacked_r1);
+    LOG_ERROR(" R2  0x%08X\n", (unsigned) stacked_r2);
+    LOG_ERROR(" R3  0x%08X\n", (unsigned) stacked_r3);
+    LOG_ERROR(" R12 0x%08X\n", (unsigned) stacked_r12);
+    LOG_ERROR(" LR  0x%08X\n", (unsigned) stacked_lr);
+    LOG_ERROR(" PC  0x%08X\n", (unsigned) stacked_pc);
 
+#if defined(DEBUG)
     __asm("BKPT #0\n"); // Break into the debugger
+#else
+    NVIC_SystemReset();  // Crash record saved, see crash.c
+#endif
 
 }
 
@@ -18,6 +18,12 @@
 #include "advert.h"
 #include "connect.h"
 #include "eddystone.h"
+#include "flash_sched.h"
+#include "crash.h"
+#include "uptime.h"
+#include "reset_stats.h"
+#include "watchdog.h"
+#include "ram_usage.h"
 #include "dbglog.h"
 
 #if defined(PROVISION_DBGLOG)
@@ -27,7 +33,7 @@
 /*---------------------------------------------------------------------------*/
 /*                                                                           */
 /*---------------------------------------------------------------------------*/
-#if defined(PROVISION_DBGLOG)
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_ERROR)
 static const struct {
     uint16_t  error_code;
     char    * text;
@@ -60,18 +66,24 @@ void app_error_handler(uint32_t error_code,
                        uint32_t line_num, 
                        const uint8_t * p_file_name)
 {
-#if defined(PROVISION_DBGLOG)
+    crash_error_save(error_code, line_num, p_file_name,
+                     (uint32_t) __builtin_return_address(0));
+
+#if DBGLOG_ENABLED(DBGLOG_LEVEL_ERROR)
     char * text = "??";
     (void) text;
 
+    /* Interrupts of this priority and below no longer drain the UART. */
+    uart_flush();
+
     for (int i=0; i < NRF_ERRORS_COUNT; i++) {
         if (error_code == nrf_errors[i].error_code) {
             text = nrf_errors[i].text;
             break;
         }
     }
-    PRINTF("%s: NRF_ERROR_%s 0x%x, at %s(%d)\n", __func__, text, 
-           (unsigned)error_code, (char*)p_file_name, (int)line_num);
+    LOG_ERROR("%s: NRF_ERROR_%s 0x%x, at %s(%d)\n", __func__, text, 
+              (unsigned)error_code, (char*)p_file_name, (int)line_num);
 
 #endif
 
@@ -138,6 +150,17 @@ static void timer_init(void)
     APP_ERROR_CHECK(err_code);
 }
 
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static void radio_evt_handler(bool radio_active)
+{
+    eddystone_scheduler(radio_active);
+    flash_sched_on_radio_evt(radio_active);
+
+    watchdog_checkin(WATCHDOG_CHECKIN_RADIO);
+}
+
 /*---------------------------------------------------------------------------*/
 /*                                                                           */
 /*---------------------------------------------------------------------------*/
@@ -147,7 +170,7 @@ static void radio_init(void)
 
     err_code = ble_radio_notification_init(NRF_APP_PRIORITY_LOW,
                                            NRF_RADIO_NOTIFICATION_DISTANCE_5500US,
-                                           eddystone_scheduler);
+                                           radio_evt_handler);
     APP_ERROR_CHECK(err_code);
 }
 
@@ -172,6 +195,8 @@ static void power_manage(void)
 /*---------------------------------------------------------------------------*/
 int main(void)
 {
+    ram_usage_init();
+
     ble_stack_init();
     scheduler_init();
 
@@ -183,21 +208,30 @@ int main(void)
 
     storage_init();
     timer_init();
+    uptime_init(reset_stats_on_second);
     radio_init();
 
     gap_params_init();
     services_init();
     eddystone_init();
+#if defined(BENCHMARK)
+    eddystone_benchmark();
+#endif
     conn_params_init();
     sec_params_init();
 
     device_manager_init();
+    crash_init();
+    reset_stats_init();
 
     advertising_start_connectable();
 
+    watchdog_init();
+
     /* Enter main loop. */
     for (;;) {
         app_sched_execute();
+        watchdog_checkin(WATCHDOG_CHECKIN_MAIN);
         power_manage();
     }
 }
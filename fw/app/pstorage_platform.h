@@ -26,6 +26,9 @@
 #define PSTORAGE_MAX_BLOCK_SIZE     PSTORAGE_FLASH_PAGE_SIZE  
 #define PSTORAGE_CMD_QUEUE_SIZE     30 
 
+/* Raw access, for the flash scheduler: bank 1 of dual bank DFU. */
+#define PSTORAGE_RAW_MODE_ENABLE
+
 
 /* Abstracts persistently memory block identifier. */
 typedef uint32_t pstorage_block_t;
@@ -0,0 +1,67 @@
+/*---------------------------------------------------------------------------*/
+/*  ram_usage.c  -- stack and heap high-water marks, see ram_usage.h         */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdint.h>
+
+#include "nrf51.h"
+
+#include "ram_usage.h"
+#include "dbglog.h"
+
+#define RAM_USAGE_PAINT   0xA5A5A5A5
+
+/* Left unpainted below the stack pointer, for ram_usage_init()'s own use. */
+#define RAM_USAGE_MARGIN  64
+
+/* From the startup file and gcc_nrf51_common.ld. */
+extern uint32_t __HeapBase;
+extern uint32_t __HeapLimit;
+extern uint32_t __StackLimit;
+extern uint32_t __StackTop;
+
+static ram_usage_t  m_usage;
+
+/*---------------------------------------------------------------------------*/
+/*  Not inlined into main(), whose frame may be below the stack pointer      */
+/*  read here.                                                               */
+/*---------------------------------------------------------------------------*/
+__attribute__((noinline))
+void ram_usage_init(void)
+{
+    uint32_t * p   = &__HeapBase;
+    uint32_t * end = (uint32_t *) (__get_MSP() - RAM_USAGE_MARGIN);
+
+    while (p < end)
+        *p++ = RAM_USAGE_PAINT;
+
+    m_usage.stack_size = (uint32_t) &__StackTop  - (uint32_t) &__StackLimit;
+    m_usage.heap_size  = (uint32_t) &__HeapLimit - (uint32_t) &__HeapBase;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+const ram_usage_t * ram_usage_update(void)
+{
+    const uint32_t * p;
+
+    /* The stack grows down: find its deepest word from below. */
+    for (p = &__HeapLimit; p < &__StackTop && *p == RAM_USAGE_PAINT; p++)
+        ;
+
+    m_usage.stack_used = (uint32_t) &__StackTop - (uint32_t) p;
+    m_usage.stack_free = (uint32_t) p - (uint32_t) &__HeapLimit;
+
+    /* The heap grows up: find its highest word from above. */
+    for (p = &__HeapLimit; p > &__HeapBase && p[-1] == RAM_USAGE_PAINT; p--)
+        ;
+
+    m_usage.heap_used = (uint32_t) p - (uint32_t) &__HeapBase;
+
+    if (m_usage.stack_used > m_usage.stack_size)
+        LOG_WARN("ram_usage: stack %u of %u\n",
+                 (unsigned) m_usage.stack_used, (unsigned) m_usage.stack_size);
+
+    return &m_usage;
+}
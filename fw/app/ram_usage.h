@@ -0,0 +1,37 @@
+/*---------------------------------------------------------------------------*/
+/*  ram_usage.h                                                              */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _RAM_USAGE_H_
+#define _RAM_USAGE_H_
+
+#include <stdint.h>
+
+/*
+ *  Stack and heap high-water marks.  The RAM from the heap up to the stack
+ *  pointer is painted at startup; a scan finds the deepest the stack, and
+ *  the highest the heap, has reached since.  The stack is measured down to
+ *  the end of the heap, so a use past the stack reserved by the linker
+ *  script shows as stack_used above stack_size.
+ *
+ *  The stack is shared with the SoftDevice, whose use is included.
+ */
+typedef struct {
+    uint32_t stack_size;    /* reserved, STACK_SIZE in the makefile         */
+    uint32_t stack_used;    /* deepest since boot                           */
+    uint32_t stack_free;    /* left at that depth, down to the heap's end   */
+    uint32_t heap_size;     /* reserved, HEAP_SIZE in the makefile          */
+    uint32_t heap_used;     /* highest since boot                           */
+} ram_usage_t;
+
+/*
+ *  Paint the RAM.  Call first thing in main(), from its shallow stack.
+ */
+void ram_usage_init(void);
+
+/*
+ *  Scan for the high-water marks, and return them.
+ */
+const ram_usage_t * ram_usage_update(void);
+
+#endif  /* _RAM_USAGE_H_ */
@@ -0,0 +1,263 @@
+/*---------------------------------------------------------------------------*/
+/*  reset_stats.c  -- resets by cause and total uptime, see reset_stats.h    */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "nrf51.h"
+#include "nrf51_bitfields.h"
+#include "nrf_soc.h"
+#include "app_error.h"
+#include "pstorage.h"
+
+#include "reset_stats.h"
+#include "flash_sched.h"
+#include "dbglog.h"
+
+#define RESET_STATS_MAGIC  0x54534552   /* "REST" */
+
+#define CHECKSUM_WORDS  (offsetof(reset_stats_t, checksum) / sizeof(uint32_t))
+
+#define RECORDS_PER_PAGE  (PSTORAGE_FLASH_PAGE_SIZE / sizeof(reset_stats_t))
+
+/* Not cleared at startup, see the .noinit section of the linker script. */
+static reset_stats_t       m_stats __attribute__((section(".noinit")));
+
+/* The copy being written to flash; kept until the store is done. */
+static reset_stats_t       m_flash;
+
+/* Index of the record written next, RECORDS_PER_PAGE once the page is full. */
+static uint32_t            m_next;
+
+static pstorage_handle_t   m_handle;
+static volatile bool       m_busy;
+static bool                m_ready;
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static uint32_t stats_checksum(const reset_stats_t * p_stats)
+{
+    const uint32_t * p_words = (const uint32_t *) p_stats;
+    uint32_t         sum     = 0;
+    uint32_t         i;
+
+    for (i = 0; i < CHECKSUM_WORDS; i++)
+        sum = ((sum << 1) | (sum >> 31)) + p_words[i];
+
+    return ~sum;
+}
+
+static bool stats_valid(const reset_stats_t * p_stats)
+{
+    return (p_stats->magic    == RESET_STATS_MAGIC) &&
+           (p_stats->checksum == stats_checksum(p_stats));
+}
+
+/*---------------------------------------------------------------------------*/
+/*  RESETREAS is cleared on each boot, so one flag is expected; if there     */
+/*  are more, the one most telling of a fault is counted.  No flag at all    */
+/*  is a power-on or brown-out reset.                                        */
+/*---------------------------------------------------------------------------*/
+static uint16_t reset_cause(uint32_t resetreas)
+{
+    if (resetreas & POWER_RESETREAS_DOG_Msk)
+        return RESET_CAUSE_WATCHDOG;
+    if (resetreas & POWER_RESETREAS_LOCKUP_Msk)
+        return RESET_CAUSE_LOCKUP;
+    if (resetreas & POWER_RESETREAS_SREQ_Msk)
+        return RESET_CAUSE_SOFT;
+    if (resetreas & POWER_RESETREAS_RESETPIN_Msk)
+        return RESET_CAUSE_PIN;
+    if (resetreas != 0)
+        return RESET_CAUSE_OTHER;
+
+    return RESET_CAUSE_POWER_ON;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  The page is only registered with pstorage: the stats are written through */
+/*  the flash scheduler, so pstorage has nothing to call back about.          */
+/*---------------------------------------------------------------------------*/
+static void pstorage_callback_handler(pstorage_handle_t * p_handle,
+                                      uint8_t             op_code,
+                                      uint32_t            result,
+                                      uint8_t           * p_data,
+                                      uint32_t            data_len)
+{
+}
+
+/*---------------------------------------------------------------------------*/
+/*  A write which fails is tried again at the next interval.  The write is   */
+/*  done when the store is, after the erase of a full page.                  */
+/*---------------------------------------------------------------------------*/
+static void flash_callback_handler(uint8_t  op_code,
+                                   uint32_t result,
+                                   uint32_t size,
+                                   uint32_t count)
+{
+    if (result != NRF_SUCCESS)
+        LOG_WARN("reset_stats: not written (%u)\n", (unsigned) result);
+
+    if (op_code == PSTORAGE_STORE_OP_CODE)
+        m_busy = false;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static uint32_t record_address(uint32_t index)
+{
+    pstorage_handle_t block;
+
+    APP_ERROR_CHECK( pstorage_block_identifier_get(&m_handle, 0, &block) );
+
+    return block.block_id + index * sizeof(reset_stats_t);
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Find the latest record in the page, and the first free one.  A record    */
+/*  cut short by a power loss fails its checksum and is skipped.             */
+/*---------------------------------------------------------------------------*/
+static bool records_scan(reset_stats_t * p_latest)
+{
+    const reset_stats_t * p_record;
+    bool                  found = false;
+
+    for (m_next = 0; m_next < RECORDS_PER_PAGE; m_next++) {
+        p_record = (const reset_stats_t *) record_address(m_next);
+
+        if (p_record->magic == PSTORAGE_FLASH_EMPTY_MASK)
+            break;
+
+        if (stats_valid(p_record)) {
+            *p_latest = *p_record;
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Append a record to the page, through the flash scheduler.  The page is   */
+/*  only erased once full.                                                   */
+/*---------------------------------------------------------------------------*/
+static void stats_save(void)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    if (m_busy)
+        return;
+
+    m_stats.saved    = m_stats.uptime;
+    m_stats.checksum = stats_checksum(&m_stats);
+
+    m_flash = m_stats;
+
+    if (m_next >= RECORDS_PER_PAGE) {
+        err_code = flash_sched_clear(record_address(0), PSTORAGE_FLASH_PAGE_SIZE,
+                                     flash_callback_handler);
+        m_next = 0;
+    }
+
+    if (err_code == NRF_SUCCESS)
+        err_code = flash_sched_store(record_address(m_next), (const uint32_t *) &m_flash,
+                                     sizeof(m_flash), flash_callback_handler);
+
+    if (err_code != NRF_SUCCESS) {
+        LOG_WARN("reset_stats: not queued (%u)\n", (unsigned) err_code);
+        return;
+    }
+
+    m_next++;
+    m_busy = true;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void reset_stats_on_second(uint32_t seconds)
+{
+    if (!m_ready)
+        return;
+
+    m_stats.uptime++;
+    m_stats.checksum = stats_checksum(&m_stats);
+
+    if (m_stats.uptime - m_stats.saved >= RESET_STATS_SAVE_INTERVAL)
+        stats_save();
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+const reset_stats_t * reset_stats_get(void)
+{
+    return &m_stats;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+bool reset_stats_ready(void)
+{
+    return m_ready;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void reset_stats_init(void)
+{
+    pstorage_module_param_t param;
+    reset_stats_t           latest;
+    bool                    found;
+    uint32_t                resetreas;
+    uint16_t                cause;
+
+    /* A page of records. */
+    param.block_size  = sizeof(reset_stats_t);
+    param.block_count = RECORDS_PER_PAGE;
+    param.cb          = pstorage_callback_handler;
+
+    APP_ERROR_CHECK( pstorage_register(&param, &m_handle) );
+
+    found = records_scan(&latest);
+
+    /* Without power the RAM copy is lost: carry on from the latest record. */
+    if (!stats_valid(&m_stats)) {
+        if (found) {
+            m_stats = latest;
+        }
+        else {
+            memset(&m_stats, 0, sizeof(m_stats));
+            m_stats.magic = RESET_STATS_MAGIC;
+        }
+    }
+
+    APP_ERROR_CHECK( sd_power_reset_reason_get(&resetreas) );
+    APP_ERROR_CHECK( sd_power_reset_reason_clr(resetreas) );
+
+    cause = reset_cause(resetreas);
+
+    if (m_stats.count[cause] < UINT16_MAX)
+        m_stats.count[cause]++;
+
+    m_stats.resets++;
+    m_stats.cause     = cause;
+    m_stats.resetreas = resetreas;
+    m_stats.checksum  = stats_checksum(&m_stats);
+
+    LOG_INFO("reset: cause %u (0x%x), resets %u, uptime %u\n",
+             (unsigned) cause, (unsigned) resetreas,
+             (unsigned) m_stats.resets, (unsigned) m_stats.uptime);
+
+    if (cause == RESET_CAUSE_POWER_ON)
+        stats_save();
+
+    m_ready = true;
+}
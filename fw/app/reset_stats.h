@@ -0,0 +1,66 @@
+/*---------------------------------------------------------------------------*/
+/*  reset_stats.h                                                            */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _RESET_STATS_H_
+#define _RESET_STATS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ *  Reset statistics: resets counted by cause, and the uptime summed over
+ *  all boots.  The counts are kept in no-init RAM, so they carry over any
+ *  reset which does not lose power, and are copied to the module's pstorage
+ *  page, from which they are restored after a power loss.
+ *
+ *  The stats are written after a power-on, and every
+ *  RESET_STATS_SAVE_INTERVAL seconds of uptime.  Each write appends a record
+ *  to the page, which is only erased once full, so frequent brown-outs cost
+ *  one erase per page of records.  A power loss forgets what was counted
+ *  since the last write.
+ */
+
+/* The nRF51 does not tell a brown-out from a power-on reset. */
+#define RESET_CAUSE_POWER_ON    0       /* power-on or brown-out              */
+#define RESET_CAUSE_PIN         1       /* reset pin                          */
+#define RESET_CAUSE_WATCHDOG    2
+#define RESET_CAUSE_SOFT        3       /* system reset request: DFU, errors  */
+#define RESET_CAUSE_LOCKUP      4       /* CPU lockup                         */
+#define RESET_CAUSE_OTHER       5       /* System OFF wakeup, debug interface */
+#define RESET_CAUSE_COUNT       6
+
+#define RESET_STATS_SAVE_INTERVAL   (6 * 60 * 60)
+
+typedef struct {
+    uint32_t magic;                     /* RESET_STATS_MAGIC                  */
+    uint32_t resets;                    /* all causes                         */
+    uint16_t count[RESET_CAUSE_COUNT];  /* by RESET_CAUSE_xxx, saturating     */
+    uint16_t cause;                     /* RESET_CAUSE_xxx of this boot       */
+    uint16_t reserved;
+    uint32_t resetreas;                 /* POWER->RESETREAS of this boot      */
+    uint32_t uptime;                    /* seconds, over all boots            */
+    uint32_t saved;                     /* uptime when written to flash       */
+    uint32_t checksum;
+} reset_stats_t;
+
+/*
+ *  Count the reset which started this boot.  Call after crash_init(), so as
+ *  not to move the pstorage pages registered before.
+ */
+void reset_stats_init(void);
+
+/*
+ *  The uptime handler, see uptime_init(): adds the second to the total.
+ */
+void reset_stats_on_second(uint32_t seconds);
+
+const reset_stats_t * reset_stats_get(void);
+
+/*
+ *  True once reset_stats_init() has loaded and counted the stats.  Before,
+ *  reset_stats_get() holds whatever RAM kept over the reset.
+ */
+bool reset_stats_ready(void);
+
+#endif  /* _RESET_STATS_H_ */
@@ -1,14 +1,21 @@
 /*----------------------------------------------------------------------------*/
 /* uart.c                                                                     */
 /* 38400 bps, 8 data bits, 1 stop bit, No Flow Control                        */
+/*                                                                            */
+/* Output is queued in a ring buffer and sent from the TXDRDY interrupt, so   */
+/* a PRINTF costs the formatting and not ~260us per character.  When the      */
+/* buffer is full, characters are dropped and counted.                        */
 /*----------------------------------------------------------------------------*/
 
 #include <stdbool.h>
 
 #include "nrf.h"
+#include "nrf_soc.h"
 #include "uart.h"
 #include "nrf_gpio.h"
 #include "boards.h"
+#include "app_fifo.h"
+#include "app_util_platform.h"
 
 /*----------------------------------------------------------------------------*/
 /*                                                                            */
@@ -16,11 +23,71 @@
 
 #define BAUD_RATE  (UART_BAUDRATE_BAUDRATE_Baud38400 << UART_BAUDRATE_BAUDRATE_Pos)
 
+/* Must be a power of two, see app_fifo. */
+#define UART_TX_BUFFER_SIZE  512
+
+static uint8_t      m_tx_buffer[UART_TX_BUFFER_SIZE];
+static app_fifo_t   m_tx_fifo;
+static bool         m_tx_busy;      /* a character is in TXD              */
+static bool         m_polled;       /* after uart_flush()                 */
+static uint32_t     m_dropped;
+
+/*----------------------------------------------------------------------------*/
+/*                                                                            */
+/*----------------------------------------------------------------------------*/
+static void tx_wait(void)
+{
+    while (NRF_UART0->EVENTS_TXDRDY != 1) {/* spin */};
+    NRF_UART0->EVENTS_TXDRDY = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+/*  tx_free() and tx_queue() are called with interrupts blocked.              */
+/*----------------------------------------------------------------------------*/
+static uint32_t tx_free(void)
+{
+    return UART_TX_BUFFER_SIZE - (m_tx_fifo.write_pos - m_tx_fifo.read_pos);
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Send ch now if the UART is idle, else queue it.                           */
+/*----------------------------------------------------------------------------*/
+static void tx_queue(uint8_t ch)
+{
+    if (!m_tx_busy) {
+        m_tx_busy = true;
+        NRF_UART0->TXD = ch;
+    }
+    else if (app_fifo_put(&m_tx_fifo, ch) != NRF_SUCCESS) {
+        m_dropped++;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Start the next queued character, or go idle.                              */
+/*----------------------------------------------------------------------------*/
+void UART0_IRQHandler(void)
+{
+    uint8_t ch;
+
+    if (NRF_UART0->EVENTS_TXDRDY == 0)
+        return;
+
+    NRF_UART0->EVENTS_TXDRDY = 0;
+
+    if (app_fifo_get(&m_tx_fifo, &ch) == NRF_SUCCESS)
+        NRF_UART0->TXD = ch;
+    else
+        m_tx_busy = false;
+}
+
 /*----------------------------------------------------------------------------*/
 /*                                                                            */
 /*----------------------------------------------------------------------------*/
 void uart_init(void)
 {
+    (void) app_fifo_init(&m_tx_fifo, m_tx_buffer, sizeof(m_tx_buffer));
+
     // Configure UART0 pins.
     nrf_gpio_cfg_output(TX_PIN_NUMBER);
     nrf_gpio_cfg_input(RX_PIN_NUMBER, NRF_GPIO_PIN_NOPULL);
@@ -34,20 +101,61 @@ void uart_init(void)
     NRF_UART0->EVENTS_TXDRDY   = 0;
     NRF_UART0->EVENTS_ERROR    = 0;
 
-    // Activate UART.
+    // Activate UART, TXDRDY interrupt only.
     NRF_UART0->ENABLE          = UART_ENABLE_ENABLE_Enabled;
-    NRF_UART0->INTENSET        = 0;
+    NRF_UART0->INTENSET        = UART_INTENSET_TXDRDY_Msk;
     NRF_UART0->TASKS_STARTTX   = 1;
     NRF_UART0->TASKS_STARTRX   = 1;
+
+    // The SoftDevice is enabled: the NVIC is reached through it.
+    (void) sd_nvic_ClearPendingIRQ(UART0_IRQn);
+    (void) sd_nvic_SetPriority(UART0_IRQn, APP_IRQ_PRIORITY_LOW);
+    (void) sd_nvic_EnableIRQ(UART0_IRQn);
 }
 
 /*----------------------------------------------------------------------------*/
 /*                                                                            */
 /*----------------------------------------------------------------------------*/
 void uart_putc(uint8_t ch) {
-    NRF_UART0->TXD = ch;
-    while (NRF_UART0->EVENTS_TXDRDY != 1) {/* spin */};
-    NRF_UART0->EVENTS_TXDRDY = 0;
+
+    if (m_polled) {
+        NRF_UART0->TXD = ch;
+        tx_wait();
+        return;
+    }
+
+    CRITICAL_REGION_ENTER();
+    tx_queue(ch);
+    CRITICAL_REGION_EXIT();
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Queue all of p_data, or none of it.                                       */
+/*----------------------------------------------------------------------------*/
+bool uart_write(const uint8_t * p_data, uint16_t length)
+{
+    bool queued = false;
+
+    if (m_polled) {
+        while (length--)
+            uart_putc(*p_data++);
+        return true;
+    }
+
+    CRITICAL_REGION_ENTER();
+
+    if (tx_free() >= length) {
+        while (length--)
+            tx_queue(*p_data++);
+        queued = true;
+    }
+    else {
+        m_dropped += length;
+    }
+
+    CRITICAL_REGION_EXIT();
+
+    return queued;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -56,13 +164,39 @@ void uart_putc(uint8_t ch) {
 void uart_puts(uint8_t * str) {
 
     while(*str) {
-        NRF_UART0->TXD = *str;
-        while (NRF_UART0->EVENTS_TXDRDY != 1) {/* spin */};
-        NRF_UART0->EVENTS_TXDRDY = 0;
+        uart_putc(*str);
         ++str;
     }
 
-    NRF_UART0->TXD = '\n';
-    while (NRF_UART0->EVENTS_TXDRDY != 1) {/* spin */};
-    NRF_UART0->EVENTS_TXDRDY = 0;
+    uart_putc('\n');
+}
+
+/*----------------------------------------------------------------------------*/
+/*  Send what is queued by polling, and write each character synchronously    */
+/*  from then on.  For fault handlers, where the UART interrupt cannot run.   */
+/*----------------------------------------------------------------------------*/
+void uart_flush(void)
+{
+    uint8_t ch;
+
+    NRF_UART0->INTENCLR = UART_INTENCLR_TXDRDY_Msk;
+    m_polled = true;
+
+    if (m_tx_busy)
+        tx_wait();
+
+    while (app_fifo_get(&m_tx_fifo, &ch) == NRF_SUCCESS) {
+        NRF_UART0->TXD = ch;
+        tx_wait();
+    }
+
+    m_tx_busy = false;
+}
+
+/*----------------------------------------------------------------------------*/
+/*                                                                            */
+/*----------------------------------------------------------------------------*/
+uint32_t uart_dropped_get(void)
+{
+    return m_dropped;
 }
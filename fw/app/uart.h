@@ -4,10 +4,20 @@
 #ifndef UART_H
 #define UART_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
-void    uart_putc( uint8_t ch );
-void    uart_puts( uint8_t * str );
-void    uart_init( void );
+void     uart_putc( uint8_t ch );
+void     uart_puts( uint8_t * str );
+void     uart_init( void );
+
+/* Queue all length bytes, or drop all of them and return false. */
+bool     uart_write( const uint8_t * p_data, uint16_t length );
+
+/* Drain the buffer and switch to polled output, for fault handlers. */
+void     uart_flush( void );
+
+/* Characters dropped because the buffer was full. */
+uint32_t uart_dropped_get( void );
 
 #endif  /* UART_H */
@@ -0,0 +1,51 @@
+/*---------------------------------------------------------------------------*/
+/*  uptime.c                                                                 */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdint.h>
+#include <stddef.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+
+#include "config.h"
+#include "uptime.h"
+
+#define UPTIME_INTERVAL  APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER)
+
+static app_timer_id_t     m_timer_id;
+static volatile uint32_t  m_seconds;
+static uptime_handler_t   m_handler;
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+static void uptime_timeout_handler(void * p_context)
+{
+    m_seconds++;
+
+    if (m_handler != NULL)
+        m_handler(m_seconds);
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+uint32_t uptime_get(void)
+{
+    return m_seconds;
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void uptime_init(uptime_handler_t handler)
+{
+    m_handler = handler;
+
+    APP_ERROR_CHECK( app_timer_create(&m_timer_id,
+                                      APP_TIMER_MODE_REPEATED,
+                                      uptime_timeout_handler) );
+
+    APP_ERROR_CHECK( app_timer_start(m_timer_id, UPTIME_INTERVAL, NULL) );
+}
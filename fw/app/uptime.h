@@ -0,0 +1,19 @@
+/*---------------------------------------------------------------------------*/
+/*  uptime.h                                                                 */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _UPTIME_H_
+#define _UPTIME_H_
+
+#include <stdint.h>
+
+/*
+ *  Seconds since boot, counted by an app_timer.  Call after timer_init().
+ *  The handler, if any, is called on each count from the timer's context.
+ */
+typedef void (*uptime_handler_t)(uint32_t seconds);
+
+void     uptime_init(uptime_handler_t handler);
+uint32_t uptime_get(void);
+
+#endif  /* _UPTIME_H_ */
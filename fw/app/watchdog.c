@@ -0,0 +1,93 @@
+/*---------------------------------------------------------------------------*/
+/*  watchdog.c  -- WDT fed on task check-ins, see watchdog.h                 */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#include <stdint.h>
+
+#include "nrf51.h"
+#include "nrf51_bitfields.h"
+#include "nrf_soc.h"
+#include "app_util_platform.h"
+
+#include "watchdog.h"
+#include "crash.h"
+
+/* The WDT counts the 32.768 kHz clock: timeout = (CRV + 1) / 32768 s. */
+#define WATCHDOG_CRV  ((WATCHDOG_TIMEOUT_MS * 32768UL) / 1000 - 1)
+
+static volatile uint32_t  m_checkins;
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void watchdog_checkin(uint32_t checkin)
+{
+    CRITICAL_REGION_ENTER();
+
+    m_checkins |= checkin;
+
+    if (m_checkins == WATCHDOG_CHECKIN_ALL) {
+        NRF_WDT->RR[0] = WDT_RR_RR_Reload;
+        m_checkins = 0;
+    }
+
+    CRITICAL_REGION_EXIT();
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Called from WDT_IRQHandler with its exception frame.  The reset follows  */
+/*  two 32 kHz cycles after the timeout: only the record is saved.  Used     */
+/*  from asm only, so kept from LTO.                                         */
+/*---------------------------------------------------------------------------*/
+__attribute__((used))
+void watchdog_timeout_handler(const uint32_t * p_frame)
+{
+    crash_watchdog_save(p_frame, WATCHDOG_CHECKIN_ALL & ~m_checkins);
+
+    for (;;)
+        ;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  As HardFault_Handler: pass the stacked frame to the C handler.           */
+/*---------------------------------------------------------------------------*/
+__attribute__((naked))
+void WDT_IRQHandler(void)
+{
+__asm(  ".syntax unified                  \n"
+        "MOVS   R0, #4                    \n"
+        "MOV    R1, LR                    \n"
+        "TST    R0, R1                    \n"
+        "BEQ    1f                        \n"
+        "MRS    R0, PSP                   \n"
+        "B      watchdog_timeout_handler  \n"
+        "1:                               \n"
+        "MRS    R0, MSP                   \n"
+        "B      watchdog_timeout_handler  \n"
+        ".syntax divided                  \n");
+}
+
+/*---------------------------------------------------------------------------*/
+/*                                                                           */
+/*---------------------------------------------------------------------------*/
+void watchdog_init(void)
+{
+    /* Above the app's own interrupts, so a hang in one of them is caught. */
+    (void) sd_nvic_ClearPendingIRQ(WDT_IRQn);
+    (void) sd_nvic_SetPriority(WDT_IRQn, APP_IRQ_PRIORITY_HIGH);
+    (void) sd_nvic_EnableIRQ(WDT_IRQn);
+
+    NRF_WDT->INTENSET = WDT_INTENSET_TIMEOUT_Msk;
+
+    /* Still running from before a soft reset, it cannot be configured. */
+    if (NRF_WDT->RUNSTATUS == 0) {
+        NRF_WDT->CONFIG = (WDT_CONFIG_HALT_Pause << WDT_CONFIG_HALT_Pos) |
+                          (WDT_CONFIG_SLEEP_Run  << WDT_CONFIG_SLEEP_Pos);
+        NRF_WDT->CRV    = WATCHDOG_CRV;
+        NRF_WDT->RREN   = WDT_RREN_RR0_Msk;
+
+        NRF_WDT->TASKS_START = 1;
+    }
+
+    NRF_WDT->RR[0] = WDT_RR_RR_Reload;
+}
@@ -0,0 +1,40 @@
+/*---------------------------------------------------------------------------*/
+/*  watchdog.h                                                               */
+/*  Copyright (c) 2015 Robin Callender. All Rights Reserved.                 */
+/*---------------------------------------------------------------------------*/
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+#include <stdint.h>
+
+/*
+ *  Watchdog supervisor: the WDT is fed only once every task below has
+ *  checked in since the last feed, so one which stops makes the WDT reset
+ *  the beacon.  Before the reset, the tasks which did not check in, and
+ *  where the code was interrupted, are saved as a crash record, see crash.h.
+ *
+ *  The WDT keeps running over a soft reset, and the bootloader feeds it
+ *  while in DFU mode.  It is paused while the debugger halts the CPU.
+ */
+#define WATCHDOG_CHECKIN_RADIO  (1 << 0)    /* radio notification handler    */
+#define WATCHDOG_CHECKIN_MAIN   (1 << 1)    /* main loop: app_scheduler      */
+#define WATCHDOG_CHECKIN_FLASH  (1 << 2)    /* flash scheduler not stuck     */
+
+#define WATCHDOG_CHECKIN_ALL    (WATCHDOG_CHECKIN_RADIO | \
+                                 WATCHDOG_CHECKIN_MAIN  | \
+                                 WATCHDOG_CHECKIN_FLASH)
+
+#define WATCHDOG_TIMEOUT_MS     8000
+
+/*
+ *  Start the WDT.  Call just before the main loop, once advertising has
+ *  started the radio events.
+ */
+void watchdog_init(void);
+
+/*
+ *  Check in one of WATCHDOG_CHECKIN_xxx; from any context.
+ */
+void watchdog_checkin(uint32_t checkin);
+
+#endif  /* _WATCHDOG_H_ */
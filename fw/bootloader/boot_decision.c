@@ -0,0 +1,126 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  boot_decision.c  -- single pass boot decision and boot phase timing.
+ *
+ *  main() used to ask bootloader_app_is_valid() once to decide on DFU and
+ *  again before starting the application.  The bank 0 result is kept here
+ *  instead, keyed on the settings write generation, so the image is only
+ *  looked at again if DFU has rewritten it.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "nrf.h"
+#include "bootloader.h"
+#include "bootloader_types.h"
+#include "dfu_types.h"
+#include "boot_decision.h"
+#include "dbglog.h"
+
+static boot_image_t m_image;
+static bool         m_image_cached = false;
+
+const boot_image_t * boot_image_validate(void)
+{
+    bootloader_settings_t settings;
+
+    bootloader_settings_get(&settings);
+
+    if (m_image_cached && (m_image.generation == settings.write_generation))
+        return &m_image;
+
+    m_image.valid      = bootloader_app_is_valid(DFU_BANK_0_REGION_START);
+    m_image.size       = settings.bank_0_size;
+    m_image.crc        = settings.bank_0_crc;
+    m_image.generation = settings.write_generation;
+    m_image_cached     = true;
+
+    return &m_image;
+}
+
+#if defined(DBGLOG_SUPPORT)
+
+/*
+ *  TIMER1 is free in the bootloader and runs from the HFCLK, so it counts
+ *  before the SoftDevice has started the LFCLK.  16MHz / 2^9 gives 32us
+ *  ticks, and the 16 bit counter wraps after about 2 seconds.
+ */
+#define BOOT_TIMER            NRF_TIMER1
+#define BOOT_TIMER_PRESCALER  9
+#define BOOT_TIMER_TICK_US    32
+
+static const char * const m_phase_names[BOOT_PHASE_COUNT] = {
+    "init",
+    "stack",
+    "validate",
+    "jump",
+};
+
+static uint32_t m_phase_ticks[BOOT_PHASE_COUNT];
+static uint16_t m_last_count;
+
+static uint16_t boot_timer_count(void)
+{
+    BOOT_TIMER->TASKS_CAPTURE[0] = 1;
+    return (uint16_t) BOOT_TIMER->CC[0];
+}
+
+/*
+ *  Ticks since the previous call.
+ */
+static uint16_t boot_timer_elapsed(void)
+{
+    uint16_t count   = boot_timer_count();
+    uint16_t elapsed = count - m_last_count;
+
+    m_last_count = count;
+    return elapsed;
+}
+
+void boot_timing_init(void)
+{
+    BOOT_TIMER->MODE      = TIMER_MODE_MODE_Timer;
+    BOOT_TIMER->BITMODE   = TIMER_BITMODE_BITMODE_16Bit;
+    BOOT_TIMER->PRESCALER = BOOT_TIMER_PRESCALER;
+    BOOT_TIMER->TASKS_CLEAR = 1;
+    BOOT_TIMER->TASKS_START = 1;
+
+    m_last_count = 0;
+}
+
+void boot_timing_phase(boot_phase_t phase)
+{
+    m_phase_ticks[phase] += boot_timer_elapsed();
+}
+
+void boot_timing_skip(void)
+{
+    (void) boot_timer_elapsed();
+}
+
+void boot_timing_report(void)
+{
+    uint32_t total = 0;
+    int      i;
+
+    for (i = 0; i < BOOT_PHASE_COUNT; i++) {
+        PRINTF("boot %-8s %8u us\n", m_phase_names[i],
+               (unsigned) (m_phase_ticks[i] * BOOT_TIMER_TICK_US));
+        total += m_phase_ticks[i];
+    }
+    PRINTF("boot total    %8u us\n", (unsigned) (total * BOOT_TIMER_TICK_US));
+    PRINTF("boot image    size %u  crc 0x%04x  %s\n",
+           (unsigned) m_image.size, (unsigned) m_image.crc,
+           m_image.valid ? "valid" : "invalid");
+
+    /* Leave TIMER1 as the application expects to find it after reset. */
+    BOOT_TIMER->TASKS_STOP     = 1;
+    BOOT_TIMER->TASKS_SHUTDOWN = 1;
+    BOOT_TIMER->PRESCALER      = 4;
+    BOOT_TIMER->BITMODE        = TIMER_BITMODE_BITMODE_16Bit;
+    BOOT_TIMER->CC[0]          = 0;
+}
+
+#endif /* DBGLOG_SUPPORT */
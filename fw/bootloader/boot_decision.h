@@ -0,0 +1,73 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  boot_decision.h  -- single pass boot decision and boot phase timing.
+ */
+#ifndef BOOT_DECISION_H__
+#define BOOT_DECISION_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ *  Bank 0 image, as validated for this boot.
+ */
+typedef struct {
+    bool     valid;         /* image may be started                       */
+    uint32_t size;          /* image size from the bootloader settings    */
+    uint16_t crc;           /* image CRC from the bootloader settings     */
+    uint32_t generation;    /* settings write generation validated        */
+} boot_image_t;
+
+/*
+ *  Validate the bank 0 image once, and return the cached result for the
+ *  rest of the boot.  Bank 0 is validated again only if the bootloader
+ *  settings were rewritten since, e.g. by a DFU session.
+ */
+const boot_image_t * boot_image_validate(void);
+
+/*
+ *  Boot phases timed and reported over the debug UART.
+ */
+typedef enum {
+    BOOT_PHASE_INIT,        /* main() entry to bootloader settings ready  */
+    BOOT_PHASE_STACK,       /* BLE stack and service init, DFU only       */
+    BOOT_PHASE_VALIDATE,    /* bank 0 image validation                    */
+    BOOT_PHASE_JUMP,        /* boot decision to application hand-off      */
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+#if defined(DBGLOG_SUPPORT)
+
+/*
+ *  Start timing the boot.  Call first thing in main().
+ */
+void boot_timing_init(void);
+
+/*
+ *  Charge the time since the previous call to the given phase.
+ *  Calls must be less than 2 seconds apart.
+ */
+void boot_timing_phase(boot_phase_t phase);
+
+/*
+ *  Discard the time since the previous call, e.g. a DFU session.
+ */
+void boot_timing_skip(void);
+
+/*
+ *  Print the phase times and release the timer.  Call just before
+ *  starting the application.
+ */
+void boot_timing_report(void);
+
+#else /* DBGLOG_SUPPORT */
+
+#define boot_timing_init()
+#define boot_timing_phase(phase)
+#define boot_timing_skip()
+#define boot_timing_report()
+
+#endif /* DBGLOG_SUPPORT */
+
+#endif // BOOT_DECISION_H__
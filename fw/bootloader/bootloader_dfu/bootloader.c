@@ -11,23 +11,34 @@
  */
 
 #include "bootloader.h"
+#include <stddef.h>
 #include <string.h>
 #include "bootloader_types.h"
 #include "bootloader_util.h"
 #include "bootloader_settings.h"
 #include "dfu.h"
 #include "dfu_transport.h"
+#include "dfu_init.h"
 #include "nrf51.h"
+#include "nrf51_bitfields.h"
 #include "app_error.h"
 #include "nrf_sdm.h"
 #include "nordic_common.h"
 #include "crc16.h"
 #include "pstorage.h"
 #include "app_scheduler.h"
+#include "app_timer.h"
 #include "nrf_delay.h"
+#if defined(DFU_DELTA_SUPPORT)
+#include "dfu_delta.h"
+#endif
+#if defined(DFU_DELTA_SUPPORT) && defined(DFU_SIGNING_SUPPORT)
+#include "sha256.h"
+#endif
 
 #define IRQ_ENABLED             0x01                    /**< Field identifying if an interrupt is enabled. */
 #define MAX_NUMBER_INTERRUPTS   32                      /**< Maximum number of interrupts available. */
+#define SETTINGS_RECORD_BUFFERS 3                       /**< Settings records which may be queued to pstorage at once. */
 
 /**@brief Enumeration for specifying current bootloader status.
  */
@@ -42,6 +53,16 @@ typedef enum
 
 static pstorage_handle_t        m_bootsettings_handle;  /**< Pstorage handle to use for registration and identifying the bootloader module on subsequent calls to the pstorage module for load and store of bootloader setting in flash. */
 static bootloader_status_t      m_update_status;        /**< Current update status for the bootloader module to ensure correct behaviour when updating settings and when update completes. */
+static uint32_t                 m_bank_0_verified_generation = EMPTY_FLASH_MASK; /**< Write generation of bank 0 already checked during this boot. */
+
+static const bootloader_settings_record_t * mp_settings_record;   /**< Current record of the bootloader settings journal, NULL if the journal is empty. */
+static uint32_t                 m_settings_sequence;    /**< Sequence number of the current record of the settings journal. */
+static uint32_t                 m_settings_next;        /**< Index of the journal record the next settings are saved to. */
+static bootloader_settings_record_t m_settings_records[SETTINGS_RECORD_BUFFERS];  /**< Records being saved, each kept until pstorage has written it. */
+static uint8_t                  m_settings_record_index;   /**< Buffer the last record was saved from. */
+static uint8_t                  m_settings_records_queued; /**< Records queued to pstorage and not yet written. */
+static app_timer_id_t           m_wdt_timer_id;         /**< Timer waking the event loop to feed a running watchdog. */
+static bool                     m_wdt_timer_started;    /**< The watchdog timer has been created and started. */
 
 /**@brief   Function for handling callbacks from pstorage module.
  *
@@ -61,10 +82,58 @@ static void pstorage_callback_handler(pstorage_handle_t * p_handle,
         m_update_status = BOOTLOADER_COMPLETE;
     }
 
+    // Records are written in the order they were queued, so the oldest buffer is free again.
+    if ((op_code == PSTORAGE_STORE_OP_CODE)                 &&
+        (p_data >= (uint8_t *)&m_settings_records[0])      &&
+        (p_data <  (uint8_t *)&m_settings_records[SETTINGS_RECORD_BUFFERS]))
+    {
+        m_settings_records_queued--;
+    }
+
     APP_ERROR_CHECK(result);
 }
 
 
+void bootloader_wdt_feed(void)
+{
+    if (NRF_WDT->RUNSTATUS != 0)
+    {
+        NRF_WDT->RR[0] = WDT_RR_RR_Reload;
+    }
+}
+
+
+/**@brief   Function for handling the watchdog timer timeout. Waking the event loop is all it does.
+ */
+static void wdt_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+}
+
+
+/**@brief   Function for starting a timer waking the event loop at half the watchdog period, so a
+ *          running watchdog is fed while no other event comes.
+ */
+static void wdt_timer_start(void)
+{
+    uint32_t err_code;
+
+    if ((NRF_WDT->RUNSTATUS == 0) || m_wdt_timer_started)
+    {
+        return;
+    }
+
+    err_code = app_timer_create(&m_wdt_timer_id, APP_TIMER_MODE_REPEATED, wdt_timeout_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // The watchdog counts the 32.768 kHz clock, as RTC1 does with a prescaler of 0.
+    err_code = app_timer_start(m_wdt_timer_id, (NRF_WDT->CRV + 1) / 2, NULL);
+    APP_ERROR_CHECK(err_code);
+
+    m_wdt_timer_started = true;
+}
+
+
 /**@brief   Function for waiting for events.
  *
  * @details This function will place the chip in low power mode while waiting for events from
@@ -75,6 +144,8 @@ static void pstorage_callback_handler(pstorage_handle_t * p_handle,
  */
 static void wait_for_events(void)
 {
+    wdt_timer_start();
+
     for (;;)
     {
         // Wait in low power state for any events.
@@ -84,10 +155,22 @@ static void wait_for_events(void)
         // Event received. Process it from the scheduler.
         app_sched_execute();
 
+        bootloader_wdt_feed();
+
         if ((m_update_status == BOOTLOADER_COMPLETE) ||
             (m_update_status == BOOTLOADER_TIMEOUT)  ||
             (m_update_status == BOOTLOADER_RESET))
         {
+            uint32_t count;
+
+            // Let queued flash operations, e.g. a resume checkpoint, complete before returning as
+            // the caller will reset the system.
+            err_code = pstorage_access_status_get(&count);
+            if ((err_code == NRF_SUCCESS) && (count != 0))
+            {
+                continue;
+            }
+
             // When update has completed or a timeout/reset occured we will return.
             return;
         }
@@ -95,6 +178,337 @@ static void wait_for_events(void)
 }
 
 
+/**@brief   Function for waiting until all queued flash operations have completed.
+ */
+static void flash_operations_wait(void)
+{
+    uint32_t count;
+
+    while ((pstorage_access_status_get(&count) == NRF_SUCCESS) && (count != 0))
+    {
+        uint32_t err_code = sd_app_evt_wait();
+        APP_ERROR_CHECK(err_code);
+
+        app_sched_execute();
+
+        bootloader_wdt_feed();
+    }
+}
+
+
+/**@brief   Function for checking if the SoftDevice is enabled.
+ *
+ * @details On the fast boot path the application is validated and started without enabling the
+ *          SoftDevice, so pstorage, which uses the SoftDevice flash API, is not available.
+ */
+static bool softdevice_enabled(void)
+{
+    uint8_t enabled = 0;
+
+    (void) sd_softdevice_is_enabled(&enabled);
+
+    return (enabled != 0);
+}
+
+
+/**@brief   Function for waiting until the NVMC is ready for the next operation.
+ */
+static void nvmc_wait(void)
+{
+    while (NRF_NVMC->READY == NVMC_READY_READY_Busy)
+    {
+        // Do nothing.
+    }
+}
+
+
+/**@brief   Function for erasing one flash page with the NVMC.
+ *
+ * @details Only used while the SoftDevice is disabled, when the bootloader owns the NVMC.
+ *
+ * @param[in] address  Address of the page.
+ */
+static void nvmc_page_erase(uint32_t address)
+{
+    NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos);
+    nvmc_wait();
+
+    NRF_NVMC->ERASEPAGE = address;
+    nvmc_wait();
+
+    NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos);
+    nvmc_wait();
+}
+
+
+/**@brief   Function for programming words of flash with the NVMC.
+ *
+ * @details Only used while the SoftDevice is disabled, when the bootloader owns the NVMC.
+ *
+ * @param[in] address  Address of the first word.
+ * @param[in] p_words  Words to program.
+ * @param[in] count    Number of words.
+ */
+static void nvmc_words_write(uint32_t address, const uint32_t * p_words, uint32_t count)
+{
+    uint32_t i;
+
+    NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Wen << NVMC_CONFIG_WEN_Pos);
+    nvmc_wait();
+
+    for (i = 0; i < count; i++)
+    {
+        ((volatile uint32_t *)address)[i] = p_words[i];
+        nvmc_wait();
+    }
+
+    NRF_NVMC->CONFIG = (NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos);
+    nvmc_wait();
+}
+
+
+/**@brief   Function for getting the pstorage handle of a page of the settings journal.
+ *
+ * @param[in]  address   Address in the page.
+ * @param[out] p_handle  Handle of the page.
+ */
+static void settings_page_handle_get(uint32_t address, pstorage_handle_t * p_handle)
+{
+    uint32_t err_code = pstorage_block_identifier_get(&m_bootsettings_handle,
+                                                      (address - BOOTLOADER_SETTINGS_ADDRESS) /
+                                                      CODE_PAGE_SIZE,
+                                                      p_handle);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief   Function for finding the current record of the settings journal, and the record the
+ *          next settings are saved to.
+ *
+ * @details The next record follows the current one in its page. Records left invalid by a save cut
+ *          short by a reset are skipped. When the page is full the next record is the first of the
+ *          other page, which is erased before the record is saved.
+ */
+static void settings_journal_init(void)
+{
+    const uint32_t records_per_page = CODE_PAGE_SIZE / BOOTLOADER_SETTINGS_RECORD_SIZE;
+    const bootloader_settings_record_t * p_record;
+    uint32_t index = 0;
+
+    mp_settings_record  = bootloader_settings_record_find();
+    m_settings_sequence = 0;
+
+    if (mp_settings_record != NULL)
+    {
+        m_settings_sequence = mp_settings_record->sequence;
+        index = ((uint32_t)mp_settings_record - BOOTLOADER_SETTINGS_ADDRESS) /
+                BOOTLOADER_SETTINGS_RECORD_SIZE + 1;
+
+        p_record = (const bootloader_settings_record_t *)
+                   (BOOTLOADER_SETTINGS_ADDRESS + index * BOOTLOADER_SETTINGS_RECORD_SIZE);
+
+        while (((index % records_per_page) != 0) && (p_record->sequence != EMPTY_FLASH_MASK))
+        {
+            index++;
+            p_record++;
+        }
+    }
+
+    m_settings_next = index % BOOTLOADER_SETTINGS_RECORD_COUNT;
+}
+
+
+/**@brief   Function for getting the current bootloader settings, including those of a record
+ *          which is still queued to be written.
+ *
+ * @param[out] pp_settings  Current bootloader settings.
+ */
+static void settings_get(const bootloader_settings_t ** pp_settings)
+{
+    if (m_settings_records_queued != 0)
+    {
+        *pp_settings = &m_settings_records[m_settings_record_index].settings;
+        return;
+    }
+
+    bootloader_util_settings_get(pp_settings);
+}
+
+
+/**@brief   Function for saving settings to the next record of the settings journal.
+ *
+ * @details The current record is left in place until the new one is complete, and the page holding
+ *          it is only erased once a record has been saved to the other page. A save cut short by a
+ *          reset fails its CRC, and the settings of the current record are kept.
+ *
+ *          Saves made while the SoftDevice is enabled are queued to pstorage without waiting, e.g.
+ *          the resume checkpoints of a transfer. Each is built in its own buffer of a small ring,
+ *          so a buffer is not changed before pstorage has written it.
+ *
+ * @param[in] p_settings  Settings to save.
+ */
+static void settings_record_save(const bootloader_settings_t * p_settings)
+{
+    const uint32_t    records_per_page = CODE_PAGE_SIZE / BOOTLOADER_SETTINGS_RECORD_SIZE;
+    uint32_t          address = BOOTLOADER_SETTINGS_ADDRESS +
+                                m_settings_next * BOOTLOADER_SETTINGS_RECORD_SIZE;
+    bool              page_start = ((m_settings_next % records_per_page) == 0);
+    bootloader_settings_record_t * p_record;
+    pstorage_handle_t page_handle;
+    uint32_t          err_code;
+
+    if (m_settings_records_queued == SETTINGS_RECORD_BUFFERS)
+    {
+        APP_ERROR_CHECK(NRF_ERROR_NO_MEM);
+    }
+
+    m_settings_record_index = (m_settings_record_index + 1) % SETTINGS_RECORD_BUFFERS;
+    p_record                = &m_settings_records[m_settings_record_index];
+
+    memset(p_record, 0xFF, sizeof(bootloader_settings_record_t));
+    memcpy(&p_record->settings, p_settings, sizeof(bootloader_settings_t));
+    p_record->sequence = ++m_settings_sequence;
+    p_record->crc      = bootloader_settings_record_crc(p_record);
+
+    mp_settings_record = (const bootloader_settings_record_t *)address;
+    m_settings_next    = (m_settings_next + 1) % BOOTLOADER_SETTINGS_RECORD_COUNT;
+
+    if (!softdevice_enabled())
+    {
+        if (page_start)
+        {
+            nvmc_page_erase(address);
+        }
+        nvmc_words_write(address,
+                         (const uint32_t *)p_record,
+                         sizeof(bootloader_settings_record_t) / sizeof(uint32_t));
+        return;
+    }
+
+    settings_page_handle_get(address, &page_handle);
+
+    if (page_start)
+    {
+        err_code = pstorage_clear(&page_handle, CODE_PAGE_SIZE);
+        APP_ERROR_CHECK(err_code);
+    }
+
+    m_settings_records_queued++;
+
+    err_code = pstorage_store(&page_handle,
+                              (uint8_t *)p_record,
+                              sizeof(bootloader_settings_record_t),
+                              address % CODE_PAGE_SIZE);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief   Function for programming one word of the current bootloader settings, which must be
+ *          erased or only have bits cleared.
+ *
+ * @details The word is programmed in place in the current record of the settings journal. Only
+ *          words left out of the record CRC may be programmed.
+ *
+ * @param[in] offset  Offset of the word in the bootloader settings.
+ * @param[in] value   Value to program.
+ */
+static void settings_word_write(uint32_t offset, uint32_t value)
+{
+    static uint32_t   word;
+    pstorage_handle_t page_handle;
+    uint32_t          address;
+
+    if (mp_settings_record == NULL)
+    {
+        return;
+    }
+
+    address = (uint32_t)&mp_settings_record->settings + offset;
+
+    if (!softdevice_enabled())
+    {
+        nvmc_words_write(address, &value, 1);
+        return;
+    }
+
+    word = value;
+
+    settings_page_handle_get(address, &page_handle);
+
+    uint32_t err_code = pstorage_store(&page_handle,
+                                       (uint8_t *)&word,
+                                       sizeof(uint32_t),
+                                       address % CODE_PAGE_SIZE);
+    APP_ERROR_CHECK(err_code);
+
+    flash_operations_wait();
+}
+
+
+/**@brief   Function for checking if the CRC check of bank 0 can be skipped on this boot.
+ *
+ * @details The check can be skipped if bank 0 was verified after it was last written, and the
+ *          verification is less than BOOTLOADER_VERIFY_INTERVAL boots old. The boot is counted by
+ *          clearing one word of the tally, which needs no page erase.
+ *
+ * @param[in] p_settings  Bootloader settings in flash.
+ *
+ * @return    true if the CRC check can be skipped.
+ */
+static bool bank_0_verified_check(const bootloader_settings_t * p_settings)
+{
+    uint32_t i;
+
+    if (p_settings->bank_0_verified != p_settings->write_generation)
+    {
+        return false;
+    }
+
+    for (i = 0; i < BOOTLOADER_VERIFY_INTERVAL; i++)
+    {
+        if (p_settings->boot_tally[i] == EMPTY_FLASH_MASK)
+        {
+            settings_word_write(offsetof(bootloader_settings_t, boot_tally) +
+                                (i * sizeof(uint32_t)),
+                                0);
+            return true;
+        }
+    }
+
+    // Periodic verification is due.
+    return false;
+}
+
+
+/**@brief   Function for recording that bank 0 passed its CRC check.
+ *
+ * @details The first verification after bank 0 was written only programs the verified marker. A
+ *          periodic verification rewrites the settings to start a new boot tally.
+ *
+ * @param[in] p_settings  Bootloader settings in flash.
+ */
+static void bank_0_verified_set(const bootloader_settings_t * p_settings)
+{
+    static bootloader_settings_t settings;
+
+    if (p_settings->bank_0_verified == EMPTY_FLASH_MASK)
+    {
+        settings_word_write(offsetof(bootloader_settings_t, bank_0_verified),
+                            p_settings->write_generation);
+        return;
+    }
+
+    memcpy(&settings, p_settings, sizeof(bootloader_settings_t));
+
+    settings.bank_0_verified = p_settings->write_generation;
+    memset(settings.boot_tally, 0xFF, sizeof(settings.boot_tally));
+
+    settings_record_save(&settings);
+
+    flash_operations_wait();
+}
+
+
 bool bootloader_app_is_valid(uint32_t app_addr)
 {
     const bootloader_settings_t * p_bootloader_settings;
@@ -115,14 +529,29 @@ bool bootloader_app_is_valid(uint32_t app_addr)
         uint16_t image_crc = 0;
 
         // A stored crc value of 0 indicates that CRC checking is not used.
-        if (p_bootloader_settings->bank_0_crc != 0)
+        if ((p_bootloader_settings->bank_0_crc == 0) ||
+            (m_bank_0_verified_generation == p_bootloader_settings->write_generation))
+        {
+            return true;
+        }
+
+        // Bank 0 verified since it was last written, and not yet due for verification.
+        if (bank_0_verified_check(p_bootloader_settings))
         {
-            image_crc = crc16_compute((uint8_t *)DFU_BANK_0_REGION_START,
-                                      p_bootloader_settings->bank_0_size,
-                                      NULL);
+            m_bank_0_verified_generation = p_bootloader_settings->write_generation;
+            return true;
         }
 
+        image_crc = crc16_compute((uint8_t *)DFU_BANK_0_REGION_START,
+                                  p_bootloader_settings->bank_0_size,
+                                  NULL);
+
         success = (image_crc == p_bootloader_settings->bank_0_crc);
+        if (success)
+        {
+            bank_0_verified_set(p_bootloader_settings);
+            m_bank_0_verified_generation = p_bootloader_settings->write_generation;
+        }
     }
 
     return success;
@@ -131,14 +560,33 @@ bool bootloader_app_is_valid(uint32_t app_addr)
 
 static void bootloader_settings_save(bootloader_settings_t * p_settings)
 {
-    uint32_t err_code = pstorage_clear(&m_bootsettings_handle, sizeof(bootloader_settings_t));
-    APP_ERROR_CHECK(err_code);
+    const bootloader_settings_t * p_bootloader_settings;
 
-    err_code = pstorage_store(&m_bootsettings_handle,
-                              (uint8_t *)p_settings,
-                              sizeof(bootloader_settings_t),
-                              0);
-    APP_ERROR_CHECK(err_code);
+    settings_get(&p_bootloader_settings);
+
+    // Each save starts a new write generation, which bank 0 has not been verified for.
+    p_settings->write_generation = p_bootloader_settings->write_generation + 1;
+    p_settings->bank_0_verified  = EMPTY_FLASH_MASK;
+    memset(p_settings->boot_tally, 0xFF, sizeof(p_settings->boot_tally));
+
+    settings_record_save(p_settings);
+}
+
+
+/**@brief Function for getting the application version to record for a received image.
+ *
+ * @details The recorded version never decreases. An image which is not versioned keeps the
+ *          version already recorded.
+ */
+static uint32_t app_version_get(uint32_t installed, uint32_t received)
+{
+    if ((received == BOOTLOADER_APP_VERSION_NONE) ||
+        ((installed != BOOTLOADER_APP_VERSION_NONE) && (received < installed)))
+    {
+        return installed;
+    }
+
+    return received;
 }
 
 
@@ -147,7 +595,8 @@ void bootloader_dfu_update_process(dfu_update_status_t update_status)
     static bootloader_settings_t  settings;
     const bootloader_settings_t * p_bootloader_settings;
 
-    bootloader_util_settings_get(&p_bootloader_settings);
+    // The last save may still be queued, e.g. that bank 0 was erased, and not yet show in flash.
+    settings_get(&p_bootloader_settings);
 
     if (update_status.status_code == DFU_UPDATE_APP_COMPLETE)
     {
@@ -155,6 +604,9 @@ void bootloader_dfu_update_process(dfu_update_status_t update_status)
         settings.bank_0_size = update_status.app_size;
         settings.bank_0      = BANK_VALID_APP;
         settings.bank_1      = BANK_INVALID_APP;
+        settings.resume_size = 0;
+        settings.app_version = app_version_get(p_bootloader_settings->app_version,
+                                               update_status.app_version);
 
         m_update_status      = BOOTLOADER_SETTINGS_SAVING;
         bootloader_settings_save(&settings);
@@ -171,6 +623,14 @@ void bootloader_dfu_update_process(dfu_update_status_t update_status)
         settings.bl_image_size  = update_status.bl_size;
         settings.app_image_size = update_status.app_size;
         settings.sd_image_start = update_status.sd_image_start;
+        settings.resume_size    = 0;
+        settings.app_version    = p_bootloader_settings->app_version;
+
+        if (update_status.app_size != 0)
+        {
+            settings.app_version = app_version_get(p_bootloader_settings->app_version,
+                                                   update_status.app_version);
+        }
 
         m_update_status         = BOOTLOADER_SETTINGS_SAVING;
         bootloader_settings_save(&settings);
@@ -184,6 +644,8 @@ void bootloader_dfu_update_process(dfu_update_status_t update_status)
         settings.sd_image_size  = update_status.sd_size;
         settings.bl_image_size  = update_status.bl_size;
         settings.app_image_size = update_status.app_size;
+        settings.resume_size    = 0;
+        settings.app_version    = p_bootloader_settings->app_version;
 
         m_update_status         = BOOTLOADER_SETTINGS_SAVING;
         bootloader_settings_save(&settings);
@@ -208,6 +670,8 @@ void bootloader_dfu_update_process(dfu_update_status_t update_status)
         settings.sd_image_size  = 0;
         settings.bl_image_size  = 0;
         settings.app_image_size = 0;
+        settings.resume_size    = 0;
+        settings.app_version    = p_bootloader_settings->app_version;
 
         m_update_status         = BOOTLOADER_SETTINGS_SAVING;
         bootloader_settings_save(&settings);
@@ -226,9 +690,39 @@ void bootloader_dfu_update_process(dfu_update_status_t update_status)
         settings.bank_0_size = 0;
         settings.bank_0      = BANK_INVALID_APP;
         settings.bank_1      = p_bootloader_settings->bank_1;
+        settings.resume_size = 0;
+        settings.app_version = p_bootloader_settings->app_version;
 
         bootloader_settings_save(&settings);
     }
+    else if (update_status.status_code == DFU_UPDATE_CHECKPOINT)
+    {
+        // Keep the current bank information and only record where an interrupted transfer of
+        // this image can be resumed from.
+        memcpy(&settings, p_bootloader_settings, sizeof(bootloader_settings_t));
+
+        settings.resume_size     = update_status.resume_size;
+        settings.resume_offset   = update_status.resume_offset;
+        settings.resume_crc      = update_status.resume_crc;
+        settings.resume_init_crc = update_status.resume_init_crc;
+
+        if (update_status.p_resume_hash != NULL)
+        {
+            memcpy(settings.resume_hash, update_status.p_resume_hash, sizeof(settings.resume_hash));
+        }
+
+        bootloader_settings_save(&settings);
+    }
+    else if (update_status.status_code == DFU_UPDATE_DELTA_COMPLETE)
+    {
+        // Bank 0 is unchanged until the application is rebuilt after reset. Only the resume point
+        // of an earlier transfer is dropped.
+        memcpy(&settings, p_bootloader_settings, sizeof(bootloader_settings_t));
+        settings.resume_size = 0;
+
+        m_update_status      = BOOTLOADER_SETTINGS_SAVING;
+        bootloader_settings_save(&settings);
+    }
     else if (update_status.status_code == DFU_RESET)
     {
         m_update_status = BOOTLOADER_RESET;
@@ -246,8 +740,8 @@ uint32_t bootloader_init(void)
     pstorage_module_param_t storage_params;
 
     storage_params.cb          = pstorage_callback_handler;
-    storage_params.block_size  = sizeof(bootloader_settings_t);
-    storage_params.block_count = 1;
+    storage_params.block_size  = CODE_PAGE_SIZE;
+    storage_params.block_count = BOOTLOADER_SETTINGS_PAGE_COUNT;
 
     err_code = pstorage_init();
     if (err_code != NRF_SUCCESS)    
@@ -256,8 +750,14 @@ uint32_t bootloader_init(void)
     }
 
     err_code = pstorage_register(&storage_params, &m_bootsettings_handle);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
 
-    return err_code;
+    settings_journal_init();
+
+    return NRF_SUCCESS;
 }
 
 
@@ -303,10 +803,15 @@ static void interrupts_disable(void)
 
 void bootloader_app_start(uint32_t app_addr)
 {
+    uint32_t err_code;
+
     // If the applications CRC has been checked and passed, the magic number will be written and we
-    // can start the application safely.
-    uint32_t err_code = sd_softdevice_disable();
-    APP_ERROR_CHECK(err_code);
+    // can start the application safely. On the fast boot path the SoftDevice was never enabled.
+    if (softdevice_enabled())
+    {
+        err_code = sd_softdevice_disable();
+        APP_ERROR_CHECK(err_code);
+    }
 
     interrupts_disable();
 
@@ -372,22 +877,226 @@ uint32_t bootloader_dfu_sd_update_finalize(void)
 }
 
 
+#if defined(DFU_DUAL_BANK_SUPPORT)
+#if defined(DFU_DELTA_SUPPORT)
+/**@brief   Function for writing one chunk of the application rebuilt from a delta image to bank 1.
+ *
+ * @details Chunks are one flash page, passed in order from the start of bank 1.
+ */
+static int delta_chunk_write(uint32_t offset, const uint8_t * p_data, uint32_t length)
+{
+    bootloader_wdt_feed();
+    nvmc_page_erase(DFU_BANK_1_REGION_START + offset);
+    nvmc_words_write(DFU_BANK_1_REGION_START + offset,
+                     (const uint32_t *)p_data,
+                     length / sizeof(uint32_t));
+    return 0;
+}
+
+
+/**@brief   Function for checking the application rebuilt in bank 1 against the delta image header.
+ *
+ * @param[in] p_header  Header of the validated delta image.
+ *
+ * @return NRF_SUCCESS if the rebuilt application matches, NRF_ERROR_INVALID_DATA otherwise.
+ */
+static uint32_t delta_image_check(const dfu_delta_header_t * p_header)
+{
+    if (crc16_compute((uint8_t *)DFU_BANK_1_REGION_START, p_header->new_size, NULL) !=
+        p_header->new_crc)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+#if defined(DFU_SIGNING_SUPPORT)
+    {
+        sha256_ctx_t ctx;
+        uint8_t      hash[32];
+
+        sha256_init(&ctx);
+        sha256_update(&ctx, (uint8_t *)DFU_BANK_1_REGION_START, p_header->new_size);
+        sha256_final(&ctx, hash);
+
+        if (memcmp(hash, p_header->new_hash, sizeof(hash)) != 0)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+    }
+#endif
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief   Function for rebuilding the application from a delta image into bank 1.
+ *
+ * @details The delta image has already been validated against its init packet. The application it
+ *          applies to must be the one in bank 0. Once the rebuilt application has been checked its
+ *          size is recorded in the descriptor, so an interrupted copy to bank 0 is completed from
+ *          bank 1 instead of applying the delta image to a partly overwritten bank 0.
+ *
+ * @param[in]  p_descriptor  Descriptor of the delta image.
+ * @param[out] p_image_size  Size of the rebuilt application.
+ * @param[out] p_image_crc   CRC of the rebuilt application.
+ *
+ * @return NRF_SUCCESS if the rebuilt application may be copied to bank 0, an error code otherwise.
+ */
+static uint32_t delta_image_build(const dfu_bank_1_descriptor_t * p_descriptor,
+                                  uint32_t                      * p_image_size,
+                                  uint16_t                      * p_image_crc)
+{
+    const bootloader_settings_t * p_bootloader_settings;
+    const uint8_t               * p_patch =
+        (const uint8_t *)DFU_DELTA_PATCH_ADDRESS(p_descriptor->image_size);
+    dfu_delta_header_t            header;
+    uint32_t                      err_code;
+
+    if (p_descriptor->image_size < DFU_DELTA_HEADER_SIZE)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    memcpy(&header, p_patch, DFU_DELTA_HEADER_SIZE);
+
+    // The rebuilt application is written from the start of bank 1, up to the delta image.
+    if ((header.new_size == 0) ||
+        (header.new_size > ((uint32_t)p_patch - DFU_BANK_1_REGION_START)) ||
+        ((header.new_size & (sizeof(uint32_t) - 1)) != 0))
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    if (p_descriptor->delta_applied == EMPTY_FLASH_MASK)
+    {
+        bootloader_util_settings_get(&p_bootloader_settings);
+
+        if ((p_bootloader_settings->bank_0 != BANK_VALID_APP)               ||
+            (p_bootloader_settings->bank_0_size != header.old_size)         ||
+            (header.old_size > DFU_IMAGE_MAX_SIZE_BANKED)                   ||
+            (crc16_compute((uint8_t *)DFU_BANK_0_REGION_START, header.old_size, NULL) !=
+             header.old_crc))
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+
+        if (dfu_delta_apply(p_patch, p_descriptor->image_size,
+                            (const uint8_t *)DFU_BANK_0_REGION_START, header.old_size,
+                            delta_chunk_write) != DFU_DELTA_SUCCESS)
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+    }
+    else if (p_descriptor->delta_applied != header.new_size)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    err_code = delta_image_check(&header);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if (p_descriptor->delta_applied == EMPTY_FLASH_MASK)
+    {
+        nvmc_words_write(DFU_BANK_1_DESCRIPTOR_ADDRESS +
+                         offsetof(dfu_bank_1_descriptor_t, delta_applied),
+                         &header.new_size,
+                         1);
+    }
+
+    *p_image_size = header.new_size;
+    *p_image_crc  = header.new_crc;
+
+    return NRF_SUCCESS;
+}
+#endif
+
+
+bool bootloader_dfu_app_swap_pending(void)
+{
+    const dfu_bank_1_descriptor_t * p_descriptor =
+        (const dfu_bank_1_descriptor_t *)DFU_BANK_1_DESCRIPTOR_ADDRESS;
+
+    return (p_descriptor->magic == DFU_BANK_1_DESCRIPTOR_MAGIC);
+}
+
+
+uint32_t bootloader_dfu_app_swap(void)
+{
+    static bootloader_settings_t    settings;
+    const bootloader_settings_t   * p_bootloader_settings;
+    const dfu_bank_1_descriptor_t * p_descriptor =
+        (const dfu_bank_1_descriptor_t *)DFU_BANK_1_DESCRIPTOR_ADDRESS;
+    uint32_t                        image_size   = p_descriptor->image_size;
+    uint16_t                        image_crc    = 0;
+    uint32_t                        address;
+    uint32_t                        err_code;
+
+    // The copy is done with the NVMC, which is only available while the SoftDevice is disabled.
+    if (softdevice_enabled())
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    err_code = dfu_app_image_validate(p_descriptor, &image_crc);
+    if ((err_code == NRF_SUCCESS) && (p_descriptor->flags & DFU_BANK_1_FLAG_DELTA))
+    {
+#if defined(DFU_DELTA_SUPPORT)
+        err_code = delta_image_build(p_descriptor, &image_size, &image_crc);
+#else
+        err_code = NRF_ERROR_NOT_SUPPORTED;
+#endif
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        bootloader_util_settings_get(&p_bootloader_settings);
+        memcpy(&settings, p_bootloader_settings, sizeof(bootloader_settings_t));
+
+        // Invalidate bank 0 before it is overwritten. If the copy is interrupted, bank 1 and its
+        // descriptor are still intact and the swap is done again on the next boot.
+        settings.bank_0      = BANK_INVALID_APP;
+        settings.bank_0_crc  = 0;
+        settings.bank_0_size = 0;
+        settings.resume_size = 0;
+        bootloader_settings_save(&settings);
+
+        for (address = 0; address < image_size; address += CODE_PAGE_SIZE)
+        {
+            uint32_t length = MIN(image_size - address, CODE_PAGE_SIZE);
+
+            bootloader_wdt_feed();
+            nvmc_page_erase(DFU_BANK_0_REGION_START + address);
+            nvmc_words_write(DFU_BANK_0_REGION_START + address,
+                             (const uint32_t *)(DFU_BANK_1_REGION_START + address),
+                             length / sizeof(uint32_t));
+        }
+
+        settings.bank_0      = BANK_VALID_APP;
+        settings.bank_0_crc  = image_crc;
+        settings.bank_0_size = image_size;
+        settings.app_version =
+            app_version_get(settings.app_version,
+                            ((const dfu_init_packet_t *)p_descriptor->init_packet)->app_version);
+        bootloader_settings_save(&settings);
+    }
+
+    // The descriptor is only acted upon once. An image which fails validation is dropped and the
+    // current application is kept.
+    nvmc_page_erase(DFU_BANK_1_DESCRIPTOR_ADDRESS);
+
+    return err_code;
+}
+#endif
+
+
 void bootloader_settings_get(bootloader_settings_t * const p_settings)
 {
-    bootloader_settings_t bootloader_settings;
-
-    (void) pstorage_load((uint8_t *)&bootloader_settings,
-                         &m_bootsettings_handle,
-                         sizeof(bootloader_settings_t),
-                         0);
-
-    p_settings->bank_0         = bootloader_settings.bank_0;
-    p_settings->bank_0_crc     = bootloader_settings.bank_0_crc;
-    p_settings->bank_0_size    = bootloader_settings.bank_0_size;
-    p_settings->bank_1         = bootloader_settings.bank_1;
-    p_settings->sd_image_size  = bootloader_settings.sd_image_size;
-    p_settings->bl_image_size  = bootloader_settings.bl_image_size;
-    p_settings->app_image_size = bootloader_settings.app_image_size;
-    p_settings->sd_image_start = bootloader_settings.sd_image_start;
+    const bootloader_settings_t * p_bootloader_settings;
+
+    bootloader_util_settings_get(&p_bootloader_settings);
+
+    memcpy(p_settings, p_bootloader_settings, sizeof(bootloader_settings_t));
 }
 
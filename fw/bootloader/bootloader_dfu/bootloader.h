@@ -92,6 +92,35 @@ uint32_t bootloader_dfu_sd_update_continue(void);
  */
 uint32_t bootloader_dfu_sd_update_finalize(void);
 
+/**@brief Function for feeding the watchdog, if it is running.
+ *
+ * @details The watchdog is not stopped by a soft reset, so once started by the application it is
+ *          still running when the application resets into DFU mode. It is fed from the event loops,
+ *          so a bootloader stuck outside them is reset, and before each of the long steps run
+ *          outside them: the init packet signature check and the application swap at boot.
+ */
+void bootloader_wdt_feed(void);
+
+#if defined(DFU_DUAL_BANK_SUPPORT)
+/**@brief Function for checking if the application has received a new application into bank 1.
+ *
+ * @retval     true          A complete bank 1 descriptor is present.
+ * @retval     false         No application is waiting in bank 1.
+ */
+bool bootloader_dfu_app_swap_pending(void);
+
+/**@brief Function for validating the application in bank 1 and copying it to bank 0.
+ *
+ * @details Must be called while the SoftDevice is disabled. The bank 1 descriptor is erased
+ *          whether or not the image was valid, so an invalid image is only rejected once.
+ *          If bank 1 holds a delta image, the application is first rebuilt from it and the
+ *          application in bank 0 into bank 1 (DFU_DELTA_SUPPORT).
+ *
+ * @retval     NRF_SUCCESS   If bank 0 now holds the application received into bank 1.
+ */
+uint32_t bootloader_dfu_app_swap(void);
+#endif
+
 #endif // BOOTLOADER_H__
 
 /**@} */
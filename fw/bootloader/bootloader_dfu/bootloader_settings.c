@@ -0,0 +1,122 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  bootloader_settings.c  -- reading the bootloader settings journal.
+ *
+ *  The settings are saved by appending a record to the journal in the last
+ *  two flash pages, see bootloader.c.  The valid record with the highest
+ *  sequence number holds the current settings, so a save cut short by a
+ *  reset leaves the previous settings in place.  Also built into the
+ *  application, which reads the settings for dual bank updates.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "bootloader_settings.h"
+#include "bootloader_types.h"
+#include "dfu_types.h"
+#include "crc16.h"
+
+#define RECORD_SETTINGS_OFFSET   offsetof(bootloader_settings_record_t, settings)
+
+/*
+ *  bank_0_verified and boot_tally are programmed in place after the record
+ *  is saved, and so are left out of its CRC.
+ */
+#define IN_PLACE_START  (RECORD_SETTINGS_OFFSET + offsetof(bootloader_settings_t, bank_0_verified))
+#define IN_PLACE_END    (RECORD_SETTINGS_OFFSET + offsetof(bootloader_settings_t, boot_tally) + \
+                         sizeof(((bootloader_settings_t *) 0)->boot_tally))
+
+/*
+ *  Settings of an empty journal.  A consolidated flash image, including the
+ *  app, lays the journal down empty, and so does not have to provide a valid
+ *  CRC for the initial application image: CRC field is zero.  Subsequent DFU
+ *  operations will enforce the CRC check.
+ */
+static const bootloader_settings_t m_default_settings = {
+    .bank_0           = BANK_VALID_APP,  // bank_0 has valid app.
+    .bank_0_crc       = 0,               // 0 means don't do CRC check.
+    .bank_1           = 0,
+    .bank_0_size      = 0,
+    .sd_image_size    = 0,
+    .bl_image_size    = 0,
+    .app_image_size   = 0,
+    .sd_image_start   = 0,
+    .resume_size      = 0,               // 0 means no transfer to resume.
+    .resume_offset    = 0,
+    .resume_crc       = 0,
+    .resume_init_crc  = 0,
+    .resume_hash      = { 0 },
+    .write_generation = 0,
+    .bank_0_verified  = EMPTY_FLASH_MASK,
+    .boot_tally       = { [0 ... BOOTLOADER_VERIFY_INTERVAL - 1] = EMPTY_FLASH_MASK },
+    .app_version      = BOOTLOADER_APP_VERSION_NONE,
+};
+
+static const bootloader_settings_record_t * record_get(uint32_t index)
+{
+    return (const bootloader_settings_record_t *)
+           (BOOTLOADER_SETTINGS_ADDRESS + index * BOOTLOADER_SETTINGS_RECORD_SIZE);
+}
+
+uint16_t bootloader_settings_record_crc(const bootloader_settings_record_t * p_record)
+{
+    const uint8_t * p_bytes = (const uint8_t *) p_record;
+    uint16_t        crc;
+
+    crc = crc16_compute(p_bytes, sizeof(p_record->sequence), NULL);
+    crc = crc16_compute(p_bytes + RECORD_SETTINGS_OFFSET,
+                        IN_PLACE_START - RECORD_SETTINGS_OFFSET,
+                        &crc);
+    crc = crc16_compute(p_bytes + IN_PLACE_END,
+                        BOOTLOADER_SETTINGS_RECORD_SIZE - IN_PLACE_END,
+                        &crc);
+    return crc;
+}
+
+/*
+ *  Only the sequence numbers are read to pick the newest record, so usually
+ *  a single CRC is computed.  A record which fails its CRC was cut short by
+ *  a reset, and the next newest is tried.
+ */
+const bootloader_settings_record_t * bootloader_settings_record_find(void)
+{
+    uint32_t below = EMPTY_FLASH_MASK;
+    uint32_t i;
+
+    for (;;) {
+        uint32_t newest = 0;
+        bool     found  = false;
+
+        for (i = 0; i < BOOTLOADER_SETTINGS_RECORD_COUNT; i++) {
+            uint32_t sequence = record_get(i)->sequence;
+
+            if (sequence < below && (!found || sequence > newest)) {
+                newest = sequence;
+                found  = true;
+            }
+        }
+
+        if (!found)
+            return NULL;
+
+        /* Saves queued back to back can both write the newer record. */
+        for (i = 0; i < BOOTLOADER_SETTINGS_RECORD_COUNT; i++) {
+            const bootloader_settings_record_t * p_record = record_get(i);
+
+            if (p_record->sequence == newest &&
+                p_record->crc == bootloader_settings_record_crc(p_record))
+                return p_record;
+        }
+
+        below = newest;
+    }
+}
+
+void bootloader_util_settings_get(const bootloader_settings_t ** pp_bootloader_settings)
+{
+    const bootloader_settings_record_t * p_record = bootloader_settings_record_find();
+
+    *pp_bootloader_settings = (p_record != NULL) ? &p_record->settings : &m_default_settings;
+}
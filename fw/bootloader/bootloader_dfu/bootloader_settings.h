@@ -23,13 +23,34 @@
 
 #include <stdint.h>
 #include "bootloader_types.h"
+#include "dfu_types.h"
+
+#define BOOTLOADER_SETTINGS_RECORD_COUNT  ((BOOTLOADER_SETTINGS_PAGE_COUNT * CODE_PAGE_SIZE) / \
+                                           BOOTLOADER_SETTINGS_RECORD_SIZE)                     /**< Number of records in the bootloader settings journal. */
 
 /**@brief Function for getting the bootloader settings.
+ *
+ * @details The settings are those of the current journal record, or the default settings if the
+ *          journal is empty, as it is when laid down with a consolidated flash image.
  * 
  * @param[out] pp_bootloader_settings Bootloader settings. 
  */
 void bootloader_util_settings_get(const bootloader_settings_t ** pp_bootloader_settings);
 
+/**@brief Function for finding the current record of the bootloader settings journal.
+ *
+ * @return The valid record with the highest sequence number, or NULL if there is none.
+ */
+const bootloader_settings_record_t * bootloader_settings_record_find(void);
+
+/**@brief Function for calculating the CRC of a bootloader settings journal record.
+ *
+ * @param[in] p_record  Record in flash, or a record being saved.
+ *
+ * @return The CRC to compare with, or to store in, the crc field of the record.
+ */
+uint16_t bootloader_settings_record_crc(const bootloader_settings_record_t * p_record);
+
 #endif // BOOTLOADER_SETTINGS_H__
 
 /**@} */
@@ -29,6 +29,18 @@
 
 #define BOOTLOADER_SVC_APP_DATA_PTR_GET 0x02
 
+/**@brief Number of boots which may skip the CRC check of an already verified bank 0 image before
+ *        it is verified again. Must be at least 1, and the same for application and bootloader.
+ */
+#ifndef BOOTLOADER_VERIFY_INTERVAL
+#define BOOTLOADER_VERIFY_INTERVAL 16
+#endif
+
+/**@brief Application version of images which are not versioned. Also the installed version read
+ *        from settings which have never recorded one.
+ */
+#define BOOTLOADER_APP_VERSION_NONE 0xFFFFFFFF
+
 /**@brief DFU Bank state code, which indicates whether the bank contains: A valid image, invalid image, or an erased flash.
   */
 typedef enum
@@ -52,8 +64,37 @@ typedef struct
     uint32_t               bl_image_size;   /**< Size of Bootloader image in bank0 if bank_0 code is BANK_VALID_SD. */
     uint32_t               app_image_size;  /**< Size of Application image in bank0 if bank_0 code is BANK_VALID_SD. */
     uint32_t               sd_image_start;  /**< Location in flash where SoftDevice image is stored for SoftDevice update. */
+    uint32_t               resume_size;     /**< Size of the image of an interrupted transfer, 0 if there is no transfer to resume. */
+    uint32_t               resume_offset;   /**< Number of bytes of the interrupted transfer committed to bank0. */
+    uint16_t               resume_crc;      /**< Running CRC of the committed bytes, used to verify them before resuming. */
+    uint16_t               resume_init_crc; /**< CRC of the init packet of the interrupted transfer, identifies the image. */
+    uint32_t               resume_hash[8];  /**< SHA-256 state of the committed bytes, when signed images are used. */
+    uint32_t               write_generation; /**< Incremented each time the settings are saved by an update. */
+    uint32_t               bank_0_verified; /**< Write generation for which bank 0 passed its CRC check, 0xFFFFFFFF if not verified. */
+    uint32_t               boot_tally[BOOTLOADER_VERIFY_INTERVAL]; /**< One word is cleared by each boot which skips the CRC check. Bank 0 is verified again when all are cleared. */
+    uint32_t               app_version;     /**< Highest application version installed, BOOTLOADER_APP_VERSION_NONE if none was versioned. Older images are refused. */
 } bootloader_settings_t;
 
+/**@brief Size of a record of the bootloader settings journal. Fields added to the end of
+ *        bootloader_settings_t take space left erased in records saved before they were added, and
+ *        so read as erased from those records.
+ */
+#define BOOTLOADER_SETTINGS_RECORD_SIZE 256
+
+/**@brief Structure of a record of the bootloader settings journal.
+ *
+ * @details Settings are saved by appending a record to the journal. The valid record with the
+ *          highest sequence number holds the current settings.
+ */
+typedef struct
+{
+    uint32_t               sequence;        /**< Incremented for each record saved. Erased if the record is free. */
+    uint16_t               crc;             /**< CRC of the record, except the crc and reserved fields and the settings programmed in place, bank_0_verified and boot_tally. */
+    uint16_t               reserved;        /**< Left erased. */
+    bootloader_settings_t  settings;        /**< Settings saved by the record. */
+    uint8_t                unused[BOOTLOADER_SETTINGS_RECORD_SIZE - 8 - sizeof(bootloader_settings_t)]; /**< Left erased, for fields added to the settings later. */
+} bootloader_settings_record_t;
+
 #endif // BOOTLOADER_TYPES_H__ 
 
 /**@} */
@@ -12,38 +12,18 @@
 
 #if __GNUC__ && __ARM_EABI__
 /*
- *  Create a union structure which will define the top-most page for
- *  bootloader setting storage, and define the initial default app slot.
- *  This allows a consolidate flash image, including the app, to be 
- *  layed down over all flash, and still not have to provide a 
- *  valid CRC for the initial application image: CRC field is zero.
- *  Subsequenct DFU operations will enforce the CRC check.
+ *  Lay down the bootloader settings journal empty, so a consolidated flash
+ *  image, including the app, replaces any settings already on the device
+ *  and starts with the default settings, see bootloader_settings.c.
  */
-typedef struct {
-    union {
-        bootloader_settings_t init_app;
-        uint8_t               asBytes[1024];
-    } u;
-} flash_area_t;
+#define BOOT_SETTINGS_SIZE  (BOOTLOADER_SETTINGS_PAGE_COUNT * CODE_PAGE_SIZE)
 
-__attribute__ ((section(".bootloaderSettings"))) flash_area_t  m_boot_settings = {
-        .u.init_app.bank_0          = BANK_VALID_APP,  // bank_0 has valid app.
-        .u.init_app.bank_0_crc      = 0,               // 0 means don't do CRC check.
-        .u.init_app.bank_1          = 0,
-        .u.init_app.bank_0_size     = 0,
-        .u.init_app.sd_image_size   = 0,
-        .u.init_app.bl_image_size   = 0,
-        .u.init_app.app_image_size  = 0,
-        .u.init_app.sd_image_start  = 0,
+__attribute__ ((section(".bootloaderSettings"))) const uint8_t m_boot_settings[BOOT_SETTINGS_SIZE] = {
+        [0 ... BOOT_SETTINGS_SIZE - 1] = 0xFF,
 };
 
 __attribute__ ((section(".uicrBootStartAddress"))) volatile uint32_t m_uicr_bootloader_start_address = BOOTLOADER_REGION_START;
 
-/* 
- *  Read only pointer to bootloader settings in flash. 
- */
-const bootloader_settings_t const * const mp_bootloader_settings = (bootloader_settings_t *) &m_boot_settings;
-
 typedef void (*reset_handler_t)(void);
 
 
@@ -86,14 +66,10 @@ static inline void StartApplication(uint32_t start_addr)
 
 void bootloader_util_app_start(uint32_t start_addr)
 {
-    PRINTF("bootloader_util_app_start: 0x%x\n", (unsigned) start_addr);
-    StartApplication(start_addr);
-}
-
-
-void bootloader_util_settings_get(const bootloader_settings_t ** pp_bootloader_settings)
-{
+#if __GNUC__ && __ARM_EABI__
     (void) m_uicr_bootloader_start_address;  // Don't remove -- keeps linker happy.
+#endif
 
-    *pp_bootloader_settings = (bootloader_settings_t *) &m_boot_settings;
+    PRINTF("bootloader_util_app_start: 0x%x\n", (unsigned) start_addr);
+    StartApplication(start_addr);
 }
@@ -0,0 +1,108 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  crc16.c  -- CRC-16-CCITT shared by the bootloader, DFU and host tools.
+ *
+ *  Replaces the SDK's bit-shift-per-byte loop with a table driven kernel.
+ *  The results are bit-exact with the SDK crc16_compute(), so CRCs produced
+ *  by gen_dat and stored in the bootloader settings remain compatible.
+ */
+#include <stdint.h>
+#include <stddef.h>
+
+#include "crc16.h"
+
+#define CRC16_INIT   0xFFFF
+#define CRC16_POLY   0x1021
+
+#if (CRC16_SLICE_BY == 0)
+
+/*
+ *  CRC of each 4-bit value shifted through the polynomial.
+ *  Two lookups per byte keep the table at 32 bytes of flash.
+ */
+static const uint16_t crc16_nibble_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+};
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc)
+{
+    uint32_t crc = (p_crc == NULL) ? CRC16_INIT : *p_crc;
+    uint32_t i;
+
+    for (i = 0; i < size; i++) {
+        crc = (crc << 4) ^ crc16_nibble_table[((crc >> 12) ^ (p_data[i] >> 4)) & 0x0f];
+        crc = (crc << 4) ^ crc16_nibble_table[((crc >> 12) ^ p_data[i]) & 0x0f];
+    }
+    return (uint16_t) crc;
+}
+
+#elif (CRC16_SLICE_BY == 1) || (CRC16_SLICE_BY == 4) || (CRC16_SLICE_BY == 8)
+
+/*
+ *  crc16_table[k][b] is the CRC contribution of byte b followed by k zero bytes.
+ */
+static uint16_t crc16_table[CRC16_SLICE_BY][256];
+static int      crc16_table_ready = 0;
+
+static void crc16_table_init(void)
+{
+    uint32_t b;
+    uint32_t k;
+    uint32_t bit;
+
+    for (b = 0; b < 256; b++) {
+        uint16_t crc = (uint16_t)(b << 8);
+
+        for (bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ CRC16_POLY) : (uint16_t)(crc << 1);
+        }
+        crc16_table[0][b] = crc;
+    }
+
+    for (k = 1; k < CRC16_SLICE_BY; k++) {
+        for (b = 0; b < 256; b++) {
+            uint16_t crc = crc16_table[k - 1][b];
+
+            crc16_table[k][b] = (uint16_t)(crc << 8) ^ crc16_table[0][crc >> 8];
+        }
+    }
+    crc16_table_ready = 1;
+}
+
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc)
+{
+    uint16_t crc = (p_crc == NULL) ? CRC16_INIT : *p_crc;
+
+    if (!crc16_table_ready)
+        crc16_table_init();
+
+#if (CRC16_SLICE_BY > 1)
+    while (size >= CRC16_SLICE_BY) {
+        uint32_t k;
+        uint16_t next;
+
+        /* The first two bytes of each slice absorb the current CRC. */
+        next  = crc16_table[CRC16_SLICE_BY - 1][(crc >> 8) ^ p_data[0]];
+        next ^= crc16_table[CRC16_SLICE_BY - 2][(crc & 0xff) ^ p_data[1]];
+
+        for (k = 2; k < CRC16_SLICE_BY; k++) {
+            next ^= crc16_table[CRC16_SLICE_BY - 1 - k][p_data[k]];
+        }
+
+        crc     = next;
+        p_data += CRC16_SLICE_BY;
+        size   -= CRC16_SLICE_BY;
+    }
+#endif
+
+    while (size--) {
+        crc = (uint16_t)(crc << 8) ^ crc16_table[0][(crc >> 8) ^ *p_data++];
+    }
+    return crc;
+}
+
+#else
+#error "CRC16_SLICE_BY must be 0, 1, 4 or 8"
+#endif
@@ -0,0 +1,33 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  crc16.h  -- CRC-16-CCITT shared by the bootloader, DFU and host tools.
+ */
+#ifndef CRC16_H__
+#define CRC16_H__
+
+#include <stdint.h>
+
+/*
+ *  Table variant selection.
+ *    0        -- 16 entry nibble table (32 bytes), for the Cortex-M0 targets.
+ *    1, 4, 8  -- slice-by-N over 256 entry tables built on first use,
+ *                for host tools.
+ */
+#ifndef CRC16_SLICE_BY
+#define CRC16_SLICE_BY   0
+#endif
+
+/*
+ *  Compute the CRC-16-CCITT (polynomial 0x1021) of a data buffer.
+ *  Bit-exact with the Nordic SDK crc16_compute().
+ *
+ *  p_data  -- data to compute the CRC over.
+ *  size    -- number of bytes in p_data.
+ *  p_crc   -- previous CRC to continue from, or NULL to start with 0xFFFF.
+ *
+ *  Returns the updated CRC.
+ */
+uint16_t crc16_compute(const uint8_t * p_data, uint32_t size, const uint16_t * p_crc);
+
+#endif // CRC16_H__
@@ -28,7 +28,8 @@
 
 /**@brief DFU event callback for asynchronous calls.
  *
- * @param[in] packet  Packet type for which this callback is related. START_PACKET, DATA_PACKET.
+ * @param[in] packet  Packet type for which this callback is related. START_PACKET, DATA_PACKET,
+ *                    STOP_INIT_PACKET.
  * @param[in] result  Operation result code. NRF_SUCCESS when a queued operation was successful.
  * @param[in] p_data  Pointer to the data to which the operation is related.
  */
@@ -97,6 +98,26 @@ uint32_t dfu_image_activate(void);
  */
 void dfu_reset(void);
 
+/**@brief Function for suspending the current update procedure when the link to the peer is lost.
+ *
+ * @details The resume point of the image transfer is recorded in the bootloader settings and a
+ *          system reset is requested. The DFU Controller can then resume the transfer by setting
+ *          DFU_UPDATE_RESUME in the update mode when starting the update again.
+ *
+ * @return    NRF_SUCCESS if the transfer was suspended. NRF_ERROR_INVALID_STATE if no transfer is
+ *            in progress or nothing that can be resumed has been written yet.
+ */
+uint32_t dfu_suspend(void);
+
+/**@brief Function for getting the number of image bytes received.
+ *
+ * @details When a transfer is resumed this is the offset from which the DFU Controller must
+ *          continue sending the image, once the init packet has been accepted.
+ *
+ * @return    Number of image bytes received.
+ */
+uint32_t dfu_data_received_get(void);
+
 /**@brief Function for validating that new bootloader has been correctly installed.
  *        
  * @return NRF_SUCCESS if install was successful. NRF_ERROR_NULL if the images differs.
@@ -125,10 +146,28 @@ uint32_t dfu_sd_image_swap(void);
 
 /**@brief Function for handling DFU init packet complete.
  *
- * @return    NRF_SUCCESS on success, an error_code otherwise.
+ * @details The init packet is checked in steps from the scheduler. When the check is done, the
+ *          result is given with a STOP_INIT_PACKET callback.
+ *
+ * @return    NRF_SUCCESS if the check has been started, an error_code otherwise.
  */
 uint32_t dfu_init_pkt_complete(void);
 
+#if defined(DFU_DUAL_BANK_SUPPORT)
+/**@brief Function for validating an application received into bank 1 by the running application.
+ *
+ * @details The init packet kept in the descriptor is checked as if it had been received by the
+ *          bootloader, and the image in bank 1 is validated against it. For a delta image it is
+ *          the delta image at \ref DFU_DELTA_PATCH_ADDRESS which is validated.
+ *
+ * @param[in]  p_descriptor  Descriptor of the image in bank 1.
+ * @param[out] p_image_crc   CRC of the image in bank 1.
+ *
+ * @return NRF_SUCCESS if the image may be copied to bank 0, an error code otherwise.
+ */
+uint32_t dfu_app_image_validate(dfu_bank_1_descriptor_t const * p_descriptor, uint16_t * p_image_crc);
+#endif
+
 #endif // DFU_H__
 
 /** @} */
@@ -35,6 +35,7 @@ typedef enum
     DFU_STATE_PREPARING,                                                            /**< State for: preparing, indicates that the flash is being erased and no data packets can be processed. */
     DFU_STATE_RDY,                                                                  /**< State for: ready. */
     DFU_STATE_RX_INIT_PKT,                                                          /**< State for: receiving initialization packet. */
+    DFU_STATE_CHECK_INIT_PKT,                                                       /**< State for: checking the received initialization packet, see \ref dfu_init_signature_check. */
     DFU_STATE_RX_DATA_PKT,                                                          /**< State for: receiving data packet. */
     DFU_STATE_VALIDATE,                                                             /**< State for: validate. */
     DFU_STATE_WAIT_4_ACTIVATE                                                       /**< State for: waiting for dfu_image_activate(). */
@@ -42,9 +43,13 @@ typedef enum
 
 #define APP_TIMER_PRESCALER         0                                               /**< Value of the RTC1 PRESCALER register. */
 #define DFU_TIMEOUT_INTERVAL        APP_TIMER_TICKS(120000, APP_TIMER_PRESCALER)    /**< DFU timeout interval in units of timer ticks. */     
+#define DFU_CHECKPOINT_INTERVAL     (8 * CODE_PAGE_SIZE)                            /**< Number of image bytes committed to flash between resume checkpoints in the bootloader settings. */
 #define IS_UPDATING_SD(START_PKT)   ((START_PKT).dfu_update_mode & DFU_UPDATE_SD)   /**< Macro for determining if a SoftDevice update is ongoing. */
 #define IS_UPDATING_BL(START_PKT)   ((START_PKT).dfu_update_mode & DFU_UPDATE_BL)   /**< Macro for determining if a Bootloader update is ongoing. */
 #define IS_UPDATING_APP(START_PKT)  ((START_PKT).dfu_update_mode & DFU_UPDATE_APP)  /**< Macro for determining if a Application update is ongoing. */
+#define IS_RESUMING(START_PKT)      ((START_PKT).dfu_update_mode & DFU_UPDATE_RESUME) /**< Macro for determining if the peer requested to resume an interrupted transfer. */
+#define IS_DELTA(START_PKT)         ((START_PKT).dfu_update_mode & DFU_UPDATE_DELTA)  /**< Macro for determining if the application image is a delta image. */
+#define IS_COMPRESSED(START_PKT)    ((START_PKT).dfu_update_mode & DFU_UPDATE_COMPRESSED) /**< Macro for determining if the application image is compressed. */
 #define IMAGE_WRITE_IN_PROGRESS()   (m_data_received > 0)                           /**< Macro for determining is image write in progress. */
 #define IS_WORD_SIZED(SIZE)         ((SIZE & (sizeof(uint32_t) - 1)) == 0)          /**< Macro for checking that the provided is word sized. */
 
@@ -0,0 +1,156 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  dfu_delta.c  -- streaming application of delta images.
+ *
+ *  The patch and the old image are read in place from flash.  The new
+ *  image is assembled one chunk at a time in RAM and handed to the output
+ *  callback, so only a single flash page of RAM is used whatever the image
+ *  size.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "dfu_delta.h"
+
+typedef struct {
+    const uint8_t * p_next;
+    const uint8_t * p_end;
+} patch_reader_t;
+
+static uint32_t m_chunk[DFU_DELTA_CHUNK_SIZE / sizeof(uint32_t)];
+
+/*
+ *  Read an unsigned LEB128 varint.  Returns 0 if the patch ends early or
+ *  the value does not fit 32 bits.
+ */
+static int varint_read(patch_reader_t * p_reader, uint32_t * p_value)
+{
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    uint8_t  byte;
+
+    do {
+        if (p_reader->p_next == p_reader->p_end || shift > 28)
+            return 0;
+
+        byte   = *p_reader->p_next++;
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *p_value = value;
+    return 1;
+}
+
+int dfu_delta_apply(const uint8_t * p_patch, uint32_t patch_size,
+                    const uint8_t * p_old, uint32_t old_size,
+                    dfu_delta_write_t write)
+{
+    dfu_delta_header_t header;
+    patch_reader_t     reader;
+    uint8_t          * p_chunk  = (uint8_t *) m_chunk;
+    uint32_t           old_pos  = 0;
+    uint32_t           new_pos  = 0;
+    uint32_t           fill     = 0;
+
+    if (patch_size < DFU_DELTA_HEADER_SIZE)
+        return DFU_DELTA_ERROR_FORMAT;
+
+    memcpy(&header, p_patch, DFU_DELTA_HEADER_SIZE);
+
+    if (header.magic != DFU_DELTA_MAGIC || header.old_size != old_size)
+        return DFU_DELTA_ERROR_FORMAT;
+
+    reader.p_next = p_patch + DFU_DELTA_HEADER_SIZE;
+    reader.p_end  = p_patch + patch_size;
+
+    while (new_pos < header.new_size) {
+        uint32_t diff_len;
+        uint32_t extra_len;
+        uint32_t seek;
+        uint32_t done;
+
+        if (!varint_read(&reader, &diff_len)  ||
+            !varint_read(&reader, &extra_len) ||
+            !varint_read(&reader, &seek))
+            return DFU_DELTA_ERROR_FORMAT;
+
+        if (diff_len > old_size - old_pos ||
+            diff_len > header.new_size - new_pos ||
+            extra_len > header.new_size - new_pos - diff_len)
+            return DFU_DELTA_ERROR_BOUNDS;
+
+        /*
+         *  Each output byte comes from the old image plus a delta, the old
+         *  image unchanged, or the patch.  Only the run lengths decide which,
+         *  so the chunk can be flushed at any byte.
+         */
+        done = 0;
+        while (done < diff_len + extra_len) {
+            uint32_t zeros;
+            uint32_t deltas;
+            uint32_t i;
+
+            if (done < diff_len) {
+                if (!varint_read(&reader, &zeros) || !varint_read(&reader, &deltas))
+                    return DFU_DELTA_ERROR_FORMAT;
+
+                if (zeros + deltas == 0)
+                    return DFU_DELTA_ERROR_FORMAT;
+
+                if (zeros > diff_len - done || deltas > diff_len - done - zeros)
+                    return DFU_DELTA_ERROR_BOUNDS;
+
+                if (deltas > (uint32_t)(reader.p_end - reader.p_next))
+                    return DFU_DELTA_ERROR_FORMAT;
+            }
+            else {
+                zeros  = 0;
+                deltas = extra_len;
+
+                if (deltas > (uint32_t)(reader.p_end - reader.p_next))
+                    return DFU_DELTA_ERROR_FORMAT;
+            }
+
+            for (i = 0; i < zeros + deltas; i++) {
+                if (done < diff_len) {
+                    p_chunk[fill] = p_old[old_pos++];
+                    if (i >= zeros)
+                        p_chunk[fill] += *reader.p_next++;
+                }
+                else {
+                    p_chunk[fill] = *reader.p_next++;
+                }
+                fill++;
+
+                if (fill == DFU_DELTA_CHUNK_SIZE) {
+                    if (write(new_pos + 1 - fill, p_chunk, fill) != 0)
+                        return DFU_DELTA_ERROR_WRITE;
+                    fill = 0;
+                }
+                new_pos++;
+            }
+            done += zeros + deltas;
+        }
+
+        /* Zigzag decoded seek, the old position must stay within the image. */
+        if (seek & 1)
+            seek = ~(seek >> 1);
+        else
+            seek = seek >> 1;
+
+        old_pos += seek;
+        if (old_pos > old_size)
+            return DFU_DELTA_ERROR_BOUNDS;
+    }
+
+    /* Only the padding to a whole number of words may follow the last record. */
+    if ((uint32_t)(reader.p_end - reader.p_next) >= sizeof(uint32_t))
+        return DFU_DELTA_ERROR_FORMAT;
+
+    if (fill != 0 && write(new_pos - fill, p_chunk, fill) != 0)
+        return DFU_DELTA_ERROR_WRITE;
+
+    return DFU_DELTA_SUCCESS;
+}
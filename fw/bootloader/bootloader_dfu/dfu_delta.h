@@ -0,0 +1,66 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  dfu_delta.h  -- delta (binary diff) images, shared by the bootloader
+ *                  and the gen_delta host tool.
+ *
+ *  A delta image rebuilds a new application from the application in
+ *  bank 0.  It is a header followed by bsdiff style control records:
+ *
+ *    diff_len   varint   bytes taken from the old image, each plus a delta
+ *    extra_len  varint   bytes copied from the patch
+ *    seek       zigzag   adjustment of the old image position
+ *    diff       diff_len bytes as runs: zero count (varint), delta count
+ *                        (varint), delta bytes; repeated until diff_len
+ *                        bytes are covered
+ *    extra      extra_len literal bytes
+ *
+ *  Unchanged bytes cost nothing but their run length, so no compressor is
+ *  needed on the device.  All integers are little endian, varints LEB128.
+ *  Like any DFU image the delta image is padded to a whole number of words.
+ */
+#ifndef DFU_DELTA_H__
+#define DFU_DELTA_H__
+
+#include <stdint.h>
+
+#define DFU_DELTA_MAGIC            0x31544C44      /* "DLT1"                */
+#define DFU_DELTA_CHUNK_SIZE       1024            /* one nRF51 flash page  */
+
+/*
+ *  Delta image header.
+ */
+typedef struct {
+    uint32_t magic;             /* DFU_DELTA_MAGIC                            */
+    uint32_t old_size;          /* size of the image the delta applies to     */
+    uint32_t new_size;          /* size of the rebuilt image                  */
+    uint16_t old_crc;           /* CRC-16 of the image the delta applies to   */
+    uint16_t new_crc;           /* CRC-16 of the rebuilt image                */
+    uint8_t  new_hash[32];      /* SHA-256 of the rebuilt image               */
+} dfu_delta_header_t;
+
+#define DFU_DELTA_HEADER_SIZE      sizeof(dfu_delta_header_t)
+
+#define DFU_DELTA_SUCCESS          0
+#define DFU_DELTA_ERROR_FORMAT     -1  /* bad header or record               */
+#define DFU_DELTA_ERROR_BOUNDS     -2  /* record reaches outside an image    */
+#define DFU_DELTA_ERROR_WRITE      -3  /* output callback failed             */
+
+/*
+ *  Output callback.  The rebuilt image is passed in order, in chunks of
+ *  DFU_DELTA_CHUNK_SIZE bytes starting at offset 0, the last one possibly
+ *  shorter.  p_data is word aligned.  Returns 0 on success.
+ */
+typedef int (*dfu_delta_write_t)(uint32_t offset, const uint8_t * p_data, uint32_t length);
+
+/*
+ *  Rebuild the new image from p_old and the delta image p_patch.  The old
+ *  image is only read, and may not overlap the output.
+ *
+ *  Returns DFU_DELTA_SUCCESS or a DFU_DELTA_ERROR code.
+ */
+int dfu_delta_apply(const uint8_t * p_patch, uint32_t patch_size,
+                    const uint8_t * p_old, uint32_t old_size,
+                    dfu_delta_write_t write);
+
+#endif // DFU_DELTA_H__
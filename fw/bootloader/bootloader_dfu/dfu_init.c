@@ -10,10 +10,19 @@
 
 #include "dfu_init.h"
 #include "dfu_types.h"
+#include "bootloader.h"
+#include "bootloader_types.h"
+#include "bootloader_settings.h"
 #include "nrf_error.h"
 #include "crc16.h"
 #include "dbglog.h"
 
+#if defined(DFU_SIGNING_SUPPORT)
+#include "sha256.h"
+#include "ed25519.h"
+#include "dfu_public_key.h"
+#endif
+
 #define __breakpoint     __ASM volatile ( "bkpt \n" )
 
 /* 
@@ -28,10 +37,47 @@
  *  Maximum length of the extended init packet. 
  *  The extended init packet may contain a CRC, a HASH, or other data. 
  *  This value must be changed according to the requirements of the system. 
- *  The template uses a maximum value of 10 in order to hold a CRC and any padded 
- *  data on transport layer without overflow.
+ *  Holds the signed layout below and any padded data on transport layer
+ *  without overflow.
+ */
+#define DFU_INIT_PACKET_EXT_LENGTH_MAX      104
+
+/*
+ *  Layout of the extended init packet written by gen_dat and sign_dat.
+ *    offset  0  -- CRC-16 of the image (always present).
+ *    offset  2  -- reserved, zero.  Keeps the hash word aligned.
+ *    offset  4  -- SHA-256 of the image.
+ *    offset 36  -- Ed25519 signature of all init packet bytes before it.
+ *  Unsigned packets stop after the CRC.
+ */
+#define DFU_INIT_EXT_CRC_OFFSET             0
+#define DFU_INIT_EXT_HASH_OFFSET            4
+#define DFU_INIT_EXT_SIGNATURE_OFFSET       (DFU_INIT_EXT_HASH_OFFSET + 32)
+#define DFU_INIT_EXT_LENGTH_SIGNED          (DFU_INIT_EXT_SIGNATURE_OFFSET + 64)
+
+#if defined(DFU_SIGNING_SUPPORT)
+/*
+ *  Public key of the trusted image signer, generated by "sign_dat genkey".
+ */
+static const uint8_t m_public_key[ED25519_PUBLIC_KEY_SIZE] = DFU_PUBLIC_KEY;
+
+/*
+ *  Progress of the init packet signature check, see dfu_init_signature_check().
  */
-#define DFU_INIT_PACKET_EXT_LENGTH_MAX      10        
+#define SIGNATURE_NONE      0   /* No init packet prevalidated, or a bad signature. */
+#define SIGNATURE_PENDING   1   /* Init packet prevalidated, check not started.     */
+#define SIGNATURE_RUNNING   2   /* Scalar multiply in progress.                     */
+#define SIGNATURE_FINISH    3   /* Scalar multiply done, result not checked.        */
+#define SIGNATURE_VALID     4   /* Signed by the trusted signer.                    */
+
+static uint8_t         m_signature_state;
+
+/*
+ *  Signed part of the init packet, the signature excluded.
+ */
+static const uint8_t * mp_signed_data;
+static uint32_t        m_signed_length;
+#endif
 
 /*
  *  Data array for storage of the extended data received. 
@@ -50,6 +96,11 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len)
 {
     uint32_t i = 0;
     
+#if defined(DFU_SIGNING_SUPPORT)
+    // The signature checked so far, if any, is for the previous init packet.
+    m_signature_state = SIGNATURE_NONE;
+#endif
+
     // In order to support signing or encryption then any init packet 
     // decryption function / library should be called from here or 
     // implemented at this location.
@@ -62,13 +113,6 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len)
     // Current template uses clear text data so they can be casted for pre-check.
     dfu_init_packet_t * p_init_packet = (dfu_init_packet_t *)p_init_data;
 
-    m_extended_packet_length = ((uint32_t)p_init_data + init_data_len) -
-                               (uint32_t)&p_init_packet->softdevice[p_init_packet->softdevice_len];
-
-    if (m_extended_packet_length < DFU_INIT_PACKET_EXT_LENGTH_MIN) {
-        return NRF_ERROR_INVALID_LENGTH;
-    }
-
     if (((uint32_t)p_init_data + init_data_len) < 
         (uint32_t)&p_init_packet->softdevice[p_init_packet->softdevice_len]) {
 
@@ -79,17 +123,58 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len)
         return NRF_ERROR_INVALID_LENGTH;
     }
 
+    // Length of the extended data, checked against the init packet before it is used.
+    i = ((uint32_t)p_init_data + init_data_len) -
+        (uint32_t)&p_init_packet->softdevice[p_init_packet->softdevice_len];
+
+    if ((i < DFU_INIT_PACKET_EXT_LENGTH_MIN) || (i > DFU_INIT_PACKET_EXT_LENGTH_MAX)) {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+
+    m_extended_packet_length = i;
+    i = 0;
+
     memcpy(m_extended_packet,
            &p_init_packet->softdevice[p_init_packet->softdevice_len],
            m_extended_packet_length);
 
+#if defined(DFU_SIGNING_SUPPORT)
+    //
+    // Only init packets signed by the trusted signer are accepted. The signature covers
+    // every field checked below and the image hash used by dfu_init_postvalidate().
+    // Checking it takes most of a second on the nRF51 (see gcc/dfu_bench.c), too long for
+    // the BLE event handling, so it is only set up here and done in steps by
+    // dfu_init_signature_check(). No image is accepted until it has passed.
+    //
+    if (m_extended_packet_length != DFU_INIT_EXT_LENGTH_SIGNED) {
+        PUTS("Init packet not signed");
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    mp_signed_data  = p_init_data;
+    m_signed_length = init_data_len - ED25519_SIGNATURE_SIZE;
+#endif
+
 /** [DFU init application version] */
-    // In order to support application versioning this check should be updated.
-    // This template allows for any application to be installed however customer
-    // could place a revision number at bottom of application to be verified by 
-    // bootloader. 
-    // This could be done at a relative location to this papplication for 
-    // example Application start address + 0x0100.
+    // Application versions only increase. The highest version installed is kept in the
+    // bootloader settings, and an older image is refused here, before it is transferred.
+    // Images without a version (BOOTLOADER_APP_VERSION_NONE) are not checked.
+    {
+        const bootloader_settings_t * p_settings;
+
+        bootloader_util_settings_get(&p_settings);
+
+        if ((p_init_packet->app_version != BOOTLOADER_APP_VERSION_NONE) &&
+            (p_settings->app_version != BOOTLOADER_APP_VERSION_NONE) &&
+            (p_init_packet->app_version < p_settings->app_version)) {
+
+            PRINTF("App version 0x%x older than 0x%x\n",
+                (unsigned) p_init_packet->app_version,
+                (unsigned) p_settings->app_version);
+
+            return NRF_ERROR_INVALID_DATA;
+        }
+    }
 /** [DFU init application version] */
     
     // First check to verify the image to be transfered matches the device type.
@@ -120,6 +205,9 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len)
         if (p_init_packet->softdevice[i] == DFU_SOFTDEVICE_ANY ||
             p_init_packet->softdevice[i++] == SOFTDEVICE_INFORMATION->firmware_id) {
             
+#if defined(DFU_SIGNING_SUPPORT)
+            m_signature_state = SIGNATURE_PENDING;
+#endif
             return NRF_SUCCESS;
         }
     }
@@ -129,23 +217,135 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len)
 }
 
 
-uint32_t dfu_init_postvalidate(uint8_t * p_image, uint32_t image_len)
+uint32_t dfu_init_signature_check(void)
 {
+#if defined(DFU_SIGNING_SUPPORT)
+    switch (m_signature_state) {
+
+        case SIGNATURE_PENDING:
+            // Decodes the public key and hashes the init packet.
+            if (ed25519_verify_start(&m_extended_packet[DFU_INIT_EXT_SIGNATURE_OFFSET],
+                                     mp_signed_data,
+                                     m_signed_length,
+                                     m_public_key) != 0) {
+                break;
+            }
+            m_signature_state = SIGNATURE_RUNNING;
+            return NRF_ERROR_BUSY;
+
+        case SIGNATURE_RUNNING:
+            if (!ed25519_verify_step()) {
+                m_signature_state = SIGNATURE_FINISH;
+            }
+            return NRF_ERROR_BUSY;
+
+        case SIGNATURE_FINISH:
+            if (ed25519_verify_finish() != 0) {
+                break;
+            }
+            m_signature_state = SIGNATURE_VALID;
+            return NRF_SUCCESS;
+
+        case SIGNATURE_VALID:
+            return NRF_SUCCESS;
+
+        default:
+            return NRF_ERROR_INVALID_STATE;
+    }
+
+    PUTS("Bad init packet signature");
+    m_signature_state = SIGNATURE_NONE;
+    return NRF_ERROR_INVALID_DATA;
+#else
+    return NRF_SUCCESS;
+#endif
+}
+
+
+void dfu_init_digest_start(dfu_init_digest_t * p_digest)
+{
+    p_digest->length = 0;
+    p_digest->crc    = 0xFFFF;   // Initial value used by crc16_compute.
+#if defined(DFU_SIGNING_SUPPORT)
+    sha256_init(&p_digest->sha256);
+#endif
+}
+
+
+void dfu_init_digest_update(dfu_init_digest_t * p_digest, const uint8_t * p_data, uint32_t length)
+{
+    p_digest->crc     = crc16_compute(p_data, length, &p_digest->crc);
+    p_digest->length += length;
+#if defined(DFU_SIGNING_SUPPORT)
+    sha256_update(&p_digest->sha256, p_data, length);
+#endif
+}
+
+
+void dfu_init_digest_resume(dfu_init_digest_t * p_digest,
+                            uint32_t            length,
+                            uint16_t            crc,
+                            uint32_t const *    p_state)
+{
+    p_digest->length = length;
+    p_digest->crc    = crc;
+#if defined(DFU_SIGNING_SUPPORT)
+    // Page aligned, so no partial SHA-256 block is pending at the resume point.
+    sha256_resume(&p_digest->sha256, p_state, length);
+#endif
+}
+
+
+uint32_t const * dfu_init_digest_state_get(dfu_init_digest_t const * p_digest)
+{
+#if defined(DFU_SIGNING_SUPPORT)
+    return p_digest->sha256.state;
+#else
+    return NULL;
+#endif
+}
+
+
+uint32_t dfu_init_postvalidate(dfu_init_digest_t const * p_digest, uint32_t image_len)
+{
+#if defined(DFU_SIGNING_SUPPORT)
+    sha256_ctx_t sha256;
+    uint8_t      image_hash[SHA256_DIGEST_SIZE];
+#else
     uint16_t image_crc;
     uint16_t received_crc;
-    
+#endif
+
+    // The digest must cover exactly the image.
+    if (p_digest->length != image_len) {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+#if defined(DFU_SIGNING_SUPPORT)
+    // The image hash is only trusted once the signature over it has been checked.
+    if (m_signature_state != SIGNATURE_VALID) {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
     //
-    // In order to support hashing (and signing) then the (decrypted) hash 
-    // should be fetched and the corresponding hash should be calculated over
-    // the image at this location.
-    // If hashing (or signing) is added to the system then the CRC validation 
-    // should be removed.
+    // The image was hashed while it was written, so only the last partial block
+    // is left to hash. Finalize a copy, the digest itself is const.
+    // The signed hash replaces the CRC check.
     //
-    // calculate CRC from active block.
-    image_crc = crc16_compute(p_image, image_len, NULL);
+    sha256 = p_digest->sha256;
+    sha256_final(&sha256, image_hash);
+
+    if (memcmp(image_hash, &m_extended_packet[DFU_INIT_EXT_HASH_OFFSET], SHA256_DIGEST_SIZE) != 0) {
+        PUTS("Bad image hash");
+        return NRF_ERROR_INVALID_DATA;
+    }
+#else
+
+    // CRC calculated while the image was written.
+    image_crc = p_digest->crc;
 
     // Decode the received CRC from extended data.    
-    received_crc = uint16_decode((uint8_t *)&m_extended_packet[0]);
+    received_crc = uint16_decode((uint8_t *)&m_extended_packet[DFU_INIT_EXT_CRC_OFFSET]);
 
     // Compare the received and calculated CRC.
     if (image_crc != received_crc) {
@@ -155,6 +355,7 @@ uint32_t dfu_init_postvalidate(uint8_t * p_image, uint32_t image_len)
         }
         return NRF_ERROR_INVALID_DATA;
     }
+#endif
 
     return NRF_SUCCESS;
 }
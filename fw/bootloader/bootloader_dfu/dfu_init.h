@@ -32,10 +32,10 @@
  *              0xFFFE = S110 development (any SoftDevice accepted),
  *          - CRC or hash of firmware image
  *
- * @note This module does not support security features such as image signing, but the corresponding
- *       implementation allows for such extensions.
- *       If the init packet is signed by a trusted source, it must be decrypted before it can be 
- *       processed.
+ * @note When built with DFU_SIGNING_SUPPORT the extended init packet must carry a SHA-256 hash of
+ *       the image and an Ed25519 signature over the init packet, made with the key whose public
+ *       half is in dfu_public_key.h. The image is then validated against the hash instead of the
+ *       CRC.
  */
 
 #ifndef DFU_INIT_H__
@@ -43,6 +43,9 @@
 
 #include <stdint.h>
 #include "nrf51.h"
+#if defined(DFU_SIGNING_SUPPORT)
+#include "sha256.h"
+#endif
 
 /**@brief Structure contained in an init packet. Contains information on device type, revision, and 
  *        supported SoftDevices.
@@ -64,6 +67,19 @@ typedef struct
     uint16_t device_rev;                                                                    /**< Device revision (2 bytes), for example major revision 1, minor revision 0. This number must be defined by the customer before production. It can be located in UICR or FICR. */
 } dfu_device_info_t;
 
+/**@brief Structure holding a streaming digest of a received image. The digest is updated as each
+ *        part of the image is written to flash, so post-validation does not need to read the image
+ *        back.
+ */
+typedef struct
+{
+    uint32_t length;                                                                        /**< Number of image bytes covered by the digest. */
+    uint16_t crc;                                                                           /**< Running CRC-16 of the image bytes. */
+#if defined(DFU_SIGNING_SUPPORT)
+    sha256_ctx_t sha256;                                                                    /**< Running SHA-256 of the image bytes. */
+#endif
+} dfu_init_digest_t;
+
 /** The device info offset can be modified to place the device info settings at a different location.
   * If the customer reserved UICR location is used for other application specific data, the offset
   * must be updated to avoid collision with that data.
@@ -95,8 +111,8 @@ typedef struct
  * @param[in] init_data_len  Length of the init data.
  *
  * @retval NRF_SUCCESS              If the pre-validation succeeded, that means the image is 
- *                                  supported by the device and it is considered to come from a 
- *                                  trusted source (signing).
+ *                                  supported by the device. With signing, the signature is then
+ *                                  checked by \ref dfu_init_signature_check.
  * @retval NRF_ERROR_INVALID_DATA   If the pre-validation failed, that means the image is not 
  *                                  supported by the device or comes from an un-trusted source 
  *                                  (signing).
@@ -105,6 +121,59 @@ typedef struct
  */
 uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len);
 
+/**@brief Function for checking the signature of the init packet accepted by
+ *        \ref dfu_init_prevalidate, one step per call.
+ *
+ * @details  A signature check takes most of a second on the nRF51, so it is split in steps of
+ *           some tens of milliseconds each. The caller keeps calling this function, returning to
+ *           its event loop in between as needed, until it no longer returns NRF_ERROR_BUSY.
+ *           \ref dfu_init_postvalidate fails unless the check has passed. The init data given to
+ *           \ref dfu_init_prevalidate must be left unchanged until the check is done. Without
+ *           signing support there is nothing to check.
+ *
+ * @retval NRF_SUCCESS             If the init packet is signed by the trusted signer.
+ * @retval NRF_ERROR_BUSY          If more steps of the check are left.
+ * @retval NRF_ERROR_INVALID_DATA  If the signature is not valid.
+ * @retval NRF_ERROR_INVALID_STATE If no init packet has passed \ref dfu_init_prevalidate.
+ */
+uint32_t dfu_init_signature_check(void);
+
+/**@brief Function for starting a new image digest.
+ *
+ * @param[out] p_digest  Digest to start.
+ */
+void dfu_init_digest_start(dfu_init_digest_t * p_digest);
+
+/**@brief Function for extending an image digest with the next part of the image.
+ *
+ * @param[in,out] p_digest  Digest to extend.
+ * @param[in]     p_data    Pointer to the image data, as written to flash.
+ * @param[in]     length    Length of the image data.
+ */
+void dfu_init_digest_update(dfu_init_digest_t * p_digest, const uint8_t * p_data, uint32_t length);
+
+/**@brief Function for restarting an image digest at the resume point of an interrupted transfer.
+ *
+ * @param[out] p_digest  Digest to restart.
+ * @param[in]  length    Number of image bytes covered at the resume point. Must be page aligned.
+ * @param[in]  crc       CRC-16 of the image bytes at the resume point.
+ * @param[in]  p_state   Hash state at the resume point, as returned by
+ *                       \ref dfu_init_digest_state_get. Ignored if no hash is used.
+ */
+void dfu_init_digest_resume(dfu_init_digest_t * p_digest,
+                            uint32_t            length,
+                            uint16_t            crc,
+                            uint32_t const *    p_state);
+
+/**@brief Function for getting the hash state of a page aligned digest, to be recorded with a resume
+ *        point.
+ *
+ * @param[in] p_digest  Digest at a page boundary.
+ *
+ * @return Pointer to the eight word hash state, or NULL if no hash is used.
+ */
+uint32_t const * dfu_init_digest_state_get(dfu_init_digest_t const * p_digest);
+
 /**@brief DFU postvalidate call for post-checking the received image using the init packet.
  *
  * @details  Post-validation can verify the integrity check the firmware image received before 
@@ -115,8 +184,10 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len);
  *           - A hash for better verification of the image.
  *           - A signature to ensure the image originates from a trusted source.
  *           Checks are intended to be expanded for customer-specific requirements.
+ *           The digest is computed while the image is received, so this call does not read the
+ *           image.
  * 
- * @param[in] p_image    Pointer to the received image. The init data provided in the call 
+ * @param[in] p_digest   Digest of the received image. The init data provided in the call 
  *                       \ref dfu_init_prevalidate will be used for validating the image.
  * @param[in] image_len  Length of the image data.
  *
@@ -127,7 +198,7 @@ uint32_t dfu_init_prevalidate(uint8_t * p_init_data, uint32_t init_data_len);
  *                                 image failed such as the CRC is not matching the image transfered
  *                                 or the verification of the image fails (signing).
  */
-uint32_t dfu_init_postvalidate(uint8_t * p_image, uint32_t image_len);
+uint32_t dfu_init_postvalidate(dfu_init_digest_t const * p_digest, uint32_t image_len);
 
 #endif // DFU_INIT_H__
 
@@ -0,0 +1,88 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  dfu_lz.c  -- streaming decoder for compressed images.
+ *
+ *  The decoder keeps its place between calls, down to half a match, so
+ *  the image can be fed to it one DFU packet at a time and stopped
+ *  whenever the output pages are still being written to flash.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "dfu_lz.h"
+
+void dfu_lz_init(dfu_lz_ctx_t * p_ctx)
+{
+    memset(p_ctx, 0, sizeof(dfu_lz_ctx_t));
+}
+
+int32_t dfu_lz_decode(dfu_lz_ctx_t * p_ctx,
+                      const uint8_t * p_in, uint32_t in_length,
+                      uint8_t * p_ring, uint32_t ring_size,
+                      uint32_t out_limit)
+{
+    uint32_t mask = ring_size - 1;
+    uint32_t used = 0;
+
+    while (p_ctx->header_length < DFU_LZ_HEADER_SIZE) {
+        if (used == in_length)
+            return used;
+
+        p_ctx->header[p_ctx->header_length++] = p_in[used++];
+
+        if (p_ctx->header_length == DFU_LZ_HEADER_SIZE) {
+            uint32_t magic = p_ctx->header[0]         | (p_ctx->header[1] << 8) |
+                             (p_ctx->header[2] << 16) | ((uint32_t) p_ctx->header[3] << 24);
+
+            if (magic != DFU_LZ_MAGIC)
+                return DFU_LZ_ERROR_FORMAT;
+
+            p_ctx->size = p_ctx->header[4]         | (p_ctx->header[5] << 8) |
+                          (p_ctx->header[6] << 16) | ((uint32_t) p_ctx->header[7] << 24);
+        }
+    }
+
+    while (p_ctx->out < p_ctx->size && p_ctx->out < out_limit) {
+
+        if (p_ctx->match_length > 0) {
+            p_ring[p_ctx->out & mask] = p_ring[(p_ctx->out - p_ctx->match_distance) & mask];
+            p_ctx->out++;
+            p_ctx->match_length--;
+            continue;
+        }
+
+        if (used == in_length)
+            break;
+
+        if (p_ctx->flag_count == 0) {
+            p_ctx->flags      = p_in[used++];
+            p_ctx->flag_count = 8;
+        }
+        else if (p_ctx->flags & 1) {
+            p_ring[p_ctx->out & mask] = p_in[used++];
+            p_ctx->out++;
+            p_ctx->flags >>= 1;
+            p_ctx->flag_count--;
+        }
+        else if (!p_ctx->match_half) {
+            p_ctx->match_low  = p_in[used++];
+            p_ctx->match_half = 1;
+        }
+        else {
+            uint16_t value = p_ctx->match_low | (p_in[used++] << 8);
+
+            p_ctx->match_half     = 0;
+            p_ctx->flags        >>= 1;
+            p_ctx->flag_count--;
+            p_ctx->match_distance = (value & (DFU_LZ_WINDOW - 1)) + 1;
+            p_ctx->match_length   = (value >> 10) + DFU_LZ_MIN_MATCH;
+
+            if (p_ctx->match_distance > p_ctx->out ||
+                p_ctx->match_length > p_ctx->size - p_ctx->out)
+                return DFU_LZ_ERROR_FORMAT;
+        }
+    }
+
+    return used;
+}
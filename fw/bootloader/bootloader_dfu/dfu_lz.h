@@ -0,0 +1,65 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  dfu_lz.h  -- compressed images, shared by the bootloader and the
+ *               gen_lz host tool.
+ *
+ *  LZSS with a 1K window, so the decoder needs no RAM but its output: the
+ *  page being filled and the page before it.  The image is a header
+ *  followed by groups of one flag byte and eight items, flag bits LSB
+ *  first:
+ *
+ *    1  literal   one byte
+ *    0  match     two bytes, little endian: bits 0-9 distance - 1,
+ *                 bits 10-15 length - 3.  Copies 3 to 66 bytes from
+ *                 1 to 1024 bytes back in the output.
+ *
+ *  The last group stops once the header size has been output.  Like any
+ *  DFU image the compressed image is padded to a whole number of words.
+ */
+#ifndef DFU_LZ_H__
+#define DFU_LZ_H__
+
+#include <stdint.h>
+
+#define DFU_LZ_MAGIC           0x315A4C44      /* "DLZ1"                     */
+#define DFU_LZ_HEADER_SIZE     8               /* magic, image size          */
+#define DFU_LZ_WINDOW          1024
+#define DFU_LZ_MIN_MATCH       3
+#define DFU_LZ_MAX_MATCH       (DFU_LZ_MIN_MATCH + 63)
+
+#define DFU_LZ_ERROR_FORMAT    -1              /* bad header or match        */
+
+/*
+ *  Decoder state.  size is valid once DFU_LZ_HEADER_SIZE bytes have been
+ *  decoded, and out counts the bytes output.
+ */
+typedef struct {
+    uint32_t size;
+    uint32_t out;
+    uint32_t header_length;
+    uint8_t  header[DFU_LZ_HEADER_SIZE];
+    uint8_t  flags;
+    uint8_t  flag_count;
+    uint8_t  match_low;
+    uint8_t  match_half;
+    uint16_t match_distance;
+    uint16_t match_length;
+} dfu_lz_ctx_t;
+
+void dfu_lz_init(dfu_lz_ctx_t * p_ctx);
+
+/*
+ *  Decode input into the ring buffer p_ring, at offset (out % ring_size).
+ *  ring_size is a power of two, at least twice DFU_LZ_WINDOW.  Decoding
+ *  stops when the input is used up, when out reaches out_limit, or when
+ *  the image is complete; it can be continued at any byte.
+ *
+ *  Returns the number of input bytes used, or DFU_LZ_ERROR_FORMAT.
+ */
+int32_t dfu_lz_decode(dfu_lz_ctx_t * p_ctx,
+                      const uint8_t * p_in, uint32_t in_length,
+                      uint8_t * p_ring, uint32_t ring_size,
+                      uint32_t out_limit);
+
+#endif // DFU_LZ_H__
@@ -26,32 +26,375 @@
 #include "nrf_error.h"
 #include "app_timer.h"
 #include "app_error.h"
+#include "app_scheduler.h"
 #include "nordic_common.h"
 #include "bootloader.h"
 #include "bootloader_types.h"
 #include "pstorage.h"
 #include "nrf_mbr.h"
 #include "dfu_init.h"
+#include "crc16.h"
 #include "dbglog.h"
+#if defined(DFU_COMPRESSION_SUPPORT)
+#include "dfu_lz.h"
+#endif
 
 static dfu_state_t                  m_dfu_state;                /**< Current DFU state. */
 static uint32_t                     m_image_size;               /**< Size of the image that will be transmitted. */
 
 static dfu_start_packet_t           m_start_packet;             /**< Start packet received for this update procedure. Contains update mode and image sizes information to be used for image transfer. */
-static uint8_t                      m_init_packet[64];          /**< Init packet, can hold CRC, Hash, Signed Hash and similar, for image validation, integrety check and authorization checking. */ 
+static uint8_t                      m_init_packet[128];         /**< Init packet, can hold CRC, Hash, Signed Hash and similar, for image validation, integrety check and authorization checking. */ 
 static uint8_t                      m_init_packet_length;       /**< Length of init packet received. */
 static uint16_t                     m_image_crc;                /**< Calculated CRC of the image received. */
 
+static dfu_init_digest_t            m_data_digest;              /**< Digest of the received data written to flash, updated as each packet is written. */
+static dfu_init_digest_t            m_checkpoint_digest;        /**< Digest of the received data at the last page boundary. Only complete pages are kept when a transfer is resumed. */
+static uint32_t                     m_checkpoint_saved;         /**< Checkpoint offset last recorded in the bootloader settings. */
+static uint32_t                     m_resume_offset;            /**< Offset from which an interrupted transfer is resumed, 0 if the transfer was started from the beginning. */
+
 static app_timer_id_t               m_dfu_timer_id;             /**< Application timer id. */
 static bool                         m_dfu_timed_out = false;    /**< Boolean flag value for tracking DFU timer timeout state. */
 
 static pstorage_handle_t            m_storage_handle_app;       /**< Pstorage handle for the application area (bank 0). Bank used when updating a SoftDevice w/wo bootloader. Handle also used when swapping received application from bank 1 to bank 0. */
 static pstorage_handle_t          * mp_storage_handle_active;   /**< Pointer to the pstorage handle for the active bank for receiving of data packets. */
+#if defined(DFU_DELTA_SUPPORT)
+static pstorage_handle_t            m_storage_handle_delta;     /**< Pstorage handle for the delta image area at the top of bank 1. */
+static dfu_bank_1_descriptor_t      m_delta_descriptor;         /**< Bank 1 descriptor written on activation of a delta image. */
+static const uint32_t               m_delta_magic = DFU_BANK_1_DESCRIPTOR_MAGIC; /**< Written after the descriptor body, marking the descriptor complete. */
+#endif
+
+#if defined(DFU_COMPRESSION_SUPPORT)
+#define LZ_QUEUE_SIZE               8                           /**< Data packets held until decoded, one per transport RX buffer. */
+
+/**@brief Data packet of a compressed image, held until it has been decoded. */
+typedef struct
+{
+    uint8_t * p_data;                                           /**< Packet data, a transport RX buffer. */
+    uint32_t  length;                                           /**< Packet length. */
+} lz_packet_t;
+
+static dfu_lz_ctx_t                 m_lz;                       /**< Decoder state of a compressed image. */
+static uint32_t                     m_lz_pages[2 * CODE_PAGE_SIZE / sizeof(uint32_t)]; /**< Page being decoded into and the page before it, which is being written to flash. Together they are the decoder window. */
+static uint32_t                     m_lz_issued;                /**< Decoded bytes handed to pstorage. */
+static uint32_t                     m_lz_stored;                /**< Decoded bytes written to flash. */
+static lz_packet_t                  m_lz_queue[LZ_QUEUE_SIZE];  /**< Packets not yet fully decoded, oldest first. */
+static uint32_t                     m_lz_queue_head;            /**< Index of the oldest packet in m_lz_queue. */
+static uint32_t                     m_lz_queue_count;           /**< Number of packets in m_lz_queue. */
+static uint32_t                     m_lz_offset;                /**< Bytes of the oldest packet decoded. */
+static uint32_t                     m_lz_padding;               /**< Bytes received after the end of the compressed image. */
+static uint8_t                    * mp_lz_final_packet;         /**< Final data packet, released to the transport once the image is in flash. */
+#endif
 
 static dfu_callback_t               m_data_pkt_cb;              /**< Callback from DFU Bank module for notification of asynchronous operation such as flash prepare. */
 static dfu_bank_func_t              m_functions;                /**< Structure holding operations for the selected update process. */
 
 
+/**@brief Function for getting the size of the image written to flash.
+ *
+ * @details This is the image size of the start packet, unless the image is compressed. The size
+ *          of a compressed image is known once the header has been decoded.
+ */
+static uint32_t dfu_write_size_get(void)
+{
+#if defined(DFU_COMPRESSION_SUPPORT)
+    if (IS_COMPRESSED(m_start_packet))
+    {
+        return m_lz.size;
+    }
+#endif
+    return m_image_size;
+}
+
+
+/**@brief Function for recording the resume point of the current transfer in the bootloader settings.
+ */
+static void dfu_resume_checkpoint(void)
+{
+    dfu_update_status_t update_status;
+
+    if (!IS_UPDATING_APP(m_start_packet) ||
+        IS_DELTA(m_start_packet) || IS_COMPRESSED(m_start_packet))
+    {
+        // Only an application transfer is resumed, the resume path prepares the application area.
+        // A delta image is not resumed, its area is cleared on every start. Nor is a compressed
+        // image, the decoder state is not kept.
+        return;
+    }
+
+    memset(&update_status, 0, sizeof(dfu_update_status_t));
+    update_status.status_code     = DFU_UPDATE_CHECKPOINT;
+    update_status.resume_size     = m_image_size;
+    update_status.resume_offset   = m_checkpoint_digest.length;
+    update_status.resume_crc      = m_checkpoint_digest.crc;
+    update_status.resume_init_crc = crc16_compute(m_init_packet, m_init_packet_length, NULL);
+    update_status.p_resume_hash   = dfu_init_digest_state_get(&m_checkpoint_digest);
+
+    m_checkpoint_saved = m_checkpoint_digest.length;
+
+    bootloader_dfu_update_process(update_status);
+}
+
+
+/**@brief Function for handling data which has been written to flash.
+ *
+ * @details The image digest is extended with the data as read back from flash, and a snapshot is
+ *          taken at each page boundary. This leaves nothing but a compare for image validation.
+ *          A checkpoint is recorded in the bootloader settings every DFU_CHECKPOINT_INTERVAL
+ *          bytes so the transfer survives a reset or power loss.
+ *
+ * @param[in] data_len  Length of the data written.
+ */
+static void dfu_data_written(uint32_t data_len)
+{
+    uint8_t * p_data = (uint8_t *)(mp_storage_handle_active->block_id + m_data_digest.length);
+    uint32_t  length;
+
+    while (data_len > 0)
+    {
+        length = CODE_PAGE_SIZE - (m_data_digest.length & (CODE_PAGE_SIZE - 1));
+        if (length > data_len)
+        {
+            length = data_len;
+        }
+
+        dfu_init_digest_update(&m_data_digest, p_data, length);
+        p_data   += length;
+        data_len -= length;
+
+        if ((m_data_digest.length & (CODE_PAGE_SIZE - 1)) == 0)
+        {
+            m_checkpoint_digest = m_data_digest;
+        }
+    }
+
+    if (((m_checkpoint_digest.length - m_checkpoint_saved) >= DFU_CHECKPOINT_INTERVAL) &&
+        (m_checkpoint_digest.length != m_image_size))
+    {
+        dfu_resume_checkpoint();
+    }
+}
+
+
+#if defined(DFU_COMPRESSION_SUPPORT)
+/**@brief Function for writing decoded pages of a compressed image to flash.
+ *
+ * @details Each page is erased just before it is written, except the first which was erased on
+ *          start. The size of the decompressed image is not known before the first data packet.
+ */
+static uint32_t dfu_lz_pages_store(void)
+{
+    uint32_t          err_code;
+    uint32_t          length;
+    pstorage_handle_t storage_handle;
+
+    while (((m_lz.out - m_lz_issued) >= CODE_PAGE_SIZE) ||
+           ((m_lz.out == m_lz.size) && (m_lz_issued < m_lz.out)))
+    {
+        length = MIN(m_lz.out - m_lz_issued, CODE_PAGE_SIZE);
+
+        if (m_lz_issued != 0)
+        {
+            storage_handle           = m_storage_handle_app;
+            storage_handle.block_id += m_lz_issued;
+
+            err_code = pstorage_raw_clear(&storage_handle, CODE_PAGE_SIZE);
+            if (err_code != NRF_SUCCESS)
+            {
+                return err_code;
+            }
+        }
+
+        err_code = pstorage_raw_store(mp_storage_handle_active,
+                                      (uint8_t *)m_lz_pages + (m_lz_issued & (sizeof(m_lz_pages) - 1)),
+                                      length,
+                                      m_lz_issued);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+
+        m_lz_issued += length;
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for decoding the held data packets of a compressed image.
+ *
+ * @details Packets are decoded in order until both page buffers hold data not yet written to
+ *          flash, and decoding continues as pages are written. Each packet is released to the
+ *          transport once decoded, the final packet once the whole image is in flash, so the
+ *          transport reports the transfer complete only then.
+ *
+ * @return NRF_SUCCESS, or an error code if the compressed image is invalid.
+ */
+static uint32_t dfu_lz_process(void)
+{
+    uint32_t      err_code;
+    int32_t       used;
+    lz_packet_t * p_packet;
+    uint8_t     * p_data;
+    bool          header_done;
+
+    while (m_lz_queue_count > 0)
+    {
+        p_packet    = &m_lz_queue[m_lz_queue_head];
+        header_done = (m_lz.header_length == DFU_LZ_HEADER_SIZE);
+
+        if (!header_done || (m_lz.out < m_lz.size))
+        {
+            used = dfu_lz_decode(&m_lz,
+                                 p_packet->p_data + m_lz_offset,
+                                 p_packet->length - m_lz_offset,
+                                 (uint8_t *)m_lz_pages,
+                                 sizeof(m_lz_pages),
+                                 m_lz_stored + sizeof(m_lz_pages));
+            if (used < 0)
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+            m_lz_offset += used;
+            header_done  = (m_lz.header_length == DFU_LZ_HEADER_SIZE);
+
+            if (header_done &&
+                ((m_lz.size == 0) ||
+                 (m_lz.size > (DFU_IMAGE_MAX_SIZE_FULL - CODE_PAGE_SIZE)) ||
+                 !IS_WORD_SIZED(m_lz.size)))
+            {
+                return NRF_ERROR_DATA_SIZE;
+            }
+
+            err_code = dfu_lz_pages_store();
+            if (err_code != NRF_SUCCESS)
+            {
+                return err_code;
+            }
+        }
+
+        if (header_done && (m_lz.out == m_lz.size))
+        {
+            // Only the padding to a whole number of words may follow the image.
+            m_lz_padding += p_packet->length - m_lz_offset;
+            m_lz_offset   = p_packet->length;
+            if (m_lz_padding >= sizeof(uint32_t))
+            {
+                return NRF_ERROR_INVALID_DATA;
+            }
+        }
+
+        if (m_lz_offset < p_packet->length)
+        {
+            // Both page buffers are in use. Decoding continues when a page has been written.
+            break;
+        }
+
+        p_data           = p_packet->p_data;
+        m_lz_queue_head  = (m_lz_queue_head + 1) % LZ_QUEUE_SIZE;
+        m_lz_queue_count--;
+        m_lz_offset      = 0;
+
+        if (p_data == mp_lz_final_packet)
+        {
+            if (!header_done || (m_lz.out != m_lz.size))
+            {
+                // The transfer ended before the image did.
+                return NRF_ERROR_INVALID_DATA;
+            }
+        }
+        else if (m_data_pkt_cb != NULL)
+        {
+            m_data_pkt_cb(DATA_PACKET, NRF_SUCCESS, p_data);
+        }
+    }
+
+    // The final packet always ends the image, padding is less than a word, so it is released
+    // from a pstorage callback after the transport has recorded it as final.
+    if ((mp_lz_final_packet != NULL) && (m_lz_queue_count == 0) && (m_lz_stored == m_lz.size))
+    {
+        p_data             = mp_lz_final_packet;
+        mp_lz_final_packet = NULL;
+
+        if (m_data_pkt_cb != NULL)
+        {
+            m_data_pkt_cb(DATA_PACKET, NRF_SUCCESS, p_data);
+        }
+    }
+
+    return NRF_SUCCESS;
+}
+
+
+/**@brief Function for handling a data packet of a compressed image.
+ *
+ * @param[in] p_data       Packet data, held until decoded.
+ * @param[in] data_length  Packet length.
+ *
+ * @return NRF_SUCCESS for the final packet, NRF_ERROR_INVALID_LENGTH if more data is expected,
+ *         an error code otherwise.
+ */
+static uint32_t dfu_lz_data_handle(uint32_t * p_data, uint32_t data_length)
+{
+    uint32_t err_code;
+    uint32_t index;
+
+    if (m_lz_queue_count == LZ_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    index                     = (m_lz_queue_head + m_lz_queue_count) % LZ_QUEUE_SIZE;
+    m_lz_queue[index].p_data  = (uint8_t *)p_data;
+    m_lz_queue[index].length  = data_length;
+    m_lz_queue_count++;
+
+    m_data_received += data_length;
+    if (m_data_received == m_image_size)
+    {
+        mp_lz_final_packet = (uint8_t *)p_data;
+    }
+
+    err_code = dfu_lz_process();
+    if (err_code != NRF_SUCCESS)
+    {
+        // As for an oversized image, all further data packets are refused.
+        m_lz_queue_count = 0;
+        m_data_received  = 0xFFFFFFFF;
+        return err_code;
+    }
+
+    return (m_data_received == m_image_size) ? NRF_SUCCESS : NRF_ERROR_INVALID_LENGTH;
+}
+
+
+/**@brief Function for handling a page of a compressed image written to flash.
+ *
+ * @param[in] result     Result of the write.
+ * @param[in] data_len   Length of the page.
+ */
+static void dfu_lz_page_stored(uint32_t result, uint32_t data_len)
+{
+    if (result == NRF_SUCCESS)
+    {
+        m_lz_stored += data_len;
+        result       = dfu_lz_process();
+    }
+
+    if (result != NRF_SUCCESS)
+    {
+        m_lz_queue_count = 0;
+        m_data_received  = 0xFFFFFFFF;
+
+        // The page buffers are not transport buffers, only the failure is passed on.
+        if (m_data_pkt_cb != NULL)
+        {
+            m_data_pkt_cb(DATA_PACKET, result, NULL);
+        }
+    }
+}
+#endif
+
+
 /**@brief Function for handling callbacks from pstorage module.
  *
  * @details Handles pstorage results for clear and storage operation. For detailed description of
@@ -66,6 +409,19 @@ static void pstorage_callback_handler(pstorage_handle_t * p_handle,
     switch (op_code)
     {
         case PSTORAGE_STORE_OP_CODE:
+            if ((result == NRF_SUCCESS) && (m_dfu_state == DFU_STATE_RX_DATA_PKT))
+            {
+                dfu_data_written(data_len);
+            }
+
+#if defined(DFU_COMPRESSION_SUPPORT)
+            if (IS_COMPRESSED(m_start_packet) && (m_dfu_state == DFU_STATE_RX_DATA_PKT))
+            {
+                dfu_lz_page_stored(result, data_len);
+                return;
+            }
+#endif
+
             if ((m_dfu_state == DFU_STATE_RX_DATA_PKT) && (m_data_pkt_cb != NULL))
             {
                 m_data_pkt_cb(DATA_PACKET, result, p_data);
@@ -102,6 +458,12 @@ static void dfu_timeout_handler(void * p_context)
 
     PUTS("*** Watchdog timeout ***");
 
+    if ((m_dfu_state == DFU_STATE_RX_DATA_PKT) && (m_checkpoint_digest.length != m_checkpoint_saved))
+    {
+        // Record how far the transfer got, so it can be resumed after the reset.
+        dfu_resume_checkpoint();
+    }
+
     m_dfu_timed_out           = true;
     update_status.status_code = DFU_TIMEOUT;
 
@@ -153,6 +515,36 @@ static void dfu_prepare_func_app_erase(uint32_t image_size)
 }
 
 
+#if defined(DFU_COMPRESSION_SUPPORT)
+/**@brief   Function for preparing of flash before receiving a compressed application image.
+ *
+ * @details Only the first page of the application area is erased here, the others are erased as
+ *          they are written. The size of the image in flash is only known from its first data
+ *          packet. Upon erase complete a callback will be done. See \ref dfu_bank_prepare_t for
+ *          further details.
+ */
+static void dfu_prepare_func_lz(uint32_t image_size)
+{
+    uint32_t err_code;
+
+    mp_storage_handle_active = &m_storage_handle_app;
+
+    dfu_lz_init(&m_lz);
+    m_lz_issued        = 0;
+    m_lz_stored        = 0;
+    m_lz_queue_head    = 0;
+    m_lz_queue_count   = 0;
+    m_lz_offset        = 0;
+    m_lz_padding       = 0;
+    mp_lz_final_packet = NULL;
+
+    m_dfu_state = DFU_STATE_PREPARING;
+    err_code    = pstorage_raw_clear(&m_storage_handle_app, CODE_PAGE_SIZE);
+    APP_ERROR_CHECK(err_code);
+}
+#endif
+
+
 /**@brief   Function for handling behaviour when clear operation has completed.
  */
 static void dfu_cleared_func_app(void)
@@ -162,6 +554,201 @@ static void dfu_cleared_func_app(void)
 }
 
 
+/**@brief   Function for preparing of flash before resuming an interrupted transfer.
+ *
+ * @details Complete pages below the resume point were verified against the recorded CRC and are
+ *          kept. The remainder of the image area is erased, as data written after the last
+ *          checkpoint may be partial. Upon erase complete a callback will be done.
+ *          See \ref dfu_bank_prepare_t for further details.
+ */
+static void dfu_prepare_func_app_resume(uint32_t image_size)
+{
+    uint32_t          err_code;
+    pstorage_handle_t storage_handle;
+
+    mp_storage_handle_active = &m_storage_handle_app;
+
+    storage_handle           = m_storage_handle_app;
+    storage_handle.block_id += m_resume_offset;
+
+    m_dfu_state = DFU_STATE_PREPARING;
+    err_code    = pstorage_raw_clear(&storage_handle, image_size - m_resume_offset);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief   Function for handling behaviour when clear operation has completed for a resumed
+ *          transfer.
+ *
+ * @details Unlike \ref dfu_cleared_func_app the resume point is kept in the bootloader settings,
+ *          so the transfer can be resumed again if it is interrupted before the next checkpoint.
+ */
+static void dfu_cleared_func_resume(void)
+{
+    PRINTF("Resuming transfer at %u\n", (unsigned) m_resume_offset);
+}
+
+
+/**@brief   Function for getting the offset from which the transfer in the start packet can be
+ *          resumed.
+ *
+ * @details A transfer can be resumed if the bootloader settings hold a resume point for an image
+ *          of the same size, and the data written before the interruption is still intact.
+ *
+ * @return  Offset to resume the transfer from, 0 if the transfer must be restarted.
+ */
+static uint32_t dfu_resume_offset_get(void)
+{
+    bootloader_settings_t settings;
+
+    bootloader_settings_get(&settings);
+
+    if ((settings.resume_size != m_image_size) ||
+        (settings.resume_offset == 0)          ||
+        (settings.resume_offset >= m_image_size))
+    {
+        return 0;
+    }
+
+    if (crc16_compute((uint8_t *)DFU_BANK_0_REGION_START,
+                      settings.resume_offset,
+                      NULL) != settings.resume_crc)
+    {
+        return 0;
+    }
+
+    return settings.resume_offset;
+}
+
+
+/**@brief   Function for checking that the init packet matches the interrupted transfer, and
+ *          continuing the transfer from the resume point.
+ *
+ * @return  NRF_SUCCESS if the transfer is resumed, NRF_ERROR_INVALID_DATA if the init packet is
+ *          for a different image.
+ */
+static uint32_t dfu_resume_init_check(void)
+{
+    bootloader_settings_t settings;
+
+    bootloader_settings_get(&settings);
+
+    // Only the image which was interrupted can be resumed. The init packet identifies it.
+    if (crc16_compute(m_init_packet, m_init_packet_length, NULL) != settings.resume_init_crc)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    m_data_received = m_resume_offset;
+    dfu_init_digest_resume(&m_data_digest, m_resume_offset, settings.resume_crc, settings.resume_hash);
+    m_checkpoint_digest = m_data_digest;
+    m_checkpoint_saved  = m_resume_offset;
+
+    return NRF_SUCCESS;
+}
+
+
+#if defined(DFU_DELTA_SUPPORT)
+/**@brief   Function for checking that the application in bank 0 can be the base of a delta
+ *          image.
+ *
+ * @details The delta image is kept at the top of bank 1 and the rebuilt image is written from the
+ *          start of bank 1, so the current application must be valid and fit in bank 0.
+ */
+static bool dfu_delta_base_valid(void)
+{
+    bootloader_settings_t settings;
+
+    bootloader_settings_get(&settings);
+
+    return (settings.bank_0 == BANK_VALID_APP) &&
+           (settings.bank_0_size <= DFU_IMAGE_MAX_SIZE_BANKED);
+}
+
+
+/**@brief   Function for preparing of flash before receiving a delta image.
+ *
+ * @details The pages holding the delta image and the bank 1 descriptor are erased. Bank 0 is left
+ *          untouched, it holds the application the delta image applies to. Upon erase complete a
+ *          callback will be done. See \ref dfu_bank_prepare_t for further details.
+ */
+static void dfu_prepare_func_delta(uint32_t image_size)
+{
+    uint32_t err_code;
+
+    m_storage_handle_delta          = m_storage_handle_app;
+    m_storage_handle_delta.block_id = DFU_DELTA_PATCH_ADDRESS(image_size);
+    mp_storage_handle_active        = &m_storage_handle_delta;
+
+    m_dfu_state = DFU_STATE_PREPARING;
+    err_code    = pstorage_raw_clear(&m_storage_handle_delta,
+                                     DFU_BANK_1_DESCRIPTOR_ADDRESS + CODE_PAGE_SIZE -
+                                     m_storage_handle_delta.block_id);
+    APP_ERROR_CHECK(err_code);
+}
+
+
+/**@brief   Function for handling behaviour when clear operation has completed for a delta image.
+ *
+ * @details Bank 0 still holds a valid application, so the bootloader settings are not changed.
+ */
+static void dfu_cleared_func_delta(void)
+{
+    PRINTF("Receiving delta image at 0x%x\n", (unsigned) m_storage_handle_delta.block_id);
+}
+
+
+/**@brief Function for activating received delta image.
+ *
+ *  @note This function will not rebuild the application. The bank 1 descriptor is written, and
+ *        the application is rebuilt from the delta image and copied to bank 0 by the bootloader
+ *        after system reset, with the SoftDevice disabled.
+ *
+ * @return NRF_SUCCESS on success. Error code otherwise.
+ */
+static uint32_t dfu_activate_delta(void)
+{
+    uint32_t            err_code;
+    pstorage_handle_t   storage_handle;
+    dfu_update_status_t update_status;
+
+    m_delta_descriptor.image_size         = m_image_size;
+    m_delta_descriptor.init_packet_length = m_init_packet_length;
+    m_delta_descriptor.flags              = DFU_BANK_1_FLAG_DELTA;
+    memcpy(m_delta_descriptor.init_packet, m_init_packet, m_init_packet_length);
+
+    storage_handle          = m_storage_handle_app;
+    storage_handle.block_id = DFU_BANK_1_DESCRIPTOR_ADDRESS;
+
+    // The magic number is stored last, the descriptor is ignored until it is complete.
+    err_code = pstorage_raw_store(&storage_handle,
+                                  (uint8_t *)&m_delta_descriptor,
+                                  offsetof(dfu_bank_1_descriptor_t, magic),
+                                  0);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    err_code = pstorage_raw_store(&storage_handle,
+                                  (uint8_t *)&m_delta_magic,
+                                  sizeof(m_delta_magic),
+                                  offsetof(dfu_bank_1_descriptor_t, magic));
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    memset(&update_status, 0, sizeof(dfu_update_status_t));
+    update_status.status_code = DFU_UPDATE_DELTA_COMPLETE;
+
+    bootloader_dfu_update_process(update_status);
+
+    return NRF_SUCCESS;
+}
+#endif
+
+
 /**@brief   Function for calculating storage offset for receiving SoftDevice image.
  *
  * @details When a new SoftDevice is received it will be temporary stored in flash before moved to
@@ -209,6 +796,7 @@ static uint32_t dfu_activate_sd(void)
     update_status.sd_size        = m_start_packet.sd_image_size;
     update_status.bl_size        = m_start_packet.bl_image_size;
     update_status.app_size       = m_start_packet.app_image_size;
+    update_status.app_version    = ((dfu_init_packet_t *)m_init_packet)->app_version;
 
     bootloader_dfu_update_process(update_status);
 
@@ -231,7 +819,8 @@ static uint32_t dfu_activate_app(void)
     memset(&update_status, 0, sizeof(dfu_update_status_t ));
     update_status.status_code = DFU_UPDATE_APP_COMPLETE;
     update_status.app_crc     = m_image_crc;
-    update_status.app_size    = m_start_packet.app_image_size;
+    update_status.app_size    = dfu_write_size_get();
+    update_status.app_version = ((dfu_init_packet_t *)m_init_packet)->app_version;
 
     bootloader_dfu_update_process(update_status);
 
@@ -290,8 +879,12 @@ uint32_t dfu_init(void)
     err_code = app_timer_start(m_dfu_timer_id, DFU_TIMEOUT_INTERVAL, NULL);
     APP_ERROR_CHECK(err_code);
 
-    m_data_received = 0;
-    m_dfu_state     = DFU_STATE_IDLE;
+    dfu_init_digest_start(&m_data_digest);
+    m_checkpoint_digest = m_data_digest;
+    m_checkpoint_saved  = 0;
+    m_resume_offset     = 0;
+    m_data_received     = 0;
+    m_dfu_state         = DFU_STATE_IDLE;
 
     return NRF_SUCCESS;
 }
@@ -322,6 +915,38 @@ uint32_t dfu_start_pkt_handle(dfu_update_packet_t * p_packet)
         return NRF_ERROR_NOT_SUPPORTED;
     }
 
+    if (IS_DELTA(m_start_packet))
+    {
+#if defined(DFU_DELTA_SUPPORT)
+        if (!IS_UPDATING_APP(m_start_packet) || !dfu_delta_base_valid())
+        {
+            return NRF_ERROR_NOT_SUPPORTED;
+        }
+
+        if (m_start_packet.app_image_size > DFU_BANK_1_IMAGE_MAX_SIZE)
+        {
+            return NRF_ERROR_DATA_SIZE;
+        }
+#else
+        // Written to bank 0, a delta image would replace the application it applies to.
+        return NRF_ERROR_NOT_SUPPORTED;
+#endif
+    }
+
+    if (IS_COMPRESSED(m_start_packet))
+    {
+#if defined(DFU_COMPRESSION_SUPPORT)
+        // Only application images are compressed, SoftDevice and bootloader sizes are needed to
+        // split a combined image.
+        if (!IS_UPDATING_APP(m_start_packet) || IS_DELTA(m_start_packet))
+        {
+            return NRF_ERROR_NOT_SUPPORTED;
+        }
+#else
+        return NRF_ERROR_NOT_SUPPORTED;
+#endif
+    }
+
     if (!(IS_WORD_SIZED(m_start_packet.sd_image_size) &&
           IS_WORD_SIZED(m_start_packet.bl_image_size) &&
           IS_WORD_SIZED(m_start_packet.app_image_size)))
@@ -358,6 +983,22 @@ uint32_t dfu_start_pkt_handle(dfu_update_packet_t * p_packet)
         m_functions.activate = dfu_activate_app;
     }
 
+#if defined(DFU_COMPRESSION_SUPPORT)
+    if (IS_COMPRESSED(m_start_packet))
+    {
+        m_functions.prepare  = dfu_prepare_func_lz;
+    }
+#endif
+
+#if defined(DFU_DELTA_SUPPORT)
+    if (IS_DELTA(m_start_packet))
+    {
+        m_functions.prepare  = dfu_prepare_func_delta;
+        m_functions.cleared  = dfu_cleared_func_delta;
+        m_functions.activate = dfu_activate_delta;
+    }
+#endif
+
     switch (m_dfu_state)
     {
         case DFU_STATE_IDLE:
@@ -367,6 +1008,18 @@ uint32_t dfu_start_pkt_handle(dfu_update_packet_t * p_packet)
             {
                 return err_code;
             }
+
+            if (IS_RESUMING(m_start_packet) && IS_UPDATING_APP(m_start_packet) &&
+                !IS_DELTA(m_start_packet) && !IS_COMPRESSED(m_start_packet))
+            {
+                m_resume_offset = dfu_resume_offset_get();
+            }
+
+            if (m_resume_offset != 0)
+            {
+                m_functions.prepare = dfu_prepare_func_app_resume;
+                m_functions.cleared = dfu_cleared_func_resume;
+            }
             m_functions.prepare(m_image_size);
 
             break;
@@ -428,6 +1081,14 @@ uint32_t dfu_data_pkt_handle(dfu_update_packet_t * p_packet)
 
             p_data = (uint32_t *)p_packet->params.data_packet.p_data_packet;
 
+#if defined(DFU_COMPRESSION_SUPPORT)
+            if (IS_COMPRESSED(m_start_packet))
+            {
+                // Decoded into page buffers, which are written to flash as they fill.
+                return dfu_lz_data_handle(p_data, data_length);
+            }
+#endif
+
             err_code = pstorage_raw_store(mp_storage_handle_active,
                                           (uint8_t *)p_data,
                                           data_length,
@@ -460,6 +1121,60 @@ uint32_t dfu_data_pkt_handle(dfu_update_packet_t * p_packet)
 }
 
 
+/**@brief   Function for checking the received init packet, one step per scheduled event.
+ *
+ * @details The signature check takes most of a second, so it is done in steps from the scheduler
+ *          instead of the BLE event handling. The result is given to the transport with a
+ *          STOP_INIT_PACKET callback.
+ *
+ * @param[in] p_event_data  Unused.
+ * @param[in] event_size    Unused.
+ */
+static void dfu_init_pkt_check(void * p_event_data, uint16_t event_size)
+{
+    uint32_t err_code;
+
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    if (m_dfu_state != DFU_STATE_CHECK_INIT_PKT)
+    {
+        // The transfer was reset while the check was queued.
+        return;
+    }
+
+    err_code = dfu_init_signature_check();
+    if (err_code == NRF_ERROR_BUSY)
+    {
+        err_code = app_sched_event_put(NULL, 0, dfu_init_pkt_check);
+        if (err_code == NRF_SUCCESS)
+        {
+            return;
+        }
+    }
+
+    if ((err_code == NRF_SUCCESS) && (m_resume_offset != 0))
+    {
+        err_code = dfu_resume_init_check();
+    }
+
+    if (err_code == NRF_SUCCESS)
+    {
+        m_dfu_state = DFU_STATE_RX_DATA_PKT;
+    }
+    else
+    {
+        m_init_packet_length = 0;
+        m_dfu_state          = DFU_STATE_RX_INIT_PKT;
+    }
+
+    if (m_data_pkt_cb != NULL)
+    {
+        m_data_pkt_cb(STOP_INIT_PACKET, err_code, NULL);
+    }
+}
+
+
 uint32_t dfu_init_pkt_complete(void)
 {
     uint32_t err_code = NRF_ERROR_INVALID_STATE;
@@ -476,9 +1191,17 @@ uint32_t dfu_init_pkt_complete(void)
         err_code = dfu_init_prevalidate(m_init_packet, m_init_packet_length);
         if (err_code == NRF_SUCCESS)
         {
-            m_dfu_state = DFU_STATE_RX_DATA_PKT;
+            // The rest of the check is scheduled, see dfu_init_pkt_check().
+            m_dfu_state = DFU_STATE_CHECK_INIT_PKT;
+
+            err_code = app_sched_event_put(NULL, 0, dfu_init_pkt_check);
+            if (err_code != NRF_SUCCESS)
+            {
+                m_dfu_state = DFU_STATE_RX_INIT_PKT;
+            }
         }
-        else
+
+        if (err_code != NRF_SUCCESS)
         {
             m_init_packet_length = 0;
         }
@@ -557,13 +1280,22 @@ uint32_t dfu_image_validate()
                 err_code = dfu_timer_restart();
                 if (err_code == NRF_SUCCESS)
                 {
-                    err_code = dfu_init_postvalidate((uint8_t *)mp_storage_handle_active->block_id,
-                                                     m_image_size);
+                    // The digest is complete once the last data packet has been written.
+                    if ((m_data_digest.length != dfu_write_size_get()) ||
+                        (m_data_digest.length == 0))
+                    {
+                        m_dfu_state = DFU_STATE_RX_DATA_PKT;
+                        return NRF_ERROR_BUSY;
+                    }
+
+                    err_code = dfu_init_postvalidate(&m_data_digest, m_data_digest.length);
                     if (err_code != NRF_SUCCESS)
                     {
                         return err_code;
                     }
 
+                    m_image_crc = m_data_digest.crc;
+
                     m_dfu_state = DFU_STATE_WAIT_4_ACTIVATE;
                 }
             }
@@ -602,6 +1334,36 @@ uint32_t dfu_image_activate()
 }
 
 
+uint32_t dfu_suspend(void)
+{
+    uint32_t err_code;
+
+    if ((m_dfu_state != DFU_STATE_RX_DATA_PKT) || (m_checkpoint_digest.length == 0))
+    {
+        // Nothing that could be resumed has been written yet.
+        return NRF_ERROR_INVALID_STATE;
+    }
+
+    err_code = app_timer_stop(m_dfu_timer_id);
+    APP_ERROR_CHECK(err_code);
+
+    if (m_checkpoint_digest.length != m_checkpoint_saved)
+    {
+        dfu_resume_checkpoint();
+    }
+
+    dfu_reset();
+
+    return NRF_SUCCESS;
+}
+
+
+uint32_t dfu_data_received_get(void)
+{
+    return m_data_received;
+}
+
+
 void dfu_reset(void)
 {
     dfu_update_status_t update_status;
@@ -781,6 +1543,71 @@ uint32_t dfu_bl_image_validate(void)
 }
 
 
+#if defined(DFU_DUAL_BANK_SUPPORT)
+uint32_t dfu_app_image_validate(dfu_bank_1_descriptor_t const * p_descriptor, uint16_t * p_image_crc)
+{
+    uint32_t          err_code;
+    uint32_t          image_start;
+    dfu_init_digest_t digest;
+
+    if ((p_descriptor->image_size == 0)                         ||
+        (p_descriptor->image_size > DFU_BANK_1_IMAGE_MAX_SIZE)  ||
+        (!IS_WORD_SIZED(p_descriptor->image_size))              ||
+        (p_descriptor->init_packet_length > sizeof(m_init_packet)))
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    // The application is not trusted to have checked the image, so the init packet is validated
+    // here exactly as if it had been received by the bootloader.
+    memcpy(m_init_packet, p_descriptor->init_packet, p_descriptor->init_packet_length);
+    m_init_packet_length = p_descriptor->init_packet_length;
+
+    err_code = dfu_init_prevalidate(m_init_packet, m_init_packet_length);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // Nothing else runs yet, so the signature is checked in one go. A running watchdog is fed
+    // between the steps.
+    do
+    {
+        bootloader_wdt_feed();
+        err_code = dfu_init_signature_check();
+    } while (err_code == NRF_ERROR_BUSY);
+
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    // The image hash below reads all of bank 1, most of a second on the nRF51.
+    bootloader_wdt_feed();
+
+    // A delta image is validated here, the image rebuilt from it is checked against its header.
+    image_start = DFU_BANK_1_REGION_START;
+    if (p_descriptor->flags & DFU_BANK_1_FLAG_DELTA)
+    {
+        image_start = DFU_DELTA_PATCH_ADDRESS(p_descriptor->image_size);
+    }
+
+    dfu_init_digest_start(&digest);
+    dfu_init_digest_update(&digest, (uint8_t *)image_start, p_descriptor->image_size);
+
+    err_code = dfu_init_postvalidate(&digest, p_descriptor->image_size);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    *p_image_crc = digest.crc;
+
+    return NRF_SUCCESS;
+}
+#endif
+
+
 uint32_t dfu_sd_image_validate(void)
 {
     bootloader_settings_t bootloader_settings;
@@ -247,6 +247,22 @@ static void dfu_cb_handler(uint32_t packet, uint32_t result, uint8_t * p_data)
             APP_ERROR_CHECK(err_code);
             break;
 
+        case STOP_INIT_PACKET:
+            if (result == NRF_SUCCESS)
+            {
+                // Non-zero when an interrupted transfer is resumed. The DFU Controller reads
+                // it with the Report Received Image Size procedure.
+                m_num_of_firmware_bytes_rcvd = dfu_data_received_get();
+            }
+
+            resp_val = nrf_err_code_translate(result, BLE_DFU_INIT_PROCEDURE);
+
+            err_code = ble_dfu_response_send(&m_dfu,
+                                             BLE_DFU_INIT_PROCEDURE,
+                                             resp_val);
+            APP_ERROR_CHECK(err_code);
+            break;
+
         default:
             // ignore.
             break;
@@ -592,13 +608,17 @@ static void on_dfu_evt(ble_dfu_t * p_dfu, ble_dfu_evt_t * p_evt)
             m_pkt_type = PKT_TYPE_INIT;
             if ((uint8_t)p_evt->evt.ble_dfu_pkt_write.p_data[0] == DFU_INIT_COMPLETE)
             {
+                // On success the response is sent once the init packet has been checked, see
+                // dfu_cb_handler().
                 err_code = dfu_init_pkt_complete();
+                if (err_code != NRF_SUCCESS)
+                {
+                    // Translate the err_code returned by the above function to DFU Response Value.
+                    resp_val = nrf_err_code_translate(err_code, BLE_DFU_INIT_PROCEDURE);
 
-                // Translate the err_code returned by the above function to DFU Response Value.
-                resp_val = nrf_err_code_translate(err_code, BLE_DFU_INIT_PROCEDURE);
-
-                err_code = ble_dfu_response_send(p_dfu, BLE_DFU_INIT_PROCEDURE, resp_val);
-                APP_ERROR_CHECK(err_code);
+                    err_code = ble_dfu_response_send(p_dfu, BLE_DFU_INIT_PROCEDURE, resp_val);
+                    APP_ERROR_CHECK(err_code);
+                }
             }
             break;
 
@@ -789,8 +809,17 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
                 // The Disconnected event is because of an external event. (Link loss or
                 // disconnect triggered by the DFU Controller before the firmware update was
                 // complete).
-                // Restart advertising so that the DFU Controller can reconnect if possible.
-                advertising_start();
+                // An interrupted image transfer is suspended, which resets the system so the
+                // DFU Controller can reconnect and resume it. Otherwise restart advertising so
+                // that the DFU Controller can reconnect if possible.
+                if (dfu_suspend() == NRF_SUCCESS)
+                {
+                    m_tear_down_in_progress = true;
+                }
+                else
+                {
+                    advertising_start();
+                }
             }
 
             m_conn_handle = BLE_CONN_HANDLE_INVALID;
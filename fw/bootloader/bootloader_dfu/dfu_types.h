@@ -49,11 +49,12 @@ typedef struct
 
 #define SOFTDEVICE_REGION_START         0x00001000                                                      /**< This field should correspond to start address of the bootloader, found in UICR.RESERVED, 0x10001014, register. This value is used for sanity check, so the bootloader will fail immediately if this value differs from runtime value. The value is used to determine max application size for updating. */
 #define BOOTLOADER_REGION_START         0x00035000                                                      /**< This field should correspond to start address of the bootloader, found in UICR.RESERVED, 0x10001014, register. This value is used for sanity check, so the bootloader will fail immediately if this value differs from runtime value. The value is used to determine max application size for updating. */
-#define BOOTLOADER_SETTINGS_ADDRESS     0x0003FC00                                                      /**< The field specifies the page location of the bootloader settings address. */
+#define BOOTLOADER_SETTINGS_ADDRESS     0x0003F800                                                      /**< The field specifies the page location of the bootloader settings journal. */
+#define BOOTLOADER_SETTINGS_PAGE_COUNT  2                                                               /**< Number of flash pages of the bootloader settings journal, the last pages of flash. */
 
 #define DFU_REGION_TOTAL_SIZE           (BOOTLOADER_REGION_START - CODE_REGION_1_START)                 /**< Total size of the region between SD and Bootloader. */
 
-#define DFU_APP_DATA_RESERVED           0x0000                                                          /**< Size of Application Data that must be preserved between application updates. This value must be a multiple of page size. Page size is 0x400 (1024d) bytes, thus this value must be 0x0000, 0x0400, 0x0800, 0x0C00, 0x1000, etc. */
+#define DFU_APP_DATA_RESERVED           0x1000                                                          /**< Size of Application Data that must be preserved between application updates. This value must be a multiple of page size. Page size is 0x400 (1024d) bytes, thus this value must be 0x0000, 0x0400, 0x0800, 0x0C00, 0x1000, etc. Holds the pstorage pages of the application, see the application pstorage_platform.h. */
 #define DFU_BANK_PADDING                (DFU_APP_DATA_RESERVED % (2 * CODE_PAGE_SIZE))                  /**< Padding to ensure that image size banked is always page sized. */
 #define DFU_IMAGE_MAX_SIZE_FULL         (DFU_REGION_TOTAL_SIZE - DFU_APP_DATA_RESERVED)                 /**< Maximum size of an application, excluding save data from the application. */
 #define DFU_IMAGE_MAX_SIZE_BANKED       ((DFU_REGION_TOTAL_SIZE - \
@@ -64,6 +65,10 @@ typedef struct
 
 #define DFU_BANK_0_REGION_START         CODE_REGION_1_START                                             /**< Bank 0 region start. */
 #define DFU_BANK_1_REGION_START         (DFU_BANK_0_REGION_START + DFU_IMAGE_MAX_SIZE_BANKED)           /**< Bank 1 region start. */
+#define DFU_BANK_1_IMAGE_MAX_SIZE       (DFU_IMAGE_MAX_SIZE_BANKED - CODE_PAGE_SIZE)                    /**< Maximum size of an application received into bank 1 by the running application. The last page of bank 1 holds the bank 1 descriptor. */
+#define DFU_BANK_1_DESCRIPTOR_ADDRESS   (DFU_BANK_1_REGION_START + DFU_BANK_1_IMAGE_MAX_SIZE)           /**< Address of the descriptor of the application received into bank 1. */
+#define DFU_DELTA_PATCH_ADDRESS(SIZE)   (DFU_BANK_1_DESCRIPTOR_ADDRESS - \
+                                         (((SIZE) + CODE_PAGE_SIZE - 1) & ~(CODE_PAGE_SIZE - 1)))       /**< Address of a delta image of SIZE bytes, kept in the pages just below the bank 1 descriptor so the rebuilt image can be written from the start of bank 1. */
 
 #define CODE_PAGE_SIZE                  0x0400                                                          /**< Size of a flash codepage. Used for size of the reserved flash space in the bootloader region. Will be runtime checked against NRF_UICR->CODEPAGESIZE to ensure the region is correct. */
 #define EMPTY_FLASH_MASK                0xFFFFFFFF                                                      /**< Bit mask that defines an empty address in flash. */
@@ -78,6 +83,13 @@ typedef struct
 #define DFU_UPDATE_SD                   0x01                                                            /**< Bit field indicating update of SoftDevice is ongoing. */
 #define DFU_UPDATE_BL                   0x02                                                            /**< Bit field indicating update of bootloader is ongoing. */
 #define DFU_UPDATE_APP                  0x04                                                            /**< Bit field indicating update of application is ongoing. */
+#define DFU_UPDATE_RESUME               0x08                                                            /**< Bit field requesting that an interrupted transfer of the same image is resumed instead of restarted. */
+#define DFU_UPDATE_DELTA                0x10                                                            /**< Bit field indicating that the application image is a delta image against the application in bank 0. */
+#define DFU_UPDATE_COMPRESSED           0x20                                                            /**< Bit field indicating that the application image is compressed. The image size is the size transferred, the init packet is for the decompressed image. */
+
+#define DFU_BANK_1_DESCRIPTOR_MAGIC     0x31424644                                                      /**< Magic number of a complete bank 1 descriptor, "DFB1". */
+#define DFU_BANK_1_INIT_PACKET_MAX      128                                                             /**< Maximum length of the init packet kept in the bank 1 descriptor. */
+#define DFU_BANK_1_FLAG_DELTA           0x01                                                            /**< Bank 1 descriptor flag, the image is a delta image stored at DFU_DELTA_PATCH_ADDRESS. */
 
 #define DFU_INIT_RX                     0x00                                                            /**< Op Code identifies for receiving init packet. */
 #define DFU_INIT_COMPLETE               0x01                                                            /**< Op Code identifies for transmission complete of init packet. */
@@ -115,6 +127,24 @@ typedef struct
     } params;
 } dfu_update_packet_t;
 
+/**@brief Structure holding the descriptor of an application received into bank 1 while the
+ *        current application keeps running.
+ *
+ * @details The descriptor is written to the last page of bank 1 once the image has been received
+ *          and validated by the application. The magic number is written last, so a descriptor is
+ *          only acted upon if it is complete. On reset the bootloader validates bank 1 against the
+ *          init packet again before it is copied to bank 0, and erases the descriptor when done.
+ */
+typedef struct
+{
+    uint32_t image_size;                                                                                /**< Size of the application image in bank 1. */
+    uint32_t init_packet_length;                                                                        /**< Length of the init packet received with the image. */
+    uint32_t flags;                                                                                     /**< DFU_BANK_1_FLAG bits describing the image. */
+    uint8_t  init_packet[DFU_BANK_1_INIT_PACKET_MAX];                                                   /**< Init packet received with the image. */
+    uint32_t magic;                                                                                     /**< DFU_BANK_1_DESCRIPTOR_MAGIC when the descriptor is complete. */
+    uint32_t delta_applied;                                                                             /**< Left erased when the descriptor is written. Set by the bootloader to the size of the image rebuilt from a delta image into bank 1, so the delta is not applied again against a partly overwritten bank 0. */
+} dfu_bank_1_descriptor_t;
+
 /**@brief DFU status error codes.
 */
 typedef enum
@@ -125,7 +155,9 @@ typedef enum
     DFU_UPDATE_BOOT_COMPLETE,                                                                           /**< Status update complete.*/
     DFU_BANK_0_ERASED,                                                                                  /**< Status bank 0 erased.*/
     DFU_TIMEOUT,                                                                                        /**< Status timeout.*/
-    DFU_RESET                                                                                           /**< Status Reset to indicate current update procedure has been aborted and system should reset. */
+    DFU_RESET,                                                                                          /**< Status Reset to indicate current update procedure has been aborted and system should reset. */
+    DFU_UPDATE_CHECKPOINT,                                                                              /**< Status part of the image has been committed to flash. The resume point must be recorded so an interrupted transfer can be resumed. */
+    DFU_UPDATE_DELTA_COMPLETE                                                                           /**< Status delta image received and its bank 1 descriptor written. Bank 0 is untouched, the image is rebuilt and installed by the bootloader on reset. */
 } dfu_update_status_code_t;
 
 /**@brief Structure holding DFU complete event.
@@ -138,6 +170,12 @@ typedef struct
     uint32_t                 bl_size;                                                                   /**< Size of the recieved BootLoader. */
     uint32_t                 app_size;                                                                  /**< Size of the recieved Application. */
     uint32_t                 sd_image_start;                                                            /**< Location in flash where the received SoftDevice image is stored. */
+    uint32_t                 resume_size;                                                               /**< Total size of the image being received. Used with DFU_UPDATE_CHECKPOINT. */
+    uint32_t                 resume_offset;                                                             /**< Number of image bytes committed to flash. Used with DFU_UPDATE_CHECKPOINT. */
+    uint16_t                 resume_crc;                                                                /**< Running CRC of the committed image bytes. Used with DFU_UPDATE_CHECKPOINT. */
+    uint16_t                 resume_init_crc;                                                           /**< CRC of the init packet, identifying the image being received. Used with DFU_UPDATE_CHECKPOINT. */
+    uint32_t const *         p_resume_hash;                                                             /**< Eight word hash state of the committed image bytes, NULL if images are not hashed. Used with DFU_UPDATE_CHECKPOINT. */
+    uint32_t                 app_version;                                                               /**< Application version from the init packet. Used with DFU_UPDATE_APP_COMPLETE and DFU_UPDATE_SD_COMPLETE. */
 } dfu_update_status_t;
 
 /**@brief Update complete handler type. */
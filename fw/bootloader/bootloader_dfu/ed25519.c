@@ -0,0 +1,1043 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  ed25519.c  -- Ed25519 (RFC 8032) signatures for signed DFU images.
+ *
+ *  Field elements are 16 limbs of 16 bits, carried after every operation,
+ *  so a limb product plus the running sum and carry fits 32 bits and a
+ *  field multiply is 256 MULS-and-add steps with no 64 bit arithmetic on
+ *  the Cortex-M0, about 3500 cycles at 16MHz against 20000 for the 64 bit
+ *  limbs of TweetNaCl, which this replaces.  Inversions use the addition
+ *  chains of ref10 (public domain): 254 squares and 11 multiplies.
+ *
+ *  Verification is variable time, as it handles public data only.  It
+ *  computes [s]B - [h]A in one pass over sliding windows of both scalars
+ *  (ref10's double scalar multiply): 253 doublings and about 86 additions
+ *  of odd multiples, those of B from a table in flash.  It runs in steps
+ *  of ED25519_VERIFY_STEP_BITS bits, see ed25519.h and gcc/dfu_bench.c.
+ *
+ *  SHA-512, needed by the signature scheme itself, is kept private to
+ *  this file.  Image hashing uses SHA-256, see sha256.c.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "ed25519.h"
+
+typedef uint16_t gf[16];
+
+static const gf gf0;
+static const gf gf1 = { 1 };
+
+#if defined(ED25519_MUL_COUNT)
+uint32_t ed25519_mul_count;
+uint32_t ed25519_add_count;
+#endif
+
+/* Curve constant d, 2*d and sqrt(-1), in 16 bit limbs. */
+static const gf ed_d = {
+    0x78a3, 0x1359, 0x4dca, 0x75eb, 0xd8ab, 0x4141, 0x0a4d, 0x0070,
+    0xe898, 0x7779, 0x4079, 0x8cc7, 0xfe73, 0x2b6f, 0x6cee, 0x5203,
+};
+static const gf ed_d2 = {
+    0xf159, 0x26b2, 0x9b94, 0xebd6, 0xb156, 0x8283, 0x149a, 0x00e0,
+    0xd130, 0xeef3, 0x80f2, 0x198e, 0xfce7, 0x56df, 0xd9dc, 0x2406,
+};
+static const gf ed_i = {
+    0xa0b0, 0x4a0e, 0x1b27, 0xc4ee, 0xe478, 0xad2f, 0x1806, 0x2f43,
+    0xd7a7, 0x3dfb, 0x0099, 0x2b4d, 0xdf0b, 0x4fc1, 0x2480, 0x2b83,
+};
+
+/* 4p in limbs of 17 bits, each above any carried limb, for subtraction. */
+static const uint32_t ed_4p[16] = {
+    0x1ffb4, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe,
+    0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe, 0x1fffe,
+};
+
+/* B, 3B, 5B, ... 15B as (y + x, y - x, 2dxy), for the sliding window of s. */
+static const gf ed_bi[8][3] = {
+    {   /* 1B */
+        { 0x3b85, 0xf58c, 0x93c6, 0x2fbc, 0x0e19, 0xfb8c, 0x2dc6, 0xcf93,
+          0x42c2, 0x643d, 0x4898, 0x270b, 0xba65, 0x33d4, 0x9d3a, 0x07cf },
+        { 0x913e, 0xd740, 0x3905, 0x9d10, 0xbeb3, 0xd140, 0x9f05, 0xfd39,
+          0x8a09, 0x688f, 0x8434, 0xa5c1, 0x1267, 0x98f8, 0x2f92, 0x44fd },
+        { 0xaa68, 0x877a, 0x1205, 0xabc9, 0xc49e, 0xccaa, 0xe823, 0x26d9,
+          0x598c, 0xdd43, 0x7dcb, 0x5a1b, 0x65a8, 0x9f0c, 0x7b68, 0x6f11 },
+    },
+    {   /* 3B */
+        { 0x9730, 0x4cee, 0xb0a8, 0xaf25, 0x4b8a, 0xe886, 0x8430, 0x025a,
+          0x6732, 0x9f01, 0x5002, 0xc11b, 0xf8f4, 0x9a80, 0x4e1b, 0x7a16 },
+        { 0xd265, 0xa4fc, 0x1fe8, 0x5661, 0xba7d, 0xe5c1, 0x53fd, 0x3bd3,
+          0xd6bd, 0x214b, 0xf31a, 0x8131, 0xda62, 0x555b, 0x1587, 0x2ab9 },
+        { 0xd889, 0x0dd0, 0x933f, 0x14ae, 0xda62, 0x1c35, 0x2322, 0x5894,
+          0xdb4c, 0x8cf2, 0xe545, 0xd170, 0xb4c6, 0x12b9, 0x26af, 0x5a28 },
+    },
+    {   /* 5B */
+        { 0xbb33, 0x08a5, 0xbc44, 0xa212, 0xed02, 0xc75e, 0x48c3, 0x8d50,
+          0xec44, 0x5abf, 0xeb0c, 0xdd1b, 0x06eb, 0x46e2, 0xccf1, 0x2945 },
+        { 0xd6ba, 0xa447, 0x82c3, 0x7f91, 0x29b7, 0x4b27, 0x14d1, 0xd500,
+          0xa087, 0xb864, 0xf11c, 0xe33c, 0x55f3, 0xeb1b, 0x7e73, 0x154a },
+        { 0x8285, 0x812a, 0xdbf1, 0xbcbb, 0xd1fc, 0xd0bd, 0x0807, 0x270e,
+          0xa72d, 0x1bbd, 0x670b, 0xb41b, 0xb69a, 0x6b3b, 0xbe69, 0x43aa },
+    },
+    {   /* 7B */
+        { 0xa3bf, 0x944e, 0x5cd0, 0x6b1a, 0xc0d2, 0xb39d, 0x353a, 0x7470,
+          0x2e49, 0x2854, 0x5282, 0x71b2, 0x927e, 0x283c, 0xea69, 0x461b },
+        { 0x21b1, 0xaa32, 0x2c9a, 0xba6f, 0x23a7, 0x3bba, 0x2153, 0x6ca0,
+          0x2c3a, 0x9219, 0x764f, 0x9dea, 0x17e0, 0x2e53, 0xdd5d, 0x1d6e },
+        { 0xb3a2, 0x01b8, 0x6dc8, 0xf183, 0xa49a, 0x053e, 0x5f47, 0xb303,
+          0xadf3, 0x5877, 0x41ba, 0x529c, 0x90a7, 0x6a0f, 0xbb1c, 0x7a9f },
+    },
+    {   /* 9B */
+        { 0x632f, 0xa6a8, 0x678a, 0x9b2e, 0x46c5, 0x51bc, 0x9e6f, 0xa650,
+          0xf5b5, 0xc686, 0x33c9, 0xceb2, 0x7f59, 0x8add, 0xed33, 0x34b9 },
+        { 0x8064, 0x039d, 0x217e, 0xf36e, 0x419b, 0xf520, 0x81b6, 0x98a0,
+          0xb044, 0xe75e, 0xc608, 0x96cb, 0x9c8f, 0xfadc, 0x5a51, 0x49c0 },
+        { 0xaf1b, 0x9045, 0xe8bf, 0x06b4, 0xd22f, 0xa719, 0x83e8, 0xe2ff,
+          0xcf16, 0x93d4, 0xfc29, 0xaaf6, 0x8b06, 0x1b00, 0x7202, 0x73c1 },
+    },
+    {   /* 11B */
+        { 0x2ade, 0x8a80, 0x0084, 0x2fbf, 0x2e27, 0x0230, 0xfecf, 0xe5d9,
+          0x3406, 0x1770, 0x8471, 0x113e, 0x8faf, 0x546d, 0xaae2, 0x4275 },
+        { 0x4348, 0x4986, 0x5b02, 0x315f, 0x8381, 0x7708, 0xb369, 0x3ed6,
+          0xeb95, 0x6a8d, 0x7555, 0xa3a0, 0xc77f, 0x29d5, 0x5980, 0x18ab },
+        { 0x89e9, 0xfd60, 0x2cc5, 0xd82b, 0xe4a4, 0x3282, 0xb4a1, 0x031e,
+          0x8622, 0xb51a, 0x1199, 0x4431, 0xf948, 0xb53d, 0x5522, 0x3dc6 },
+    },
+    {   /* 13B */
+        { 0x7f6d, 0xa200, 0xc222, 0xbf70, 0xdedb, 0xb5bc, 0xb39a, 0xbf84,
+          0xba07, 0xfb07, 0x0e12, 0x537a, 0xf241, 0xc346, 0xd7ee, 0x234f },
+        { 0xbf93, 0x327f, 0x013b, 0x506f, 0x6f6b, 0x9b77, 0xebc9, 0xaefc,
+          0x5968, 0xaaad, 0xb232, 0x9d12, 0x24a7, 0x1760, 0x882d, 0x0267 },
+        { 0xa378, 0x732e, 0xa119, 0x5360, 0xd471, 0xdf8d, 0xe6b1, 0x2437,
+          0xe533, 0x91a7, 0x37f8, 0xa2ef, 0x7863, 0xaa09, 0xa6fd, 0x497b },
+    },
+    {   /* 15B */
+        { 0xeaa0, 0x13cf, 0xcc03, 0x24ce, 0x246d, 0x189c, 0xc28d, 0x8648,
+          0xd4d0, 0xc1f2, 0xbdfa, 0x2dbd, 0xe72b, 0xf12d, 0x2917, 0x61e2 },
+        { 0xcf0b, 0x468c, 0xcd86, 0x040b, 0x10d6, 0x2a99, 0x9ba4, 0xd382,
+          0x5192, 0x07b2, 0x3008, 0x7508, 0x5ebf, 0x18d0, 0xcd42, 0x43b5 },
+        { 0xb516, 0x9bd0, 0x762f, 0x5d9a, 0xdeee, 0x373f, 0xaf4e, 0xeb38,
+          0x4270, 0x93d6, 0x5a7d, 0x032e, 0xd842, 0x0ae4, 0x6121, 0x511d },
+    },
+};
+
+/* Group order L = 2^252 + 27742317777372353535851937790883648493, little-endian. */
+static const int64_t ed_l[32] = {
+    0xed, 0xd3, 0xf5, 0x5c, 0x1a, 0x63, 0x12, 0x58,
+    0xd6, 0x9c, 0xf7, 0xa2, 0xde, 0xf9, 0xde, 0x14,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10,
+};
+
+/*---------------------------------------------------------------------------*/
+/*  SHA-512                                                                  */
+/*---------------------------------------------------------------------------*/
+
+#define SHA512_BLOCK_SIZE    128
+
+typedef struct {
+    uint64_t state[8];
+    uint32_t length;
+    uint8_t  buffer[SHA512_BLOCK_SIZE];
+} sha512_ctx_t;
+
+#define ROR64(x, n)  (((x) >> (n)) | ((x) << (64 - (n))))
+
+static const uint64_t sha512_k[80] = {
+    0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+    0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+    0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+    0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+    0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+    0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+    0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+    0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+    0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+    0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+    0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+    0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+    0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+    0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+    0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+    0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+    0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+    0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+    0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+    0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+static const uint64_t sha512_iv[8] = {
+    0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+    0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+static void sha512_block(uint64_t * state, const uint8_t * p_block)
+{
+    uint64_t w[16];
+    uint64_t v[8];
+    uint64_t t1;
+    uint64_t t2;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = 0;
+        for (j = 0; j < 8; j++) {
+            w[i] = (w[i] << 8) | p_block[8 * i + j];
+        }
+    }
+
+    memcpy(v, state, sizeof(v));
+
+    for (i = 0; i < 80; i++) {
+        if (i >= 16) {
+            t1 = w[(i - 2) & 15];
+            t2 = w[(i - 15) & 15];
+            w[i & 15] += (ROR64(t1, 19) ^ ROR64(t1, 61) ^ (t1 >> 6)) +
+                         w[(i - 7) & 15] +
+                         (ROR64(t2, 1) ^ ROR64(t2, 8) ^ (t2 >> 7));
+        }
+
+        t1 = v[7] + (ROR64(v[4], 14) ^ ROR64(v[4], 18) ^ ROR64(v[4], 41)) +
+             ((v[4] & v[5]) ^ (~v[4] & v[6])) + sha512_k[i] + w[i & 15];
+        t2 = (ROR64(v[0], 28) ^ ROR64(v[0], 34) ^ ROR64(v[0], 39)) +
+             ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = v[3] + t1;
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = t1 + t2;
+    }
+
+    for (i = 0; i < 8; i++) {
+        state[i] += v[i];
+    }
+}
+
+static void sha512_init(sha512_ctx_t * p_ctx)
+{
+    memcpy(p_ctx->state, sha512_iv, sizeof(p_ctx->state));
+    p_ctx->length = 0;
+}
+
+static void sha512_update(sha512_ctx_t * p_ctx, const uint8_t * p_data, uint32_t size)
+{
+    uint32_t used;
+
+    while (size > 0) {
+        used = p_ctx->length & (SHA512_BLOCK_SIZE - 1);
+        p_ctx->buffer[used] = *p_data++;
+        p_ctx->length++;
+        size--;
+
+        if (used == SHA512_BLOCK_SIZE - 1) {
+            sha512_block(p_ctx->state, p_ctx->buffer);
+        }
+    }
+}
+
+static void sha512_final(sha512_ctx_t * p_ctx, uint8_t * p_digest)
+{
+    uint32_t used = p_ctx->length & (SHA512_BLOCK_SIZE - 1);
+    uint32_t bits = p_ctx->length << 3;
+    uint32_t i;
+
+    p_ctx->buffer[used++] = 0x80;
+
+    if (used > SHA512_BLOCK_SIZE - 16) {
+        memset(&p_ctx->buffer[used], 0, SHA512_BLOCK_SIZE - used);
+        sha512_block(p_ctx->state, p_ctx->buffer);
+        used = 0;
+    }
+    memset(&p_ctx->buffer[used], 0, SHA512_BLOCK_SIZE - used);
+
+    /* Only short messages are signed; the length fits in 32 bits. */
+    p_ctx->buffer[124] = (uint8_t)(bits >> 24);
+    p_ctx->buffer[125] = (uint8_t)(bits >> 16);
+    p_ctx->buffer[126] = (uint8_t)(bits >> 8);
+    p_ctx->buffer[127] = (uint8_t)(bits);
+    sha512_block(p_ctx->state, p_ctx->buffer);
+
+    for (i = 0; i < 64; i++) {
+        p_digest[i] = (uint8_t)(p_ctx->state[i / 8] >> (56 - 8 * (i % 8)));
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Field arithmetic modulo 2^255 - 19                                       */
+/*---------------------------------------------------------------------------*/
+
+static void set25519(gf r, const gf a)
+{
+    memcpy(r, a, sizeof(gf));
+}
+
+/*
+ *  Carry limbs of up to 24 bits into a field element, folding the top
+ *  carry back in as 38.  Two passes leave every limb below 2^16.
+ */
+static void car25519(gf o, uint32_t * t)
+{
+    uint32_t c = 0;
+    int      i;
+    int      j;
+
+    for (j = 0; j < 2; j++) {
+        for (i = 0; i < 16; i++) {
+            t[i] += c;
+            c = t[i] >> 16;
+            t[i] &= 0xffff;
+        }
+        c *= 38;
+    }
+    t[0] += c;
+
+    for (i = 0; i < 16; i++) {
+        o[i] = (uint16_t) t[i];
+    }
+}
+
+
+/*
+ *  Write the fully reduced element as 32 little-endian bytes.  A carried
+ *  element is below 2^256 = 2p + 38, so p is taken off at most twice.
+ */
+static void pack25519(uint8_t * o, const gf n)
+{
+    uint32_t m[16];
+    uint16_t mask;
+    gf       t;
+    int      i;
+    int      j;
+
+    set25519(t, n);
+
+    for (j = 0; j < 2; j++) {
+        m[0] = t[0] - 0xffed;
+        for (i = 1; i < 15; i++) {
+            m[i] = t[i] - 0xffff - ((m[i - 1] >> 16) & 1);
+            m[i - 1] &= 0xffff;
+        }
+        m[15] = t[15] - 0x7fff - ((m[14] >> 16) & 1);
+        m[14] &= 0xffff;
+
+        /* Keep t if taking off p borrowed. */
+        mask = (uint16_t)(((m[15] >> 16) & 1) - 1);
+        for (i = 0; i < 16; i++) {
+            t[i] = (t[i] & ~mask) | ((uint16_t) m[i] & mask);
+        }
+    }
+
+    for (i = 0; i < 16; i++) {
+        o[2 * i]     = (uint8_t)(t[i]);
+        o[2 * i + 1] = (uint8_t)(t[i] >> 8);
+    }
+}
+
+static int neq25519(const gf a, const gf b)
+{
+    uint8_t c[32];
+    uint8_t d[32];
+
+    pack25519(c, a);
+    pack25519(d, b);
+    return memcmp(c, d, 32) != 0;
+}
+
+static uint8_t par25519(const gf a)
+{
+    uint8_t d[32];
+
+    pack25519(d, a);
+    return d[0] & 1;
+}
+
+static void unpack25519(gf o, const uint8_t * n)
+{
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        o[i] = n[2 * i] | (uint16_t)(n[2 * i + 1] << 8);
+    }
+    o[15] &= 0x7fff;
+}
+
+static void fe_add(gf o, const gf a, const gf b)
+{
+    uint32_t t[16];
+    int      i;
+
+#if defined(ED25519_MUL_COUNT)
+    ed25519_add_count++;
+#endif
+
+    for (i = 0; i < 16; i++) {
+        t[i] = (uint32_t) a[i] + b[i];
+    }
+    car25519(o, t);
+}
+
+static void fe_sub(gf o, const gf a, const gf b)
+{
+    uint32_t t[16];
+    int      i;
+
+#if defined(ED25519_MUL_COUNT)
+    ed25519_add_count++;
+#endif
+
+    for (i = 0; i < 16; i++) {
+        t[i] = a[i] + ed_4p[i] - b[i];
+    }
+    car25519(o, t);
+}
+
+#define MULADD(j)                               \
+    do {                                        \
+        c += ai * b[j] + t[i + j];              \
+        t[i + j] = (uint16_t) c;                \
+        c >>= 16;                               \
+    } while (0)
+
+/*
+ *  o = a * b, row by row.  With 16 bit limbs a * b[j] + t[i + j] + c is
+ *  below 2^32, so a row is 16 multiply-adds in 32 bits.  The upper half
+ *  of the product is folded back in as 38 * 2^256 = 2^256 * 2^255 / p.
+ */
+static void fe_mul(gf o, const gf a, const gf b)
+{
+    uint16_t t[32];
+    uint32_t u[16];
+    uint32_t ai;
+    uint32_t c;
+    int      i;
+
+#if defined(ED25519_MUL_COUNT)
+    ed25519_mul_count++;
+#endif
+
+    memset(t, 0, sizeof(t));
+
+    for (i = 0; i < 16; i++) {
+        ai = a[i];
+        c  = 0;
+        MULADD(0);  MULADD(1);  MULADD(2);  MULADD(3);
+        MULADD(4);  MULADD(5);  MULADD(6);  MULADD(7);
+        MULADD(8);  MULADD(9);  MULADD(10); MULADD(11);
+        MULADD(12); MULADD(13); MULADD(14); MULADD(15);
+        t[i + 16] = (uint16_t) c;
+    }
+
+    for (i = 0; i < 16; i++) {
+        u[i] = t[i] + 38 * (uint32_t) t[i + 16];
+    }
+    car25519(o, u);
+}
+
+static void fe_sq(gf o, const gf a)
+{
+    fe_mul(o, a, a);
+}
+
+/*
+ *  o = a^(2^n), n > 0.
+ */
+static void fe_sqn(gf o, const gf a, int n)
+{
+    fe_sq(o, a);
+    while (--n > 0) {
+        fe_sq(o, o);
+    }
+}
+
+/*
+ *  o = z^(p - 2) = 1/z.  The chain builds z^(2^k - 1) for k = 5, 10,
+ *  20, 40, 50, 100, 200 and 250.
+ */
+static void inv25519(gf o, const gf z)
+{
+    gf t0;
+    gf t1;
+    gf t2;
+    gf t3;
+
+    fe_sq(t0, z);               /* 2 */
+    fe_sqn(t1, t0, 2);          /* 8 */
+    fe_mul(t1, z, t1);          /* 9 */
+    fe_mul(t0, t0, t1);         /* 11 */
+    fe_sq(t2, t0);              /* 22 */
+    fe_mul(t1, t1, t2);         /* 2^5 - 1 */
+    fe_sqn(t2, t1, 5);
+    fe_mul(t1, t2, t1);         /* 2^10 - 1 */
+    fe_sqn(t2, t1, 10);
+    fe_mul(t2, t2, t1);         /* 2^20 - 1 */
+    fe_sqn(t3, t2, 20);
+    fe_mul(t2, t3, t2);         /* 2^40 - 1 */
+    fe_sqn(t2, t2, 10);
+    fe_mul(t1, t2, t1);         /* 2^50 - 1 */
+    fe_sqn(t2, t1, 50);
+    fe_mul(t2, t2, t1);         /* 2^100 - 1 */
+    fe_sqn(t3, t2, 100);
+    fe_mul(t2, t3, t2);         /* 2^200 - 1 */
+    fe_sqn(t2, t2, 50);
+    fe_mul(t1, t2, t1);         /* 2^250 - 1 */
+    fe_sqn(t1, t1, 5);          /* 2^255 - 2^5 */
+    fe_mul(o, t1, t0);          /* 2^255 - 21 */
+}
+
+/*
+ *  o = z^((p - 5) / 8) = z^(2^252 - 3), for the square root in point
+ *  decoding.
+ */
+static void pow2523(gf o, const gf z)
+{
+    gf t0;
+    gf t1;
+    gf t2;
+
+    fe_sq(t0, z);               /* 2 */
+    fe_sqn(t1, t0, 2);          /* 8 */
+    fe_mul(t1, z, t1);          /* 9 */
+    fe_mul(t0, t0, t1);         /* 11 */
+    fe_sq(t0, t0);              /* 22 */
+    fe_mul(t0, t1, t0);         /* 2^5 - 1 */
+    fe_sqn(t1, t0, 5);
+    fe_mul(t0, t1, t0);         /* 2^10 - 1 */
+    fe_sqn(t1, t0, 10);
+    fe_mul(t1, t1, t0);         /* 2^20 - 1 */
+    fe_sqn(t2, t1, 20);
+    fe_mul(t1, t2, t1);         /* 2^40 - 1 */
+    fe_sqn(t1, t1, 10);
+    fe_mul(t0, t1, t0);         /* 2^50 - 1 */
+    fe_sqn(t1, t0, 50);
+    fe_mul(t1, t1, t0);         /* 2^100 - 1 */
+    fe_sqn(t2, t1, 100);
+    fe_mul(t1, t2, t1);         /* 2^200 - 1 */
+    fe_sqn(t1, t1, 50);
+    fe_mul(t0, t1, t0);         /* 2^250 - 1 */
+    fe_sqn(t0, t0, 2);          /* 2^252 - 4 */
+    fe_mul(o, t0, z);           /* 2^252 - 3 */
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Group arithmetic (ref10 formulas)                                        */
+/*                                                                           */
+/*  Points are extended (X, Y, Z, T).  Sums and doubles come out completed, */
+/*  ((X : Z), (Y : T)), and cost 3 multiplies back to (X, Y, Z), or 4 with  */
+/*  T when another sum follows.  An addend is cached as (Y + X, Y - X, Z,   */
+/*  2dT); table entries for B have Z = 1, which saves a multiply.           */
+/*---------------------------------------------------------------------------*/
+
+static void point_zero(gf p[4])
+{
+    set25519(p[0], gf0);
+    set25519(p[1], gf1);
+    set25519(p[2], gf1);
+    set25519(p[3], gf0);
+}
+
+
+/*
+ *  p from the completed point r, with T only if with_t.
+ */
+static void point_complete(gf p[4], gf r[4], int with_t)
+{
+    fe_mul(p[0], r[0], r[3]);
+    fe_mul(p[1], r[1], r[2]);
+    fe_mul(p[2], r[2], r[3]);
+    if (with_t)
+        fe_mul(p[3], r[0], r[1]);
+}
+
+static void point_cache(gf c[4], gf p[4])
+{
+    fe_add(c[0], p[1], p[0]);
+    fe_sub(c[1], p[1], p[0]);
+    set25519(c[2], p[2]);
+    fe_mul(c[3], p[3], ed_d2);
+}
+
+/*
+ *  r = 2p, completed.  Only X, Y and Z of p are used.
+ */
+static void point_dbl(gf r[4], gf p[4])
+{
+    gf t;
+
+    fe_sq(r[0], p[0]);
+    fe_sq(r[2], p[1]);
+    fe_sq(r[3], p[2]);
+    fe_add(r[3], r[3], r[3]);
+    fe_add(r[1], p[0], p[1]);
+    fe_sq(t, r[1]);
+    fe_add(r[1], r[2], r[0]);
+    fe_sub(r[2], r[2], r[0]);
+    fe_sub(r[0], t, r[1]);
+    fe_sub(r[3], r[3], r[2]);
+}
+
+/*
+ *  r = p + q, or p - q if neg, completed.  q is given as Y + X, Y - X,
+ *  Z (NULL for 1) and 2dT.  The formula also doubles, when q is p.
+ */
+static void point_add(gf r[4], gf p[4],
+                      const gf ypx, const gf ymx, const gf z, const gf t2d, int neg)
+{
+    gf t;
+
+    fe_add(r[0], p[1], p[0]);
+    fe_sub(r[1], p[1], p[0]);
+    fe_mul(r[2], r[0], neg ? ymx : ypx);
+    fe_mul(r[1], r[1], neg ? ypx : ymx);
+    fe_mul(r[3], t2d, p[3]);
+    if (z != NULL)
+        fe_mul(r[0], p[2], z);
+    else
+        set25519(r[0], p[2]);
+    fe_add(t, r[0], r[0]);
+    fe_sub(r[0], r[2], r[1]);
+    fe_add(r[1], r[2], r[1]);
+    if (neg) {
+        fe_sub(r[2], t, r[3]);
+        fe_add(r[3], t, r[3]);
+    }
+    else {
+        fe_add(r[2], t, r[3]);
+        fe_sub(r[3], t, r[3]);
+    }
+}
+
+static void point_pack(uint8_t * r, gf p[4])
+{
+    gf tx;
+    gf ty;
+    gf zi;
+
+    inv25519(zi, p[2]);
+    fe_mul(tx, p[0], zi);
+    fe_mul(ty, p[1], zi);
+    pack25519(r, ty);
+    r[31] ^= par25519(tx) << 7;
+}
+
+/*
+ *  Decode a point and negate it.  Returns -1 if it is not on the curve.
+ */
+static int point_unpackneg(gf r[4], const uint8_t * p)
+{
+    gf t;
+    gf chk;
+    gf num;
+    gf den;
+    gf den2;
+    gf den4;
+    gf den6;
+
+    set25519(r[2], gf1);
+    unpack25519(r[1], p);
+    fe_sq(num, r[1]);
+    fe_mul(den, num, ed_d);
+    fe_sub(num, num, r[2]);
+    fe_add(den, r[2], den);
+
+    fe_sq(den2, den);
+    fe_sq(den4, den2);
+    fe_mul(den6, den4, den2);
+    fe_mul(t, den6, num);
+    fe_mul(t, t, den);
+
+    pow2523(t, t);
+    fe_mul(t, t, num);
+    fe_mul(t, t, den);
+    fe_mul(t, t, den);
+    fe_mul(r[0], t, den);
+
+    fe_sq(chk, r[0]);
+    fe_mul(chk, chk, den);
+    if (neq25519(chk, num))
+        fe_mul(r[0], r[0], ed_i);
+
+    fe_sq(chk, r[0]);
+    fe_mul(chk, chk, den);
+    if (neq25519(chk, num))
+        return -1;
+
+    if (par25519(r[0]) == (p[31] >> 7))
+        fe_sub(r[0], gf0, r[0]);
+
+    fe_mul(r[3], r[0], r[1]);
+    return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Scalar arithmetic modulo L                                               */
+/*---------------------------------------------------------------------------*/
+
+static void mod_l(uint8_t * r, int64_t x[64])
+{
+    int64_t carry;
+    int     i;
+    int     j;
+
+    for (i = 63; i >= 32; i--) {
+        carry = 0;
+        for (j = i - 32; j < i - 12; j++) {
+            x[j] += carry - 16 * x[i] * ed_l[j - (i - 32)];
+            carry = (x[j] + 128) >> 8;
+            x[j] -= carry * 256;
+        }
+        x[j] += carry;
+        x[i] = 0;
+    }
+
+    carry = 0;
+    for (j = 0; j < 32; j++) {
+        x[j] += carry - (x[31] >> 4) * ed_l[j];
+        carry = x[j] >> 8;
+        x[j] &= 255;
+    }
+    for (j = 0; j < 32; j++) {
+        x[j] -= carry * ed_l[j];
+    }
+    for (i = 0; i < 32; i++) {
+        x[i + 1] += x[i] >> 8;
+        r[i] = (uint8_t)(x[i] & 255);
+    }
+}
+
+/*
+ *  Reduce a 64 byte hash modulo L, in place, into its first 32 bytes.
+ */
+static void reduce(uint8_t * r)
+{
+    int64_t x[64];
+    int     i;
+
+    for (i = 0; i < 64; i++) {
+        x[i] = r[i];
+    }
+    memset(r, 0, 64);
+    mod_l(r, x);
+}
+
+/*
+ *  Check that a 32 byte scalar is below L, as RFC 8032 requires of s.
+ */
+static int scalar_is_canonical(const uint8_t * s)
+{
+    int i;
+
+    for (i = 31; i >= 0; i--) {
+        if (s[i] != ed_l[i])
+            return s[i] < ed_l[i];
+    }
+    return 0;
+}
+
+/*
+ *  Recode a 32 byte scalar into signed digits, odd and within +-15, with
+ *  at least 4 zeros after each non-zero digit (ref10's slide).
+ */
+static void slide(int8_t * r, const uint8_t * a)
+{
+    int i;
+    int b;
+    int k;
+
+    for (i = 0; i < 256; i++) {
+        r[i] = 1 & (a[i >> 3] >> (i & 7));
+    }
+
+    for (i = 0; i < 256; i++) {
+        if (r[i] == 0)
+            continue;
+
+        for (b = 1; b <= 6 && i + b < 256; b++) {
+            if (r[i + b] == 0)
+                continue;
+
+            if (r[i] + (r[i + b] << b) <= 15) {
+                r[i] += r[i + b] << b;
+                r[i + b] = 0;
+            }
+            else if (r[i] - (r[i + b] << b) >= -15) {
+                r[i] -= r[i + b] << b;
+                for (k = i + b; k < 256; k++) {
+                    if (r[k] == 0) {
+                        r[k] = 1;
+                        break;
+                    }
+                    r[k] = 0;
+                }
+            }
+            else {
+                break;
+            }
+        }
+    }
+}
+
+/*---------------------------------------------------------------------------*/
+/*  Signatures                                                               */
+/*---------------------------------------------------------------------------*/
+
+static gf      ed_p[4];         /* accumulator                      */
+static gf      ed_ai[8][4];     /* -A, -3A, ... -15A, cached        */
+static int8_t  ed_hd[256];      /* digits of h                      */
+static int8_t  ed_sd[256];      /* digits of s                      */
+static uint8_t ed_r[32];        /* R of the signature               */
+static int     ed_bit = -1;     /* next digit, -1 when all are done */
+static int     ed_started;
+
+int ed25519_verify_start(const uint8_t * p_sig,
+                         const uint8_t * p_msg,
+                         uint32_t        msg_len,
+                         const uint8_t * p_public_key)
+{
+    sha512_ctx_t ctx;
+    uint8_t      h[64];
+    gf           a2[4];
+    gf           r[4];
+    int          i;
+
+    ed_started = 0;
+    ed_bit     = -1;
+
+    if (!scalar_is_canonical(&p_sig[32]))
+        return -1;
+
+    if (point_unpackneg(ed_p, p_public_key) != 0)
+        return -1;
+
+    /* h = SHA-512(R || A || M) mod L */
+    sha512_init(&ctx);
+    sha512_update(&ctx, p_sig, 32);
+    sha512_update(&ctx, p_public_key, ED25519_PUBLIC_KEY_SIZE);
+    sha512_update(&ctx, p_msg, msg_len);
+    sha512_final(&ctx, h);
+    reduce(h);
+
+    slide(ed_hd, h);
+    slide(ed_sd, &p_sig[32]);
+    memcpy(ed_r, p_sig, 32);
+
+    /* Odd multiples of -A, the table of B is in flash. */
+    point_cache(ed_ai[0], ed_p);
+    point_dbl(r, ed_p);
+    point_complete(a2, r, 1);
+    for (i = 1; i < 8; i++) {
+        point_add(r, a2, ed_ai[i - 1][0], ed_ai[i - 1][1], ed_ai[i - 1][2], ed_ai[i - 1][3], 0);
+        point_complete(ed_p, r, 1);
+        point_cache(ed_ai[i], ed_p);
+    }
+
+    /* R' = [s]B + [h](-A), from the top non-zero digit down. */
+    point_zero(ed_p);
+    for (ed_bit = 255; ed_bit >= 0; ed_bit--) {
+        if (ed_hd[ed_bit] != 0 || ed_sd[ed_bit] != 0)
+            break;
+    }
+
+    ed_started = 1;
+    return 0;
+}
+
+int ed25519_verify_step(void)
+{
+    const gf * q;
+    gf         r[4];
+    int        n;
+    int        d;
+
+    for (n = 0; (n < ED25519_VERIFY_STEP_BITS) && (ed_bit >= 0); n++, ed_bit--) {
+        point_dbl(r, ed_p);
+
+        d = ed_hd[ed_bit];
+        if (d != 0) {
+            q = ed_ai[(d < 0 ? -d : d) / 2];
+            point_complete(ed_p, r, 1);
+            point_add(r, ed_p, q[0], q[1], q[2], q[3], d < 0);
+        }
+
+        d = ed_sd[ed_bit];
+        if (d != 0) {
+            q = ed_bi[(d < 0 ? -d : d) / 2];
+            point_complete(ed_p, r, 1);
+            point_add(r, ed_p, q[0], q[1], NULL, q[2], d < 0);
+        }
+
+        point_complete(ed_p, r, 0);
+    }
+
+    return ed_bit >= 0;
+}
+
+int ed25519_verify_finish(void)
+{
+    uint8_t r[32];
+
+    if (!ed_started)
+        return -1;
+
+    while (ed25519_verify_step())
+        ;
+
+    ed_started = 0;
+
+    point_pack(r, ed_p);
+
+    return (memcmp(r, ed_r, 32) == 0) ? 0 : -1;
+}
+
+int ed25519_verify(const uint8_t * p_sig,
+                   const uint8_t * p_msg,
+                   uint32_t        msg_len,
+                   const uint8_t * p_public_key)
+{
+    if (ed25519_verify_start(p_sig, p_msg, msg_len, p_public_key) != 0)
+        return -1;
+
+    return ed25519_verify_finish();
+}
+
+#if defined(ED25519_SIGN_SUPPORT)
+
+/* Base point (X, Y), in 16 bit limbs. */
+static const gf ed_x = {
+    0xd51a, 0x8f25, 0x2d60, 0xc956, 0xa7b2, 0x9525, 0xc760, 0x692c,
+    0xdc5c, 0xfdd6, 0xe231, 0xc0a4, 0x53fe, 0xcd6e, 0x36d3, 0x2169,
+};
+static const gf ed_y = {
+    0x6658, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+    0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666, 0x6666,
+};
+
+static void sel25519(gf p, gf q, int b)
+{
+    uint16_t c = (uint16_t) -b;
+    uint16_t t;
+    int      i;
+
+    for (i = 0; i < 16; i++) {
+        t = c & (p[i] ^ q[i]);
+        p[i] ^= t;
+        q[i] ^= t;
+    }
+}
+
+static void point_base(gf p[4])
+{
+    set25519(p[0], ed_x);
+    set25519(p[1], ed_y);
+    set25519(p[2], gf1);
+    fe_mul(p[3], ed_x, ed_y);
+}
+
+/*
+ *  Constant time [s]B, used with secret scalars.
+ */
+static void scalarbase(gf p[4], const uint8_t * s)
+{
+    gf  q[4];
+    gf  c[4];
+    gf  r[4];
+    int i;
+    int j;
+    int b;
+
+    point_zero(p);
+    point_base(q);
+
+    for (i = 255; i >= 0; i--) {
+        b = (s[i / 8] >> (i & 7)) & 1;
+        for (j = 0; j < 4; j++)
+            sel25519(p[j], q[j], b);
+        point_cache(c, p);
+        point_add(r, q, c[0], c[1], c[2], c[3], 0);
+        point_complete(q, r, 1);
+        point_add(r, p, c[0], c[1], c[2], c[3], 0);
+        point_complete(p, r, 1);
+        for (j = 0; j < 4; j++)
+            sel25519(p[j], q[j], b);
+    }
+}
+
+/*
+ *  Expand the seed into the clamped secret scalar and the nonce prefix.
+ */
+static void expand_seed(uint8_t * d, const uint8_t * p_seed)
+{
+    sha512_ctx_t ctx;
+
+    sha512_init(&ctx);
+    sha512_update(&ctx, p_seed, ED25519_SEED_SIZE);
+    sha512_final(&ctx, d);
+
+    d[0]  &= 248;
+    d[31] &= 127;
+    d[31] |= 64;
+}
+
+void ed25519_public_key(uint8_t * p_public_key, const uint8_t * p_seed)
+{
+    gf      p[4];
+    uint8_t d[64];
+
+    expand_seed(d, p_seed);
+    scalarbase(p, d);
+    point_pack(p_public_key, p);
+}
+
+void ed25519_sign(uint8_t       * p_sig,
+                  const uint8_t * p_msg,
+                  uint32_t        msg_len,
+                  const uint8_t * p_seed)
+{
+    sha512_ctx_t ctx;
+    gf           p[4];
+    uint8_t      d[64];
+    uint8_t      r[64];
+    uint8_t      h[64];
+    uint8_t      pk[ED25519_PUBLIC_KEY_SIZE];
+    int64_t      x[64];
+    int          i;
+    int          j;
+
+    expand_seed(d, p_seed);
+    scalarbase(p, d);
+    point_pack(pk, p);
+
+    /* r = SHA-512(prefix || M) mod L, R = [r]B */
+    sha512_init(&ctx);
+    sha512_update(&ctx, &d[32], 32);
+    sha512_update(&ctx, p_msg, msg_len);
+    sha512_final(&ctx, r);
+    reduce(r);
+    scalarbase(p, r);
+    point_pack(p_sig, p);
+
+    /* h = SHA-512(R || A || M) mod L */
+    sha512_init(&ctx);
+    sha512_update(&ctx, p_sig, 32);
+    sha512_update(&ctx, pk, ED25519_PUBLIC_KEY_SIZE);
+    sha512_update(&ctx, p_msg, msg_len);
+    sha512_final(&ctx, h);
+    reduce(h);
+
+    /* s = (r + h * a) mod L */
+    memset(x, 0, sizeof(x));
+    for (i = 0; i < 32; i++)
+        x[i] = r[i];
+    for (i = 0; i < 32; i++) {
+        for (j = 0; j < 32; j++)
+            x[i + j] += h[i] * (int64_t) d[j];
+    }
+    mod_l(&p_sig[32], x);
+}
+
+#endif
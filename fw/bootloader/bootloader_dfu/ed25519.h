@@ -0,0 +1,93 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  ed25519.h  -- Ed25519 (RFC 8032) signatures for signed DFU images.
+ *
+ *  The bootloader only verifies.  Host tools define ED25519_SIGN_SUPPORT
+ *  to also derive keys and sign, and ED25519_MUL_COUNT to count field
+ *  multiplies and adds, which set the cost of a verify on the nRF51.
+ */
+#ifndef ED25519_H__
+#define ED25519_H__
+
+#include <stdint.h>
+
+#define ED25519_SEED_SIZE         32
+#define ED25519_PUBLIC_KEY_SIZE   32
+#define ED25519_SIGNATURE_SIZE    64
+
+/*
+ *  Scalar bits handled by each ed25519_verify_step(), of 253 or so.
+ */
+#define ED25519_VERIFY_STEP_BITS  32
+
+/*
+ *  Verify an Ed25519 signature.
+ *
+ *  p_sig        -- 64 byte signature.
+ *  p_msg        -- signed message.
+ *  msg_len      -- length of p_msg in bytes.
+ *  p_public_key -- 32 byte public key of the signer.
+ *
+ *  Returns 0 if the signature is valid, -1 otherwise.
+ *
+ *  Not reentrant: the curve points are held in static storage to keep
+ *  the bootloader stack small.
+ */
+int ed25519_verify(const uint8_t * p_sig,
+                   const uint8_t * p_msg,
+                   uint32_t        msg_len,
+                   const uint8_t * p_public_key);
+
+/*
+ *  Verify an Ed25519 signature in steps, so the caller can come back to
+ *  its event loop between them.  ed25519_verify() is the three in a row.
+ *
+ *  ed25519_verify_start() decodes the key and hashes the message, taking
+ *  the same arguments as ed25519_verify().  Returns -1 if the signature
+ *  or key is malformed, 0 otherwise.  The message is not used after it.
+ *
+ *  ed25519_verify_step() does the next ED25519_VERIFY_STEP_BITS of the
+ *  scalar multiply.  Returns non-zero while more steps are left.
+ *
+ *  ed25519_verify_finish() does any steps left and checks the result.
+ *  Returns 0 if the signature is valid, -1 otherwise, or if no verify
+ *  was started.
+ */
+int ed25519_verify_start(const uint8_t * p_sig,
+                         const uint8_t * p_msg,
+                         uint32_t        msg_len,
+                         const uint8_t * p_public_key);
+
+int ed25519_verify_step(void);
+
+int ed25519_verify_finish(void);
+
+#if defined(ED25519_MUL_COUNT)
+
+/*
+ *  Field multiplies (squares included) and adds or subtracts done so far.
+ */
+extern uint32_t ed25519_mul_count;
+extern uint32_t ed25519_add_count;
+
+#endif
+
+#if defined(ED25519_SIGN_SUPPORT)
+
+/*
+ *  Derive the 32 byte public key from a 32 byte secret seed.
+ */
+void ed25519_public_key(uint8_t * p_public_key, const uint8_t * p_seed);
+
+/*
+ *  Sign a message with the key derived from a 32 byte secret seed.
+ */
+void ed25519_sign(uint8_t       * p_sig,
+                  const uint8_t * p_msg,
+                  uint32_t        msg_len,
+                  const uint8_t * p_seed);
+
+#endif
+
+#endif // ED25519_H__
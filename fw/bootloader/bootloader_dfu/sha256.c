@@ -0,0 +1,156 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  sha256.c  -- streaming SHA-256 (FIPS 180-4) shared by the bootloader
+ *               and host tools.
+ *
+ *  The bootloader feeds each part of the image to sha256_update() as it is
+ *  written to flash, so only the last partial block is left to hash when
+ *  the image is validated.  The round loop is kept rolled, with a 16 word
+ *  message schedule, to stay small on the Cortex-M0.
+ */
+#include <stdint.h>
+#include <string.h>
+
+#include "sha256.h"
+
+#define ROR(x, n)    (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define CH(x, y, z)  (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x)       (ROR(x, 2)  ^ ROR(x, 13) ^ ROR(x, 22))
+#define EP1(x)       (ROR(x, 6)  ^ ROR(x, 11) ^ ROR(x, 25))
+#define SIG0(x)      (ROR(x, 7)  ^ ROR(x, 18) ^ ((x) >> 3))
+#define SIG1(x)      (ROR(x, 17) ^ ROR(x, 19) ^ ((x) >> 10))
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t sha256_iv[SHA256_STATE_WORDS] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+/*
+ *  Hash one 64 byte block into the chaining state.
+ */
+static void sha256_block(uint32_t * state, const uint8_t * p_block)
+{
+    uint32_t w[16];
+    uint32_t v[8];
+    uint32_t t1;
+    uint32_t t2;
+    uint32_t i;
+
+    for (i = 0; i < 16; i++) {
+        w[i] = ((uint32_t) p_block[4 * i]     << 24) |
+               ((uint32_t) p_block[4 * i + 1] << 16) |
+               ((uint32_t) p_block[4 * i + 2] << 8)  |
+               ((uint32_t) p_block[4 * i + 3]);
+    }
+
+    memcpy(v, state, sizeof(v));
+
+    for (i = 0; i < 64; i++) {
+        if (i >= 16) {
+            w[i & 15] += SIG1(w[(i - 2) & 15]) + w[(i - 7) & 15] + SIG0(w[(i - 15) & 15]);
+        }
+
+        t1 = v[7] + EP1(v[4]) + CH(v[4], v[5], v[6]) + sha256_k[i] + w[i & 15];
+        t2 = EP0(v[0]) + MAJ(v[0], v[1], v[2]);
+
+        v[7] = v[6];
+        v[6] = v[5];
+        v[5] = v[4];
+        v[4] = v[3] + t1;
+        v[3] = v[2];
+        v[2] = v[1];
+        v[1] = v[0];
+        v[0] = t1 + t2;
+    }
+
+    for (i = 0; i < 8; i++) {
+        state[i] += v[i];
+    }
+}
+
+void sha256_init(sha256_ctx_t * p_ctx)
+{
+    sha256_resume(p_ctx, sha256_iv, 0);
+}
+
+void sha256_resume(sha256_ctx_t * p_ctx, const uint32_t * p_state, uint32_t length)
+{
+    memcpy(p_ctx->state, p_state, sizeof(p_ctx->state));
+    p_ctx->length = length;
+}
+
+void sha256_update(sha256_ctx_t * p_ctx, const uint8_t * p_data, uint32_t size)
+{
+    uint32_t used = p_ctx->length & (SHA256_BLOCK_SIZE - 1);
+    uint32_t fill;
+
+    p_ctx->length += size;
+
+    /* Complete a buffered partial block first. */
+    if (used > 0) {
+        fill = SHA256_BLOCK_SIZE - used;
+
+        if (size < fill) {
+            memcpy(&p_ctx->buffer[used], p_data, size);
+            return;
+        }
+        memcpy(&p_ctx->buffer[used], p_data, fill);
+        sha256_block(p_ctx->state, p_ctx->buffer);
+        p_data += fill;
+        size   -= fill;
+    }
+
+    /* Whole blocks are hashed in place, e.g. straight from flash. */
+    while (size >= SHA256_BLOCK_SIZE) {
+        sha256_block(p_ctx->state, p_data);
+        p_data += SHA256_BLOCK_SIZE;
+        size   -= SHA256_BLOCK_SIZE;
+    }
+
+    memcpy(p_ctx->buffer, p_data, size);
+}
+
+void sha256_final(sha256_ctx_t * p_ctx, uint8_t * p_digest)
+{
+    uint32_t used = p_ctx->length & (SHA256_BLOCK_SIZE - 1);
+    uint32_t bits = p_ctx->length << 3;
+    uint32_t i;
+
+    p_ctx->buffer[used++] = 0x80;
+
+    if (used > SHA256_BLOCK_SIZE - 8) {
+        memset(&p_ctx->buffer[used], 0, SHA256_BLOCK_SIZE - used);
+        sha256_block(p_ctx->state, p_ctx->buffer);
+        used = 0;
+    }
+    memset(&p_ctx->buffer[used], 0, SHA256_BLOCK_SIZE - used);
+
+    /* Message length in bits, big-endian.  Images are well below 512MB. */
+    p_ctx->buffer[59] = (uint8_t)(p_ctx->length >> 29);
+    p_ctx->buffer[60] = (uint8_t)(bits >> 24);
+    p_ctx->buffer[61] = (uint8_t)(bits >> 16);
+    p_ctx->buffer[62] = (uint8_t)(bits >> 8);
+    p_ctx->buffer[63] = (uint8_t)(bits);
+    sha256_block(p_ctx->state, p_ctx->buffer);
+
+    for (i = 0; i < SHA256_STATE_WORDS; i++) {
+        p_digest[4 * i]     = (uint8_t)(p_ctx->state[i] >> 24);
+        p_digest[4 * i + 1] = (uint8_t)(p_ctx->state[i] >> 16);
+        p_digest[4 * i + 2] = (uint8_t)(p_ctx->state[i] >> 8);
+        p_digest[4 * i + 3] = (uint8_t)(p_ctx->state[i]);
+    }
+}
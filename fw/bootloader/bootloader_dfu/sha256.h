@@ -0,0 +1,48 @@
+/*
+ *  Copyright (c) 2015 Robin Callender. All Rights Reserved.
+ *
+ *  sha256.h  -- streaming SHA-256 shared by the bootloader and host tools.
+ */
+#ifndef SHA256_H__
+#define SHA256_H__
+
+#include <stdint.h>
+
+#define SHA256_BLOCK_SIZE    64
+#define SHA256_DIGEST_SIZE   32
+#define SHA256_STATE_WORDS   8
+
+/*
+ *  Hash context.  The context may be copied to take a snapshot, e.g. to
+ *  finalize a digest while it continues to be updated.
+ */
+typedef struct {
+    uint32_t state[SHA256_STATE_WORDS];     /* chaining state                 */
+    uint32_t length;                        /* bytes hashed so far            */
+    uint8_t  buffer[SHA256_BLOCK_SIZE];     /* partial block, length % 64     */
+} sha256_ctx_t;
+
+/*
+ *  Start a new hash.
+ */
+void sha256_init(sha256_ctx_t * p_ctx);
+
+/*
+ *  Restart a hash from a chaining state saved at a block boundary.
+ *
+ *  p_state -- chaining state, as found in sha256_ctx_t.state.
+ *  length  -- bytes hashed to reach p_state, a multiple of SHA256_BLOCK_SIZE.
+ */
+void sha256_resume(sha256_ctx_t * p_ctx, const uint32_t * p_state, uint32_t length);
+
+/*
+ *  Extend the hash with size bytes of p_data.
+ */
+void sha256_update(sha256_ctx_t * p_ctx, const uint8_t * p_data, uint32_t size);
+
+/*
+ *  Finish the hash and write the 32 byte digest.  The context is consumed.
+ */
+void sha256_final(sha256_ctx_t * p_ctx, uint8_t * p_digest);
+
+#endif // SHA256_H__
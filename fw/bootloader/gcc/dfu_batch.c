@@ -0,0 +1,492 @@
+/*
+ *   dfu_batch.c  -- update a batch of devices, several at a time
+ *
+ *   Compile:  make -f gen_dat.mk dfu_batch
+ *   Usage:    dfu_batch [options] bin-filename dat-filename device...
+ *               -t transport   link backend, default "sim" (dfu_sim.c)
+ *               -o options     backend options, see the backend
+ *               -j jobs        devices updated at once, default 4
+ *               -r retries     further attempts per device, default 3
+ *               -m mode        update mode of the start packet, default
+ *                              0x04 (application), 0x24 for gen_lz images
+ *               -p packets     packet receipt notification interval,
+ *                              default 10
+ *               -n count       add devices dev0 .. dev<count-1>
+ *
+ *   Runs the DFU Controller side of dfu_transport_ble.c against each
+ *   device: START, INIT, RECEIVE, VALIDATE, ACTIVATE.  A device that
+ *   drops the link is retried, resuming from the bootloader's last
+ *   checkpoint when the image allows it, and a table of per-device
+ *   results and throughput is printed at the end.  The exit status is
+ *   the number of devices not updated.
+ *
+ *   Example:  dfu_batch -n 50 -j 8 -o loss=0.0005 application.bin application.dat
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "crc16.h"
+#include "dfu_link.h"
+
+#define PACKET_SIZE             20          /* DFU data packet, ATT MTU less 3 */
+#define RESPONSE_TIMEOUT_MS     10000
+#define JOBS_MAX                64
+
+#define OP_START                1
+#define OP_INIT                 2
+#define OP_RECEIVE              3
+#define OP_VALIDATE             4
+#define OP_ACTIVATE             5
+#define OP_REPORT               7
+#define OP_PRN_REQUEST          8
+#define OP_RESPONSE             0x10
+#define OP_PRN                  0x11
+
+#define RESP_SUCCESS            1
+#define RESP_CRC_ERROR          5
+
+#define MODE_APP                0x04
+#define MODE_RESUME             0x08
+#define MODE_DELTA              0x10
+#define MODE_COMPRESSED         0x20
+
+/* Outcome of one attempt. */
+#define SESSION_OK              0
+#define SESSION_RETRY           1           /* link loss, timeout or bad image */
+#define SESSION_FAILED          2           /* refused by the device           */
+
+static const dfu_link_ops_t * const m_links[] = {
+    &dfu_sim_link,
+};
+
+typedef struct {
+    const char * device;
+    int          result;
+    const char * error;
+    uint32_t     attempts;
+    uint32_t     resumed;           /* bytes not sent again thanks to resume */
+    uint64_t     sent;              /* image bytes sent, all attempts        */
+    uint64_t     time_us;           /* link time, all attempts               */
+} job_t;
+
+static const dfu_link_ops_t * m_link;
+static const char           * m_options;
+static const uint8_t        * m_bin;
+static size_t                 m_bin_size;
+static const uint8_t        * m_dat;
+static size_t                 m_dat_size;
+static uint8_t                m_mode    = MODE_APP;
+static uint32_t               m_retries = 3;
+static uint32_t               m_prn     = 10;
+
+static job_t                * m_jobs;
+static uint32_t               m_job_count;
+static uint32_t               m_job_next;
+static pthread_mutex_t        m_job_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ *  Read all of a file into a malloc'ed buffer.
+ */
+static uint8_t * read_file(const char * filename, size_t * p_size)
+{
+    FILE    * file;
+    uint8_t * data;
+    long      size;
+
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    data = (size > 0) ? (uint8_t*) malloc(size) : NULL;
+    if (data == NULL || fread(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s read failed\n", filename);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *p_size = (size_t) size;
+    return data;
+}
+
+static uint32_t get_le32(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void put_le32(uint8_t * p, uint32_t value)
+{
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static int control_point(dfu_link_t * p_link, const uint8_t * p_data, uint32_t length)
+{
+    return m_link->write(p_link, DFU_LINK_CONTROL_POINT, p_data, length);
+}
+
+/*
+ *  Write data to the Packet characteristic, PACKET_SIZE at a time.
+ */
+static int packet(dfu_link_t * p_link, const uint8_t * p_data, uint32_t length)
+{
+    while (length > 0) {
+        uint32_t size = (length < PACKET_SIZE) ? length : PACKET_SIZE;
+
+        if (m_link->write(p_link, DFU_LINK_PACKET, p_data, size) != DFU_LINK_OK)
+            return DFU_LINK_LOST;
+
+        p_data += size;
+        length -= size;
+    }
+
+    return DFU_LINK_OK;
+}
+
+/*
+ *  Wait for the response to procedure op, or for a packet receipt
+ *  notification if op is OP_PRN.  The value reported, if any, is
+ *  returned in *p_value.
+ *
+ *  Returns the response value, or 0 if the link was lost or timed out.
+ */
+static int response_wait(dfu_link_t * p_link, uint8_t op, uint32_t * p_value)
+{
+    uint8_t notification[20];
+    int     length;
+
+    for (;;) {
+        length = m_link->notification(p_link, notification, sizeof(notification),
+                                      RESPONSE_TIMEOUT_MS);
+        if (length <= 0)
+            return 0;
+
+        if (op == OP_PRN && notification[0] == OP_PRN && length >= 5) {
+            *p_value = get_le32(&notification[1]);
+            return RESP_SUCCESS;
+        }
+
+        if (notification[0] == OP_RESPONSE && length >= 3 && notification[1] == op) {
+            if (p_value != NULL && length >= 7)
+                *p_value = get_le32(&notification[3]);
+            return notification[2];
+        }
+
+        /* An error response to the data transfer ends it, whatever was awaited. */
+        if (notification[0] == OP_RESPONSE && length >= 3 && notification[1] == OP_RECEIVE)
+            return notification[2];
+    }
+}
+
+static int session_error(job_t * p_job, int response, const char * procedure)
+{
+    p_job->error = procedure;
+
+    if (response == 0 || response == RESP_CRC_ERROR)
+        return SESSION_RETRY;
+
+    return SESSION_FAILED;
+}
+
+/*
+ *  One attempt at updating a device.
+ */
+static int session(job_t * p_job, dfu_link_t * p_link, int resume)
+{
+    uint8_t  command[3];
+    uint8_t  sizes[12];
+    uint32_t offset = 0;
+    uint32_t count  = 0;
+    uint32_t value;
+    int      response = 0;
+
+    if (m_prn != 0) {
+        command[0] = OP_PRN_REQUEST;
+        command[1] = (uint8_t) m_prn;
+        command[2] = (uint8_t)(m_prn >> 8);
+        if (control_point(p_link, command, 3) != DFU_LINK_OK)
+            return session_error(p_job, 0, "connect");
+    }
+
+    command[0] = OP_START;
+    command[1] = m_mode | (resume ? MODE_RESUME : 0);
+    memset(sizes, 0, sizeof(sizes));
+    put_le32(&sizes[8], (uint32_t) m_bin_size);
+
+    if (control_point(p_link, command, 2) != DFU_LINK_OK ||
+        packet(p_link, sizes, sizeof(sizes)) != DFU_LINK_OK ||
+        (response = response_wait(p_link, OP_START, NULL)) != RESP_SUCCESS)
+        return session_error(p_job, response, "start");
+
+    command[0] = OP_INIT;
+    command[1] = 0;
+    if (control_point(p_link, command, 2) != DFU_LINK_OK ||
+        packet(p_link, m_dat, (uint32_t) m_dat_size) != DFU_LINK_OK)
+        return session_error(p_job, 0, "init");
+
+    command[1] = 1;
+    response   = 0;
+    if (control_point(p_link, command, 2) != DFU_LINK_OK ||
+        (response = response_wait(p_link, OP_INIT, NULL)) != RESP_SUCCESS)
+        return session_error(p_job, response, "init");
+
+    if (resume) {
+        command[0] = OP_REPORT;
+        value      = 0;
+        response   = 0;
+        if (control_point(p_link, command, 1) != DFU_LINK_OK ||
+            (response = response_wait(p_link, OP_REPORT, &value)) != RESP_SUCCESS)
+            return session_error(p_job, response, "report");
+
+        if (value > m_bin_size || (value & 3))
+            return session_error(p_job, 0, "report");
+
+        offset           = value;
+        p_job->resumed  += offset;
+    }
+
+    command[0] = OP_RECEIVE;
+    if (control_point(p_link, command, 1) != DFU_LINK_OK)
+        return session_error(p_job, 0, "receive");
+
+    while (offset < m_bin_size) {
+        uint32_t size = (m_bin_size - offset < PACKET_SIZE) ? m_bin_size - offset : PACKET_SIZE;
+
+        if (m_link->write(p_link, DFU_LINK_PACKET, &m_bin[offset], size) != DFU_LINK_OK)
+            return session_error(p_job, 0, "receive");
+
+        offset      += size;
+        p_job->sent += size;
+
+        /* Keep in step with the device, as its receive buffers are few. */
+        if (m_prn != 0 && ++count == m_prn && offset < m_bin_size) {
+            count = 0;
+            if ((response = response_wait(p_link, OP_PRN, &value)) != RESP_SUCCESS)
+                return session_error(p_job, response, "receive");
+            if (value != offset)
+                return session_error(p_job, 0, "receive");
+        }
+    }
+
+    if ((response = response_wait(p_link, OP_RECEIVE, NULL)) != RESP_SUCCESS)
+        return session_error(p_job, response, "receive");
+
+    command[0] = OP_VALIDATE;
+    response   = 0;
+    if (control_point(p_link, command, 1) != DFU_LINK_OK ||
+        (response = response_wait(p_link, OP_VALIDATE, NULL)) != RESP_SUCCESS)
+        return session_error(p_job, response, "validate");
+
+    /* The device resets into the new application, so the link is lost here. */
+    command[0] = OP_ACTIVATE;
+    control_point(p_link, command, 1);
+
+    return SESSION_OK;
+}
+
+static void job_run(job_t * p_job)
+{
+    dfu_link_t * p_link;
+    int          resumable = !(m_mode & (MODE_DELTA | MODE_COMPRESSED));
+    int          result    = SESSION_RETRY;
+
+    while (result == SESSION_RETRY && p_job->attempts <= m_retries) {
+        p_job->attempts++;
+
+        p_link = m_link->open(p_job->device, m_options);
+        if (p_link == NULL) {
+            p_job->error = "connect";
+            continue;
+        }
+
+        result = session(p_job, p_link, resumable && p_job->attempts > 1);
+
+        p_job->time_us += m_link->time_us(p_link);
+        m_link->close(p_link);
+
+        if (result != SESSION_OK)
+            fprintf(stderr, "%s: attempt %u failed in %s\n",
+                    p_job->device, (unsigned) p_job->attempts, p_job->error);
+    }
+
+    p_job->result = result;
+    if (result == SESSION_OK)
+        p_job->error = NULL;
+}
+
+static void * worker(void * p_context)
+{
+    job_t * p_job;
+
+    (void) p_context;
+
+    for (;;) {
+        pthread_mutex_lock(&m_job_lock);
+        p_job = (m_job_next < m_job_count) ? &m_jobs[m_job_next++] : NULL;
+        pthread_mutex_unlock(&m_job_lock);
+
+        if (p_job == NULL)
+            return NULL;
+
+        job_run(p_job);
+    }
+}
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void report(double elapsed)
+{
+    uint32_t failed = 0;
+    uint64_t time_us = 0;
+    uint32_t i;
+
+    printf("%-16s %-10s %8s %10s %9s %9s\n",
+           "device", "result", "attempts", "resumed", "time s", "bytes/s");
+
+    for (i = 0; i < m_job_count; i++) {
+        job_t * p_job = &m_jobs[i];
+        double  seconds = p_job->time_us / 1e6;
+
+        if (p_job->result != SESSION_OK)
+            failed++;
+        time_us += p_job->time_us;
+
+        printf("%-16s %-10s %8u %10u %9.2f %9.0f\n",
+               p_job->device,
+               (p_job->result == SESSION_OK) ? "ok" : p_job->error,
+               (unsigned) p_job->attempts,
+               (unsigned) p_job->resumed,
+               seconds,
+               (seconds > 0) ? p_job->sent / seconds : 0.0);
+    }
+
+    printf("%u of %u devices updated, %.1f s of link time, %.2f s elapsed\n",
+           (unsigned) (m_job_count - failed), (unsigned) m_job_count,
+           time_us / 1e6, elapsed);
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: dfu_batch [-t transport] [-o options] [-j jobs] [-r retries]\n");
+    fprintf(stderr, "                 [-m mode] [-p packets] [-n count]\n");
+    fprintf(stderr, "                 bin-filename dat-filename device...\n");
+    return -1;
+}
+
+int main(int argc, char* argv[])
+{
+    pthread_t threads[JOBS_MAX];
+    uint32_t  jobs  = 4;
+    uint32_t  count = 0;
+    uint32_t  i;
+    double    start;
+    int       opt;
+
+    m_link = m_links[0];
+
+    while ((opt = getopt(argc, argv, "t:o:j:r:m:p:n:")) != -1) {
+        switch (opt) {
+        case 't':
+            m_link = NULL;
+            for (i = 0; i < sizeof(m_links) / sizeof(m_links[0]); i++)
+                if (strcmp(m_links[i]->name, optarg) == 0)
+                    m_link = m_links[i];
+            if (m_link == NULL) {
+                fprintf(stderr, "unknown transport %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'o': m_options = optarg;                                   break;
+        case 'j': jobs      = (uint32_t) strtoul(optarg, NULL, 0);      break;
+        case 'r': m_retries = (uint32_t) strtoul(optarg, NULL, 0);      break;
+        case 'm': m_mode    = (uint8_t) strtoul(optarg, NULL, 0);       break;
+        case 'p': m_prn     = (uint32_t) strtoul(optarg, NULL, 0);      break;
+        case 'n': count     = (uint32_t) strtoul(optarg, NULL, 0);      break;
+        default:
+            return usage();
+        }
+    }
+
+    if (argc - optind < 2 || (argc - optind == 2 && count == 0))
+        return usage();
+
+    if (jobs == 0)
+        jobs = 1;
+    if (jobs > JOBS_MAX)
+        jobs = JOBS_MAX;
+
+    m_bin = read_file(argv[optind], &m_bin_size);
+    m_dat = read_file(argv[optind + 1], &m_dat_size);
+    if (m_bin == NULL || m_dat == NULL)
+        return -1;
+
+    if (m_bin_size & 3) {
+        fprintf(stderr, "%s must be word sized, as for DFU\n", argv[optind]);
+        return -1;
+    }
+
+    m_job_count = (argc - optind - 2) + count;
+    m_jobs      = (job_t*) calloc(m_job_count, sizeof(job_t));
+    if (m_jobs == NULL)
+        return -1;
+
+    for (i = 0; i < (uint32_t)(argc - optind - 2); i++)
+        m_jobs[i].device = argv[optind + 2 + i];
+
+    for (; i < m_job_count; i++) {
+        char * name = (char*) malloc(16);
+
+        if (name == NULL)
+            return -1;
+        snprintf(name, 16, "dev%u", (unsigned) (i - (argc - optind - 2)));
+        m_jobs[i].device = name;
+    }
+
+    /* crc16.c builds its tables on first use, do that before the threads start. */
+    (void) crc16_compute(m_bin, 1, NULL);
+
+    start = now();
+
+    if (jobs > m_job_count)
+        jobs = m_job_count;
+
+    for (i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return -1;
+        }
+    }
+
+    for (i = 0; i < jobs; i++)
+        pthread_join(threads[i], NULL);
+
+    report(now() - start);
+
+    count = 0;
+    for (i = 0; i < m_job_count; i++)
+        if (m_jobs[i].result != SESSION_OK)
+            count++;
+
+    return (int) count;
+}
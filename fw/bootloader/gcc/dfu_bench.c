@@ -0,0 +1,269 @@
+/*
+ *   dfu_bench.c  -- host benchmark of signed image validation
+ *
+ *   Compile:  make -f gen_dat.mk dfu_bench
+ *   Usage:    dfu_bench [bin-filename [cycles-per-block [cycles-per-mul [cycles-per-add]]]]
+ *
+ *   Replays a DFU transfer through the bootloader's sha256.c and crc16.c
+ *   the way dfu_single_bank.c does: the digest is extended as each data
+ *   packet is written, and dfu_init_postvalidate() only finalizes it.
+ *   Without a bin file a pseudo-random image of the largest application
+ *   size is used.
+ *
+ *   The SHA-256 block count of each phase is exact.  nRF51 times are
+ *   projected from it with the cycles-per-block figure, by default an
+ *   estimate for the C kernel on the 16MHz Cortex-M0; pass a measured
+ *   figure to refine it.  The init packet signature check is projected
+ *   the same way from its field multiply and add counts, also exact, and
+ *   the cycles-per-mul and cycles-per-add figures.
+ *
+ *   Validation, after the last data packet, is the streamed finalize and
+ *   exits non-zero past VALIDATE_BUDGET_MS.  The signature is checked
+ *   before any data, in steps run from the scheduler as
+ *   dfu_init_signature_check() does: no step may take more than
+ *   STEP_BUDGET_MS, and the init packet response waits for all of them,
+ *   at most INIT_BUDGET_MS.  At boot, when bank 1 is swapped in, the
+ *   bootloader feeds a running watchdog between the steps and before the
+ *   read-back hash, so each of those must fit in WDT_TIMEOUT_MS, or the
+ *   swap is reset and retried on every boot.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc16.h"
+#include "sha256.h"
+#include "ed25519.h"
+
+#define IMAGE_MAX_SIZE        (116 * 1024)    /* App region, see bootloader_ac.ld */
+#define DATA_PACKET_SIZE      20              /* One BLE data packet            */
+#define CODE_PAGE_SIZE        1024
+#define NRF51_CLOCK_HZ        16000000
+#define CYCLES_PER_BLOCK      6000            /* Estimate, rolled C kernel, -O3 */
+#define CYCLES_PER_MUL        3500            /* Estimate, 256 MULS and adds    */
+#define CYCLES_PER_ADD        500             /* Estimate, add and carry        */
+#define CYCLES_START          150000          /* Estimate, SHA-512 and mod L    */
+#define VALIDATE_BUDGET_MS    300
+#define STEP_BUDGET_MS        100
+#define INIT_BUDGET_MS        1000
+#define WDT_TIMEOUT_MS        8000            /* See WATCHDOG_TIMEOUT_MS, app   */
+#define REPEAT                200
+
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double nrf51_ms(uint32_t count, uint32_t cycles_each)
+{
+    return (double) count * cycles_each * 1000.0 / NRF51_CLOCK_HZ;
+}
+
+/*
+ *  Projected time of one signature check step, from the field operations
+ *  done since the last call.
+ */
+static double step_ms(uint32_t cycles_per_mul, uint32_t cycles_per_add)
+{
+    static uint32_t muls;
+    static uint32_t adds;
+    double          ms;
+
+    ms = nrf51_ms(ed25519_mul_count - muls, cycles_per_mul) +
+         nrf51_ms(ed25519_add_count - adds, cycles_per_add);
+
+    muls = ed25519_mul_count;
+    adds = ed25519_add_count;
+
+    return ms;
+}
+
+int main(int argc, char* argv[])
+{
+    static uint8_t image[IMAGE_MAX_SIZE];
+    sha256_ctx_t   stream;
+    sha256_ctx_t   copy;
+    uint8_t        hash[SHA256_DIGEST_SIZE];
+    uint8_t        seed[ED25519_SEED_SIZE];
+    uint8_t        public_key[ED25519_PUBLIC_KEY_SIZE];
+    uint8_t        sig[ED25519_SIGNATURE_SIZE];
+    uint16_t       crc = 0xFFFF;
+    uint32_t       cycles_per_block = CYCLES_PER_BLOCK;
+    uint32_t       cycles_per_mul = CYCLES_PER_MUL;
+    uint32_t       cycles_per_add = CYCLES_PER_ADD;
+    uint32_t       size = IMAGE_MAX_SIZE;
+    uint32_t       offset;
+    uint32_t       length;
+    uint32_t       image_blocks;
+    uint32_t       final_blocks;
+    uint32_t       verify_steps;
+    double         verify_ms;
+    double         longest_ms;
+    double         validate_ms;
+    double         read_back_ms;
+    double         ms;
+    int            result = 0;
+    double         t_stream;
+    double         t_validate;
+    double         t_full;
+    double         t_verify;
+    double         t;
+    int            i;
+
+    if (argc > 1) {
+        FILE * binfile = fopen(argv[1], "rb");
+
+        if (binfile == NULL) {
+            fprintf(stderr, "bin file open failed\n");
+            return -1;
+        }
+        size = (uint32_t) fread(image, 1, sizeof(image), binfile);
+        fclose(binfile);
+    }
+    else {
+        srand(1);
+        for (i = 0; i < IMAGE_MAX_SIZE; i++)
+            image[i] = (uint8_t) rand();
+    }
+
+    if (argc > 2)
+        cycles_per_block = (uint32_t) strtoul(argv[2], NULL, 0);
+
+    if (argc > 3)
+        cycles_per_mul = (uint32_t) strtoul(argv[3], NULL, 0);
+
+    if (argc > 4)
+        cycles_per_add = (uint32_t) strtoul(argv[4], NULL, 0);
+
+    /* Reception: the digest follows the data packets into flash. */
+    t = now();
+    sha256_init(&stream);
+    for (offset = 0; offset < size; offset += length) {
+        length = (size - offset < DATA_PACKET_SIZE) ? size - offset : DATA_PACKET_SIZE;
+        crc = crc16_compute(&image[offset], length, &crc);
+        sha256_update(&stream, &image[offset], length);
+    }
+    t_stream = now() - t;
+
+    /* Validation: finalize a copy of the digest, as dfu_init_postvalidate() does. */
+    t = now();
+    for (i = 0; i < REPEAT; i++) {
+        copy = stream;
+        sha256_final(&copy, hash);
+    }
+    t_validate = (now() - t) / REPEAT;
+
+    /* Validation without streaming: hash the whole image read back from flash. */
+    t = now();
+    for (i = 0; i < REPEAT / 10; i++) {
+        sha256_init(&copy);
+        sha256_update(&copy, image, size);
+        sha256_final(&copy, hash);
+    }
+    t_full = (now() - t) / (REPEAT / 10);
+
+    /* Signature check of the init packet, once per transfer before any data. */
+    memset(seed, 0x5a, sizeof(seed));
+    ed25519_public_key(public_key, seed);
+    ed25519_sign(sig, hash, sizeof(hash), seed);
+
+    /* Same steps as dfu_init_signature_check(): start, multiply, finish. */
+    ed25519_mul_count = 0;
+    ed25519_add_count = 0;
+    step_ms(cycles_per_mul, cycles_per_add);
+
+    t = now();
+    if (ed25519_verify_start(sig, hash, sizeof(hash), public_key) != 0) {
+        fprintf(stderr, "signature self-check failed\n");
+        return -1;
+    }
+    verify_ms    = step_ms(cycles_per_mul, cycles_per_add) + nrf51_ms(1, CYCLES_START);
+    longest_ms   = verify_ms;
+    verify_steps = 1;
+
+    do {
+        i  = ed25519_verify_step();
+        ms = step_ms(cycles_per_mul, cycles_per_add);
+        verify_ms += ms;
+        if (ms > longest_ms)
+            longest_ms = ms;
+        verify_steps++;
+    } while (i);
+
+    if (ed25519_verify_finish() != 0) {
+        fprintf(stderr, "signature self-check failed\n");
+        return -1;
+    }
+    t_verify = now() - t;
+    ms = step_ms(cycles_per_mul, cycles_per_add);
+    verify_ms += ms;
+    if (ms > longest_ms)
+        longest_ms = ms;
+    verify_steps++;
+
+    image_blocks = size / SHA256_BLOCK_SIZE;
+    final_blocks = ((size % SHA256_BLOCK_SIZE) > SHA256_BLOCK_SIZE - 9) ? 2 : 1;
+
+    validate_ms  = nrf51_ms(final_blocks, cycles_per_block);
+    read_back_ms = nrf51_ms(image_blocks + final_blocks, cycles_per_block);
+
+    printf("image             %u bytes, CRC 0x%04x\n", (unsigned) size, (unsigned) crc);
+    printf("cycles per block  %u (nRF51 @ %u MHz)\n",
+           (unsigned) cycles_per_block, (unsigned) (NRF51_CLOCK_HZ / 1000000));
+    printf("cycles per mul    %u, per add %u\n", (unsigned) cycles_per_mul, (unsigned) cycles_per_add);
+    printf("\n");
+    printf("                      blocks    host ms    nRF51 ms\n");
+    printf("per page received     %6u   %8.4f   %9.1f\n",
+           (unsigned) (CODE_PAGE_SIZE / SHA256_BLOCK_SIZE),
+           t_stream * 1000.0 * CODE_PAGE_SIZE / size,
+           nrf51_ms(CODE_PAGE_SIZE / SHA256_BLOCK_SIZE, cycles_per_block));
+    printf("reception (spread)    %6u   %8.4f   %9.1f\n",
+           (unsigned) image_blocks, t_stream * 1000.0,
+           nrf51_ms(image_blocks, cycles_per_block));
+    printf("validate, streamed    %6u   %8.4f   %9.1f\n",
+           (unsigned) final_blocks, t_validate * 1000.0,
+           nrf51_ms(final_blocks, cycles_per_block));
+    printf("validate, read back   %6u   %8.4f   %9.1f\n",
+           (unsigned) (image_blocks + final_blocks), t_full * 1000.0, read_back_ms);
+    printf("init packet verify    %6u*  %8.4f   %9.1f\n",
+           (unsigned) verify_steps, t_verify * 1000.0, verify_ms);
+    printf("  longest step                           %9.1f\n", longest_ms);
+    printf("                      * steps, %u field multiplies and %u adds\n",
+           (unsigned) ed25519_mul_count, (unsigned) ed25519_add_count);
+    printf("\n");
+
+    if (validate_ms > VALIDATE_BUDGET_MS) {
+        printf("FAIL: validation, %.1f ms, exceeds %d ms\n", validate_ms, VALIDATE_BUDGET_MS);
+        result = 1;
+    }
+    else {
+        printf("PASS: validation, %.1f ms, within %d ms\n", validate_ms, VALIDATE_BUDGET_MS);
+    }
+
+    if ((longest_ms > STEP_BUDGET_MS) || (verify_ms > INIT_BUDGET_MS)) {
+        printf("FAIL: signature check, %.1f ms in steps of up to %.1f ms, exceeds %d ms or %d ms\n",
+               verify_ms, longest_ms, INIT_BUDGET_MS, STEP_BUDGET_MS);
+        result = 1;
+    }
+    else {
+        printf("PASS: signature check, %.1f ms in steps of up to %.1f ms, within %d ms and %d ms\n",
+               verify_ms, longest_ms, INIT_BUDGET_MS, STEP_BUDGET_MS);
+    }
+
+    if ((longest_ms > WDT_TIMEOUT_MS) || (read_back_ms > WDT_TIMEOUT_MS)) {
+        printf("FAIL: signature check step or read-back hash exceeds the %d ms watchdog\n",
+               WDT_TIMEOUT_MS);
+        result = 1;
+    }
+    else {
+        printf("PASS: signature check steps and read-back hash each within the %d ms watchdog\n",
+               WDT_TIMEOUT_MS);
+    }
+
+    return result;
+}
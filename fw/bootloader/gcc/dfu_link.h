@@ -0,0 +1,67 @@
+/*
+ *   dfu_link.h  -- DFU transports for the dfu_batch host tool.
+ *
+ *   A link is a connection to one device's DFU service, as exposed by
+ *   dfu_transport_ble.c: writes to the Control Point and Packet
+ *   characteristics, and Control Point notifications back.  dfu_batch
+ *   drives the procedures; a backend only moves bytes.
+ *
+ *   To add a transport, fill in a dfu_link_ops_t and list it in
+ *   m_links[] in dfu_batch.c.  Every function is called from the one
+ *   session thread that opened the link, but links of different devices
+ *   are used concurrently.
+ */
+#ifndef DFU_LINK_H__
+#define DFU_LINK_H__
+
+#include <stdint.h>
+
+#define DFU_LINK_CONTROL_POINT   0     /* DFU Control Point characteristic   */
+#define DFU_LINK_PACKET          1     /* DFU Packet characteristic          */
+
+#define DFU_LINK_OK              0
+#define DFU_LINK_TIMEOUT         0     /* no notification within the timeout */
+#define DFU_LINK_LOST           -1     /* disconnected, the link must be closed */
+
+typedef struct dfu_link dfu_link_t;
+
+typedef struct {
+    const char * name;
+
+    /*
+     *  Connect to device, a backend specific address.  options is the
+     *  backend option string given to dfu_batch, or NULL.  Returns NULL
+     *  if the device can not be reached.
+     */
+    dfu_link_t * (*open)(const char * device, const char * options);
+
+    /*
+     *  Write to a characteristic: with response to the Control Point,
+     *  without response to the Packet.  Returns DFU_LINK_OK or
+     *  DFU_LINK_LOST.
+     */
+    int (*write)(dfu_link_t * p_link, int characteristic,
+                 const uint8_t * p_data, uint32_t length);
+
+    /*
+     *  Wait for the next Control Point notification.  Returns its length,
+     *  DFU_LINK_TIMEOUT or DFU_LINK_LOST.
+     */
+    int (*notification)(dfu_link_t * p_link, uint8_t * p_data, uint32_t size,
+                        uint32_t timeout_ms);
+
+    /*
+     *  Time on the link since it was opened, in microseconds.  Wall clock
+     *  for real transports, simulated time for the simulator.
+     */
+    uint64_t (*time_us)(dfu_link_t * p_link);
+
+    void (*close)(dfu_link_t * p_link);
+} dfu_link_ops_t;
+
+/*
+ *  Simulated devices, see dfu_sim.c.
+ */
+extern const dfu_link_ops_t dfu_sim_link;
+
+#endif // DFU_LINK_H__
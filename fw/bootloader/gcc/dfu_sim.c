@@ -0,0 +1,723 @@
+/*
+ *   dfu_sim.c  -- simulated devices for the dfu_batch host tool.
+ *
+ *   Each device is the single bank bootloader's DFU service as seen over
+ *   the air: the Control Point procedures of dfu_transport_ble.c and the
+ *   checks of dfu_single_bank.c and dfu_init.c, on a RAM copy of the
+ *   application region.  Images are checked with the bootloader's own
+ *   crc16.c and sha256.c, and compressed images decoded with dfu_lz.c.
+ *   Ed25519 signatures are not checked, there is no trusted key here.
+ *
+ *   Time is simulated, so a batch runs as fast as the host allows while
+ *   throughput is reported as the devices would see it: a connection
+ *   interval with a number of packets per interval, flash page erase
+ *   times, and link loss.  A device keeps its state between links, so a
+ *   reconnect resumes an interrupted transfer as the bootloader does.
+ *
+ *   Options, comma separated:
+ *     interval=MS   connection interval, default 15
+ *     ppi=N         data packets per connection interval, default 4
+ *     loss=P        link loss probability per write, default 0
+ *     corrupt=P     data packet corruption probability, default 0
+ *     type=N        device type, default 0xFFFF (any image)
+ *     rev=N         device revision, default 0xFFFF (any image)
+ *     sd=N          SoftDevice firmware ID, default 0x0064 (S110 8.0)
+ *     seed=N        random seed, default 1
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "crc16.h"
+#include "sha256.h"
+#include "dfu_lz.h"
+#include "dfu_link.h"
+
+#define SIM_DEVICES_MAX         256
+#define SIM_FLASH_SIZE          0x20000         /* power of two, a dfu_lz ring     */
+#define IMAGE_MAX_SIZE          (116 * 1024)    /* App region, see bootloader_ac.ld */
+#define CODE_PAGE_SIZE          1024
+
+#define CONNECT_US              1000000         /* scan, connect and discovery    */
+#define PAGE_ERASE_US           21000           /* nRF51 page erase               */
+#define VALIDATE_US_PER_KB      250             /* CRC-16 of 1K on the nRF51      */
+#define NOTIFICATIONS_MAX       8
+
+/* Control Point procedures, and the notifications in reply. */
+#define OP_START                1
+#define OP_INIT                 2
+#define OP_RECEIVE              3
+#define OP_VALIDATE             4
+#define OP_ACTIVATE             5
+#define OP_RESET                6
+#define OP_REPORT               7
+#define OP_PRN_REQUEST          8
+#define OP_RESPONSE             0x10
+#define OP_PRN                  0x11
+
+#define RESP_SUCCESS            1
+#define RESP_INVALID_STATE      2
+#define RESP_NOT_SUPPORTED      3
+#define RESP_DATA_SIZE          4
+#define RESP_CRC_ERROR          5
+#define RESP_OPER_FAILED        6
+
+/* Update modes, see dfu_types.h. */
+#define MODE_SD                 0x01
+#define MODE_BL                 0x02
+#define MODE_APP                0x04
+#define MODE_RESUME             0x08
+#define MODE_DELTA              0x10
+#define MODE_COMPRESSED         0x20
+
+/* Init packet, see dfu_init.h and dfu_init.c. */
+#define INIT_SOFTDEVICE_OFFSET  10
+#define INIT_EXT_LENGTH_MIN     2
+#define INIT_EXT_LENGTH_MAX     104
+#define INIT_EXT_LENGTH_SIGNED  100
+#define INIT_EXT_HASH_OFFSET    4
+#define INIT_LENGTH_MAX         (INIT_SOFTDEVICE_OFFSET + 2 * 16 + INIT_EXT_LENGTH_MAX)
+#define DEVICE_TYPE_EMPTY       0xFFFF
+#define DEVICE_REVISION_EMPTY   0xFFFF
+#define SOFTDEVICE_ANY          0xFFFE
+
+enum {
+    STATE_IDLE,
+    STATE_START_PKT,        /* START written, waiting for the image sizes */
+    STATE_RDY,
+    STATE_RX_INIT_PKT,
+    STATE_INIT_DONE,
+    STATE_RX_DATA_PKT,
+    STATE_DATA_DONE,
+    STATE_VALIDATED,
+};
+
+/*
+ *  A device, kept from one link to the next.
+ */
+typedef struct {
+    char      name[32];
+    int       in_use;
+    uint32_t  rng;
+    uint16_t  device_type;
+    uint16_t  device_rev;
+    uint16_t  softdevice;
+    uint32_t  app_size;             /* installed application              */
+    uint16_t  app_crc;
+    uint32_t  activations;
+    uint32_t  resume_size;          /* resume point, as in the settings   */
+    uint32_t  resume_offset;
+    uint16_t  resume_init_crc;
+    uint8_t * flash;                /* application region                 */
+} sim_device_t;
+
+struct dfu_link {
+    sim_device_t * p_device;
+    uint64_t       interval_us;
+    uint32_t       ppi;
+    double         loss;
+    double         corrupt;
+    uint64_t       time_us;
+    int            lost;
+    int            state;
+    uint8_t        mode;
+    uint32_t       image_size;      /* bytes transferred                  */
+    uint32_t       received;
+    uint32_t       prn;
+    uint32_t       prn_count;
+    uint8_t        init[INIT_LENGTH_MAX];
+    uint32_t       init_length;
+    dfu_lz_ctx_t   lz;
+    uint8_t        notif[NOTIFICATIONS_MAX][8];
+    uint32_t       notif_length[NOTIFICATIONS_MAX];
+    uint64_t       notif_time[NOTIFICATIONS_MAX];
+    uint32_t       notif_head;
+    uint32_t       notif_count;
+};
+
+static sim_device_t    m_devices[SIM_DEVICES_MAX];
+static uint32_t        m_device_count;
+static pthread_mutex_t m_devices_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t get_le32(const uint8_t * p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t get_le16(const uint8_t * p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+/*
+ *  xorshift32, per device so a batch is repeatable whatever the thread
+ *  scheduling.
+ */
+static double sim_random(sim_device_t * p_device)
+{
+    uint32_t x = p_device->rng;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    p_device->rng = x;
+
+    return (double) x / 4294967296.0;
+}
+
+static uint32_t name_hash(const char * name)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*name)
+        hash = (hash ^ (uint8_t) *name++) * 16777619u;
+
+    return hash;
+}
+
+static const char * option_get(const char * options, const char * key)
+{
+    size_t key_length = strlen(key);
+
+    while (options != NULL && *options) {
+        if (strncmp(options, key, key_length) == 0 && options[key_length] == '=')
+            return options + key_length + 1;
+
+        options = strchr(options, ',');
+        if (options != NULL)
+            options++;
+    }
+
+    return NULL;
+}
+
+static double option_double(const char * options, const char * key, double value)
+{
+    const char * p = option_get(options, key);
+
+    return (p != NULL) ? strtod(p, NULL) : value;
+}
+
+static uint32_t option_u32(const char * options, const char * key, uint32_t value)
+{
+    const char * p = option_get(options, key);
+
+    return (p != NULL) ? (uint32_t) strtoul(p, NULL, 0) : value;
+}
+
+/*
+ *  Queue a notification, sent delay_us from now.
+ */
+static void notify(dfu_link_t * p_link, const uint8_t * p_data, uint32_t length,
+                   uint64_t delay_us)
+{
+    uint32_t index;
+
+    if (p_link->notif_count == NOTIFICATIONS_MAX)
+        return;
+
+    index = (p_link->notif_head + p_link->notif_count) % NOTIFICATIONS_MAX;
+    memcpy(p_link->notif[index], p_data, length);
+    p_link->notif_length[index] = length;
+    p_link->notif_time[index]   = p_link->time_us + delay_us;
+    p_link->notif_count++;
+}
+
+static void respond(dfu_link_t * p_link, uint8_t op, uint8_t status, uint64_t delay_us)
+{
+    uint8_t response[3] = { OP_RESPONSE, op, status };
+
+    notify(p_link, response, sizeof(response), delay_us);
+}
+
+/*
+ *  Link loss.  As dfu_suspend() does, an interrupted transfer keeps the
+ *  complete pages received, to be resumed on the next link.
+ */
+static void link_lose(dfu_link_t * p_link)
+{
+    sim_device_t * p_device = p_link->p_device;
+
+    if (p_link->state == STATE_RX_DATA_PKT &&
+        !(p_link->mode & (MODE_DELTA | MODE_COMPRESSED)) &&
+        p_link->received >= CODE_PAGE_SIZE) {
+        p_device->resume_size     = p_link->image_size;
+        p_device->resume_offset   = p_link->received & ~(CODE_PAGE_SIZE - 1);
+        p_device->resume_init_crc = crc16_compute(p_link->init, p_link->init_length, NULL);
+    }
+
+    p_link->lost        = 1;
+    p_link->notif_count = 0;
+}
+
+/*
+ *  Image sizes of the START procedure, see dfu_start_pkt_handle().
+ */
+static void start_packet(dfu_link_t * p_link, const uint8_t * p_data, uint32_t length)
+{
+    sim_device_t * p_device = p_link->p_device;
+    uint32_t       sd_size;
+    uint32_t       bl_size;
+    uint32_t       app_size;
+    uint32_t       offset = 0;
+
+    if (length != 12) {
+        respond(p_link, OP_START, RESP_NOT_SUPPORTED, 0);
+        p_link->state = STATE_IDLE;
+        return;
+    }
+
+    sd_size  = get_le32(p_data);
+    bl_size  = get_le32(p_data + 4);
+    app_size = get_le32(p_data + 8);
+
+    /* The simulated bootloader only takes applications. */
+    if (!(p_link->mode & MODE_APP) || (p_link->mode & (MODE_SD | MODE_BL | MODE_DELTA))) {
+        respond(p_link, OP_START, RESP_NOT_SUPPORTED, 0);
+        p_link->state = STATE_IDLE;
+        return;
+    }
+
+    if (sd_size != 0 || bl_size != 0 || app_size == 0 || (app_size & 3) ||
+        app_size > IMAGE_MAX_SIZE) {
+        respond(p_link, OP_START, RESP_DATA_SIZE, 0);
+        p_link->state = STATE_IDLE;
+        return;
+    }
+
+    p_link->image_size  = app_size;
+    p_link->received    = 0;
+    p_link->init_length = 0;
+
+    if ((p_link->mode & MODE_RESUME) && !(p_link->mode & MODE_COMPRESSED) &&
+        p_device->resume_size == app_size)
+        offset = p_device->resume_offset;
+    else
+        p_device->resume_size = 0;
+
+    /* Only the pages above the resume point are erased. */
+    memset(p_device->flash + offset, 0xFF, SIM_FLASH_SIZE - offset);
+    p_link->received = offset;
+
+    p_link->state = STATE_RDY;
+    respond(p_link, OP_START, RESP_SUCCESS,
+            (uint64_t) ((app_size - offset + CODE_PAGE_SIZE - 1) / CODE_PAGE_SIZE) * PAGE_ERASE_US);
+}
+
+/*
+ *  Init packet checks of dfu_init_prevalidate(), but the signature.
+ */
+static uint8_t init_check(dfu_link_t * p_link)
+{
+    sim_device_t * p_device = p_link->p_device;
+    uint32_t       softdevice_len;
+    uint32_t       ext_length;
+    uint32_t       i;
+
+    if (p_link->init_length < INIT_SOFTDEVICE_OFFSET)
+        return RESP_OPER_FAILED;
+
+    softdevice_len = get_le16(&p_link->init[8]);
+    if (p_link->init_length < INIT_SOFTDEVICE_OFFSET + 2 * softdevice_len)
+        return RESP_OPER_FAILED;
+
+    ext_length = p_link->init_length - (INIT_SOFTDEVICE_OFFSET + 2 * softdevice_len);
+    if (ext_length < INIT_EXT_LENGTH_MIN || ext_length > INIT_EXT_LENGTH_MAX)
+        return RESP_OPER_FAILED;
+
+    if (p_device->device_type != DEVICE_TYPE_EMPTY &&
+        get_le16(&p_link->init[0]) != p_device->device_type)
+        return RESP_OPER_FAILED;
+
+    if (p_device->device_rev != DEVICE_REVISION_EMPTY &&
+        get_le16(&p_link->init[2]) != p_device->device_rev)
+        return RESP_OPER_FAILED;
+
+    for (i = 0; i < softdevice_len; i++) {
+        uint16_t softdevice = get_le16(&p_link->init[INIT_SOFTDEVICE_OFFSET + 2 * i]);
+
+        if (softdevice == SOFTDEVICE_ANY || softdevice == p_device->softdevice)
+            return RESP_SUCCESS;
+    }
+
+    return RESP_OPER_FAILED;
+}
+
+static void init_complete(dfu_link_t * p_link)
+{
+    sim_device_t * p_device = p_link->p_device;
+    uint8_t        status   = init_check(p_link);
+
+    /* Only the transfer which was interrupted is resumed, see dfu_resume_init_check(). */
+    if (p_link->received != 0 &&
+        crc16_compute(p_link->init, p_link->init_length, NULL) != p_device->resume_init_crc) {
+        memset(p_device->flash, 0xFF, p_link->received);
+        p_link->received      = 0;
+        p_device->resume_size = 0;
+    }
+
+    if (status == RESP_SUCCESS) {
+        p_link->state = STATE_INIT_DONE;
+        dfu_lz_init(&p_link->lz);
+    }
+    else {
+        p_link->state = STATE_IDLE;
+    }
+
+    respond(p_link, OP_INIT, status, 0);
+}
+
+/*
+ *  Size of the image in flash, the decoded size of a compressed image.
+ */
+static uint32_t image_length(dfu_link_t * p_link)
+{
+    return (p_link->mode & MODE_COMPRESSED) ? p_link->lz.size : p_link->image_size;
+}
+
+static void data_packet(dfu_link_t * p_link, const uint8_t * p_data, uint32_t length)
+{
+    sim_device_t * p_device = p_link->p_device;
+    uint8_t        packet[32];
+    uint8_t        prn[5];
+
+    if ((length & 3) || length > sizeof(packet)) {
+        respond(p_link, OP_RECEIVE, RESP_NOT_SUPPORTED, 0);
+        return;
+    }
+
+    if (p_link->received + length > p_link->image_size) {
+        p_link->state = STATE_IDLE;
+        respond(p_link, OP_RECEIVE, RESP_DATA_SIZE, 0);
+        return;
+    }
+
+    memcpy(packet, p_data, length);
+    if (sim_random(p_device) < p_link->corrupt)
+        packet[(uint32_t)(sim_random(p_device) * length)] ^= 0x01;
+
+    if (p_link->mode & MODE_COMPRESSED) {
+        int32_t used = dfu_lz_decode(&p_link->lz, packet, length, p_device->flash,
+                                     SIM_FLASH_SIZE, IMAGE_MAX_SIZE);
+
+        if (used < 0 || (p_link->lz.header_length == DFU_LZ_HEADER_SIZE &&
+                         (p_link->lz.size > IMAGE_MAX_SIZE || (p_link->lz.size & 3)))) {
+            p_link->state = STATE_IDLE;
+            respond(p_link, OP_RECEIVE, RESP_OPER_FAILED, 0);
+            return;
+        }
+    }
+    else {
+        memcpy(p_device->flash + p_link->received, packet, length);
+    }
+
+    p_link->received += length;
+
+    if (p_link->received == p_link->image_size) {
+        p_link->state = STATE_DATA_DONE;
+        respond(p_link, OP_RECEIVE, RESP_SUCCESS, 0);
+        return;
+    }
+
+    if (p_link->prn != 0 && ++p_link->prn_count == p_link->prn) {
+        p_link->prn_count = 0;
+        prn[0] = OP_PRN;
+        prn[1] = (uint8_t) p_link->received;
+        prn[2] = (uint8_t)(p_link->received >> 8);
+        prn[3] = (uint8_t)(p_link->received >> 16);
+        prn[4] = (uint8_t)(p_link->received >> 24);
+        notify(p_link, prn, sizeof(prn), 0);
+    }
+}
+
+/*
+ *  Check the image against the init packet, see dfu_init_postvalidate().
+ */
+static void validate(dfu_link_t * p_link)
+{
+    sim_device_t * p_device = p_link->p_device;
+    uint32_t       softdevice_len = get_le16(&p_link->init[8]);
+    uint8_t      * p_ext = &p_link->init[INIT_SOFTDEVICE_OFFSET + 2 * softdevice_len];
+    uint32_t       ext_length = p_link->init_length - (INIT_SOFTDEVICE_OFFSET + 2 * softdevice_len);
+    uint32_t       length = image_length(p_link);
+    uint8_t        status = RESP_SUCCESS;
+
+    if ((p_link->mode & MODE_COMPRESSED) && p_link->lz.out != p_link->lz.size) {
+        status = RESP_CRC_ERROR;
+    }
+    else if (ext_length == INIT_EXT_LENGTH_SIGNED) {
+        sha256_ctx_t sha256;
+        uint8_t      hash[SHA256_DIGEST_SIZE];
+
+        sha256_init(&sha256);
+        sha256_update(&sha256, p_device->flash, length);
+        sha256_final(&sha256, hash);
+
+        if (memcmp(hash, p_ext + INIT_EXT_HASH_OFFSET, SHA256_DIGEST_SIZE) != 0)
+            status = RESP_CRC_ERROR;
+    }
+    else if (crc16_compute(p_device->flash, length, NULL) != get_le16(p_ext)) {
+        status = RESP_CRC_ERROR;
+    }
+
+    /* A failed image is not resumed. */
+    p_device->resume_size = 0;
+    p_link->state = (status == RESP_SUCCESS) ? STATE_VALIDATED : STATE_IDLE;
+
+    respond(p_link, OP_VALIDATE, status,
+            (uint64_t) ((length + 1023) / 1024) * VALIDATE_US_PER_KB);
+}
+
+static void control_point(dfu_link_t * p_link, const uint8_t * p_data, uint32_t length)
+{
+    sim_device_t * p_device = p_link->p_device;
+    uint8_t        report[7];
+
+    if (length == 0)
+        return;
+
+    switch (p_data[0]) {
+
+    case OP_START:
+        p_link->mode  = (length > 1) ? p_data[1] : MODE_APP;
+        p_link->state = STATE_START_PKT;
+        break;
+
+    case OP_INIT:
+        if (length > 1 && p_data[1] == 1) {
+            if (p_link->state == STATE_RX_INIT_PKT)
+                init_complete(p_link);
+            else
+                respond(p_link, OP_INIT, RESP_INVALID_STATE, 0);
+        }
+        else if (p_link->state == STATE_RDY) {
+            p_link->state       = STATE_RX_INIT_PKT;
+            p_link->init_length = 0;
+        }
+        else {
+            respond(p_link, OP_INIT, RESP_INVALID_STATE, 0);
+        }
+        break;
+
+    case OP_RECEIVE:
+        if (p_link->state == STATE_INIT_DONE) {
+            p_link->state     = STATE_RX_DATA_PKT;
+            p_link->prn_count = 0;
+        }
+        else {
+            respond(p_link, OP_RECEIVE, RESP_INVALID_STATE, 0);
+        }
+        break;
+
+    case OP_VALIDATE:
+        if (p_link->state == STATE_DATA_DONE)
+            validate(p_link);
+        else
+            respond(p_link, OP_VALIDATE, RESP_INVALID_STATE, 0);
+        break;
+
+    case OP_ACTIVATE:
+        if (p_link->state == STATE_VALIDATED) {
+            p_device->app_size = image_length(p_link);
+            p_device->app_crc  = crc16_compute(p_device->flash, p_device->app_size, NULL);
+            p_device->activations++;
+        }
+        /* The device resets, and so does the link. */
+        link_lose(p_link);
+        break;
+
+    case OP_RESET:
+        link_lose(p_link);
+        break;
+
+    case OP_REPORT:
+        report[0] = OP_RESPONSE;
+        report[1] = OP_REPORT;
+        report[2] = RESP_SUCCESS;
+        report[3] = (uint8_t) p_link->received;
+        report[4] = (uint8_t)(p_link->received >> 8);
+        report[5] = (uint8_t)(p_link->received >> 16);
+        report[6] = (uint8_t)(p_link->received >> 24);
+        notify(p_link, report, sizeof(report), 0);
+        break;
+
+    case OP_PRN_REQUEST:
+        p_link->prn       = (length >= 3) ? get_le16(&p_data[1]) : 0;
+        p_link->prn_count = 0;
+        break;
+
+    default:
+        respond(p_link, p_data[0], RESP_NOT_SUPPORTED, 0);
+        break;
+    }
+}
+
+static dfu_link_t * sim_open(const char * device, const char * options)
+{
+    sim_device_t * p_device = NULL;
+    dfu_link_t   * p_link;
+    uint32_t       i;
+
+    pthread_mutex_lock(&m_devices_lock);
+
+    for (i = 0; i < m_device_count; i++) {
+        if (strcmp(m_devices[i].name, device) == 0) {
+            p_device = &m_devices[i];
+            break;
+        }
+    }
+
+    if (p_device == NULL && m_device_count < SIM_DEVICES_MAX) {
+        p_device = &m_devices[m_device_count];
+        p_device->flash = (uint8_t*) malloc(SIM_FLASH_SIZE);
+        if (p_device->flash != NULL) {
+            m_device_count++;
+            snprintf(p_device->name, sizeof(p_device->name), "%s", device);
+            p_device->rng         = name_hash(device) ^ option_u32(options, "seed", 1);
+            p_device->rng        |= 1;
+            p_device->device_type = (uint16_t) option_u32(options, "type", DEVICE_TYPE_EMPTY);
+            p_device->device_rev  = (uint16_t) option_u32(options, "rev", DEVICE_REVISION_EMPTY);
+            p_device->softdevice  = (uint16_t) option_u32(options, "sd", 0x0064);
+            memset(p_device->flash, 0xFF, SIM_FLASH_SIZE);
+        }
+        else {
+            p_device = NULL;
+        }
+    }
+
+    if (p_device == NULL || p_device->in_use) {
+        pthread_mutex_unlock(&m_devices_lock);
+        return NULL;
+    }
+    p_device->in_use = 1;
+
+    pthread_mutex_unlock(&m_devices_lock);
+
+    p_link = (dfu_link_t*) calloc(1, sizeof(dfu_link_t));
+    if (p_link == NULL) {
+        p_device->in_use = 0;
+        return NULL;
+    }
+
+    p_link->p_device    = p_device;
+    p_link->interval_us = (uint64_t)(option_double(options, "interval", 15.0) * 1000);
+    p_link->ppi         = option_u32(options, "ppi", 4);
+    p_link->loss        = option_double(options, "loss", 0.0);
+    p_link->corrupt     = option_double(options, "corrupt", 0.0);
+    p_link->time_us     = CONNECT_US;
+    p_link->state       = STATE_IDLE;
+
+    if (p_link->ppi == 0)
+        p_link->ppi = 1;
+
+    return p_link;
+}
+
+static int sim_write(dfu_link_t * p_link, int characteristic,
+                     const uint8_t * p_data, uint32_t length)
+{
+    if (p_link->lost)
+        return DFU_LINK_LOST;
+
+    if (sim_random(p_link->p_device) < p_link->loss) {
+        link_lose(p_link);
+        return DFU_LINK_LOST;
+    }
+
+    if (characteristic == DFU_LINK_CONTROL_POINT) {
+        /* A write request takes a connection interval for its response. */
+        p_link->time_us += p_link->interval_us;
+        control_point(p_link, p_data, length);
+        return DFU_LINK_OK;
+    }
+
+    p_link->time_us += p_link->interval_us / p_link->ppi;
+
+    switch (p_link->state) {
+
+    case STATE_START_PKT:
+        start_packet(p_link, p_data, length);
+        break;
+
+    case STATE_RX_INIT_PKT:
+        if (p_link->init_length + length > INIT_LENGTH_MAX) {
+            p_link->state = STATE_IDLE;
+            respond(p_link, OP_INIT, RESP_OPER_FAILED, 0);
+            break;
+        }
+        memcpy(&p_link->init[p_link->init_length], p_data, length);
+        p_link->init_length += length;
+        break;
+
+    case STATE_RX_DATA_PKT:
+        data_packet(p_link, p_data, length);
+        break;
+
+    default:
+        /* Ignored, as by dfu_transport_ble.c without a procedure. */
+        break;
+    }
+
+    return DFU_LINK_OK;
+}
+
+static int sim_notification(dfu_link_t * p_link, uint8_t * p_data, uint32_t size,
+                            uint32_t timeout_ms)
+{
+    uint32_t length;
+    uint32_t head = p_link->notif_head;
+
+    if (p_link->notif_count == 0) {
+        if (p_link->lost)
+            return DFU_LINK_LOST;
+
+        p_link->time_us += (uint64_t) timeout_ms * 1000;
+        return DFU_LINK_TIMEOUT;
+    }
+
+    if (p_link->notif_time[head] > p_link->time_us)
+        p_link->time_us = p_link->notif_time[head];
+
+    /* A notification takes up to a connection interval to arrive. */
+    p_link->time_us += p_link->interval_us / 2;
+
+    length = p_link->notif_length[head];
+    if (length > size)
+        length = size;
+    memcpy(p_data, p_link->notif[head], length);
+
+    p_link->notif_head = (head + 1) % NOTIFICATIONS_MAX;
+    p_link->notif_count--;
+
+    return (int) length;
+}
+
+static uint64_t sim_time_us(dfu_link_t * p_link)
+{
+    return p_link->time_us;
+}
+
+static void sim_close(dfu_link_t * p_link)
+{
+    sim_device_t * p_device = p_link->p_device;
+
+    if (!p_link->lost)
+        link_lose(p_link);
+
+    pthread_mutex_lock(&m_devices_lock);
+    p_device->in_use = 0;
+    pthread_mutex_unlock(&m_devices_lock);
+
+    free(p_link);
+}
+
+const dfu_link_ops_t dfu_sim_link = {
+    .name         = "sim",
+    .open         = sim_open,
+    .write        = sim_write,
+    .notification = sim_notification,
+    .time_us      = sim_time_us,
+    .close        = sim_close,
+};
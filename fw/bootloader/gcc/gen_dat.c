@@ -1,7 +1,30 @@
 /*
- *   gen_dat.c  -- generate a *.dat file from a *.bin file
+ *   gen_dat.c  -- build a DFU package: init packet (*.dat), manifest and zip
  *
- *   Compile:  gcc gen_dat.c -o gen_dat
+ *   Compile:  make -f gen_dat.mk
+ *             The CRC-16 is the bootloader's own crc16.c, built with the
+ *             slice-by-8 table variant; signing uses its sha256.c and
+ *             ed25519.c.
+ *   Usage:    gen_dat [options] bin-filename dat-filename
+ *             gen_dat [options] -f variants-filename
+ *               -t type        device type, default 0xffff (any)
+ *               -r rev         device revision, default 0xffff (any)
+ *               -a version     application version, default 0xffffffff
+ *               -s id[,id...]  supported SoftDevice firmware IDs, default
+ *                              0x005a,0x0064 (S110 7.1 and 8.0)
+ *               -k key         sign for SIGNING_SUPPORT bootloaders, with
+ *                              a key from "sign_dat genkey"
+ *               -m manifest    write the manifest (JSON) with the image
+ *                              size, CRC-16 and SHA-256
+ *               -z zip         write a DFU zip of the bin, dat and manifest
+ *               -j jobs        variants built at once, default 4
+ *
+ *             A variants file lists one package per line, as arguments
+ *             to gen_dat without -f and -j: options then bin-filename and
+ *             dat-filename.  Line options override those of the command
+ *             line.  Blank lines and lines starting with # are skipped.
+ *
+ *             The bin file is read in blocks, twice with -z.
  *   NOTE:     move executable to app's gcc directory.
  */
 #include <stdint.h>
@@ -9,128 +32,707 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "crc16.h"
+#include "sha256.h"
+#include "ed25519.h"
+
+#define SOFTDEVICES_MAX         16
+#define BLOCK_SIZE              4096
+#define JOBS_MAX                64
+#define LINE_MAX_LENGTH         1024
+#define ARGS_MAX                32
 
 /*
- *  Minimalistic INIT file structure
- *  See Nordic docs for INIT (*.dat) file format details.
+ *  INIT file layout, see Nordic docs and dfu_init.c:
+ *    device_type, device_rev (16 bits), app_version (32 bits),
+ *    softdevice_len (16 bits), softdevice[softdevice_len] (16 bits),
+ *    then the extended packet: CRC-16 of the image, and when signed two
+ *    reserved bytes, the image SHA-256 and an Ed25519 signature of all
+ *    bytes before it.
  */
+#define DAT_LENGTH_MAX          (10 + 2 * SOFTDEVICES_MAX + 2 + 2 + \
+                                 SHA256_DIGEST_SIZE + ED25519_SIGNATURE_SIZE)
+#define DAT_EXT_RESERVED_SIZE   2
+
+#define MANIFEST_LENGTH_MAX     2048
+
 typedef struct {
-    uint16_t device_type;
-    uint16_t device_rev;
-    uint32_t app_version;
-    uint16_t softdevice_len;
-    uint16_t softdevice_1;
-    uint16_t softdevice_2;
-    uint16_t crc;
-} dfu_init_t;
-
-static dfu_init_t dfu_init = {
+    const char * binfilename;
+    const char * datfilename;
+    const char * manifestfilename;
+    const char * zipfilename;
+    const char * keyfilename;
+    uint16_t     device_type;
+    uint16_t     device_rev;
+    uint32_t     app_version;
+    uint16_t     softdevice[SOFTDEVICES_MAX];
+    uint32_t     softdevice_len;
+    int          result;
+} variant_t;
+
+/*
+ *  One pass over the image.
+ */
+typedef struct {
+    uint32_t size;
+    uint16_t crc16;
+    uint32_t crc32;                 /* for the zip */
+    uint8_t  sha256[SHA256_DIGEST_SIZE];
+} image_t;
+
+static const variant_t m_defaults = {
     .device_type    = 0xffff,
     .device_rev     = 0xffff,
     .app_version    = 0xffffffff,
-    .softdevice_len = 0x0002,
-    .softdevice_1   = 0x005a,  // SoftDevice 7.1
-    .softdevice_2   = 0x0064,  // SoftDevice 8.0
-    .crc            = 0x0000,
+    .softdevice     = { 0x005a,    // SoftDevice 7.1
+                        0x0064 },  // SoftDevice 8.0
+    .softdevice_len = 2,
 };
 
+static uint32_t        m_crc32_table[256];
+
+static variant_t     * m_variants;
+static uint32_t        m_variant_count;
+static uint32_t        m_variant_next;
+static pthread_mutex_t m_variant_lock = PTHREAD_MUTEX_INITIALIZER;
+
 /*
- *  This CRC code was liberated from the Nordic SDK.
- *  That way it exactly matched the algrithm used by the bootloader.
+ *  CRC-32 of zip entries, table built before any thread starts.
  */
-uint16_t crc16_compute(const uint8_t * p_data,
-                       uint32_t size,
-                       const uint16_t * p_crc)
+static void crc32_init(void)
 {
     uint32_t i;
-    uint16_t crc = (p_crc == NULL) ? 0xffff : *p_crc;
+    uint32_t j;
+
+    for (i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (j = 0; j < 8; j++)
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+
+        m_crc32_table[i] = crc;
+    }
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t * p_data, size_t size)
+{
+    crc = ~crc;
+    while (size--)
+        crc = m_crc32_table[(crc ^ *p_data++) & 0xFF] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+static void put_le16(uint8_t * p, uint16_t value)
+{
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t)(value >> 8);
+}
 
-    for (i = 0; i < size; i++) {
-        crc  = (unsigned char)(crc >> 8) | (crc << 8);
-        crc ^= p_data[i];
-        crc ^= (unsigned char)(crc & 0xff) >> 4;
-        crc ^= (crc << 8) << 4;
-        crc ^= ((crc & 0xff) << 4) << 1;
+static void put_le32(uint8_t * p, uint32_t value)
+{
+    p[0] = (uint8_t) value;
+    p[1] = (uint8_t)(value >> 8);
+    p[2] = (uint8_t)(value >> 16);
+    p[3] = (uint8_t)(value >> 24);
+}
+
+static const char * base_name(const char * filename)
+{
+    const char * p = strrchr(filename, '/');
+    const char * q = strrchr(filename, '\\');
+
+    if (q > p)
+        p = q;
+
+    return (p != NULL) ? p + 1 : filename;
+}
+
+static int write_file(const char * filename, const uint8_t * data, size_t size)
+{
+    FILE * file;
+
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return -1;
     }
-    return crc;
+
+    if (fwrite(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s write failed\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    return fclose(file);
+}
+
+static int read_seed(const char * keyfilename, uint8_t * seed)
+{
+    FILE * file;
+
+    file = fopen(keyfilename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", keyfilename, strerror(errno));
+        return -1;
+    }
+
+    if (fread(seed, ED25519_SEED_SIZE, 1, file) != 1 || fgetc(file) != EOF) {
+        fprintf(stderr, "%s is not a %d byte key\n", keyfilename, ED25519_SEED_SIZE);
+        fclose(file);
+        return -1;
+    }
+
+    fclose(file);
+    return 0;
 }
 
 /*
- *  Given an input bin file, generate a matching dat file.
+ *  Size, CRC-16, CRC-32 and SHA-256 of the image, in one pass.
  */
-int main(int argc, char* argv[])
+static int image_scan(const char * binfilename, image_t * p_image)
 {
-    char * binfilename = NULL;
-    char * datfilename = NULL;
+    uint8_t      block[BLOCK_SIZE];
+    sha256_ctx_t sha256;
+    FILE       * file;
+    size_t       size;
 
-    FILE * binfile = NULL;
-    FILE * datfile = NULL;
+    file = fopen(binfilename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", binfilename, strerror(errno));
+        return -1;
+    }
 
-    size_t    binsize  = 0;
-    uint8_t * bindata  = NULL;
-    uint16_t  crc      = 0;
+    memset(p_image, 0, sizeof(image_t));
+    p_image->crc16 = 0xFFFF;    // Initial value used by crc16_compute.
+    sha256_init(&sha256);
 
-    /*
-     *  USAGE:  gen_dat  bin-filename dat-filename
-     */
-    if (argc < 3)
+    while ((size = fread(block, 1, sizeof(block), file)) > 0) {
+        p_image->size  += (uint32_t) size;
+        p_image->crc16  = crc16_compute(block, (uint32_t) size, &p_image->crc16);
+        p_image->crc32  = crc32_update(p_image->crc32, block, size);
+        sha256_update(&sha256, block, (uint32_t) size);
+    }
+
+    if (ferror(file) || p_image->size == 0) {
+        fprintf(stderr, "%s read failed\n", binfilename);
+        fclose(file);
         return -1;
+    }
 
-    binfilename = argv[1];
-    datfilename = argv[2];
+    fclose(file);
+    sha256_final(&sha256, p_image->sha256);
+    return 0;
+}
 
-    /* Open bin file for reads. */
-    binfile = fopen(binfilename, "r");
-    if (binfile == NULL) {
-        fprintf(stderr, "bin file open failed: %s\n", strerror(errno));
+/*
+ *  Build the init packet.  Returns its length, or 0 on error.
+ */
+static uint32_t dat_build(const variant_t * p_variant, const image_t * p_image, uint8_t * dat)
+{
+    uint8_t  seed[ED25519_SEED_SIZE];
+    uint32_t length = 0;
+    uint32_t i;
+
+    put_le16(&dat[length], p_variant->device_type);          length += 2;
+    put_le16(&dat[length], p_variant->device_rev);           length += 2;
+    put_le32(&dat[length], p_variant->app_version);          length += 4;
+    put_le16(&dat[length], (uint16_t) p_variant->softdevice_len); length += 2;
+
+    for (i = 0; i < p_variant->softdevice_len; i++) {
+        put_le16(&dat[length], p_variant->softdevice[i]);
+        length += 2;
+    }
+
+    put_le16(&dat[length], p_image->crc16);                  length += 2;
+
+    if (p_variant->keyfilename == NULL)
+        return length;
+
+    if (read_seed(p_variant->keyfilename, seed) != 0)
+        return 0;
+
+    memset(&dat[length], 0, DAT_EXT_RESERVED_SIZE);          length += DAT_EXT_RESERVED_SIZE;
+    memcpy(&dat[length], p_image->sha256, SHA256_DIGEST_SIZE); length += SHA256_DIGEST_SIZE;
+
+    ed25519_sign(&dat[length], dat, length, seed);
+    length += ED25519_SIGNATURE_SIZE;
+
+    return length;
+}
+
+/*
+ *  Manifest in the layout of Nordic's DFU zip files, with the image size
+ *  and SHA-256 added.  Returns its length.
+ */
+static uint32_t manifest_build(const variant_t * p_variant, const image_t * p_image,
+                               char * manifest, size_t size)
+{
+    char     softdevices[SOFTDEVICES_MAX * 8] = "";
+    char     sha256[2 * SHA256_DIGEST_SIZE + 1];
+    uint32_t i;
+    int      length;
+
+    for (i = 0; i < p_variant->softdevice_len; i++)
+        sprintf(softdevices + strlen(softdevices), "%s%u", i ? ", " : "",
+                (unsigned) p_variant->softdevice[i]);
+
+    for (i = 0; i < SHA256_DIGEST_SIZE; i++)
+        sprintf(&sha256[2 * i], "%02x", p_image->sha256[i]);
+
+    length = snprintf(manifest, size,
+        "{\n"
+        "    \"manifest\": {\n"
+        "        \"application\": {\n"
+        "            \"bin_file\": \"%s\",\n"
+        "            \"dat_file\": \"%s\",\n"
+        "            \"size\": %u,\n"
+        "            \"sha256\": \"%s\",\n"
+        "            \"signed\": %s,\n"
+        "            \"init_packet_data\": {\n"
+        "                \"application_version\": %u,\n"
+        "                \"device_revision\": %u,\n"
+        "                \"device_type\": %u,\n"
+        "                \"firmware_crc16\": %u,\n"
+        "                \"softdevice_req\": [%s]\n"
+        "            }\n"
+        "        },\n"
+        "        \"dfu_version\": 0.5\n"
+        "    }\n"
+        "}\n",
+        base_name(p_variant->binfilename),
+        base_name(p_variant->datfilename),
+        (unsigned) p_image->size,
+        sha256,
+        p_variant->keyfilename ? "true" : "false",
+        (unsigned) p_variant->app_version,
+        (unsigned) p_variant->device_rev,
+        (unsigned) p_variant->device_type,
+        (unsigned) p_image->crc16,
+        softdevices);
+
+    return (length > 0 && (size_t) length < size) ? (uint32_t) length : 0;
+}
+
+/*
+ *  Zip entries are stored, not deflated: the images hardly compress and
+ *  the DFU apps accept either.  The timestamp is fixed (1980-01-01) so
+ *  that a package is reproducible.
+ */
+typedef struct {
+    const char * name;
+    uint32_t     crc32;
+    uint32_t     size;
+    uint32_t     offset;
+} zip_entry_t;
+
+static int zip_local_header(FILE * file, zip_entry_t * p_entry, uint32_t * p_offset)
+{
+    uint8_t  header[30];
+    uint16_t name_length = (uint16_t) strlen(p_entry->name);
+
+    p_entry->offset = *p_offset;
+
+    put_le32(&header[0],  0x04034b50);
+    put_le16(&header[4],  10);                  /* version needed */
+    put_le16(&header[6],  0);                   /* flags          */
+    put_le16(&header[8],  0);                   /* stored         */
+    put_le16(&header[10], 0);                   /* time           */
+    put_le16(&header[12], 0x0021);              /* date           */
+    put_le32(&header[14], p_entry->crc32);
+    put_le32(&header[18], p_entry->size);
+    put_le32(&header[22], p_entry->size);
+    put_le16(&header[26], name_length);
+    put_le16(&header[28], 0);
+
+    if (fwrite(header, sizeof(header), 1, file) != 1 ||
+        fwrite(p_entry->name, name_length, 1, file) != 1)
         return -1;
+
+    *p_offset += sizeof(header) + name_length + p_entry->size;
+    return 0;
+}
+
+static int zip_directory(FILE * file, const zip_entry_t * p_entries, uint32_t count,
+                         uint32_t offset)
+{
+    uint8_t  header[46];
+    uint8_t  end[22];
+    uint32_t size = 0;
+    uint32_t i;
+
+    for (i = 0; i < count; i++) {
+        uint16_t name_length = (uint16_t) strlen(p_entries[i].name);
+
+        memset(header, 0, sizeof(header));
+        put_le32(&header[0],  0x02014b50);
+        put_le16(&header[4],  20);              /* version made by */
+        put_le16(&header[6],  10);              /* version needed  */
+        put_le16(&header[12], 0);               /* time            */
+        put_le16(&header[14], 0x0021);          /* date            */
+        put_le32(&header[16], p_entries[i].crc32);
+        put_le32(&header[20], p_entries[i].size);
+        put_le32(&header[24], p_entries[i].size);
+        put_le16(&header[28], name_length);
+        put_le32(&header[42], p_entries[i].offset);
+
+        if (fwrite(header, sizeof(header), 1, file) != 1 ||
+            fwrite(p_entries[i].name, name_length, 1, file) != 1)
+            return -1;
+
+        size += sizeof(header) + name_length;
     }
 
-    /* Open dat file for writes. */
-    datfile = fopen(datfilename, "wb");
-    if (datfile == NULL) {
-        fprintf(stderr, "dat file open failed: %s\n", strerror(errno));
-        fclose(binfile);
+    memset(end, 0, sizeof(end));
+    put_le32(&end[0],  0x06054b50);
+    put_le16(&end[8],  (uint16_t) count);
+    put_le16(&end[10], (uint16_t) count);
+    put_le32(&end[12], size);
+    put_le32(&end[16], offset);
+
+    return (fwrite(end, sizeof(end), 1, file) == 1) ? 0 : -1;
+}
+
+static int zip_write(const variant_t * p_variant, const image_t * p_image,
+                     const uint8_t * dat, uint32_t dat_length,
+                     const char * manifest, uint32_t manifest_length)
+{
+    uint8_t     block[BLOCK_SIZE];
+    zip_entry_t entries[3];
+    FILE      * zip;
+    FILE      * bin;
+    uint32_t    offset = 0;
+    uint32_t    copied = 0;
+    size_t      size;
+    int         result = -1;
+
+    entries[0].name  = base_name(p_variant->binfilename);
+    entries[0].crc32 = p_image->crc32;
+    entries[0].size  = p_image->size;
+    entries[1].name  = base_name(p_variant->datfilename);
+    entries[1].crc32 = crc32_update(0, dat, dat_length);
+    entries[1].size  = dat_length;
+    entries[2].name  = "manifest.json";
+    entries[2].crc32 = crc32_update(0, (const uint8_t*) manifest, manifest_length);
+    entries[2].size  = manifest_length;
+
+    bin = fopen(p_variant->binfilename, "rb");
+    if (bin == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", p_variant->binfilename, strerror(errno));
+        return -1;
+    }
+
+    zip = fopen(p_variant->zipfilename, "wb");
+    if (zip == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", p_variant->zipfilename, strerror(errno));
+        fclose(bin);
         return -1;
     }
 
-    /* Detrmine size of bin file in bytes. */
-    fseek(binfile, 0L, SEEK_END);
-    binsize = ftell(binfile);
-    fseek(binfile, 0L, SEEK_SET);
+    if (zip_local_header(zip, &entries[0], &offset) != 0)
+        goto done;
+
+    while ((size = fread(block, 1, sizeof(block), bin)) > 0) {
+        copied += (uint32_t) size;
+        if (copied > p_image->size || fwrite(block, size, 1, zip) != 1)
+            goto done;
+    }
+
+    /* The image must not have changed since it was scanned. */
+    if (copied != p_image->size) {
+        fprintf(stderr, "%s changed while packaging\n", p_variant->binfilename);
+        goto done;
+    }
+
+    if (zip_local_header(zip, &entries[1], &offset) != 0 ||
+        fwrite(dat, dat_length, 1, zip) != 1 ||
+        zip_local_header(zip, &entries[2], &offset) != 0 ||
+        fwrite(manifest, manifest_length, 1, zip) != 1 ||
+        zip_directory(zip, entries, 3, offset) != 0)
+        goto done;
+
+    result = 0;
+
+done:
+    fclose(bin);
+    if (fclose(zip) != 0)
+        result = -1;
+    if (result != 0)
+        fprintf(stderr, "%s write failed\n", p_variant->zipfilename);
+
+    return result;
+}
+
+static int package(const variant_t * p_variant)
+{
+    image_t  image;
+    uint8_t  dat[DAT_LENGTH_MAX];
+    char     manifest[MANIFEST_LENGTH_MAX];
+    uint32_t dat_length;
+    uint32_t manifest_length = 0;
+
+    if (image_scan(p_variant->binfilename, &image) != 0)
+        return -1;
 
-    if (binsize == 0) {
-        fprintf(stderr, "bin file size determination failed");
-        fclose(datfile);
-        fclose(binfile);
+    dat_length = dat_build(p_variant, &image, dat);
+    if (dat_length == 0)
         return -1;
+
+    if (write_file(p_variant->datfilename, dat, dat_length) != 0)
+        return -1;
+
+    if (p_variant->manifestfilename != NULL || p_variant->zipfilename != NULL) {
+        manifest_length = manifest_build(p_variant, &image, manifest, sizeof(manifest));
+        if (manifest_length == 0) {
+            fprintf(stderr, "%s: manifest too long\n", p_variant->datfilename);
+            return -1;
+        }
+    }
+
+    if (p_variant->manifestfilename != NULL &&
+        write_file(p_variant->manifestfilename, (uint8_t*) manifest, manifest_length) != 0)
+        return -1;
+
+    if (p_variant->zipfilename != NULL &&
+        zip_write(p_variant, &image, dat, dat_length, manifest, manifest_length) != 0)
+        return -1;
+
+    return 0;
+}
+
+static int parse_softdevices(variant_t * p_variant, const char * list)
+{
+    char * end;
+
+    p_variant->softdevice_len = 0;
+
+    while (*list) {
+        if (p_variant->softdevice_len == SOFTDEVICES_MAX)
+            return -1;
+
+        p_variant->softdevice[p_variant->softdevice_len++] = (uint16_t) strtoul(list, &end, 0);
+        if (end == list || (*end != ',' && *end != '\0'))
+            return -1;
+
+        list = (*end == ',') ? end + 1 : end;
+    }
+
+    return (p_variant->softdevice_len > 0) ? 0 : -1;
+}
+
+/*
+ *  Parse options and file names into p_variant.  -f and -j are only
+ *  taken when p_variants/p_jobs are given, i.e. on the command line.
+ *  Returns 0, or -1 on a usage error.
+ */
+static int parse_args(variant_t * p_variant, int argc, char * argv[],
+                      const char ** p_variants, uint32_t * p_jobs)
+{
+    int i;
+    int files = 0;
+
+    for (i = 0; i < argc; i++) {
+        const char * arg   = argv[i];
+        const char * value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+        if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0') {
+            if (files == 0)
+                p_variant->binfilename = arg;
+            else if (files == 1)
+                p_variant->datfilename = arg;
+            else
+                return -1;
+            files++;
+            continue;
+        }
+
+        if (value == NULL)
+            return -1;
+        i++;
+
+        switch (arg[1]) {
+        case 't': p_variant->device_type      = (uint16_t) strtoul(value, NULL, 0); break;
+        case 'r': p_variant->device_rev       = (uint16_t) strtoul(value, NULL, 0); break;
+        case 'a': p_variant->app_version      = (uint32_t) strtoul(value, NULL, 0); break;
+        case 'k': p_variant->keyfilename      = value;                              break;
+        case 'm': p_variant->manifestfilename = value;                              break;
+        case 'z': p_variant->zipfilename      = value;                              break;
+        case 's':
+            if (parse_softdevices(p_variant, value) != 0)
+                return -1;
+            break;
+        case 'f':
+            if (p_variants == NULL)
+                return -1;
+            *p_variants = value;
+            break;
+        case 'j':
+            if (p_jobs == NULL)
+                return -1;
+            *p_jobs = (uint32_t) strtoul(value, NULL, 0);
+            break;
+        default:
+            return -1;
+        }
     }
 
-    /* Allocate buffer to hold all of bin file. */
-    bindata = (uint8_t*) malloc(binsize);
-    if (bindata == NULL) {
-        fprintf(stderr, "malloc failed");
-        fclose(datfile);
-        fclose(binfile);
+    return 0;
+}
+
+/*
+ *  Read the variants file, each line on top of the command line options.
+ */
+static int read_variants(const char * filename, const variant_t * p_defaults)
+{
+    char      line[LINE_MAX_LENGTH];
+    char    * argv[ARGS_MAX];
+    FILE    * file;
+    uint32_t  number = 0;
+    int       i;
+
+    file = fopen(filename, "r");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
         return -1;
     }
 
-    /* Fill buffer with bin file data. */
-    fread(bindata, binsize, 1, binfile);
+    while (fgets(line, sizeof(line), file) != NULL) {
+        variant_t * p_variant;
+        char      * p = line;
+        int         argc = 0;
+
+        number++;
+
+        while (argc < ARGS_MAX) {
+            while (isspace((unsigned char) *p))
+                p++;
+            if (*p == '\0' || *p == '#')
+                break;
 
-    /* Compute CRC-16. */
-    dfu_init.crc = crc16_compute(bindata, binsize, 0);
+            argv[argc++] = p;
+            while (*p && !isspace((unsigned char) *p))
+                p++;
+            if (*p)
+                *p++ = '\0';
+        }
 
-    /* 
-     *  Write INIT file
-     */
-    fwrite(&dfu_init, sizeof(dfu_init_t), 1, datfile);
+        if (argc == 0)
+            continue;
 
-    /*
-     *  Close all files
-     */
-    fclose(datfile);
-    fclose(binfile);
+        p_variant = (variant_t*) realloc(m_variants, (m_variant_count + 1) * sizeof(variant_t));
+        if (p_variant == NULL) {
+            fclose(file);
+            return -1;
+        }
+        m_variants = p_variant;
+        p_variant  = &m_variants[m_variant_count];
+        *p_variant = *p_defaults;
 
+        /* The arguments point into line, which is reused. */
+        for (i = 0; i < argc; i++) {
+            argv[i] = strdup(argv[i]);
+            if (argv[i] == NULL) {
+                fclose(file);
+                return -1;
+            }
+        }
+
+        if (parse_args(p_variant, argc, argv, NULL, NULL) != 0 ||
+            p_variant->binfilename == NULL || p_variant->datfilename == NULL) {
+            fprintf(stderr, "%s:%u: bad variant\n", filename, (unsigned) number);
+            fclose(file);
+            return -1;
+        }
+
+        m_variant_count++;
+    }
+
+    fclose(file);
     return 0;
-}
\ No newline at end of file
+}
+
+static void * worker(void * p_context)
+{
+    variant_t * p_variant;
+
+    (void) p_context;
+
+    for (;;) {
+        pthread_mutex_lock(&m_variant_lock);
+        p_variant = (m_variant_next < m_variant_count) ? &m_variants[m_variant_next++] : NULL;
+        pthread_mutex_unlock(&m_variant_lock);
+
+        if (p_variant == NULL)
+            return NULL;
+
+        p_variant->result = package(p_variant);
+    }
+}
+
+static int usage(void)
+{
+    fprintf(stderr, "usage: gen_dat [-t type] [-r rev] [-a version] [-s id[,id...]] [-k key]\n");
+    fprintf(stderr, "               [-m manifest] [-z zip] bin-filename dat-filename\n");
+    fprintf(stderr, "       gen_dat [options] [-j jobs] -f variants-filename\n");
+    return -1;
+}
+
+/*
+ *  Build the package(s) given.
+ */
+int main(int argc, char* argv[])
+{
+    pthread_t    threads[JOBS_MAX];
+    variant_t    variant  = m_defaults;
+    const char * variants = NULL;
+    uint32_t     jobs     = 4;
+    uint32_t     failed   = 0;
+    uint32_t     i;
+
+    if (parse_args(&variant, argc - 1, argv + 1, &variants, &jobs) != 0)
+        return usage();
+
+    crc32_init();
+
+    if (variants == NULL) {
+        if (variant.binfilename == NULL || variant.datfilename == NULL)
+            return usage();
+
+        return package(&variant);
+    }
+
+    if (variant.binfilename != NULL || read_variants(variants, &variant) != 0)
+        return usage();
+
+    /* crc16.c builds its tables on first use, do that before the threads start. */
+    (void) crc16_compute((const uint8_t*) "", 0, NULL);
+
+    if (jobs == 0)
+        jobs = 1;
+    if (jobs > JOBS_MAX)
+        jobs = JOBS_MAX;
+    if (jobs > m_variant_count)
+        jobs = m_variant_count;
+
+    for (i = 0; i < jobs; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return -1;
+        }
+    }
+
+    for (i = 0; i < jobs; i++)
+        pthread_join(threads[i], NULL);
+
+    for (i = 0; i < m_variant_count; i++) {
+        if (m_variants[i].result != 0) {
+            fprintf(stderr, "%s: failed\n", m_variants[i].datfilename);
+            failed++;
+        }
+    }
+
+    return (int) failed;
+}
@@ -1,19 +1,46 @@
 #------------------------------------------------------------------------------
 #  gen_dat.mk
+#
+#  Host tools, built from the bootloader's own sources:
+#      make -f gen_dat.mk gen_dat
+#  The app makefile builds those it runs into its own directory, through
+#  OUTPUT_DIRECTORY.
 #------------------------------------------------------------------------------
 
 ifeq ($(OS),Windows_NT)
-    EXT = ".exe"
+    EXT = .exe
 else
     UNAME_S := $(shell uname -s)
 
     ifeq ($(UNAME_S),Linux)
-        EXT = ""
+        EXT =
     endif
     ifeq ($(UNAME_S),Darwin)
-        EXT = ".osx"
+        EXT = .osx
     endif
 endif
 
-gen_dat$(EXT):
-	gcc gen_dat.c -o gen_dat$(EXT)
+OUTPUT_DIRECTORY ?= .
+
+DFU_DIR  := ../bootloader_dfu
+CRC16    := $(DFU_DIR)/crc16.c $(DFU_DIR)/crc16.h
+SHA256   := $(DFU_DIR)/sha256.c $(DFU_DIR)/sha256.h
+ED25519  := $(DFU_DIR)/ed25519.c $(DFU_DIR)/ed25519.h
+
+$(OUTPUT_DIRECTORY)/gen_dat$(EXT): gen_dat.c $(CRC16) $(SHA256) $(ED25519)
+	gcc -O2 -pthread -DCRC16_SLICE_BY=8 -DED25519_SIGN_SUPPORT -I$(DFU_DIR) gen_dat.c $(DFU_DIR)/crc16.c $(DFU_DIR)/sha256.c $(DFU_DIR)/ed25519.c -o $@
+
+$(OUTPUT_DIRECTORY)/sign_dat$(EXT): sign_dat.c $(SHA256) $(ED25519)
+	gcc -O2 -DED25519_SIGN_SUPPORT -I$(DFU_DIR) sign_dat.c $(DFU_DIR)/sha256.c $(DFU_DIR)/ed25519.c -o $@
+
+$(OUTPUT_DIRECTORY)/dfu_bench$(EXT): dfu_bench.c $(CRC16) $(SHA256) $(ED25519)
+	gcc -O2 -DCRC16_SLICE_BY=8 -DED25519_SIGN_SUPPORT -DED25519_MUL_COUNT -I$(DFU_DIR) dfu_bench.c $(DFU_DIR)/crc16.c $(DFU_DIR)/sha256.c $(DFU_DIR)/ed25519.c -o $@
+
+$(OUTPUT_DIRECTORY)/gen_delta$(EXT): gen_delta.c $(CRC16) $(SHA256) $(DFU_DIR)/dfu_delta.c $(DFU_DIR)/dfu_delta.h
+	gcc -O2 -DCRC16_SLICE_BY=8 -I$(DFU_DIR) gen_delta.c $(DFU_DIR)/crc16.c $(DFU_DIR)/sha256.c $(DFU_DIR)/dfu_delta.c -o $@
+
+$(OUTPUT_DIRECTORY)/gen_lz$(EXT): gen_lz.c $(DFU_DIR)/dfu_lz.c $(DFU_DIR)/dfu_lz.h
+	gcc -O2 -I$(DFU_DIR) gen_lz.c $(DFU_DIR)/dfu_lz.c -o $@
+
+$(OUTPUT_DIRECTORY)/dfu_batch$(EXT): dfu_batch.c dfu_sim.c dfu_link.h $(CRC16) $(SHA256) $(DFU_DIR)/dfu_lz.c $(DFU_DIR)/dfu_lz.h
+	gcc -O2 -pthread -DCRC16_SLICE_BY=8 -I$(DFU_DIR) dfu_batch.c dfu_sim.c $(DFU_DIR)/crc16.c $(DFU_DIR)/sha256.c $(DFU_DIR)/dfu_lz.c -o $@
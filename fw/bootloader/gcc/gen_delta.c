@@ -0,0 +1,516 @@
+/*
+ *   gen_delta.c  -- make a delta image for bootloaders built with DELTA_SUPPORT
+ *
+ *   Compile:  make -f gen_dat.mk gen_delta
+ *             Uses the bootloader's own crc16.c, sha256.c and dfu_delta.c.
+ *   Usage:    gen_delta diff old-bin-filename new-bin-filename delta-filename
+ *                 Write the delta image which rebuilds the new application
+ *                 from the old one, the application on the device.  Make
+ *                 its dat file with gen_dat (and sign_dat) as for a bin.
+ *             gen_delta apply old-bin-filename delta-filename new-bin-filename
+ *                 Rebuild the new application as the bootloader does, and
+ *                 check it against the delta image header.
+ *   NOTE:     move executable to app's gcc directory.
+ *
+ *   Matching follows bsdiff: a suffix array of the old image finds the
+ *   longest match for each position of the new image, and matches are
+ *   extended both ways while most bytes agree.  The byte-wise differences
+ *   of a moved function are then mostly zero, which the delta image stores
+ *   as run lengths, see dfu_delta.h.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "crc16.h"
+#include "sha256.h"
+#include "dfu_delta.h"
+
+/* Zero runs shorter than this are cheaper kept in a run of deltas. */
+#define MIN_ZERO_RUN   3
+
+typedef struct {
+    uint8_t * data;
+    size_t    size;
+    size_t    capacity;
+} buffer_t;
+
+static const int32_t * sort_rank;
+static int32_t         sort_count;
+static int32_t         sort_step;
+
+static uint8_t       * rebuilt;
+static uint32_t        rebuilt_size;
+
+/*
+ *  Read all of a file into a malloc'ed buffer.
+ */
+static uint8_t * read_file(const char * filename, size_t * p_size)
+{
+    FILE    * file;
+    uint8_t * data;
+    long      size;
+
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    data = (size > 0) ? (uint8_t*) malloc(size) : NULL;
+    if (data == NULL || fread(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s read failed\n", filename);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *p_size = (size_t) size;
+    return data;
+}
+
+static int write_file(const char * filename, const uint8_t * data, size_t size)
+{
+    FILE * file;
+
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    if (fwrite(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s write failed\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    return fclose(file);
+}
+
+static void put_byte(buffer_t * p_buf, uint8_t byte)
+{
+    if (p_buf->size == p_buf->capacity) {
+        p_buf->capacity = p_buf->capacity ? 2 * p_buf->capacity : 4096;
+        p_buf->data     = (uint8_t*) realloc(p_buf->data, p_buf->capacity);
+        if (p_buf->data == NULL) {
+            fprintf(stderr, "malloc failed\n");
+            exit(-1);
+        }
+    }
+    p_buf->data[p_buf->size++] = byte;
+}
+
+static void put_varint(buffer_t * p_buf, uint32_t value)
+{
+    while (value >= 0x80) {
+        put_byte(p_buf, (uint8_t)(value | 0x80));
+        value >>= 7;
+    }
+    put_byte(p_buf, (uint8_t) value);
+}
+
+/*
+ *  Suffix array by prefix doubling: suffixes are sorted on their first
+ *  2^k bytes, using the ranks from the previous round.  The empty suffix
+ *  is included and sorts first, as bsdiff's search expects.
+ */
+static int suffix_compare(const void * a, const void * b)
+{
+    int32_t i  = *(const int32_t *) a;
+    int32_t j  = *(const int32_t *) b;
+    int32_t ri = (i + sort_step < sort_count) ? sort_rank[i + sort_step] : -1;
+    int32_t rj = (j + sort_step < sort_count) ? sort_rank[j + sort_step] : -1;
+
+    if (sort_rank[i] != sort_rank[j])
+        return (sort_rank[i] < sort_rank[j]) ? -1 : 1;
+    if (ri != rj)
+        return (ri < rj) ? -1 : 1;
+    return 0;
+}
+
+static int32_t * suffix_sort(const uint8_t * old, int32_t oldsize)
+{
+    int32_t   count = oldsize + 1;
+    int32_t * index = (int32_t*) malloc(count * sizeof(int32_t));
+    int32_t * rank  = (int32_t*) malloc(count * sizeof(int32_t));
+    int32_t * next  = (int32_t*) malloc(count * sizeof(int32_t));
+    int32_t   i;
+
+    if (index == NULL || rank == NULL || next == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        exit(-1);
+    }
+
+    for (i = 0; i < count; i++) {
+        index[i] = i;
+        rank[i]  = (i < oldsize) ? old[i] + 1 : 0;
+    }
+
+    sort_rank  = rank;
+    sort_count = count;
+
+    for (sort_step = 1; ; sort_step *= 2) {
+        qsort(index, count, sizeof(int32_t), suffix_compare);
+
+        next[index[0]] = 0;
+        for (i = 1; i < count; i++)
+            next[index[i]] = next[index[i - 1]] +
+                             (suffix_compare(&index[i - 1], &index[i]) != 0);
+
+        memcpy(rank, next, count * sizeof(int32_t));
+
+        if (rank[index[count - 1]] == count - 1)
+            break;
+    }
+
+    free(next);
+    free(rank);
+    return index;
+}
+
+static int32_t match_length(const uint8_t * a, int32_t asize, const uint8_t * b, int32_t bsize)
+{
+    int32_t i;
+
+    for (i = 0; i < asize && i < bsize; i++) {
+        if (a[i] != b[i])
+            break;
+    }
+    return i;
+}
+
+/*
+ *  Binary search of the suffix array for the longest match of new.
+ */
+static int32_t search(const int32_t * index, const uint8_t * old, int32_t oldsize,
+                      const uint8_t * new, int32_t newsize,
+                      int32_t start, int32_t end, int32_t * p_pos)
+{
+    int32_t x, y;
+
+    while (end - start >= 2) {
+        int32_t mid = start + (end - start) / 2;
+        int32_t len = oldsize - index[mid];
+
+        if (memcmp(old + index[mid], new, (len < newsize) ? len : newsize) < 0)
+            start = mid;
+        else
+            end = mid;
+    }
+
+    x = match_length(old + index[start], oldsize - index[start], new, newsize);
+    y = match_length(old + index[end], oldsize - index[end], new, newsize);
+
+    if (x > y) {
+        *p_pos = index[start];
+        return x;
+    }
+    *p_pos = index[end];
+    return y;
+}
+
+/*
+ *  One control record: diff bytes as zero and delta runs, then extra bytes.
+ */
+static void put_record(buffer_t * p_buf,
+                       const uint8_t * old, int32_t oldpos,
+                       const uint8_t * new, int32_t newpos,
+                       int32_t diff_len, int32_t extra_len, int32_t seek)
+{
+    int32_t i = 0;
+
+    put_varint(p_buf, (uint32_t) diff_len);
+    put_varint(p_buf, (uint32_t) extra_len);
+    put_varint(p_buf, ((uint32_t) seek << 1) ^ (uint32_t)(seek >> 31));
+
+    while (i < diff_len) {
+        int32_t zeros = 0;
+        int32_t start;
+        int32_t end;
+
+        while (i + zeros < diff_len && new[newpos + i + zeros] == old[oldpos + i + zeros])
+            zeros++;
+
+        start = i + zeros;
+        end   = start;
+
+        /* Extend the deltas over zero runs too short to be worth a new run. */
+        while (end < diff_len) {
+            int32_t run = 0;
+
+            while (end + run < diff_len && new[newpos + end + run] == old[oldpos + end + run])
+                run++;
+
+            if (run == 0) {
+                end++;
+                continue;
+            }
+            if (run >= MIN_ZERO_RUN || end + run == diff_len)
+                break;
+            end += run;
+        }
+
+        put_varint(p_buf, (uint32_t) zeros);
+        put_varint(p_buf, (uint32_t)(end - start));
+
+        for (i = start; i < end; i++)
+            put_byte(p_buf, (uint8_t)(new[newpos + i] - old[oldpos + i]));
+    }
+
+    for (i = 0; i < extra_len; i++)
+        put_byte(p_buf, new[newpos + diff_len + i]);
+}
+
+/*
+ *  The bsdiff matching loop.
+ */
+static void make_records(buffer_t * p_buf,
+                         const uint8_t * old, int32_t oldsize,
+                         const uint8_t * new, int32_t newsize)
+{
+    int32_t * index      = suffix_sort(old, oldsize);
+    int32_t   scan       = 0;
+    int32_t   len        = 0;
+    int32_t   pos        = 0;
+    int32_t   lastscan   = 0;
+    int32_t   lastpos    = 0;
+    int32_t   lastoffset = 0;
+
+    while (scan < newsize) {
+        int32_t oldscore = 0;
+        int32_t scsc;
+
+        for (scsc = scan += len; scan < newsize; scan++) {
+            len = search(index, old, oldsize, new + scan, newsize - scan, 0, oldsize, &pos);
+
+            for (; scsc < scan + len; scsc++) {
+                if (scsc + lastoffset < oldsize && old[scsc + lastoffset] == new[scsc])
+                    oldscore++;
+            }
+
+            if ((len == oldscore && len != 0) || len > oldscore + 8)
+                break;
+
+            if (scan + lastoffset < oldsize && old[scan + lastoffset] == new[scan])
+                oldscore--;
+        }
+
+        if (len != oldscore || scan == newsize) {
+            int32_t s, sf, lenf, sb, lenb, i;
+
+            /* Extend the previous match forwards... */
+            s = sf = lenf = 0;
+            for (i = 0; lastscan + i < scan && lastpos + i < oldsize; ) {
+                if (old[lastpos + i] == new[lastscan + i])
+                    s++;
+                i++;
+                if (s * 2 - i > sf * 2 - lenf) {
+                    sf   = s;
+                    lenf = i;
+                }
+            }
+
+            /* ...and the new match backwards. */
+            lenb = 0;
+            if (scan < newsize) {
+                s = sb = 0;
+                for (i = 1; scan >= lastscan + i && pos >= i; i++) {
+                    if (old[pos - i] == new[scan - i])
+                        s++;
+                    if (s * 2 - i > sb * 2 - lenb) {
+                        sb   = s;
+                        lenb = i;
+                    }
+                }
+            }
+
+            /* Split any overlap where the bytes agree best. */
+            if (lastscan + lenf > scan - lenb) {
+                int32_t overlap = (lastscan + lenf) - (scan - lenb);
+                int32_t ss      = 0;
+                int32_t lens    = 0;
+
+                s = 0;
+                for (i = 0; i < overlap; i++) {
+                    if (new[lastscan + lenf - overlap + i] == old[lastpos + lenf - overlap + i])
+                        s++;
+                    if (new[scan - lenb + i] == old[pos - lenb + i])
+                        s--;
+                    if (s > ss) {
+                        ss   = s;
+                        lens = i + 1;
+                    }
+                }
+
+                lenf += lens - overlap;
+                lenb -= lens;
+            }
+
+            put_record(p_buf, old, lastpos, new, lastscan,
+                       lenf, (scan - lenb) - (lastscan + lenf),
+                       (pos - lenb) - (lastpos + lenf));
+
+            lastscan   = scan - lenb;
+            lastpos    = pos - lenb;
+            lastoffset = pos - scan;
+        }
+    }
+
+    free(index);
+}
+
+static int diff(const char * oldfilename, const char * newfilename, const char * deltafilename)
+{
+    dfu_delta_header_t header;
+    sha256_ctx_t       sha256;
+    buffer_t           delta = { NULL, 0, 0 };
+    uint8_t          * old;
+    uint8_t          * new;
+    size_t             oldsize = 0;
+    size_t             newsize = 0;
+    int                result;
+
+    old = read_file(oldfilename, &oldsize);
+    if (old == NULL)
+        return -1;
+
+    new = read_file(newfilename, &newsize);
+    if (new == NULL) {
+        free(old);
+        return -1;
+    }
+
+    if (oldsize == 0 || newsize == 0 || ((oldsize | newsize) & (sizeof(uint32_t) - 1))) {
+        fprintf(stderr, "images must be word sized, as for DFU\n");
+        free(new);
+        free(old);
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    header.magic    = DFU_DELTA_MAGIC;
+    header.old_size = (uint32_t) oldsize;
+    header.new_size = (uint32_t) newsize;
+    header.old_crc  = crc16_compute(old, (uint32_t) oldsize, NULL);
+    header.new_crc  = crc16_compute(new, (uint32_t) newsize, NULL);
+
+    sha256_init(&sha256);
+    sha256_update(&sha256, new, (uint32_t) newsize);
+    sha256_final(&sha256, header.new_hash);
+
+    for (result = 0; result < (int) DFU_DELTA_HEADER_SIZE; result++)
+        put_byte(&delta, ((uint8_t *) &header)[result]);
+
+    make_records(&delta, old, (int32_t) oldsize, new, (int32_t) newsize);
+
+    while (delta.size & (sizeof(uint32_t) - 1))
+        put_byte(&delta, 0);
+
+    printf("%s: %u bytes, %u%% of %s\n", deltafilename, (unsigned) delta.size,
+           (unsigned) (100 * delta.size / newsize), newfilename);
+
+    result = write_file(deltafilename, delta.data, delta.size);
+
+    free(delta.data);
+    free(new);
+    free(old);
+
+    return result;
+}
+
+static int rebuilt_write(uint32_t offset, const uint8_t * p_data, uint32_t length)
+{
+    if (offset + length > rebuilt_size)
+        return -1;
+
+    memcpy(&rebuilt[offset], p_data, length);
+    return 0;
+}
+
+static int apply(const char * oldfilename, const char * deltafilename, const char * newfilename)
+{
+    dfu_delta_header_t header;
+    sha256_ctx_t       sha256;
+    uint8_t            hash[SHA256_DIGEST_SIZE];
+    uint8_t          * old;
+    uint8_t          * delta;
+    size_t             oldsize   = 0;
+    size_t             deltasize = 0;
+    int                result    = -1;
+
+    old = read_file(oldfilename, &oldsize);
+    if (old == NULL)
+        return -1;
+
+    delta = read_file(deltafilename, &deltasize);
+    if (delta == NULL) {
+        free(old);
+        return -1;
+    }
+
+    if (deltasize < DFU_DELTA_HEADER_SIZE) {
+        fprintf(stderr, "%s is not a delta image\n", deltafilename);
+        goto done;
+    }
+    memcpy(&header, delta, DFU_DELTA_HEADER_SIZE);
+
+    if (header.old_crc != crc16_compute(old, (uint32_t) oldsize, NULL)) {
+        fprintf(stderr, "%s does not apply to %s\n", deltafilename, oldfilename);
+        goto done;
+    }
+
+    rebuilt_size = header.new_size;
+    rebuilt      = (uint8_t*) malloc(rebuilt_size ? rebuilt_size : 1);
+    if (rebuilt == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        goto done;
+    }
+
+    result = dfu_delta_apply(delta, (uint32_t) deltasize, old, (uint32_t) oldsize, rebuilt_write);
+    if (result != DFU_DELTA_SUCCESS) {
+        fprintf(stderr, "%s apply failed: %d\n", deltafilename, result);
+        result = -1;
+        goto done;
+    }
+
+    sha256_init(&sha256);
+    sha256_update(&sha256, rebuilt, rebuilt_size);
+    sha256_final(&sha256, hash);
+
+    if (crc16_compute(rebuilt, rebuilt_size, NULL) != header.new_crc ||
+        memcmp(hash, header.new_hash, sizeof(hash)) != 0) {
+        fprintf(stderr, "%s rebuilt image does not match its header\n", deltafilename);
+        result = -1;
+        goto done;
+    }
+
+    result = write_file(newfilename, rebuilt, rebuilt_size);
+
+done:
+    free(rebuilt);
+    free(delta);
+    free(old);
+
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 5 && strcmp(argv[1], "diff") == 0)
+        return diff(argv[2], argv[3], argv[4]);
+
+    if (argc == 5 && strcmp(argv[1], "apply") == 0)
+        return apply(argv[2], argv[3], argv[4]);
+
+    fprintf(stderr, "usage: gen_delta diff old-bin-filename new-bin-filename delta-filename\n");
+    fprintf(stderr, "       gen_delta apply old-bin-filename delta-filename new-bin-filename\n");
+    return -1;
+}
@@ -0,0 +1,281 @@
+/*
+ *   gen_lz.c  -- compress an image for bootloaders built with COMPRESSION_SUPPORT
+ *
+ *   Compile:  make -f gen_dat.mk gen_lz
+ *             Uses the bootloader's own dfu_lz.c.
+ *   Usage:    gen_lz compress bin-filename lz-filename
+ *                 Write the compressed image.  The dat file is still made
+ *                 by gen_dat (and sign_dat) from the uncompressed bin, as
+ *                 the bootloader checks the image it writes to flash.
+ *             gen_lz decompress lz-filename bin-filename
+ *                 Decompress as the bootloader does, 20 byte packets into
+ *                 two flash pages.
+ *   NOTE:     move executable to app's gcc directory.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "dfu_lz.h"
+
+#define PACKET_SIZE    20      /* DFU data packet, ATT MTU less 3 */
+#define PAGE_SIZE      1024
+
+/*
+ *  Read all of a file into a malloc'ed buffer.
+ */
+static uint8_t * read_file(const char * filename, size_t * p_size)
+{
+    FILE    * file;
+    uint8_t * data;
+    long      size;
+
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    data = (size > 0) ? (uint8_t*) malloc(size) : NULL;
+    if (data == NULL || fread(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s read failed\n", filename);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *p_size = (size_t) size;
+    return data;
+}
+
+static int write_file(const char * filename, const uint8_t * data, size_t size)
+{
+    FILE * file;
+
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    if (fwrite(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s write failed\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    return fclose(file);
+}
+
+/*
+ *  Longest match for position pos within the window.
+ */
+static size_t find_match(const uint8_t * data, size_t size, size_t pos, size_t * p_distance)
+{
+    size_t best = 0;
+    size_t max  = size - pos;
+    size_t distance;
+
+    if (max > DFU_LZ_MAX_MATCH)
+        max = DFU_LZ_MAX_MATCH;
+
+    for (distance = 1; distance <= DFU_LZ_WINDOW && distance <= pos; distance++) {
+        const uint8_t * p_old = data + pos - distance;
+        size_t          length = 0;
+
+        while (length < max && p_old[length] == data[pos + length])
+            length++;
+
+        if (length > best) {
+            best        = length;
+            *p_distance = distance;
+            if (best == max)
+                break;
+        }
+    }
+
+    return (best >= DFU_LZ_MIN_MATCH) ? best : 0;
+}
+
+static int compress(const char * binfilename, const char * lzfilename)
+{
+    uint8_t * bin;
+    uint8_t * lz;
+    size_t    binsize = 0;
+    size_t    lzsize;
+    size_t    flag_pos = 0;
+    size_t    items    = 8;
+    size_t    pos      = 0;
+    int       result;
+
+    bin = read_file(binfilename, &binsize);
+    if (bin == NULL)
+        return -1;
+
+    if (binsize & (sizeof(uint32_t) - 1)) {
+        fprintf(stderr, "%s must be word sized, as for DFU\n", binfilename);
+        free(bin);
+        return -1;
+    }
+
+    /* Worst case is all literals: one flag byte per eight. */
+    lz = (uint8_t*) calloc(DFU_LZ_HEADER_SIZE + binsize + binsize / 8 + 8, 1);
+    if (lz == NULL) {
+        fprintf(stderr, "malloc failed\n");
+        free(bin);
+        return -1;
+    }
+
+    lz[0] = (uint8_t)(DFU_LZ_MAGIC);
+    lz[1] = (uint8_t)(DFU_LZ_MAGIC >> 8);
+    lz[2] = (uint8_t)(DFU_LZ_MAGIC >> 16);
+    lz[3] = (uint8_t)(DFU_LZ_MAGIC >> 24);
+    lz[4] = (uint8_t)(binsize);
+    lz[5] = (uint8_t)(binsize >> 8);
+    lz[6] = (uint8_t)(binsize >> 16);
+    lz[7] = (uint8_t)(binsize >> 24);
+    lzsize = DFU_LZ_HEADER_SIZE;
+
+    while (pos < binsize) {
+        size_t distance = 0;
+        size_t length;
+
+        if (items == 8) {
+            flag_pos       = lzsize++;
+            lz[flag_pos]   = 0;
+            items          = 0;
+        }
+
+        length = find_match(bin, binsize, pos, &distance);
+
+        /* Lazy matching: a literal is better if the next match is longer. */
+        if (length > 0 && length < DFU_LZ_MAX_MATCH && pos + 1 < binsize) {
+            size_t next_distance;
+
+            if (find_match(bin, binsize, pos + 1, &next_distance) > length + 1)
+                length = 0;
+        }
+
+        if (length == 0) {
+            lz[flag_pos] |= 1 << items;
+            lz[lzsize++]  = bin[pos++];
+        }
+        else {
+            uint16_t value = (uint16_t)((distance - 1) | ((length - DFU_LZ_MIN_MATCH) << 10));
+
+            lz[lzsize++] = (uint8_t) value;
+            lz[lzsize++] = (uint8_t)(value >> 8);
+            pos += length;
+        }
+        items++;
+    }
+
+    while (lzsize & (sizeof(uint32_t) - 1))
+        lz[lzsize++] = 0;
+
+    printf("%s: %u bytes, %u%% of %s\n", lzfilename, (unsigned) lzsize,
+           (unsigned) (100 * lzsize / (binsize ? binsize : 1)), binfilename);
+
+    result = write_file(lzfilename, lz, lzsize);
+
+    free(lz);
+    free(bin);
+
+    return result;
+}
+
+static int decompress(const char * lzfilename, const char * binfilename)
+{
+    static uint8_t ring[2 * PAGE_SIZE];
+    dfu_lz_ctx_t   ctx;
+    uint8_t      * lz;
+    uint8_t      * bin = NULL;
+    size_t         lzsize = 0;
+    size_t         in     = 0;
+    uint32_t       stored = 0;
+    int            result = -1;
+
+    lz = read_file(lzfilename, &lzsize);
+    if (lz == NULL)
+        return -1;
+
+    dfu_lz_init(&ctx);
+
+    while (in < lzsize) {
+        size_t  length = (lzsize - in < PACKET_SIZE) ? lzsize - in : PACKET_SIZE;
+        size_t  offset = 0;
+
+        while (offset < length) {
+            int32_t used = dfu_lz_decode(&ctx, &lz[in + offset], length - offset,
+                                         ring, sizeof(ring), stored + sizeof(ring));
+            if (used < 0) {
+                fprintf(stderr, "%s is not a compressed image\n", lzfilename);
+                goto done;
+            }
+            offset += used;
+
+            if (bin == NULL && ctx.header_length == DFU_LZ_HEADER_SIZE) {
+                bin = (uint8_t*) malloc(ctx.size ? ctx.size : 1);
+                if (bin == NULL) {
+                    fprintf(stderr, "malloc failed\n");
+                    goto done;
+                }
+            }
+
+            /* "Store" whole pages, and the last one. */
+            while (bin != NULL && (ctx.out - stored >= PAGE_SIZE ||
+                                   (ctx.out == ctx.size && stored < ctx.out))) {
+                uint32_t size = (ctx.out - stored < PAGE_SIZE) ? ctx.out - stored : PAGE_SIZE;
+
+                memcpy(&bin[stored], &ring[stored % sizeof(ring)], size);
+                stored += size;
+            }
+
+            if (ctx.out == ctx.size && ctx.header_length == DFU_LZ_HEADER_SIZE)
+                break;
+        }
+
+        if (ctx.out == ctx.size && ctx.header_length == DFU_LZ_HEADER_SIZE) {
+            if (lzsize - (in + offset) >= sizeof(uint32_t)) {
+                fprintf(stderr, "%s has data after the image\n", lzfilename);
+                goto done;
+            }
+            in = lzsize;
+            break;
+        }
+        in += length;
+    }
+
+    if (bin == NULL || ctx.out != ctx.size) {
+        fprintf(stderr, "%s is truncated\n", lzfilename);
+        goto done;
+    }
+
+    result = write_file(binfilename, bin, ctx.size);
+
+done:
+    free(bin);
+    free(lz);
+
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 4 && strcmp(argv[1], "compress") == 0)
+        return compress(argv[2], argv[3]);
+
+    if (argc == 4 && strcmp(argv[1], "decompress") == 0)
+        return decompress(argv[2], argv[3]);
+
+    fprintf(stderr, "usage: gen_lz compress bin-filename lz-filename\n");
+    fprintf(stderr, "       gen_lz decompress lz-filename bin-filename\n");
+    return -1;
+}
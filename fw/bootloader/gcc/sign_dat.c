@@ -0,0 +1,258 @@
+/*
+ *   sign_dat.c  -- sign a *.dat file for bootloaders built with SIGNING_SUPPORT
+ *
+ *   Compile:  make -f gen_dat.mk sign_dat
+ *             Uses the bootloader's own sha256.c and ed25519.c.
+ *   Usage:    sign_dat genkey key-filename header-filename
+ *                 Create a new secret key and write its public key as a
+ *                 header for the bootloader build (dfu_public_key.h).
+ *                 Keep the key file out of the repository.
+ *             sign_dat pubkey key-filename header-filename
+ *                 Write the header again for an existing key.
+ *             sign_dat sign key-filename bin-filename dat-filename
+ *                 Add the image SHA-256 and an Ed25519 signature to the
+ *                 dat file made by gen_dat for the bin file.
+ *   NOTE:     move executable to app's gcc directory.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sha256.h"
+#include "ed25519.h"
+
+/*
+ *  Extended init packet layout, see dfu_init.c.
+ *  The base init packet, up to and including the CRC, is what gen_dat
+ *  writes: 10 bytes of fields, the SoftDevice list and the CRC.
+ */
+#define DAT_SOFTDEVICE_LEN_OFFSET   8
+#define DAT_EXT_RESERVED_SIZE       2
+
+/*
+ *  Read all of a file into a malloc'ed buffer.
+ */
+static uint8_t * read_file(const char * filename, size_t * p_size)
+{
+    FILE    * file;
+    uint8_t * data;
+    long      size;
+
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return NULL;
+    }
+
+    fseek(file, 0L, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0L, SEEK_SET);
+
+    data = (size > 0) ? (uint8_t*) malloc(size) : NULL;
+    if (data == NULL || fread(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s read failed\n", filename);
+        free(data);
+        fclose(file);
+        return NULL;
+    }
+
+    fclose(file);
+    *p_size = (size_t) size;
+    return data;
+}
+
+static int write_file(const char * filename, const uint8_t * data, size_t size)
+{
+    FILE * file;
+
+    file = fopen(filename, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", filename, strerror(errno));
+        return -1;
+    }
+
+    if (fwrite(data, size, 1, file) != 1) {
+        fprintf(stderr, "%s write failed\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    return fclose(file);
+}
+
+static int read_seed(const char * keyfilename, uint8_t * seed)
+{
+    uint8_t * key;
+    size_t    size = 0;
+
+    key = read_file(keyfilename, &size);
+    if (key == NULL)
+        return -1;
+
+    if (size != ED25519_SEED_SIZE) {
+        fprintf(stderr, "%s is not a %d byte key\n", keyfilename, ED25519_SEED_SIZE);
+        free(key);
+        return -1;
+    }
+
+    memcpy(seed, key, ED25519_SEED_SIZE);
+    free(key);
+    return 0;
+}
+
+/*
+ *  Write the public key as the DFU_PUBLIC_KEY initializer used by dfu_init.c.
+ */
+static int write_header(const char * headerfilename, const uint8_t * seed)
+{
+    uint8_t public_key[ED25519_PUBLIC_KEY_SIZE];
+    FILE  * header;
+    int     i;
+
+    ed25519_public_key(public_key, seed);
+
+    header = fopen(headerfilename, "w");
+    if (header == NULL) {
+        fprintf(stderr, "%s open failed: %s\n", headerfilename, strerror(errno));
+        return -1;
+    }
+
+    fprintf(header, "/*\n");
+    fprintf(header, " *  dfu_public_key.h  -- generated by sign_dat, do not edit.\n");
+    fprintf(header, " */\n");
+    fprintf(header, "#ifndef DFU_PUBLIC_KEY_H__\n");
+    fprintf(header, "#define DFU_PUBLIC_KEY_H__\n\n");
+    fprintf(header, "#define DFU_PUBLIC_KEY { \\\n");
+
+    for (i = 0; i < ED25519_PUBLIC_KEY_SIZE; i++) {
+        fprintf(header, "%s0x%02x,%s", (i % 8) ? " " : "    ", public_key[i],
+                ((i % 8) == 7) ? " \\\n" : "");
+    }
+
+    fprintf(header, "}\n\n");
+    fprintf(header, "#endif // DFU_PUBLIC_KEY_H__\n");
+
+    return fclose(header);
+}
+
+static int genkey(const char * keyfilename, const char * headerfilename)
+{
+    uint8_t seed[ED25519_SEED_SIZE];
+    FILE  * file;
+
+    /* Never replace a key: images signed with it could no longer be updated. */
+    file = fopen(keyfilename, "rb");
+    if (file != NULL) {
+        fprintf(stderr, "%s already exists\n", keyfilename);
+        fclose(file);
+        return -1;
+    }
+
+    file = fopen("/dev/urandom", "rb");
+    if (file == NULL || fread(seed, sizeof(seed), 1, file) != 1) {
+        fprintf(stderr, "no random source\n");
+        if (file != NULL)
+            fclose(file);
+        return -1;
+    }
+    fclose(file);
+
+    if (write_file(keyfilename, seed, sizeof(seed)) != 0)
+        return -1;
+
+    return write_header(headerfilename, seed);
+}
+
+static int pubkey(const char * keyfilename, const char * headerfilename)
+{
+    uint8_t seed[ED25519_SEED_SIZE];
+
+    if (read_seed(keyfilename, seed) != 0)
+        return -1;
+
+    return write_header(headerfilename, seed);
+}
+
+static int sign(const char * keyfilename, const char * binfilename, const char * datfilename)
+{
+    uint8_t      seed[ED25519_SEED_SIZE];
+    sha256_ctx_t sha256;
+    uint8_t    * bindata;
+    uint8_t    * datdata;
+    uint8_t    * signed_dat;
+    size_t       binsize = 0;
+    size_t       datsize = 0;
+    size_t       basesize;
+    size_t       msgsize;
+    int          result;
+
+    if (read_seed(keyfilename, seed) != 0)
+        return -1;
+
+    bindata = read_file(binfilename, &binsize);
+    if (bindata == NULL)
+        return -1;
+
+    datdata = read_file(datfilename, &datsize);
+    if (datdata == NULL) {
+        free(bindata);
+        return -1;
+    }
+
+    /* Fields and SoftDevice list, then the CRC.  Any old signature is dropped. */
+    basesize = (datsize > DAT_SOFTDEVICE_LEN_OFFSET + 1) ?
+               DAT_SOFTDEVICE_LEN_OFFSET + 2 +
+               2 * (datdata[DAT_SOFTDEVICE_LEN_OFFSET] |
+                    (datdata[DAT_SOFTDEVICE_LEN_OFFSET + 1] << 8)) + 2 : 0;
+
+    if (basesize == 0 || datsize < basesize) {
+        fprintf(stderr, "%s is not a gen_dat file\n", datfilename);
+        free(datdata);
+        free(bindata);
+        return -1;
+    }
+
+    msgsize    = basesize + DAT_EXT_RESERVED_SIZE + SHA256_DIGEST_SIZE;
+    signed_dat = (uint8_t*) calloc(msgsize + ED25519_SIGNATURE_SIZE, 1);
+    if (signed_dat == NULL) {
+        fprintf(stderr, "malloc failed");
+        free(datdata);
+        free(bindata);
+        return -1;
+    }
+
+    memcpy(signed_dat, datdata, basesize);
+
+    sha256_init(&sha256);
+    sha256_update(&sha256, bindata, binsize);
+    sha256_final(&sha256, &signed_dat[basesize + DAT_EXT_RESERVED_SIZE]);
+
+    ed25519_sign(&signed_dat[msgsize], signed_dat, msgsize, seed);
+
+    result = write_file(datfilename, signed_dat, msgsize + ED25519_SIGNATURE_SIZE);
+
+    free(signed_dat);
+    free(datdata);
+    free(bindata);
+
+    return result;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 4 && strcmp(argv[1], "genkey") == 0)
+        return genkey(argv[2], argv[3]);
+
+    if (argc == 4 && strcmp(argv[1], "pubkey") == 0)
+        return pubkey(argv[2], argv[3]);
+
+    if (argc == 5 && strcmp(argv[1], "sign") == 0)
+        return sign(argv[2], argv[3], argv[4]);
+
+    fprintf(stderr, "usage: sign_dat genkey key-filename header-filename\n");
+    fprintf(stderr, "       sign_dat pubkey key-filename header-filename\n");
+    fprintf(stderr, "       sign_dat sign key-filename bin-filename dat-filename\n");
+    return -1;
+}
@@ -26,6 +26,7 @@
 #include "boards.h"
 #include "bootloader.h"
 #include "bootloader_util.h"
+#include "boot_decision.h"
 #include "dfu_transport.h"
 #include "uart.h"
 #include "pstorage_platform.h"
@@ -70,7 +71,8 @@
 #define APP_TIMER_PRESCALER             0
 
 /*
- *  Maximum number of simultaneously created timers.
+ *  Maximum number of simultaneously created timers: DFU timeout,
+ *  connection parameters and the watchdog feed, see bootloader.c.
  */
 #define APP_TIMER_MAX_TIMERS            3
 
@@ -187,16 +189,18 @@ static void sys_evt_dispatch(uint32_t event)
 
 
 /*
- *  Function for initializing the BLE stack.
+ *  Function for initializing the SoftDevice, without enabling it.
  *
- *  Initializes the SoftDevice and the BLE event interrupt.
+ *  Makes the SoftDevice API available and forwards interrupts to the 
+ *  bootloader.  This is all a normal boot needs before the application,
+ *  which enables the SoftDevice itself, is started.
  *
  *  param[in] init_softdevice  true if SoftDevice should be initialized. 
  *                             The SoftDevice must only  be initialized 
  *                             if a chip reset has occured. Soft reset from 
  *                             application must not reinitialize the SoftDevice.
  */
-static void ble_stack_init(bool init_softdevice)
+static void softdevice_init(bool init_softdevice)
 {
     uint32_t         err_code;
     sd_mbr_command_t com = {SD_MBR_COMMAND_INIT_SD, };
@@ -209,6 +213,18 @@ static void ble_stack_init(bool init_softdevice)
 
     err_code = sd_softdevice_vector_table_base_set(BOOTLOADER_REGION_START);
     APP_ERROR_CHECK(err_code);
+}
+
+
+/*
+ *  Function for initializing the BLE stack.
+ *
+ *  Enables the SoftDevice and the BLE event interrupt.  Only done when
+ *  the bootloader itself needs BLE, i.e. for DFU.
+ */
+static void ble_stack_init(void)
+{
+    uint32_t err_code;
 
     /* Initialize the SoftDevice handler module. See specific board header file */
     SOFTDEVICE_HANDLER_INIT(LFCLKSRC_OPTION, NULL);
@@ -259,19 +275,38 @@ static void dis_init(void)
     PUTS("Device Info Service");
 }
 
+/*
+ *  Function for bringing up everything a DFU session needs: timers,
+ *  the BLE stack and the scheduler.
+ */
+static void dfu_stack_init(void)
+{
+    timers_init();
+    ble_stack_init();
+    scheduler_init();
+}
+
 /*
  *  Function for bootloader main entry.
+ *
+ *  A normal boot only validates the application and starts it: the
+ *  SoftDevice is not enabled and no BLE service is set up unless DFU
+ *  is entered.
  */
 int main(void)
 {
     uint32_t err_code;
     bool     dfu_start = false;
+    bool     stack_ready = false;
+    const boot_image_t * p_image;
     bool     app_reset = (NRF_POWER->GPREGRET == BOOTLOADER_DFU_START);
 
     if (app_reset) {
         NRF_POWER->GPREGRET = 0;
     }
 
+    boot_timing_init();
+
     leds_init();
 
 #if defined(DBGLOG_SUPPORT)
@@ -286,7 +321,7 @@ int main(void)
     APP_ERROR_CHECK_BOOL(NRF_FICR->CODEPAGESIZE == CODE_PAGE_SIZE);
 
     // Initialize.
-    timers_init();
+    softdevice_init(!app_reset);
 
 #if defined(BUTTON_SUPPORT)
     buttons_init();
@@ -294,25 +329,43 @@ int main(void)
 
     (void)bootloader_init();
 
+    boot_timing_phase(BOOT_PHASE_INIT);
+
+#if defined(DFU_DUAL_BANK_SUPPORT)
+    // Install an application received into bank 1 by the running application.
+    // An invalid image is dropped and the current application is kept.
+    if (bootloader_dfu_app_swap_pending()) {
+        nrf_gpio_pin_clear(UPDATE_IN_PROGRESS_LED);
+
+        err_code = bootloader_dfu_app_swap();
+        PRINTF("Bank 1 swap: %u\n", (unsigned) err_code);
+
+        nrf_gpio_pin_set(UPDATE_IN_PROGRESS_LED);
+
+        // The swap is not part of the boot time.
+        boot_timing_skip();
+    }
+#endif
+
     if (bootloader_dfu_sd_in_progress()) {
         nrf_gpio_pin_clear(UPDATE_IN_PROGRESS_LED);
 
         err_code = bootloader_dfu_sd_update_continue();
         APP_ERROR_CHECK(err_code);
 
-        ble_stack_init(!app_reset);
-        scheduler_init();
+        // INIT_SD above ran on the SoftDevice just replaced: run it, and set
+        // the vector table base, on the new one before it is enabled.
+        softdevice_init(true);
+
+        dfu_stack_init();
+        stack_ready = true;
 
         err_code = bootloader_dfu_sd_update_finalize();
         APP_ERROR_CHECK(err_code);
 
         nrf_gpio_pin_set(UPDATE_IN_PROGRESS_LED);
-    }
-    else {
-        // If stack is present then continue initialization of bootloader.
-        ble_stack_init(!app_reset);
-        scheduler_init();
-        dis_init();
+
+        boot_timing_phase(BOOT_PHASE_STACK);
     }
 
     dfu_start  = app_reset;
@@ -321,7 +374,18 @@ int main(void)
     dfu_start |= ((nrf_gpio_pin_read(BOOTLOADER_BUTTON) == 0) ? true: false);
 #endif
 
-    if (dfu_start || (!bootloader_app_is_valid(DFU_BANK_0_REGION_START))) {
+    // Validated once here, before any BLE bring-up, and reused below unless DFU 
+    // rewrites bank 0.
+    if (dfu_start || (!boot_image_validate()->valid)) {
+
+        boot_timing_phase(BOOT_PHASE_VALIDATE);
+
+        if (!stack_ready) {
+            dfu_stack_init();
+            dis_init();
+
+            boot_timing_phase(BOOT_PHASE_STACK);
+        }
 
         nrf_gpio_pin_clear(UPDATE_IN_PROGRESS_LED);
 
@@ -332,12 +396,29 @@ int main(void)
         APP_ERROR_CHECK(err_code);
 
         nrf_gpio_pin_set(UPDATE_IN_PROGRESS_LED);
+
+        // The DFU session is not part of the boot time.
+        boot_timing_skip();
+
+#if defined(DFU_DELTA_SUPPORT)
+        // A delta image is installed on the next boot, with the SoftDevice disabled.
+        if (bootloader_dfu_app_swap_pending()) {
+            NVIC_SystemReset();
+        }
+#endif
     }
 
-    if (bootloader_app_is_valid(DFU_BANK_0_REGION_START) && !bootloader_dfu_sd_in_progress()) {
+    p_image = boot_image_validate();
+
+    boot_timing_phase(BOOT_PHASE_VALIDATE);
+
+    if (p_image->valid && !bootloader_dfu_sd_in_progress()) {
 
         PUTS("Start App");
 
+        boot_timing_phase(BOOT_PHASE_JUMP);
+        boot_timing_report();
+
         // Select a bank region to use as application region.
         // @note: Only applications running from DFU_BANK_0_REGION_START is supported.
         bootloader_app_start(DFU_BANK_0_REGION_START);
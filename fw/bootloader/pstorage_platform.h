@@ -35,11 +35,17 @@
 #define PSTORAGE_MIN_BLOCK_SIZE     0x0010
 
 
+/*
+ *  Number of flash pages for persistent data: the two pages of the
+ *  bootloader settings journal.
+ */
+#define PSTORAGE_NUM_OF_PAGES       2
+
 /* 
  *  Start address for persistent data, configurable according to 
  *  system requirements.
  */
-#define PSTORAGE_DATA_START_ADDR    ((PSTORAGE_FLASH_PAGE_END - PSTORAGE_MAX_APPLICATIONS) \
+#define PSTORAGE_DATA_START_ADDR    ((PSTORAGE_FLASH_PAGE_END - PSTORAGE_NUM_OF_PAGES) \
                                     * PSTORAGE_FLASH_PAGE_SIZE)
 
 /*
@@ -22,36 +22,103 @@
 #include "app_timer.h"
 #include "app_gpiote.h"
 #include "app_button.h"
+#include "app_util_platform.h"
 #endif // BSP_SIMPLE
 
-#define ADVERTISING_LED_ON_INTERVAL            200
-#define ADVERTISING_LED_OFF_INTERVAL           1800
+#define LED_PULSE_SHORT                        10     /**< Width (ms) of the low duty cycle pulses, bright enough at full current without PWM. */
+#define LED_PULSE_LONG                         100    /**< Width (ms) of the pulses indicating errors and bonding. */
+#define LED_STEADY                             0xFFFF /**< on_ms of a steady LED, with a period of 0. */
 
-#define ADVERTISING_DIRECTED_LED_ON_INTERVAL   200
-#define ADVERTISING_DIRECTED_LED_OFF_INTERVAL  200
+#define STATE_TIMEOUT                          30     /**< Seconds a state is indicated before its LED is switched off. */
+#define CONNECTED_TIMEOUT                      3      /**< Seconds the connected state is indicated. */
 
-#define ADVERTISING_WHITELIST_LED_ON_INTERVAL  200
-#define ADVERTISING_WHITELIST_LED_OFF_INTERVAL 800
-
-#define ADVERTISING_SLOW_LED_ON_INTERVAL       400
-#define ADVERTISING_SLOW_LED_OFF_INTERVAL      4000
-
-#define BONDING_INTERVAL                       100
-
-#define SENT_OK_INTERVAL                       100
-#define SEND_ERROR_INTERVAL                    500
-
-#define RCV_OK_INTERVAL                        100
-#define RCV_ERROR_INTERVAL                     500
+#if LEDS_NUMBER > 0 && !(defined BSP_SIMPLE)
+/**@brief LEDs driven by a pattern, see @ref led_mask.
+ */
+#define LED_SEL_0                              (1 << 0)
+#define LED_SEL_1                              (1 << 1)
+#define LED_SEL_ALERT                          (1 << 2)
+#define LED_SEL_ALL                            (LED_SEL_0 | LED_SEL_1 | LED_SEL_ALERT) /**< All LEDs of the board. */
+#define LED_SEL_INVERT                         (1 << 6) /**< Pulses invert the LEDs, so an event shows over a state. */
+#define LED_SEL_EXCLUSIVE                      (1 << 7) /**< The other channels are stopped, and their LEDs switched off. */
+
+/**@brief Channels indicating independently, each on its own LEDs.
+ */
+typedef enum
+{
+    LED_CHANNEL_STATE,                   /**< States: advertising, connected, user states. */
+    LED_CHANNEL_EVENT,                   /**< Events shown over the state: sent, received. */
+    LED_CHANNEL_ALERT,                   /**< Alerts. */
+    LED_CHANNELS
+} led_channel_id_t;
 
-#define ALERT_INTERVAL                         200
+/**@brief LED pattern of an indication.
+ *
+ * @details A pulse is on_ms long and starts every period_ms. The pattern ends after
+ *          repeat pulses or timeout_s seconds, whichever comes first, and 0 is for no
+ *          limit. With a period of 0 the LEDs are on steadily until the timeout, and
+ *          with an on_ms of 0 they are off.
+ */
+typedef struct
+{
+    uint8_t  channel;                    /**< @ref led_channel_id_t. */
+    uint8_t  leds;                       /**< LED_SEL bits. */
+    uint16_t on_ms;                      /**< Pulse width. */
+    uint16_t period_ms;                  /**< Pulse period. */
+    uint8_t  repeat;                     /**< Number of pulses. */
+    uint8_t  timeout_s;                  /**< Auto-off timeout. */
+} led_pattern_t;
+
+/**@brief State of a channel.
+ */
+typedef struct
+{
+    uint32_t mask;                       /**< LEDs driven. */
+    uint32_t on_ticks;                   /**< Pulse width. */
+    uint32_t off_ticks;                  /**< Time between pulses. */
+    uint32_t due;                        /**< Ticks to the next edge, 0 when none is. */
+    uint16_t pulses;                     /**< Pulses left, this one included, 0 for no limit. */
+    bool     invert;                     /**< Pulses invert the LEDs. */
+    bool     on;                         /**< In a pulse. */
+} led_channel_t;
+
+/**@brief Patterns, indexed by @ref bsp_indication_t.
+ */
+static const led_pattern_t m_patterns[BSP_INDICATE_LAST + 1] =
+{
+    //                                     channel            leds                                        on_ms            period repeat timeout_s
+    [BSP_INDICATE_IDLE]                  = {LED_CHANNEL_STATE, 0,                                         0,               0,     0,     0},
+    [BSP_INDICATE_SCANNING]              = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_PULSE_SHORT, 2000,  0,     STATE_TIMEOUT},
+    [BSP_INDICATE_ADVERTISING]           = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_PULSE_SHORT, 2000,  0,     STATE_TIMEOUT},
+    [BSP_INDICATE_ADVERTISING_WHITELIST] = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_PULSE_SHORT, 1000,  0,     STATE_TIMEOUT},
+    [BSP_INDICATE_ADVERTISING_SLOW]      = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_PULSE_SHORT, 4000,  0,     STATE_TIMEOUT},
+    [BSP_INDICATE_ADVERTISING_DIRECTED]  = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_PULSE_SHORT, 400,   0,     STATE_TIMEOUT},
+    [BSP_INDICATE_BONDING]               = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_PULSE_LONG,  200,   0,     STATE_TIMEOUT},
+    [BSP_INDICATE_CONNECTED]             = {LED_CHANNEL_STATE, LED_SEL_0,                                 LED_STEADY,      0,     0,     CONNECTED_TIMEOUT},
+    [BSP_INDICATE_SENT_OK]               = {LED_CHANNEL_EVENT, LED_SEL_1 | LED_SEL_INVERT,                LED_PULSE_SHORT, 200,   1,     0},
+    [BSP_INDICATE_SEND_ERROR]            = {LED_CHANNEL_EVENT, LED_SEL_1 | LED_SEL_INVERT,                LED_PULSE_LONG,  200,   3,     0},
+    [BSP_INDICATE_RCV_OK]                = {LED_CHANNEL_EVENT, LED_SEL_1 | LED_SEL_INVERT,                LED_PULSE_SHORT, 200,   1,     0},
+    [BSP_INDICATE_RCV_ERROR]             = {LED_CHANNEL_EVENT, LED_SEL_1 | LED_SEL_INVERT,                LED_PULSE_LONG,  200,   3,     0},
+    [BSP_INDICATE_FATAL_ERROR]           = {LED_CHANNEL_STATE, LED_SEL_ALL | LED_SEL_EXCLUSIVE,           LED_STEADY,      0,     0,     0},
+    [BSP_INDICATE_ALERT_0]               = {LED_CHANNEL_ALERT, LED_SEL_ALERT,                             800,             1600,  0,     0},
+    [BSP_INDICATE_ALERT_1]               = {LED_CHANNEL_ALERT, LED_SEL_ALERT,                             600,             1200,  0,     0},
+    [BSP_INDICATE_ALERT_2]               = {LED_CHANNEL_ALERT, LED_SEL_ALERT,                             400,             800,   0,     0},
+    [BSP_INDICATE_ALERT_3]               = {LED_CHANNEL_ALERT, LED_SEL_ALERT,                             LED_STEADY,      0,     0,     0},
+    [BSP_INDICATE_ALERT_OFF]             = {LED_CHANNEL_ALERT, LED_SEL_ALERT,                             0,               0,     0,     0},
+    [BSP_INDICATE_USER_STATE_OFF]        = {LED_CHANNEL_STATE, LED_SEL_EXCLUSIVE,                         0,               0,     0,     0},
+    [BSP_INDICATE_USER_STATE_0]          = {LED_CHANNEL_STATE, LED_SEL_0 | LED_SEL_EXCLUSIVE,             LED_STEADY,      0,     0,     0},
+    [BSP_INDICATE_USER_STATE_1]          = {LED_CHANNEL_STATE, LED_SEL_1 | LED_SEL_EXCLUSIVE,             LED_STEADY,      0,     0,     0},
+    [BSP_INDICATE_USER_STATE_2]          = {LED_CHANNEL_STATE, LED_SEL_0 | LED_SEL_1 | LED_SEL_EXCLUSIVE, LED_STEADY,      0,     0,     0},
+    [BSP_INDICATE_USER_STATE_3]          = {LED_CHANNEL_STATE, LED_SEL_ALL | LED_SEL_EXCLUSIVE,           LED_STEADY,      0,     0,     0},
+    [BSP_INDICATE_USER_STATE_ON]         = {LED_CHANNEL_STATE, LED_SEL_ALL | LED_SEL_EXCLUSIVE,           LED_STEADY,      0,     0,     0},
+};
 
-#if LEDS_NUMBER > 0 && !(defined BSP_SIMPLE)
-static bsp_indication_t m_stable_state        = BSP_INDICATE_IDLE;
+static led_channel_t    m_channels[LED_CHANNELS];
 static uint32_t         m_app_ticks_per_100ms = 0;
 static uint32_t         m_indication_type     = 0;
+static uint32_t         m_leds_timer_start;
+static bool             m_leds_timer_running  = false;
 static app_timer_id_t   m_leds_timer_id;
-static app_timer_id_t   m_alert_timer_id;
 #endif // LEDS_NUMBER > 0 && !(defined BSP_SIMPLE)
 
 #if BUTTONS_NUMBER > 0
@@ -102,8 +169,6 @@ static const app_button_cfg_t app_buttons[BUTTONS_NUMBER] =
 #endif // BSP_SIMPLE
 #endif // BUTTONS_NUMBER > 0
 
-#define BSP_MS_TO_TICK(MS) (m_app_ticks_per_100ms * (MS / 100))
-
 #ifdef BSP_LED_2_MASK
 #define ALERT_LED_MASK BSP_LED_2_MASK
 #else
@@ -185,224 +250,261 @@ static void bsp_button_event_handler(uint8_t pin_no, uint8_t button_action)
 #endif // (BUTTONS_NUMBER > 0) && !(defined BSP_SIMPLE)
 
 #if LEDS_NUMBER > 0 && !(defined BSP_SIMPLE)
-/**@brief       Configure leds to indicate required state.
- * @param[in]   indicate   State to be indicated.
+/**@brief       Convert LED_SEL bits to a mask of LEDs.
  */
-static uint32_t bsp_led_indication(bsp_indication_t indicate)
+static uint32_t led_mask(uint8_t leds)
 {
-    uint32_t err_code   = NRF_SUCCESS;
-    uint32_t next_delay = 0;
+    uint32_t mask = 0;
 
-    switch (indicate)
+    if ((leds & LED_SEL_ALL) == LED_SEL_ALL)
     {
-        case BSP_INDICATE_IDLE:
-            LEDS_OFF(LEDS_MASK & ~ALERT_LED_MASK);
-            m_stable_state = indicate;
-            break;
+        return LEDS_MASK;
+    }
 
-        case BSP_INDICATE_SCANNING:
-        case BSP_INDICATE_ADVERTISING:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~ALERT_LED_MASK);
+    if (leds & LED_SEL_0)
+    {
+        mask |= BSP_LED_0_MASK;
+    }
 
-            // in advertising blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING ? ADVERTISING_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING ? ADVERTISING_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
+    if (leds & LED_SEL_1)
+    {
+        mask |= BSP_LED_1_MASK;
+    }
 
-            m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
-            break;
+    if (leds & LED_SEL_ALERT)
+    {
+        mask |= ALERT_LED_MASK;
+    }
 
-        case BSP_INDICATE_ADVERTISING_WHITELIST:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~ALERT_LED_MASK);
+    return mask;
+}
 
-            // in advertising quickly blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_WHITELIST ?
-                             ADVERTISING_WHITELIST_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_WHITELIST ?
-                             ADVERTISING_WHITELIST_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
-            m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
-            break;
 
-        case BSP_INDICATE_ADVERTISING_SLOW:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~ALERT_LED_MASK);
+/**@brief       Convert milliseconds to timer ticks, at least the shortest timeout of the timer.
+ *
+ * @details     Pulses as short as a few ms are timed exactly, rather than in steps of 100 ms.
+ */
+static uint32_t led_ticks(uint32_t ms)
+{
+    uint32_t ticks = (m_app_ticks_per_100ms * ms) / 100;
 
-            // in advertising slowly blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_SLOW ? ADVERTISING_SLOW_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_SLOW ? ADVERTISING_SLOW_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
-            m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
-            break;
+    return (ticks < APP_TIMER_MIN_TIMEOUT_TICKS) ? APP_TIMER_MIN_TIMEOUT_TICKS : ticks;
+}
 
-        case BSP_INDICATE_ADVERTISING_DIRECTED:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~ALERT_LED_MASK);
 
-            // in advertising very quickly blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_DIRECTED ?
-                             ADVERTISING_DIRECTED_LED_OFF_INTERVAL :
-                             ADVERTISING_SLOW_LED_OFF_INTERVAL;
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-                next_delay = indicate ==
-                             BSP_INDICATE_ADVERTISING_DIRECTED ?
-                             ADVERTISING_DIRECTED_LED_ON_INTERVAL :
-                             ADVERTISING_SLOW_LED_ON_INTERVAL;
-            }
-            m_stable_state = indicate;
-            err_code       = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(next_delay), NULL);
-            break;
+/**@brief       Switch the LEDs of a channel.
+ */
+static void led_channel_set(led_channel_t * p_channel, bool on)
+{
+    if (p_channel->invert)
+    {
+        if (on != p_channel->on)
+        {
+            LEDS_INVERT(p_channel->mask);
+        }
+    }
+    else if (on)
+    {
+        LEDS_ON(p_channel->mask);
+    }
+    else
+    {
+        LEDS_OFF(p_channel->mask);
+    }
 
-        case BSP_INDICATE_BONDING:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~ALERT_LED_MASK);
+    p_channel->on = on;
+}
 
-            // in bonding fast blink LED_0
-            if (LED_IS_ON(BSP_LED_0_MASK))
-            {
-                LEDS_OFF(BSP_LED_0_MASK);
-            }
-            else
-            {
-                LEDS_ON(BSP_LED_0_MASK);
-            }
 
-            m_stable_state = indicate;
-            err_code       =
-                app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(BONDING_INTERVAL), NULL);
-            break;
-
-        case BSP_INDICATE_CONNECTED:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK & ~ALERT_LED_MASK);
-            LEDS_ON(BSP_LED_0_MASK);
-            m_stable_state = indicate;
-            break;
-
-        case BSP_INDICATE_SENT_OK:
-            // when sending shortly invert LED_1
-            LEDS_INVERT(BSP_LED_1_MASK);
-            err_code = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(SENT_OK_INTERVAL), NULL);
-            break;
-
-        case BSP_INDICATE_SEND_ERROR:
-            // on receving error invert LED_1 for long time
-            LEDS_INVERT(BSP_LED_1_MASK);
-            err_code = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(SEND_ERROR_INTERVAL), NULL);
-            break;
-
-        case BSP_INDICATE_RCV_OK:
-            // when receving shortly invert LED_1
-            LEDS_INVERT(BSP_LED_1_MASK);
-            err_code = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(RCV_OK_INTERVAL), NULL);
-            break;
-
-        case BSP_INDICATE_RCV_ERROR:
-            // on receving error invert LED_1 for long time
-            LEDS_INVERT(BSP_LED_1_MASK);
-            err_code = app_timer_start(m_leds_timer_id, BSP_MS_TO_TICK(RCV_ERROR_INTERVAL), NULL);
-            break;
-
-        case BSP_INDICATE_FATAL_ERROR:
-            // on fatal error turn on all leds
-            LEDS_ON(LEDS_MASK);
-            break;
-
-        case BSP_INDICATE_ALERT_0:
-        case BSP_INDICATE_ALERT_1:
-        case BSP_INDICATE_ALERT_2:
-        case BSP_INDICATE_ALERT_3:
-        case BSP_INDICATE_ALERT_OFF:
-            err_code   = app_timer_stop(m_alert_timer_id);
-            next_delay = (uint32_t)BSP_INDICATE_ALERT_OFF - (uint32_t)indicate;
-
-            // a little trick to find out that if it did not fall through ALERT_OFF
-            if (next_delay && (err_code == NRF_SUCCESS))
-            {
-                if (next_delay > 1)
-                {
-                    err_code = app_timer_start(m_alert_timer_id, BSP_MS_TO_TICK(
-                                                   (next_delay * ALERT_INTERVAL)), NULL);
-                }
-                LEDS_ON(ALERT_LED_MASK);
-            }
-            else
+/**@brief       Start a pattern on its channel, from the first pulse.
+ */
+static void led_channel_start(led_pattern_t const * p_pattern)
+{
+    led_channel_t * p_channel = &m_channels[p_pattern->channel];
+    uint32_t        mask      = led_mask(p_pattern->leds);
+    uint32_t        limit;
+    uint32_t        i;
+
+    if (p_pattern->leds & LED_SEL_EXCLUSIVE)
+    {
+        for (i = 0; i < LED_CHANNELS; i++)
+        {
+            m_channels[i].due = 0;
+            m_channels[i].on  = false;
+        }
+        LEDS_OFF(LEDS_MASK & ~mask);
+    }
+    else
+    {
+        led_channel_set(p_channel, false);
+        if (p_pattern->channel == LED_CHANNEL_STATE)
+        {
+            LEDS_OFF(LEDS_MASK & ~ALERT_LED_MASK & ~mask);
+        }
+    }
+
+    p_channel->mask   = mask;
+    p_channel->invert = (p_pattern->leds & LED_SEL_INVERT) ? true : false;
+    p_channel->due    = 0;
+
+    if (p_pattern->on_ms == 0)
+    {
+        return;
+    }
+
+    if (p_pattern->period_ms == 0)
+    {
+        // steady: a single pulse as long as the timeout, or no end at all
+        p_channel->on_ticks  = led_ticks(p_pattern->timeout_s * 1000UL);
+        p_channel->off_ticks = 0;
+        p_channel->pulses    = 1;
+    }
+    else
+    {
+        p_channel->on_ticks  = led_ticks(p_pattern->on_ms);
+        p_channel->off_ticks = led_ticks(p_pattern->period_ms - p_pattern->on_ms);
+        p_channel->pulses    = p_pattern->repeat;
+
+        if (p_pattern->timeout_s)
+        {
+            limit = (p_pattern->timeout_s * 1000UL) / p_pattern->period_ms;
+            limit = MAX(limit, 1);
+
+            if ((p_channel->pulses == 0) || (p_channel->pulses > limit))
             {
-                LEDS_OFF(ALERT_LED_MASK);
+                p_channel->pulses = limit;
             }
-            break;
+        }
+    }
+
+    led_channel_set(p_channel, true);
+
+    if ((p_pattern->period_ms != 0) || (p_pattern->timeout_s != 0))
+    {
+        p_channel->due = p_channel->on_ticks;
+    }
+}
+
+
+/**@brief       Make the next edge of a channel: end or start a pulse.
+ */
+static void led_channel_edge(led_channel_t * p_channel)
+{
+    if (p_channel->on)
+    {
+        led_channel_set(p_channel, false);
+
+        if (p_channel->pulses == 1)
+        {
+            p_channel->due = 0;
+            return;
+        }
+
+        if (p_channel->pulses > 1)
+        {
+            p_channel->pulses--;
+        }
+        p_channel->due = p_channel->off_ticks;
+    }
+    else
+    {
+        led_channel_set(p_channel, true);
+        p_channel->due = p_channel->on_ticks;
+    }
+}
+
+
+/**@brief       Move the channels on by the ticks since the timer was started, making the edges due.
+ *
+ * @details     An edge due within the shortest timeout of the timer is made early, as the timer
+ *              could not be started for it.
+ */
+static void leds_advance(void)
+{
+    uint32_t now;
+    uint32_t elapsed = 0;
+    uint32_t i;
+
+    if (!m_leds_timer_running)
+    {
+        return;
+    }
+
+    UNUSED_VARIABLE(app_timer_cnt_get(&now));
+    UNUSED_VARIABLE(app_timer_cnt_diff_compute(now, m_leds_timer_start, &elapsed));
+    m_leds_timer_start = now;
+
+    for (i = 0; i < LED_CHANNELS; i++)
+    {
+        if (m_channels[i].due == 0)
+        {
+            continue;
+        }
+
+        if (m_channels[i].due <= elapsed + APP_TIMER_MIN_TIMEOUT_TICKS)
+        {
+            led_channel_edge(&m_channels[i]);
+        }
+        else
+        {
+            m_channels[i].due -= elapsed;
+        }
+    }
+}
+
+
+/**@brief       (Re)start the timer for the next edge of any channel.
+ *
+ * @details     The timer is left stopped while no pattern has an edge to come, so steady and
+ *              finished indications cost no wakeups.
+ */
+static uint32_t leds_timer_start(void)
+{
+    uint32_t err_code = app_timer_stop(m_leds_timer_id);
+    uint32_t next     = 0;
+    uint32_t i;
 
-        case BSP_INDICATE_USER_STATE_OFF:
-            LEDS_OFF(LEDS_MASK);
-            m_stable_state = indicate;
-            break;
+    m_leds_timer_running = false;
 
-        case BSP_INDICATE_USER_STATE_0:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_0_MASK);
-            LEDS_ON(BSP_LED_0_MASK);
-            m_stable_state = indicate;
-            break;
+    for (i = 0; i < LED_CHANNELS; i++)
+    {
+        if (m_channels[i].due && ((next == 0) || (m_channels[i].due < next)))
+        {
+            next = m_channels[i].due;
+        }
+    }
 
-        case BSP_INDICATE_USER_STATE_1:
-            LEDS_OFF(LEDS_MASK & ~BSP_LED_1_MASK);
-            LEDS_ON(BSP_LED_1_MASK);
-            m_stable_state = indicate;
-            break;
+    if ((err_code == NRF_SUCCESS) && next)
+    {
+        err_code = app_timer_cnt_get(&m_leds_timer_start);
+    }
 
-        case BSP_INDICATE_USER_STATE_2:
-            LEDS_OFF(LEDS_MASK & ~(BSP_LED_0_MASK | BSP_LED_1_MASK));
-            LEDS_ON(BSP_LED_0_MASK | BSP_LED_1_MASK);
-            m_stable_state = indicate;
-            break;
+    if ((err_code == NRF_SUCCESS) && next)
+    {
+        err_code             = app_timer_start(m_leds_timer_id, next, NULL);
+        m_leds_timer_running = (err_code == NRF_SUCCESS);
+    }
 
-        case BSP_INDICATE_USER_STATE_3:
+    return err_code;
+}
 
-        case BSP_INDICATE_USER_STATE_ON:
-            LEDS_ON(LEDS_MASK);
-            m_stable_state = indicate;
-            break;
 
-        default:
-            break;
+/**@brief       Configure leds to indicate required state.
+ * @param[in]   indicate   State to be indicated.
+ */
+static uint32_t bsp_led_indication(bsp_indication_t indicate)
+{
+    uint32_t err_code = NRF_SUCCESS;
+
+    if (indicate <= BSP_INDICATE_LAST)
+    {
+        CRITICAL_REGION_ENTER();
+
+        leds_advance();
+        led_channel_start(&m_patterns[indicate]);
+        err_code = leds_timer_start();
+
+        CRITICAL_REGION_EXIT();
     }
 
     return err_code;
@@ -412,7 +514,7 @@ static uint32_t bsp_led_indication(bsp_indication_t indicate)
 /**@brief Handle events from leds timer.
  *
  * @note Timer handler does not support returning an error code.
- * Errors from bsp_led_indication() are not propagated.
+ * Errors from leds_timer_start() are not propagated.
  *
  * @param[in]   p_context   parameter registered in timer start function.
  */
@@ -422,19 +524,13 @@ static void leds_timer_handler(void * p_context)
 
     if (m_indication_type & BSP_INIT_LED)
     {
-        UNUSED_VARIABLE(bsp_led_indication(m_stable_state));
-    }
-}
+        CRITICAL_REGION_ENTER();
 
+        leds_advance();
+        UNUSED_VARIABLE(leds_timer_start());
 
-/**@brief Handle events from alert timer.
- *
- * @param[in]   p_context   parameter registered in timer start function.
- */
-static void alert_timer_handler(void * p_context)
-{
-    UNUSED_PARAMETER(p_context);
-    LEDS_INVERT(ALERT_LED_MASK);
+        CRITICAL_REGION_EXIT();
+    }
 }
 #endif // #if LEDS_NUMBER > 0 && !(defined BSP_SIMPLE)
 
@@ -534,11 +630,6 @@ uint32_t bsp_init(uint32_t type, uint32_t ticks_per_100ms, bsp_event_callback_t
             app_timer_create(&m_leds_timer_id, APP_TIMER_MODE_SINGLE_SHOT, leds_timer_handler);
     }
 
-    if (err_code == NRF_SUCCESS)
-    {
-        err_code =
-            app_timer_create(&m_alert_timer_id, APP_TIMER_MODE_REPEATED, alert_timer_handler);
-    }
 #endif // LEDS_NUMBER > 0 && !(defined BSP_SIMPLE)
 
     return err_code;
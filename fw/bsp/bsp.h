@@ -19,6 +19,8 @@
  * @brief BSP module.
  * @details This module provides a layer of abstraction from the board.
  *          It allows the user to indicate certain states on LEDs in a simple way.
+ *          Each state is a pattern of pulses, most of them short and ending after
+ *          a timeout, so that the LEDs draw little current.
  *          Module functionality can be modified by additional defines:
  *          - BSP_SIMPLE reduces functionality of this module to enable 
  *            and read state of the buttons
@@ -51,7 +53,7 @@
 /**@def BSP_APP_TIMERS_NUMBER
  * Number of @ref app_timer instances required by BSP with LED support.
  */
-#define BSP_APP_TIMERS_NUMBER 2
+#define BSP_APP_TIMERS_NUMBER 1
 #endif // LEDS_NUMBER > 0
 
 /**@brief Types of BSP initialization.
@@ -221,6 +223,8 @@ uint32_t bsp_event_to_button_assign(uint32_t button, bsp_event_t event);
  * @details     This function indicates the required state by means of LEDs (if enabled).
  *
  * @note        Alerts are indicated independently.
+ * @note        States other than the user states and fatal error are indicated for a limited
+ *              time only, after which their LEDs are switched off until the next indication.
  *
  * @param[in]   indicate   State to be indicated.
  *